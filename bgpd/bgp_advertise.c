@@ -152,6 +152,249 @@ bgp_advertise_unintern (struct hash *hash, struct bgp_advertise_attr *baa)
     }
 }
 
+/* Adjacency index.  Each node keeps its adj_out and adj_in as lists,
+   which is fine for the few peers most prefixes have.  A route server
+   or reflector with hundreds of peers would walk hundreds of entries
+   for every lookup though, so past BGP_ADJ_INDEX_MIN entries a list
+   also gets an open addressed table keyed by peer.  */
+static unsigned int
+bgp_adj_table_hash (struct bgp_adj_table *table, const struct peer *peer)
+{
+  return ((uintptr_t) peer >> 4) * 2654435761U & (table->size - 1);
+}
+
+static void *
+bgp_adj_table_lookup (struct bgp_adj_table *table, const struct peer *peer)
+{
+  unsigned int i;
+
+  for (i = bgp_adj_table_hash (table, peer);
+       table->slot[i].peer;
+       i = (i + 1) & (table->size - 1))
+    if (table->slot[i].peer == peer)
+      return table->slot[i].adj;
+  return NULL;
+}
+
+static void bgp_adj_table_insert (struct bgp_adj_table *, struct peer *,
+                                  void *);
+
+static void
+bgp_adj_table_resize (struct bgp_adj_table *table, unsigned int size)
+{
+  struct bgp_adj_slot *old = table->slot;
+  unsigned int oldsize = table->size;
+  unsigned int i;
+
+  table->size = size;
+  table->count = 0;
+  table->slot = XCALLOC (MTYPE_BGP_ADJ_INDEX,
+                         size * sizeof (struct bgp_adj_slot));
+
+  for (i = 0; i < oldsize; i++)
+    if (old[i].peer)
+      bgp_adj_table_insert (table, old[i].peer, old[i].adj);
+
+  if (old)
+    XFREE (MTYPE_BGP_ADJ_INDEX, old);
+}
+
+static void
+bgp_adj_table_insert (struct bgp_adj_table *table, struct peer *peer,
+                      void *adj)
+{
+  unsigned int i;
+
+  /* Keep at most half full. */
+  if ((table->count + 1) * 2 > table->size)
+    bgp_adj_table_resize (table, table->size * 2);
+
+  for (i = bgp_adj_table_hash (table, peer);
+       table->slot[i].peer;
+       i = (i + 1) & (table->size - 1))
+    ;
+  table->slot[i].peer = peer;
+  table->slot[i].adj = adj;
+  table->count++;
+}
+
+static void
+bgp_adj_table_delete (struct bgp_adj_table *table, struct peer *peer)
+{
+  unsigned int i, j, k;
+  unsigned int mask = table->size - 1;
+
+  for (i = bgp_adj_table_hash (table, peer);
+       table->slot[i].peer != peer;
+       i = (i + 1) & mask)
+    assert (table->slot[i].peer);
+
+  /* Shift back any later entries of the run which could then no
+     longer be reached. */
+  for (j = (i + 1) & mask; table->slot[j].peer; j = (j + 1) & mask)
+    {
+      k = bgp_adj_table_hash (table, table->slot[j].peer);
+      if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j)))
+	{
+	  table->slot[i] = table->slot[j];
+	  i = j;
+	}
+    }
+  table->slot[i].peer = NULL;
+  table->slot[i].adj = NULL;
+  table->count--;
+}
+
+static void
+bgp_adj_table_free (struct bgp_adj_table *table)
+{
+  if (table->slot)
+    XFREE (MTYPE_BGP_ADJ_INDEX, table->slot);
+  table->slot = NULL;
+  table->size = table->count = 0;
+}
+
+static struct bgp_adj_index *
+bgp_adj_index_get (struct bgp_node *rn)
+{
+  if (! rn->adj_index)
+    rn->adj_index = XCALLOC (MTYPE_BGP_ADJ_INDEX,
+                             sizeof (struct bgp_adj_index));
+  return rn->adj_index;
+}
+
+static void
+bgp_adj_index_release (struct bgp_node *rn)
+{
+  struct bgp_adj_index *index = rn->adj_index;
+
+  if (index && ! index->out.size && ! index->in.size)
+    {
+      XFREE (MTYPE_BGP_ADJ_INDEX, index);
+      rn->adj_index = NULL;
+    }
+}
+
+struct bgp_adj_out *
+bgp_adj_out_find (struct bgp_node *rn, const struct peer *peer)
+{
+  struct bgp_adj_out *adj;
+
+  if (rn->adj_index && rn->adj_index->out.size)
+    return bgp_adj_table_lookup (&rn->adj_index->out, peer);
+
+  for (adj = rn->adj_out; adj; adj = adj->next)
+    if (adj->peer == peer)
+      break;
+  return adj;
+}
+
+struct bgp_adj_in *
+bgp_adj_in_find (struct bgp_node *rn, const struct peer *peer)
+{
+  struct bgp_adj_in *adj;
+
+  if (rn->adj_index && rn->adj_index->in.size)
+    return bgp_adj_table_lookup (&rn->adj_index->in, peer);
+
+  for (adj = rn->adj_in; adj; adj = adj->next)
+    if (adj->peer == peer)
+      break;
+  return adj;
+}
+
+static void
+bgp_adj_out_link (struct bgp_node *rn, struct bgp_adj_out *adj)
+{
+  struct bgp_adj_table *table;
+  struct bgp_adj_out *a;
+  unsigned int count = 0;
+
+  BGP_ADJ_OUT_ADD (rn, adj);
+
+  if (rn->adj_index && rn->adj_index->out.size)
+    {
+      bgp_adj_table_insert (&rn->adj_index->out, adj->peer, adj);
+      return;
+    }
+
+  for (a = rn->adj_out; a; a = a->next)
+    if (++count > BGP_ADJ_INDEX_MIN)
+      break;
+  if (count <= BGP_ADJ_INDEX_MIN)
+    return;
+
+  table = &bgp_adj_index_get (rn)->out;
+  bgp_adj_table_resize (table, BGP_ADJ_INDEX_MIN * 4);
+  for (a = rn->adj_out; a; a = a->next)
+    bgp_adj_table_insert (table, a->peer, a);
+}
+
+static void
+bgp_adj_out_unlink (struct bgp_node *rn, struct bgp_adj_out *adj)
+{
+  struct bgp_adj_table *table;
+
+  BGP_ADJ_OUT_DEL (rn, adj);
+
+  if (! rn->adj_index || ! rn->adj_index->out.size)
+    return;
+
+  table = &rn->adj_index->out;
+  bgp_adj_table_delete (table, adj->peer);
+  if (table->count < BGP_ADJ_INDEX_MIN / 2)
+    {
+      bgp_adj_table_free (table);
+      bgp_adj_index_release (rn);
+    }
+}
+
+static void
+bgp_adj_in_link (struct bgp_node *rn, struct bgp_adj_in *adj)
+{
+  struct bgp_adj_table *table;
+  struct bgp_adj_in *a;
+  unsigned int count = 0;
+
+  BGP_ADJ_IN_ADD (rn, adj);
+
+  if (rn->adj_index && rn->adj_index->in.size)
+    {
+      bgp_adj_table_insert (&rn->adj_index->in, adj->peer, adj);
+      return;
+    }
+
+  for (a = rn->adj_in; a; a = a->next)
+    if (++count > BGP_ADJ_INDEX_MIN)
+      break;
+  if (count <= BGP_ADJ_INDEX_MIN)
+    return;
+
+  table = &bgp_adj_index_get (rn)->in;
+  bgp_adj_table_resize (table, BGP_ADJ_INDEX_MIN * 4);
+  for (a = rn->adj_in; a; a = a->next)
+    bgp_adj_table_insert (table, a->peer, a);
+}
+
+static void
+bgp_adj_in_unlink (struct bgp_node *rn, struct bgp_adj_in *adj)
+{
+  struct bgp_adj_table *table;
+
+  BGP_ADJ_IN_DEL (rn, adj);
+
+  if (! rn->adj_index || ! rn->adj_index->in.size)
+    return;
+
+  table = &rn->adj_index->in;
+  bgp_adj_table_delete (table, adj->peer);
+  if (table->count < BGP_ADJ_INDEX_MIN / 2)
+    {
+      bgp_adj_table_free (table);
+      bgp_adj_index_release (rn);
+    }
+}
+
 /* BGP adjacency keeps minimal advertisement information.  */
 static void
 bgp_adj_out_free (struct bgp_adj_out *adj)
@@ -166,9 +409,7 @@ bgp_adj_out_lookup (struct peer *peer, struct prefix *p,
 {
   struct bgp_adj_out *adj;
 
-  for (adj = rn->adj_out; adj; adj = adj->next)
-    if (adj->peer == peer)
-      break;
+  adj = bgp_adj_out_find (rn, peer);
 
   if (! adj)
     return 0;
@@ -225,11 +466,7 @@ bgp_adj_out_set (struct bgp_node *rn, struct peer *peer, struct prefix *p,
 
   /* Look for adjacency information. */
   if (rn)
-    {
-      for (adj = rn->adj_out; adj; adj = adj->next)
-	if (adj->peer == peer)
-	  break;
-    }
+    adj = bgp_adj_out_find (rn, peer);
 
   if (! adj)
     {
@@ -238,7 +475,7 @@ bgp_adj_out_set (struct bgp_node *rn, struct peer *peer, struct prefix *p,
       
       if (rn)
         {
-          BGP_ADJ_OUT_ADD (rn, adj);
+          bgp_adj_out_link (rn, adj);
           bgp_lock_node (rn);
         }
     }
@@ -277,9 +514,7 @@ bgp_adj_out_unset (struct bgp_node *rn, struct peer *peer, struct prefix *p,
     return;
 
   /* Lookup existing adjacency, if it is not there return immediately.  */
-  for (adj = rn->adj_out; adj; adj = adj->next)
-    if (adj->peer == peer)
-      break;
+  adj = bgp_adj_out_find (rn, peer);
 
   if (! adj)
     return;
@@ -305,7 +540,7 @@ bgp_adj_out_unset (struct bgp_node *rn, struct peer *peer, struct prefix *p,
   else
     {
       /* Remove myself from adjacency. */
-      BGP_ADJ_OUT_DEL (rn, adj);
+      bgp_adj_out_unlink (rn, adj);
       
       /* Free allocated information.  */
       bgp_adj_out_free (adj);
@@ -324,7 +559,7 @@ bgp_adj_out_remove (struct bgp_node *rn, struct bgp_adj_out *adj,
   if (adj->adv)
     bgp_advertise_clean (peer, adj, afi, safi);
 
-  BGP_ADJ_OUT_DEL (rn, adj);
+  bgp_adj_out_unlink (rn, adj);
   bgp_adj_out_free (adj);
 }
 
@@ -333,22 +568,20 @@ bgp_adj_in_set (struct bgp_node *rn, struct peer *peer, struct attr *attr)
 {
   struct bgp_adj_in *adj;
 
-  for (adj = rn->adj_in; adj; adj = adj->next)
+  adj = bgp_adj_in_find (rn, peer);
+  if (adj)
     {
-      if (adj->peer == peer)
+      if (adj->attr != attr)
 	{
-	  if (adj->attr != attr)
-	    {
-	      bgp_attr_unintern (&adj->attr);
-	      adj->attr = bgp_attr_intern (attr);
-	    }
-	  return;
+	  bgp_attr_unintern (&adj->attr);
+	  adj->attr = bgp_attr_intern (attr);
 	}
+      return;
     }
   adj = XCALLOC (MTYPE_BGP_ADJ_IN, sizeof (struct bgp_adj_in));
   adj->peer = peer_lock (peer); /* adj_in peer reference */
   adj->attr = bgp_attr_intern (attr);
-  BGP_ADJ_IN_ADD (rn, adj);
+  bgp_adj_in_link (rn, adj);
   bgp_lock_node (rn);
 }
 
@@ -356,7 +589,7 @@ void
 bgp_adj_in_remove (struct bgp_node *rn, struct bgp_adj_in *bai)
 {
   bgp_attr_unintern (&bai->attr);
-  BGP_ADJ_IN_DEL (rn, bai);
+  bgp_adj_in_unlink (rn, bai);
   peer_unlock (bai->peer); /* adj_in peer reference */
   XFREE (MTYPE_BGP_ADJ_IN, bai);
 }
@@ -366,10 +599,7 @@ bgp_adj_in_unset (struct bgp_node *rn, struct peer *peer)
 {
   struct bgp_adj_in *adj;
 
-  for (adj = rn->adj_in; adj; adj = adj->next)
-    if (adj->peer == peer)
-      break;
-
+  adj = bgp_adj_in_find (rn, peer);
   if (! adj)
     return;
 
@@ -394,6 +624,7 @@ bgp_sync_init (struct peer *peer)
 	FIFO_INIT (&sync->withdraw_low);
 	peer->sync[afi][safi] = sync;
 	peer->hash[afi][safi] = hash_create (baa_hash_key, baa_hash_cmp);
+	peer->hash[afi][safi]->name = "BGP advertise attributes";
       }
 }
 
@@ -94,6 +94,30 @@ struct bgp_adj_in
   struct attr *attr;
 };
 
+/* Open addressed table of a node's adjacencies, by peer.  */
+struct bgp_adj_table
+{
+  /* Number of slots, a power of two, or 0 when the list is short
+     enough to just walk.  */
+  unsigned int size;
+  unsigned int count;
+
+  struct bgp_adj_slot
+  {
+    struct peer *peer;
+    void *adj;
+  } *slot;
+};
+
+struct bgp_adj_index
+{
+  struct bgp_adj_table out;
+  struct bgp_adj_table in;
+};
+
+/* Lists longer than this are indexed.  */
+#define BGP_ADJ_INDEX_MIN	8
+
 /* BGP advertisement list.  */
 struct bgp_synchronize
 {
@@ -136,6 +160,10 @@ extern void bgp_adj_out_remove (struct bgp_node *, struct bgp_adj_out *,
 			 struct peer *, afi_t, safi_t);
 extern int bgp_adj_out_lookup (struct peer *, struct prefix *, afi_t, safi_t,
 			struct bgp_node *);
+extern struct bgp_adj_out *bgp_adj_out_find (struct bgp_node *,
+                                             const struct peer *);
+extern struct bgp_adj_in *bgp_adj_in_find (struct bgp_node *,
+                                           const struct peer *);
 
 extern void bgp_adj_in_set (struct bgp_node *, struct peer *, struct attr *);
 extern void bgp_adj_in_unset (struct bgp_node *, struct peer *);
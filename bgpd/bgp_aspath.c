@@ -88,6 +88,9 @@ struct assegment_header
 /* Hash for aspath.  This is the top level structure of AS path. */
 static struct hash *ashash;
 
+/* Last serial number given to an interned path. */
+static unsigned long aspath_serial;
+
 /* Stream for SNMP. See aspath_snmp_pathseg */
 static struct stream *snmp_stream;
 
@@ -628,6 +631,11 @@ aspath_intern (struct aspath *aspath)
   if (find != aspath)
     aspath_free (aspath);
 
+  if (! find->serial)
+    {
+      find->key = aspath_key_make (find);
+      find->serial = ++aspath_serial;
+    }
   find->refcnt++;
 
   if (! find->str)
@@ -807,6 +815,11 @@ aspath_parse (struct stream *s, size_t length, int use32bit)
   
   if (! find)
     return NULL;
+  if (! find->serial)
+    {
+      find->key = aspath_key_make (find);
+      find->serial = ++aspath_serial;
+    }
   find->refcnt++;
 
   return find;
@@ -1803,13 +1816,17 @@ aspath_str2aspath (const char *str)
   return aspath;
 }
 
-/* Make hash value by raw aspath data. */
+/* Make hash value by raw aspath data.  Interned paths never change,
+   so theirs is worked out once, in aspath_intern.  */
 unsigned int
 aspath_key_make (void *p)
 {
   struct aspath * aspath = (struct aspath *) p;
   unsigned int key = 0;
 
+  if (aspath->serial)
+    return aspath->key;
+
   if (!aspath->str)
     aspath_str_update (aspath);
   
@@ -1848,6 +1865,7 @@ void
 aspath_init (void)
 {
   ashash = hash_create_size (32767, aspath_key_make, aspath_cmp);
+  ashash->name = "BGP AS paths";
 }
 
 void
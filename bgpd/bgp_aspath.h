@@ -58,6 +58,13 @@ struct aspath
   /* String expression of AS path.  This string is used by vty output
      and AS path regular expression match.  */
   char *str;
+
+  /* Unique, non-zero number given to the path when it is interned, so
+     results computed for it can be remembered.  */
+  unsigned long serial;
+
+  /* Hash key, saved when the path is interned.  */
+  unsigned int key;
 };
 
 #define ASPATH_STR_DEFAULT_LEN 32
@@ -200,6 +200,7 @@ static void
 cluster_init (void)
 {
   cluster_hash = hash_create (cluster_hash_key_make, cluster_hash_cmp);
+  cluster_hash->name = "BGP cluster lists";
 }
 
 static void
@@ -276,6 +277,7 @@ static void
 transit_init (void)
 {
   transit_hash = hash_create (transit_hash_key_make, transit_hash_cmp);
+  transit_hash->name = "BGP transit attributes";
 }
 
 static void
@@ -432,6 +434,7 @@ static void
 attrhash_init (void)
 {
   attrhash = hash_create (attrhash_key_make, attrhash_cmp);
+  attrhash->name = "BGP attributes";
 }
 
 static void
@@ -885,8 +888,7 @@ bgp_attr_flag_invalid (struct bgp_attr_parser_args *args)
       && CHECK_FLAG (flags, BGP_ATTR_FLAG_TRANS))
     SET_FLAG (mask, BGP_ATTR_FLAG_PARTIAL);
   
-  if ((flags & ~attr_flags_values[attr_code])
-      == attr_flags_values[attr_code])
+  if ((flags & ~mask) == attr_flags_values[attr_code])
     return 0;
   
   bgp_attr_flags_diagnose (args, attr_flags_values[attr_code]);
@@ -23,6 +23,9 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "command.h"
 #include "prefix.h"
 #include "memory.h"
+#include "hash.h"
+#include "jhash.h"
+#include "routemap.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_community.h"
@@ -230,6 +233,47 @@ community_list_get (struct community_list_handler *ch,
   return list;
 }
 
+/* A community or extended community value of a single value entry. */
+struct community_list_value
+{
+  u_char val[ECOMMUNITY_SIZE];
+  struct community_entry *entry;
+};
+
+static unsigned int
+community_list_value_key (void *arg)
+{
+  struct community_list_value *value = arg;
+
+  return jhash (value->val, ECOMMUNITY_SIZE, 0);
+}
+
+static int
+community_list_value_cmp (const void *arg1, const void *arg2)
+{
+  const struct community_list_value *v1 = arg1;
+  const struct community_list_value *v2 = arg2;
+
+  return memcmp (v1->val, v2->val, ECOMMUNITY_SIZE) == 0;
+}
+
+static void *
+community_list_value_alloc (void *arg)
+{
+  struct community_list_value *value;
+
+  value = XMALLOC (MTYPE_COMMUNITY_LIST_VALUE,
+		   sizeof (struct community_list_value));
+  memcpy (value, arg, sizeof (struct community_list_value));
+  return value;
+}
+
+static void
+community_list_value_free (void *arg)
+{
+  XFREE (MTYPE_COMMUNITY_LIST_VALUE, arg);
+}
+
 static void
 community_list_delete (struct community_list *list)
 {
@@ -242,6 +286,12 @@ community_list_delete (struct community_list *list)
       community_entry_free (entry);
     }
 
+  if (list->values)
+    {
+      hash_clean (list->values, community_list_value_free);
+      hash_free (list->values);
+    }
+
   clist = list->parent;
 
   if (list->next)
@@ -255,6 +305,7 @@ community_list_delete (struct community_list *list)
     clist->head = list->next;
 
   community_list_free (list);
+  route_map_cache_flush ();
 }
 
 static int
@@ -276,6 +327,8 @@ community_list_entry_add (struct community_list *list,
   else
     list->head = entry;
   list->tail = entry;
+  list->compiled = 0;
+  route_map_cache_flush ();
 }
 
 /* Delete community-list entry from the list.  */
@@ -294,6 +347,8 @@ community_list_entry_delete (struct community_list *list,
     list->head = entry->next;
 
   community_entry_free (entry);
+  list->compiled = 0;
+  route_map_cache_flush ();
 
   if (community_list_empty_p (list))
     community_list_delete (list);
@@ -420,42 +475,160 @@ community_regexp_delete (struct community *com, regex_t * reg)
   return com;
 }
 
-/* When given community attribute matches to the community-list return
-   1 else return 0.  */
-int
-community_list_match (struct community *com, struct community_list *list)
+/* Most standard entries are of a single community value.  Whether one
+   of those matches only depends on whether the value is in the route's
+   communities, so they are put in a hash by value.  A route's values
+   are then looked up there to find the first such entry which matches,
+   and only the other entries before it need to be tried in turn.  */
+static void
+community_list_compile (struct community_list *list)
 {
   struct community_entry *entry;
+  struct community_entry **tail;
+  struct community_list_value value;
+  int pos = 0;
+
+  if (list->compiled)
+    return;
 
+  if (list->values)
+    hash_clean (list->values, community_list_value_free);
+  else
+    {
+      list->values = hash_create (community_list_value_key,
+				  community_list_value_cmp);
+      list->values->name = "BGP community-list values";
+    }
+
+  tail = &list->scan;
   for (entry = list->head; entry; entry = entry->next)
     {
-      if (entry->any)
-        return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
+      entry->pos = pos++;
+      entry->next_scan = NULL;
+      memset (&value, 0, sizeof (struct community_list_value));
+      value.entry = entry;
+
+      if (! entry->any && entry->style == COMMUNITY_LIST_STANDARD
+	  && entry->u.com->size == 1
+	  && ! community_include (entry->u.com, COMMUNITY_INTERNET))
+	memcpy (value.val, com_nthval (entry->u.com, 0), sizeof (u_int32_t));
+      else if (! entry->any && entry->style == EXTCOMMUNITY_LIST_STANDARD
+	       && entry->u.ecom->size == 1)
+	memcpy (value.val, entry->u.ecom->val, ECOMMUNITY_SIZE);
+      else
+	{
+	  *tail = entry;
+	  tail = &entry->next_scan;
+	  continue;
+	}
 
-      if (entry->style == COMMUNITY_LIST_STANDARD)
-        {
-          if (community_include (entry->u.com, COMMUNITY_INTERNET))
-            return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
+      /* The first entry of a value is the one which applies. */
+      hash_get (list->values, &value, community_list_value_alloc);
+    }
+  *tail = NULL;
 
-          if (community_match (com, entry->u.com))
-            return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-        }
-      else if (entry->style == COMMUNITY_LIST_EXPANDED)
-        {
-          if (community_regexp_match (com, entry->reg))
-            return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-        }
+  list->compiled = 1;
+}
+
+/* The earliest single value entry whose value is val, if it is before
+   best. */
+static struct community_entry *
+community_list_value_lookup (struct community_list *list, const void *val,
+			     size_t size, struct community_entry *best)
+{
+  struct community_list_value value;
+  struct community_list_value *found;
+
+  memset (value.val, 0, ECOMMUNITY_SIZE);
+  memcpy (value.val, val, size);
+
+  found = hash_lookup (list->values, &value);
+  if (found && (! best || found->entry->pos < best->pos))
+    return found->entry;
+  return best;
+}
+
+/* Does one of the entries not in the value hash match? */
+static int
+community_entry_match (struct community_entry *entry, struct community *com,
+		       int exact)
+{
+  if (entry->any)
+    return 1;
+
+  switch (entry->style)
+    {
+    case COMMUNITY_LIST_STANDARD:
+      if (community_include (entry->u.com, COMMUNITY_INTERNET))
+	return 1;
+      if (exact)
+	return community_cmp (com, entry->u.com);
+      return community_match (com, entry->u.com);
+    case COMMUNITY_LIST_EXPANDED:
+      return community_regexp_match (com, entry->reg);
+    default:
+      return 0;
     }
+}
+
+/* Find the first entry matching com, with or without exact matching of
+   standard entries, and return 1 if it permits. */
+static int
+community_list_match_common (struct community *com,
+			     struct community_list *list, int exact)
+{
+  struct community_entry *entry;
+  struct community_entry *best = NULL;
+  int i;
+
+  community_list_compile (list);
+
+  if (com && (! exact || com->size == 1))
+    for (i = 0; i < com->size; i++)
+      best = community_list_value_lookup (list, com_nthval (com, i),
+					  sizeof (u_int32_t), best);
+
+  for (entry = list->scan; entry; entry = entry->next_scan)
+    {
+      if (best && entry->pos > best->pos)
+	break;
+      if (community_entry_match (entry, com, exact))
+	return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
+    }
+
+  if (best)
+    return best->direct == COMMUNITY_PERMIT ? 1 : 0;
   return 0;
 }
 
+/* When given community attribute matches to the community-list return
+   1 else return 0.  */
+int
+community_list_match (struct community *com, struct community_list *list)
+{
+  return community_list_match_common (com, list, 0);
+}
+
 int
 ecommunity_list_match (struct ecommunity *ecom, struct community_list *list)
 {
   struct community_entry *entry;
+  struct community_entry *best = NULL;
+  int i;
 
-  for (entry = list->head; entry; entry = entry->next)
+  community_list_compile (list);
+
+  if (ecom)
+    for (i = 0; i < ecom->size; i++)
+      best = community_list_value_lookup (list,
+					  ecom->val + i * ECOMMUNITY_SIZE,
+					  ECOMMUNITY_SIZE, best);
+
+  for (entry = list->scan; entry; entry = entry->next_scan)
     {
+      if (best && entry->pos > best->pos)
+	break;
+
       if (entry->any)
         return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
 
@@ -470,6 +643,9 @@ ecommunity_list_match (struct ecommunity *ecom, struct community_list *list)
             return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
         }
     }
+
+  if (best)
+    return best->direct == COMMUNITY_PERMIT ? 1 : 0;
   return 0;
 }
 
@@ -479,28 +655,7 @@ int
 community_list_exact_match (struct community *com,
                             struct community_list *list)
 {
-  struct community_entry *entry;
-
-  for (entry = list->head; entry; entry = entry->next)
-    {
-      if (entry->any)
-        return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-
-      if (entry->style == COMMUNITY_LIST_STANDARD)
-        {
-          if (community_include (entry->u.com, COMMUNITY_INTERNET))
-            return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-
-          if (community_cmp (com, entry->u.com))
-            return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-        }
-      else if (entry->style == COMMUNITY_LIST_EXPANDED)
-        {
-          if (community_regexp_match (com, entry->reg))
-            return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-        }
-    }
-  return 0;
+  return community_list_match_common (com, list, 1);
 }
 
 /* Delete all permitted communities in the list from com.  */
@@ -58,6 +58,13 @@ struct community_list
   /* Community-list entry in this community-list.  */
   struct community_entry *head;
   struct community_entry *tail;
+
+  /* Standard entries of one community value, other than internet, by
+     value.  The other entries are chained from scan in list order.
+     Rebuilt by community_list_compile () when compiled is clear.  */
+  struct hash *values;
+  struct community_entry *scan;
+  u_char compiled;
 };
 
 /* Each entry in community-list.  */
@@ -87,6 +94,10 @@ struct community_entry
 
   /* Expanded community-list regular expression.  */
   regex_t *reg;
+
+  /* Position in the list, and the next entry to scan, when compiled.  */
+  int pos;
+  struct community_entry *next_scan;
 };
 
 /* Linked list of community-list.  */
@@ -22,12 +22,16 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 
 #include "hash.h"
 #include "memory.h"
+#include "jhash.h"
 
 #include "bgpd/bgp_community.h"
 
 /* Hash of community attribute. */
 static struct hash *comhash;
 
+/* Last serial number given to an interned community.  */
+static unsigned long community_serial;
+
 /* Allocate a new communities value.  */
 static struct community *
 community_new (void)
@@ -309,13 +313,16 @@ community_intern (struct community *com)
   if (find != com)
     community_free (com);
 
+  if (! find->serial)
+    {
+      find->key = community_hash_make (find);
+      find->serial = ++community_serial;
+    }
+
   /* Increment refrence counter.  */
   find->refcnt++;
 
-  /* Make string.  */
-  if (! find->str)
-    find->str = community_com2str (find);
-
+  /* The string is made by community_str () when needed.  */
   return find;
 }
 
@@ -390,21 +397,15 @@ community_str (struct community *com)
 }
 
 /* Make hash value of community attribute. This function is used by
-   hash package.*/
+   hash package.  An interned community returns the key saved by
+   community_intern.  */
 unsigned int
 community_hash_make (struct community *com)
 {
-  int c;
-  unsigned int key;
-  unsigned char *pnt;
+  if (com->serial)
+    return com->key;
 
-  key = 0;
-  pnt = (unsigned char *)com->val;
-  
-  for(c = 0; c < com->size * 4; c++)
-    key += pnt[c];
-      
-  return key;
+  return jhash2 (com->val, com->size, 0);
 }
 
 int
@@ -636,6 +637,7 @@ community_init (void)
 {
   comhash = hash_create ((unsigned int (*) (void *))community_hash_make,
 			 (int (*) (const void *, const void *))community_cmp);
+  comhash->name = "BGP communities";
 }
 
 void
@@ -36,6 +36,10 @@ struct community
   /* String of community attribute.  This sring is used by vty output
      and expanded community-list for regular expression match.  */
   char *str;
+  /* Unique, non-zero number given when interned.  */
+  unsigned long serial;
+  /* Hash key, saved when interned.  */
+  unsigned int key;
 };
 
 /* Well-known communities value.  */
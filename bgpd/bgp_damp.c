@@ -47,10 +47,12 @@ static struct bgp_damp_config *damp = &bgp_damp_cfg;
 static int
 bgp_reuse_index (int penalty)
 {
-  unsigned int i;
+  u_int64_t i = 0;
   int index;
 
-  i = (int)(((double) penalty / damp->reuse_limit - 1.0) * damp->scale_factor);
+  if ((unsigned int) penalty > damp->reuse_limit)
+    i = ((u_int64_t) (penalty - damp->reuse_limit) * damp->reuse_scale_factor)
+        >> BGP_DAMP_SCALE_SHIFT;
   
   if ( i >= damp->reuse_index_size )
     i = damp->reuse_index_size - 1;
@@ -93,7 +95,7 @@ bgp_damp_decay (time_t tdiff, int penalty)
 {
   unsigned int i;
 
-  i = (int) ((double) tdiff / DELTA_T);
+  i = tdiff / DELTA_T;
 
   if (i == 0)
     return penalty; 
@@ -101,39 +103,31 @@ bgp_damp_decay (time_t tdiff, int penalty)
   if (i >= damp->decay_array_size)
     return 0;
 
-  return (int) (penalty * damp->decay_array[i]);
+  return ((u_int64_t) penalty * damp->decay_array[i]) >> BGP_DAMP_DECAY_SHIFT;
 }
 
-/* Handler of reuse timer event.  Each route in the current reuse-list
-   is evaluated.  RFC2439 Section 4.8.7.  */
+/* The reuse sweep.  Each route the reuse timer took off the current
+   reuse-list is evaluated, as many as fit in a time slice at a time.
+   Reused routes only have their node queued for processing, so that
+   the nodes of a whole slice go through the process queue together.  */
 static int
-bgp_reuse_timer (struct thread *t)
+bgp_reuse_sweep (struct thread *t)
 {
   struct bgp_damp_info *bdi;
-  struct bgp_damp_info *next;
+  struct bgp_damp_info **sweep = &damp->reuse_list[damp->reuse_list_size];
+  struct timeval now;
   time_t t_now, t_diff;
-    
-  damp->t_reuse = NULL;
-  damp->t_reuse =
-    thread_add_timer (master, bgp_reuse_timer, NULL, DELTA_REUSE);
 
-  t_now = bgp_clock ();
+  damp->t_reuse_sweep = NULL;
 
-  /* 1.  save a pointer to the current zeroth queue head and zero the
-     list head entry.  */
-  bdi = damp->reuse_list[damp->reuse_offset];
-  damp->reuse_list[damp->reuse_offset] = NULL;
-
-  /* 2.  set offset = modulo reuse-list-size ( offset + 1 ), thereby
-     rotating the circular queue of list-heads.  */
-  damp->reuse_offset = (damp->reuse_offset + 1) % damp->reuse_list_size;
+  t_now = bgp_clock ();
 
-  /* 3. if ( the saved list head pointer is non-empty ) */
-  for (; bdi; bdi = next)
+  while ((bdi = *sweep) != NULL)
     {
       struct bgp *bgp = bdi->binfo->peer->bgp;
       
-      next = bdi->next;
+      bgp_reuse_list_delete (bdi);
+      damp->sweep_paths++;
 
       /* Set t-diff = t-now - t-updated.  */
       t_diff = t_now - bdi->t_updated;
@@ -150,6 +144,7 @@ bgp_reuse_timer (struct thread *t)
 	  /* Reuse the route.  */
 	  bgp_info_unset_flag (bdi->rn, bdi->binfo, BGP_INFO_DAMPED);
 	  bdi->suppress_time = 0;
+	  damp->sweep_reused++;
 
 	  if (bdi->lastrecord == BGP_RECORD_UPDATE)
 	    {
@@ -159,14 +154,77 @@ bgp_reuse_timer (struct thread *t)
 	      bgp_process (bgp, bdi->rn, bdi->afi, bdi->safi);
 	    }
 
-	  if (bdi->penalty <= damp->reuse_limit / 2.0)
+	  BGP_DAMP_LIST_ADD (damp, bdi);
+	  if (bdi->penalty * 2 <= damp->reuse_limit)
 	    bgp_damp_info_free (bdi, 1);
-	  else
-	    BGP_DAMP_LIST_ADD (damp, bdi);
 	}
       else
 	/* Re-insert into another list (See RFC2439 Section 4.8.6).  */
 	bgp_reuse_list_add (bdi);
+
+      if (*sweep && thread_should_yield (t))
+	{
+	  damp->t_reuse_sweep =
+	    thread_add_background (master, bgp_reuse_sweep, NULL, 0);
+	  return 0;
+	}
+    }
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  damp->sweep_time = (now.tv_sec - damp->sweep_start.tv_sec) * 1000000
+                     + (now.tv_usec - damp->sweep_start.tv_usec);
+  if (damp->sweep_time > damp->sweep_time_max)
+    damp->sweep_time_max = damp->sweep_time;
+  damp->sweeps++;
+
+  return 0;
+}
+
+/* Handler of reuse timer event.  The routes in the current reuse-list
+   are handed to the reuse sweep.  RFC2439 Section 4.8.7.  */
+static int
+bgp_reuse_timer (struct thread *t)
+{
+  struct bgp_damp_info *bdi;
+  struct bgp_damp_info *last;
+  struct bgp_damp_info **sweep = &damp->reuse_list[damp->reuse_list_size];
+    
+  damp->t_reuse = NULL;
+  damp->t_reuse =
+    thread_add_timer (master, bgp_reuse_timer, NULL, DELTA_REUSE);
+
+  /* 1.  save a pointer to the current zeroth queue head and zero the
+     list head entry.  */
+  bdi = damp->reuse_list[damp->reuse_offset];
+  damp->reuse_list[damp->reuse_offset] = NULL;
+
+  /* 2.  set offset = modulo reuse-list-size ( offset + 1 ), thereby
+     rotating the circular queue of list-heads.  */
+  damp->reuse_offset = (damp->reuse_offset + 1) % damp->reuse_list_size;
+
+  /* 3. if ( the saved list head pointer is non-empty ) */
+  if (! bdi)
+    return 0;
+
+  /* Put them on the sweep's list, ahead of any left from last time.  */
+  for (last = bdi; ; last = last->next)
+    {
+      last->index = damp->reuse_list_size;
+      if (! last->next)
+	break;
+    }
+  last->next = *sweep;
+  if (*sweep)
+    (*sweep)->prev = last;
+  *sweep = bdi;
+
+  if (! damp->t_reuse_sweep)
+    {
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &damp->sweep_start);
+      damp->sweep_paths = 0;
+      damp->sweep_reused = 0;
+      damp->t_reuse_sweep =
+	thread_add_background (master, bgp_reuse_sweep, NULL, 0);
     }
 
   return 0;
@@ -197,6 +255,7 @@ bgp_damp_withdraw (struct bgp_info *binfo, struct bgp_node *rn,
          3. withdraw the route.  */
 
       bdi =  XCALLOC (MTYPE_BGP_DAMP_INFO, sizeof (struct bgp_damp_info));
+      damp->info_count++;
       bdi->binfo = binfo;
       bdi->rn = rn;
       bdi->penalty = (attr_change ? DEFAULT_PENALTY / 2 : DEFAULT_PENALTY);
@@ -289,7 +348,7 @@ bgp_damp_update (struct bgp_info *binfo, struct bgp_node *rn,
   else
     status = BGP_DAMP_SUPPRESSED;  
 
-  if (bdi->penalty > damp->reuse_limit / 2.0)
+  if (bdi->penalty * 2 > damp->reuse_limit)
     bdi->t_updated = t_now;
   else
     bgp_damp_info_free (bdi, 0);
@@ -334,7 +393,7 @@ bgp_damp_scan (struct bgp_info *binfo, afi_t afi, safi_t safi)
       t_diff = t_now - bdi->t_updated;
       bdi->penalty = bgp_damp_decay (t_diff, bdi->penalty);
 
-      if (bdi->penalty <= damp->reuse_limit / 2.0)
+      if (bdi->penalty * 2 <= damp->reuse_limit)
         {
           /* release the bdi, bdi->binfo. */  
           bgp_damp_info_free (bdi, 1);
@@ -368,6 +427,7 @@ bgp_damp_info_free (struct bgp_damp_info *bdi, int withdraw)
     bgp_info_delete (bdi->rn, binfo);
   
   XFREE (MTYPE_BGP_DAMP_INFO, bdi);
+  damp->info_count--;
 }
 
 static void
@@ -375,7 +435,7 @@ bgp_damp_parameter_set (int hlife, int reuse, int sup, int maxsup)
 {
   double reuse_max_ratio;
   unsigned int i;
-  double j;
+  double j, decay;
 	
   damp->suppress_value = sup;
   damp->half_life = hlife;
@@ -390,13 +450,15 @@ bgp_damp_parameter_set (int hlife, int reuse, int sup, int maxsup)
   /* Decay-array computations */
   damp->decay_array_size = ceil ((double) damp->max_suppress_time / DELTA_T);
   damp->decay_array = XMALLOC (MTYPE_BGP_DAMP_ARRAY,
-			       sizeof(double) * (damp->decay_array_size));
-  damp->decay_array[0] = 1.0;
-  damp->decay_array[1] = exp ((1.0/((double)damp->half_life/DELTA_T)) * log(0.5));
+			       sizeof(u_int32_t) * (damp->decay_array_size));
+  decay = exp ((1.0/((double)damp->half_life/DELTA_T)) * log(0.5));
 
   /* Calculate decay values for all possible times */
-  for (i = 2; i < damp->decay_array_size; i++)
-    damp->decay_array[i] = damp->decay_array[i-1] * damp->decay_array[1];
+  for (i = 0, j = BGP_DAMP_DECAY_ONE; i < damp->decay_array_size; i++)
+    {
+      damp->decay_array[i] = j + 0.5;
+      j *= decay;
+    }
 	
   /* Reuse-list computations */
   i = ceil ((double)damp->max_suppress_time / DELTA_REUSE) + 1;
@@ -405,8 +467,8 @@ bgp_damp_parameter_set (int hlife, int reuse, int sup, int maxsup)
   damp->reuse_list_size = i; 
 
   damp->reuse_list = XCALLOC (MTYPE_BGP_DAMP_ARRAY, 
-			      damp->reuse_list_size 
-			      * sizeof (struct bgp_reuse_node *));
+			      (damp->reuse_list_size + 1)
+			      * sizeof (struct bgp_damp_info *));
 
   /* Reuse-array computations */
   damp->reuse_index = XCALLOC (MTYPE_BGP_DAMP_ARRAY,
@@ -419,6 +481,13 @@ bgp_damp_parameter_set (int hlife, int reuse, int sup, int maxsup)
 
   damp->scale_factor = (double)damp->reuse_index_size/(reuse_max_ratio - 1);
 
+  /* A small ratio gives a negative scale, which puts every route on
+     the last reuse list.  */
+  j = damp->scale_factor * (1 << BGP_DAMP_SCALE_SHIFT) / damp->reuse_limit;
+  if (j < 0 || j > UINT_MAX)
+    j = UINT_MAX;
+  damp->reuse_scale_factor = j;
+
   for (i = 0; i < damp->reuse_index_size; i++)
     {
       damp->reuse_index[i] = 
@@ -474,7 +543,8 @@ bgp_damp_info_clean (void)
 
   damp->reuse_offset = 0;
 
-  for (i = 0; i < damp->reuse_list_size; i++)
+  /* Including the routes the reuse sweep has yet to look at.  */
+  for (i = 0; i <= damp->reuse_list_size; i++)
     {
       if (! damp->reuse_list[i])
 	continue;
@@ -502,6 +572,7 @@ bgp_damp_disable (struct bgp *bgp, afi_t afi, safi_t safi)
   if (damp->t_reuse )
     thread_cancel (damp->t_reuse);
   damp->t_reuse = NULL;
+  THREAD_OFF (damp->t_reuse_sweep);
 
   /* Clean BGP dampening information.  */
   bgp_damp_info_clean ();
@@ -545,7 +616,7 @@ bgp_get_reuse_time (unsigned int penalty, char *buf, size_t len)
 
   if (penalty > damp->reuse_limit)
     {
-      reuse_time = (int) (DELTA_T * ((log((double)damp->reuse_limit/penalty))/(log(damp->decay_array[1])))); 
+      reuse_time = (int) (damp->half_life * ((log((double)damp->reuse_limit/penalty))/(log(0.5)))); 
 
       if (reuse_time > damp->max_suppress_time)
 	reuse_time = damp->max_suppress_time;
@@ -635,3 +706,36 @@ bgp_damp_reuse_time_vty (struct vty *vty, struct bgp_info *binfo,
 
   return  bgp_get_reuse_time (penalty, timebuf, len);
 }
+
+void
+bgp_damp_show_statistics (struct vty *vty)
+{
+  unsigned long bytes;
+
+  if (! damp->decay_array)
+    {
+      vty_out (vty, "Dampening is not enabled%s", VTY_NEWLINE);
+      return;
+    }
+
+  bytes = damp->info_count * sizeof (struct bgp_damp_info)
+          + damp->decay_array_size * sizeof (u_int32_t)
+          + damp->reuse_index_size * sizeof (int)
+          + (damp->reuse_list_size + 1) * sizeof (struct bgp_damp_info *);
+
+  vty_out (vty, "Half-life %ld min, reuse %u, suppress %u, "
+           "max-suppress %ld min%s",
+           damp->half_life / 60, damp->reuse_limit, damp->suppress_value,
+           damp->max_suppress_time / 60, VTY_NEWLINE);
+  vty_out (vty, "Paths with dampening information: %lu, using %lu bytes%s",
+           damp->info_count, bytes, VTY_NEWLINE);
+  vty_out (vty, "Reuse sweeps: %lu, longest %lu ms%s",
+           damp->sweeps, damp->sweep_time_max / 1000, VTY_NEWLINE);
+  if (damp->t_reuse_sweep)
+    vty_out (vty, "  Sweep in progress: %lu paths, %lu reused so far%s",
+             damp->sweep_paths, damp->sweep_reused, VTY_NEWLINE);
+  else if (damp->sweeps)
+    vty_out (vty, "  Last sweep: %lu paths, %lu reused, in %lu ms%s",
+             damp->sweep_paths, damp->sweep_reused,
+             damp->sweep_time / 1000, VTY_NEWLINE);
+}
@@ -91,15 +91,16 @@ struct bgp_damp_config
   unsigned int decay_rate_per_tick;	/* Calculated from half-life */
   unsigned int decay_array_size; /* Calculated using config parameters */
   double scale_factor;
-  unsigned int reuse_scale_factor; 
+  unsigned int reuse_scale_factor; /* scale_factor / reuse_limit, fixed point */
          
-  /* Decay array per-set based. */ 
-  double *decay_array;	
+  /* Decay array per-set based, fractions of BGP_DAMP_DECAY_ONE. */ 
+  u_int32_t *decay_array;	
 
   /* Reuse index array per-set based. */ 
   int *reuse_index;
 
-  /* Reuse list array per-set based. */  
+  /* Reuse list array per-set based.  There is one more list than
+     reuse_list_size, for the routes the reuse sweep has yet to look at.  */
   struct bgp_damp_info **reuse_list;
   int reuse_offset;
         
@@ -108,6 +109,18 @@ struct bgp_damp_config
 
   /* Reuse timer thread per-set base. */
   struct thread* t_reuse;
+
+  /* Reuse sweep, run in the background when the timer fires. */
+  struct thread *t_reuse_sweep;
+
+  /* Statistics. */
+  unsigned long info_count;		/* Routes with dampening info */
+  unsigned long sweeps;			/* Reuse sweeps run */
+  unsigned long sweep_paths;		/* Routes looked at by the last one */
+  unsigned long sweep_reused;		/* Routes it reused */
+  unsigned long sweep_time;		/* How long it took, in usec */
+  unsigned long sweep_time_max;
+  struct timeval sweep_start;
 };
 
 #define BGP_DAMP_NONE           0
@@ -120,6 +133,13 @@ struct bgp_damp_config
 /* Time granularity for decay arrays */
 #define DELTA_T 	           5
 
+/* Decay factors are fixed point, with this as 1.0 */
+#define BGP_DAMP_DECAY_SHIFT      24
+#define BGP_DAMP_DECAY_ONE      (1U << BGP_DAMP_DECAY_SHIFT)
+
+/* reuse_scale_factor is fixed point, with this as 1.0 */
+#define BGP_DAMP_SCALE_SHIFT      16
+
 #define DEFAULT_PENALTY         1000
 
 #define DEFAULT_HALF_LIFE         15
@@ -141,6 +161,7 @@ extern void bgp_damp_info_clean (void);
 extern int bgp_damp_decay (time_t, int);
 extern void bgp_config_write_damp (struct vty *);
 extern void bgp_damp_info_vty (struct vty *, struct bgp_info *);
+extern void bgp_damp_show_statistics (struct vty *);
 extern const char * bgp_damp_reuse_time_vty (struct vty *, struct bgp_info *,
                                              char *, size_t);
 
@@ -73,8 +73,19 @@ struct bgp_dump
   char *interval_str;
 
   struct thread *t_interval;
+
+  /* Table dump in progress.  The node to carry on from is kept locked,
+     as is the table it is in. */
+  struct thread *t_routes;
+  struct bgp_table *table;
+  struct bgp_node *rn;
+  afi_t afi;
+  unsigned int seq;
 };
 
+/* Table dumps are written through a stdio buffer this big. */
+#define BGP_DUMP_ROUTES_BUFSIZ	(256 * 1024)
+
 /* BGP packet dump output buffer. */
 struct stream *bgp_dump_obuf;
 
@@ -87,8 +98,9 @@ struct bgp_dump bgp_dump_updates;
 /* BGP dump structure for 'dump bgp routes' */
 struct bgp_dump bgp_dump_routes;
 
-/* Dump whole BGP table is very heavy process.  */
-struct thread *t_bgp_dump_routes;
+/* Peers which are in the peer index table of the table dump in progress
+   are marked with this. */
+static u_int32_t bgp_dump_routes_gen;
 
 /* Some define for BGP packet dump. */
 static FILE *
@@ -133,6 +145,10 @@ bgp_dump_open_file (struct bgp_dump *bgp_dump)
     }
   umask(oldumask);  
 
+  /* A table dump is written a record at a time, let stdio gather them. */
+  if (bgp_dump->type == BGP_DUMP_ROUTES)
+    setvbuf (bgp_dump->fp, NULL, _IOFBF, BGP_DUMP_ROUTES_BUFSIZ);
+
   return bgp_dump->fp;
 }
 
@@ -220,8 +236,8 @@ bgp_dump_routes_index_table(struct bgp *bgp)
       stream_putw(obuf, 0);
     }
 
-  /* Peer count */
-  stream_putw (obuf, listcount(bgp->peer));
+  /* Peer count, with peer_self for the routes originated here */
+  stream_putw (obuf, listcount(bgp->peer) + 1);
 
   /* Walk down all peers */
   for(ALL_LIST_ELEMENTS_RO (bgp->peer, node, peer))
@@ -261,125 +277,240 @@ bgp_dump_routes_index_table(struct bgp *bgp)
 
       /* Store the peer number for this peer */
       peer->table_dump_index = peerno;
+      peer->table_dump_gen = bgp_dump_routes_gen;
       peerno++;
     }
 
+  /* peer_self, which has no address: network, redistribute and
+     aggregate routes are dumped as from this router itself. */
+  stream_putc (obuf, TABLE_DUMP_V2_PEER_INDEX_TABLE_AS4+TABLE_DUMP_V2_PEER_INDEX_TABLE_IP);
+  stream_put_in_addr (obuf, &bgp->router_id);
+  stream_putl (obuf, 0);
+  stream_putl (obuf, bgp->as);
+  bgp->peer_self->table_dump_index = peerno;
+  bgp->peer_self->table_dump_gen = bgp_dump_routes_gen;
+
   bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
 
   fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump_routes.fp);
-  fflush (bgp_dump_routes.fp);
 }
 
 
-/* Runs under child process. */
+/* Write the RIB entry record for one prefix.  Returns the sequence
+   number of the next record. */
 static unsigned int
-bgp_dump_routes_func (int afi, int first_run, unsigned int seq)
+bgp_dump_routes_node (struct bgp_node *rn, afi_t afi, unsigned int seq)
 {
   struct stream *obuf;
   struct bgp_info *info;
-  struct bgp_node *rn;
-  struct bgp *bgp;
-  struct bgp_table *table;
-
-  bgp = bgp_get_default ();
-  if (!bgp)
-    return seq;
-
-  if (bgp_dump_routes.fp == NULL)
-    return seq;
-
-  /* Note that bgp_dump_routes_index_table will do ipv4 and ipv6 peers,
-     so this should only be done on the first call to bgp_dump_routes_func.
-     ( this function will be called once for ipv4 and once for ipv6 ) */
-  if(first_run)
-    bgp_dump_routes_index_table(bgp);
 
   obuf = bgp_dump_obuf;
   stream_reset(obuf);
 
-  /* Walk down each BGP route. */
-  table = bgp->rib[afi][SAFI_UNICAST];
-
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+  /* MRT header */
+  if (afi == AFI_IP)
     {
-      if(!rn->info)
-        continue;
-
-      stream_reset(obuf);
-
-      /* MRT header */
-      if (afi == AFI_IP)
-        {
-          bgp_dump_header (obuf, MSG_TABLE_DUMP_V2, TABLE_DUMP_V2_RIB_IPV4_UNICAST);
-        }
+      bgp_dump_header (obuf, MSG_TABLE_DUMP_V2, TABLE_DUMP_V2_RIB_IPV4_UNICAST);
+    }
 #ifdef HAVE_IPV6
-      else if (afi == AFI_IP6)
-        {
-          bgp_dump_header (obuf, MSG_TABLE_DUMP_V2, TABLE_DUMP_V2_RIB_IPV6_UNICAST);
-        }
+  else if (afi == AFI_IP6)
+    {
+      bgp_dump_header (obuf, MSG_TABLE_DUMP_V2, TABLE_DUMP_V2_RIB_IPV6_UNICAST);
+    }
 #endif /* HAVE_IPV6 */
 
-      /* Sequence number */
-      stream_putl(obuf, seq);
+  /* Sequence number */
+  stream_putl(obuf, seq);
 
-      /* Prefix length */
-      stream_putc (obuf, rn->p.prefixlen);
+  /* Prefix length */
+  stream_putc (obuf, rn->p.prefixlen);
 
-      /* Prefix */
-      if (afi == AFI_IP)
-        {
-          /* We'll dump only the useful bits (those not 0), but have to align on 8 bits */
-          stream_write(obuf, (u_char *)&rn->p.u.prefix4, (rn->p.prefixlen+7)/8);
-        }
+  /* Prefix */
+  if (afi == AFI_IP)
+    {
+      /* We'll dump only the useful bits (those not 0), but have to align on 8 bits */
+      stream_write(obuf, (u_char *)&rn->p.u.prefix4, (rn->p.prefixlen+7)/8);
+    }
 #ifdef HAVE_IPV6
-      else if (afi == AFI_IP6)
-        {
-          /* We'll dump only the useful bits (those not 0), but have to align on 8 bits */
-          stream_write (obuf, (u_char *)&rn->p.u.prefix6, (rn->p.prefixlen+7)/8);
-        }
+  else if (afi == AFI_IP6)
+    {
+      /* We'll dump only the useful bits (those not 0), but have to align on 8 bits */
+      stream_write (obuf, (u_char *)&rn->p.u.prefix6, (rn->p.prefixlen+7)/8);
+    }
 #endif /* HAVE_IPV6 */
 
-      /* Save where we are now, so we can overwride the entry count later */
-      int sizep = stream_get_endp(obuf);
+  /* Save where we are now, so we can overwride the entry count later */
+  int sizep = stream_get_endp(obuf);
 
-      /* Entry count */
-      uint16_t entry_count = 0;
+  /* Entry count */
+  uint16_t entry_count = 0;
 
-      /* Entry count, note that this is overwritten later */
-      stream_putw(obuf, 0);
+  /* Entry count, note that this is overwritten later */
+  stream_putw(obuf, 0);
 
-      for (info = rn->info; info; info = info->next)
-        {
-          entry_count++;
+  for (info = rn->info; info; info = info->next)
+    {
+      /* Peers which came up after the peer index table was written
+         have no index to give. */
+      if (info->peer->table_dump_gen != bgp_dump_routes_gen)
+        continue;
+
+      entry_count++;
 
-          /* Peer index */
-          stream_putw(obuf, info->peer->table_dump_index);
+      /* Peer index */
+      stream_putw(obuf, info->peer->table_dump_index);
 
-          /* Originated */
+      /* Originated */
 #ifdef HAVE_CLOCK_MONOTONIC
-          stream_putl (obuf, time(NULL) - (bgp_clock() - info->uptime));
+      stream_putl (obuf, time(NULL) - (bgp_clock() - info->uptime));
 #else
-          stream_putl (obuf, info->uptime);
+      stream_putl (obuf, info->uptime);
 #endif /* HAVE_CLOCK_MONOTONIC */
 
-          /* Dump attribute. */
-          /* Skip prefix & AFI/SAFI for MP_NLRI */
-          bgp_dump_routes_attr (obuf, info->attr, &rn->p);
-        }
+      /* Dump attribute. */
+      /* Skip prefix & AFI/SAFI for MP_NLRI */
+      bgp_dump_routes_attr (obuf, info->attr, &rn->p);
+    }
+
+  if (entry_count == 0)
+    return seq;
+
+  /* Overwrite the entry count, now that we know the right number */
+  stream_putw_at (obuf, sizep, entry_count);
+
+  bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
+  fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump_routes.fp);
+
+  return seq + 1;
+}
+
+/* Start walking the table for the dump's current AFI, or return 0 if
+   there is nothing left to dump. */
+static int
+bgp_dump_routes_table (struct bgp_dump *bgp_dump)
+{
+  struct bgp *bgp;
+
+  bgp = bgp_get_default ();
+  if (!bgp)
+    return 0;
+
+  for (; bgp_dump->afi < AFI_MAX; bgp_dump->afi++)
+    {
+#ifndef HAVE_IPV6
+      if (bgp_dump->afi != AFI_IP)
+        continue;
+#endif /* HAVE_IPV6 */
+      if (!bgp->rib[bgp_dump->afi][SAFI_UNICAST])
+        continue;
+
+      bgp_dump->table = bgp->rib[bgp_dump->afi][SAFI_UNICAST];
+      bgp_table_lock (bgp_dump->table);
+      bgp_dump->rn = bgp_table_top (bgp_dump->table);
+      if (bgp_dump->rn)
+        return 1;
+
+      bgp_table_unlock (bgp_dump->table);
+      bgp_dump->table = NULL;
+    }
+  return 0;
+}
+
+/* Abandon or finish the table dump in progress, and close the file.
+   For a RIB dump there's no point in leaving it open until the next
+   scheduled dump starts. */
+static void
+bgp_dump_routes_stop (struct bgp_dump *bgp_dump)
+{
+  THREAD_OFF (bgp_dump->t_routes);
+
+  if (bgp_dump->rn)
+    {
+      bgp_unlock_node (bgp_dump->rn);
+      bgp_dump->rn = NULL;
+    }
+  if (bgp_dump->table)
+    {
+      bgp_table_unlock (bgp_dump->table);
+      bgp_dump->table = NULL;
+    }
+  if (bgp_dump->fp)
+    {
+      fclose (bgp_dump->fp);
+      bgp_dump->fp = NULL;
+    }
+}
+
+/* Dump the RIB a slice at a time, in a background thread, so as not to
+   hold up everything else for as long as a full table takes.  Each slice
+   runs until it should yield and then carries on from where it was the
+   next time round, however the table has changed meanwhile. */
+static int
+bgp_dump_routes_func (struct thread *t)
+{
+  struct bgp_dump *bgp_dump;
+  struct bgp_node *rn;
 
-      /* Overwrite the entry count, now that we know the right number */
-      stream_putw_at (obuf, sizep, entry_count);
+  bgp_dump = THREAD_ARG (t);
+  bgp_dump->t_routes = NULL;
 
-      seq++;
+  while (bgp_dump->rn || bgp_dump_routes_table (bgp_dump))
+    {
+      rn = bgp_dump->rn;
+      bgp_dump->rn = NULL;
 
-      bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
-      fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump_routes.fp);
+      for (; rn; rn = bgp_route_next (rn))
+        {
+          if (rn->info)
+            bgp_dump->seq = bgp_dump_routes_node (rn, bgp_dump->afi,
+                                                  bgp_dump->seq);
+
+          if (thread_should_yield (t))
+            {
+              /* bgp_route_next has taken the lock on the next node. */
+              bgp_dump->rn = bgp_route_next (rn);
+              if (bgp_dump->rn)
+                {
+                  bgp_dump->t_routes =
+                    thread_add_background (master, bgp_dump_routes_func,
+                                           bgp_dump, 0);
+                  return 0;
+                }
+              break;
+            }
+        }
 
+      bgp_table_unlock (bgp_dump->table);
+      bgp_dump->table = NULL;
+      bgp_dump->afi++;
     }
 
-  fflush (bgp_dump_routes.fp);
+  bgp_dump_routes_stop (bgp_dump);
+  return 0;
+}
 
-  return seq;
+/* Start a table dump into the newly opened file. */
+static void
+bgp_dump_routes_start (struct bgp_dump *bgp_dump)
+{
+  struct bgp *bgp;
+
+  bgp = bgp_get_default ();
+  if (!bgp)
+    {
+      bgp_dump_routes_stop (bgp_dump);
+      return;
+    }
+
+  /* Note that bgp_dump_routes_index_table will do ipv4 and ipv6 peers,
+     so this should only be done once at the start. */
+  bgp_dump_routes_gen++;
+  bgp_dump_routes_index_table (bgp);
+
+  bgp_dump->afi = AFI_IP;
+  bgp_dump->seq = 0;
+  bgp_dump->t_routes = thread_add_background (master, bgp_dump_routes_func,
+                                              bgp_dump, 0);
 }
 
 static int
@@ -389,20 +520,17 @@ bgp_dump_interval_func (struct thread *t)
   bgp_dump = THREAD_ARG (t);
   bgp_dump->t_interval = NULL;
 
+  /* Let a table dump which hasn't finished yet carry on, rather than
+     starting on a new file.  This one is skipped. */
+  if (bgp_dump->type == BGP_DUMP_ROUTES && bgp_dump->t_routes)
+    zlog_warn ("%s: previous table dump has not finished, skipping",
+               bgp_dump->filename);
   /* Reschedule dump even if file couldn't be opened this time... */
-  if (bgp_dump_open_file (bgp_dump) != NULL)
+  else if (bgp_dump_open_file (bgp_dump) != NULL)
     {
       /* In case of bgp_dump_routes, we need special route dump function. */
       if (bgp_dump->type == BGP_DUMP_ROUTES)
-	{
-	  unsigned int seq = bgp_dump_routes_func (AFI_IP, 1, 0);
-#ifdef HAVE_IPV6
-	  bgp_dump_routes_func (AFI_IP6, 0, seq);
-#endif /* HAVE_IPV6 */
-	  /* Close the file now. For a RIB dump there's no point in leaving
-	   * it open until the next scheduled dump starts. */
-	  fclose(bgp_dump->fp); bgp_dump->fp = NULL;
-	}
+        bgp_dump_routes_start (bgp_dump);
     }
 
   /* if interval is set reschedule */
@@ -620,6 +748,10 @@ bgp_dump_set (struct vty *vty, struct bgp_dump *bgp_dump,
     {
       interval = 0;
     }
+
+  /* The file is about to be reopened, so give up on any table dump
+     still being written to it. */
+  bgp_dump_routes_stop (bgp_dump);
     
   /* Create interval thread. */
   bgp_dump_interval_add (bgp_dump, interval);
@@ -648,12 +780,8 @@ bgp_dump_unset (struct vty *vty, struct bgp_dump *bgp_dump)
       bgp_dump->filename = NULL;
     }
 
-  /* This should be called when interval is expired. */
-  if (bgp_dump->fp)
-    {
-      fclose (bgp_dump->fp);
-      bgp_dump->fp = NULL;
-    }
+  /* Stop any table dump in progress, and close the file. */
+  bgp_dump_routes_stop (bgp_dump);
 
   /* Create interval thread. */
   if (bgp_dump->t_interval)
@@ -873,6 +1001,7 @@ bgp_dump_init (void)
 void
 bgp_dump_finish (void)
 {
+  bgp_dump_routes_stop (&bgp_dump_routes);
   stream_free (bgp_dump_obuf);
   bgp_dump_obuf = NULL;
 }
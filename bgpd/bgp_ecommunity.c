@@ -22,6 +22,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 
 #include "hash.h"
 #include "memory.h"
+#include "jhash.h"
 #include "prefix.h"
 #include "command.h"
 
@@ -31,6 +32,9 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 
 /* Hash of community attribute. */
 static struct hash *ecomhash;
+
+/* Last serial number given to an interned extended community.  */
+static unsigned long ecommunity_serial;
 
 /* Allocate a new ecommunities.  */
 static struct ecommunity *
@@ -200,11 +204,14 @@ ecommunity_intern (struct ecommunity *ecom)
   if (find != ecom)
     ecommunity_free (&ecom);
 
+  if (! find->serial)
+    {
+      find->key = ecommunity_hash_make (find);
+      find->serial = ++ecommunity_serial;
+    }
   find->refcnt++;
 
-  if (! find->str)
-    find->str = ecommunity_ecom2str (find, ECOMMUNITY_FORMAT_DISPLAY);
-
+  /* The string is made by ecommunity_str () when needed.  */
   return find;
 }
 
@@ -228,22 +235,17 @@ ecommunity_unintern (struct ecommunity **ecom)
     }
 }
 
-/* Utinity function to make hash key.  */
+/* Utinity function to make hash key.  Interned values return the key
+   saved by ecommunity_intern.  */
 unsigned int
 ecommunity_hash_make (void *arg)
 {
   const struct ecommunity *ecom = arg;
-  int c;
-  unsigned int key;
-  u_int8_t *pnt;
 
-  key = 0;
-  pnt = ecom->val;
-  
-  for (c = 0; c < ecom->size * ECOMMUNITY_SIZE; c++)
-    key += pnt[c];
+  if (ecom->serial)
+    return ecom->key;
 
-  return key;
+  return jhash (ecom->val, ecom->size * ECOMMUNITY_SIZE, 0);
 }
 
 /* Compare two Extended Communities Attribute structure.  */
@@ -257,11 +259,19 @@ ecommunity_cmp (const void *arg1, const void *arg2)
 	  && memcmp (ecom1->val, ecom2->val, ecom1->size * ECOMMUNITY_SIZE) == 0);
 }
 
+/* Return extended communities hash entry count.  */
+unsigned long
+ecommunity_count (void)
+{
+  return ecomhash->count;
+}
+
 /* Initialize Extended Comminities related hash. */
 void
 ecommunity_init (void)
 {
   ecomhash = hash_create (ecommunity_hash_make, ecommunity_cmp);
+  ecomhash->name = "BGP ext-communities";
 }
 
 void
@@ -736,7 +746,8 @@ ecommunity_match (const struct ecommunity *ecom1,
   /* Every community on com2 needs to be on com1 for this to match */
   while (i < ecom1->size && j < ecom2->size)
     {
-      if (memcmp (ecom1->val + i, ecom2->val + j, ECOMMUNITY_SIZE) == 0)
+      if (memcmp (ecom1->val + i * ECOMMUNITY_SIZE,
+                  ecom2->val + j * ECOMMUNITY_SIZE, ECOMMUNITY_SIZE) == 0)
         j++;
       i++;
     }
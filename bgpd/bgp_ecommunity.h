@@ -55,6 +55,10 @@ struct ecommunity
 
   /* Human readable format string.  */
   char *str;
+  /* Unique, non-zero number given when interned.  */
+  unsigned long serial;
+  /* Hash key, saved when interned.  */
+  unsigned int key;
 };
 
 /* Extended community value is eight octet.  */
@@ -67,6 +71,7 @@ struct ecommunity_val
 
 extern void ecommunity_init (void);
 extern void ecommunity_finish (void);
+extern unsigned long ecommunity_count (void);
 extern void ecommunity_free (struct ecommunity **);
 extern struct ecommunity *ecommunity_parse (u_int8_t *, u_short);
 extern struct ecommunity *ecommunity_dup (struct ecommunity *);
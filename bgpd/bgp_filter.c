@@ -24,6 +24,8 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "log.h"
 #include "memory.h"
 #include "buffer.h"
+#include "prefix.h"
+#include "routemap.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_aspath.h"
@@ -61,7 +63,7 @@ struct as_filter
 
   enum as_filter_type type;
 
-  regex_t *reg;
+  struct aspath_regex *reg;
   char *reg_str;
 };
 
@@ -83,6 +85,19 @@ struct as_list
 
   struct as_filter *head;
   struct as_filter *tail;
+
+  /* Results for recently matched AS paths, see as_list_apply(). */
+  struct as_list_memo *memo;
+};
+
+/* AS paths are interned and shared by many routes, so the result of a
+   list for a path is kept, indexed by the path's serial number. */
+#define AS_LIST_MEMO_SIZE	1024
+
+struct as_list_memo
+{
+  unsigned long serial;
+  enum as_filter_type type;
 };
 
 /* ip as-path access-list 10 permit AS1. */
@@ -107,7 +122,7 @@ static void
 as_filter_free (struct as_filter *asfilter)
 {
   if (asfilter->reg)
-    bgp_regex_free (asfilter->reg);
+    bgp_aspath_regex_free (asfilter->reg);
   if (asfilter->reg_str)
     XFREE (MTYPE_AS_FILTER_STR, asfilter->reg_str);
   XFREE (MTYPE_AS_FILTER, asfilter);
@@ -115,7 +130,7 @@ as_filter_free (struct as_filter *asfilter)
 
 /* Make new AS filter. */
 static struct as_filter *
-as_filter_make (regex_t *reg, const char *reg_str, enum as_filter_type type)
+as_filter_make (struct aspath_regex *reg, const char *reg_str, enum as_filter_type type)
 {
   struct as_filter *asfilter;
 
@@ -139,9 +154,22 @@ as_filter_lookup (struct as_list *aslist, const char *reg_str,
   return NULL;
 }
 
+/* The list has changed, forget earlier results, including those of
+   route-maps which use it. */
+static void
+as_list_memo_reset (struct as_list *aslist)
+{
+  if (aslist->memo)
+    XFREE (MTYPE_AS_LIST_MEMO, aslist->memo);
+  aslist->memo = NULL;
+  route_map_cache_flush ();
+}
+
 static void
 as_list_filter_add (struct as_list *aslist, struct as_filter *asfilter)
 {
+  as_list_memo_reset (aslist);
+
   asfilter->next = NULL;
   asfilter->prev = aslist->tail;
 
@@ -186,6 +214,7 @@ as_list_free (struct as_list *aslist)
       free (aslist->name);
       aslist->name = NULL;
     }
+  as_list_memo_reset (aslist);
   XFREE (MTYPE_AS_LIST, aslist);
 }
 
@@ -361,6 +390,7 @@ as_list_filter_delete (struct as_list *aslist, struct as_filter *asfilter)
     aslist->head = asfilter->next;
 
   as_filter_free (asfilter);
+  as_list_memo_reset (aslist);
 
   /* If access_list becomes empty delete it from access_master. */
   if (as_list_empty (aslist))
@@ -374,7 +404,7 @@ as_list_filter_delete (struct as_list *aslist, struct as_filter *asfilter)
 static int
 as_filter_match (struct as_filter *asfilter, struct aspath *aspath)
 {
-  if (bgp_regexec (asfilter->reg, aspath) != REG_NOMATCH)
+  if (bgp_aspath_regexec (asfilter->reg, aspath) != REG_NOMATCH)
     return 1;
   return 0;
 }
@@ -385,18 +415,40 @@ as_list_apply (struct as_list *aslist, void *object)
 {
   struct as_filter *asfilter;
   struct aspath *aspath;
+  struct as_list_memo *memo = NULL;
+  enum as_filter_type type = AS_FILTER_DENY;
 
   aspath = (struct aspath *) object;
 
   if (aslist == NULL)
     return AS_FILTER_DENY;
 
+  /* Only interned paths have a serial number. */
+  if (aspath->serial)
+    {
+      if (! aslist->memo)
+	aslist->memo = XCALLOC (MTYPE_AS_LIST_MEMO, AS_LIST_MEMO_SIZE
+				* sizeof (struct as_list_memo));
+      memo = &aslist->memo[aspath->serial & (AS_LIST_MEMO_SIZE - 1)];
+      if (memo->serial == aspath->serial)
+	return memo->type;
+    }
+
   for (asfilter = aslist->head; asfilter; asfilter = asfilter->next)
     {
       if (as_filter_match (asfilter, aspath))
-	return asfilter->type;
+	{
+	  type = asfilter->type;
+	  break;
+	}
+    }
+
+  if (memo)
+    {
+      memo->serial = aspath->serial;
+      memo->type = type;
     }
-  return AS_FILTER_DENY;
+  return type;
 }
 
 /* Add hook function. */
@@ -440,7 +492,7 @@ DEFUN (ip_as_path, ip_as_path_cmd,
   enum as_filter_type type;
   struct as_filter *asfilter;
   struct as_list *aslist;
-  regex_t *regex;
+  struct aspath_regex *regex;
   char *regstr;
 
   /* Check the filter type. */
@@ -457,7 +509,7 @@ DEFUN (ip_as_path, ip_as_path_cmd,
   /* Check AS path regex. */
   regstr = argv_concat(argv, argc, 2);
 
-  regex = bgp_regcomp (regstr);
+  regex = bgp_aspath_regcomp (regstr);
   if (!regex)
     {
       XFREE (MTYPE_TMP, regstr);
@@ -498,7 +550,7 @@ DEFUN (no_ip_as_path,
   struct as_filter *asfilter;
   struct as_list *aslist;
   char *regstr;
-  regex_t *regex;
+  struct aspath_regex *regex;
 
   /* Lookup AS list from AS path list. */
   aslist = as_list_lookup (argv[0]);
@@ -523,7 +575,7 @@ DEFUN (no_ip_as_path,
   /* Compile AS path. */
   regstr = argv_concat(argv, argc, 2);
 
-  regex = bgp_regcomp (regstr);
+  regex = bgp_aspath_regcomp (regstr);
   if (!regex)
     {
       XFREE (MTYPE_TMP, regstr);
@@ -536,7 +588,7 @@ DEFUN (no_ip_as_path,
   asfilter = as_filter_lookup (aslist, regstr, type);
 
   XFREE (MTYPE_TMP, regstr);
-  bgp_regex_free (regex);
+  bgp_aspath_regex_free (regex);
 
   if (asfilter == NULL)
     {
@@ -40,6 +40,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_dump.h"
 #include "bgpd/bgp_open.h"
+#include "bgpd/bgp_updgrp.h"
 #ifdef HAVE_SNMP
 #include "bgpd/bgp_snmp.h"
 #endif /* HAVE_SNMP */
@@ -261,6 +262,21 @@ bgp_holdtime_timer (struct thread *thread)
   peer = THREAD_ARG (thread);
   peer->t_holdtime = NULL;
 
+  /* If the peer's messages are sitting unread in the socket, it is us
+   * who have been too busy to read them, not the peer that is dead.
+   * Give bgp_read a chance to run before tearing the session down.
+   */
+  if (peer->status == Established && bgp_read_pending (peer))
+    {
+      if (BGP_DEBUG (fsm, FSM))
+	zlog (peer->log, LOG_DEBUG,
+	      "%s [FSM] Timer (holdtime deferred, input pending)",
+	      peer->host);
+      BGP_TIMER_ON (peer->t_holdtime, bgp_holdtime_timer,
+		    BGP_HOLDTIME_GRACE);
+      return 0;
+    }
+
   if (BGP_DEBUG (fsm, FSM))
     zlog (peer->log, LOG_DEBUG,
 	  "%s [FSM] Timer (holdtime timer expire)",
@@ -496,6 +512,9 @@ bgp_stop (struct peer *peer)
       peer->synctime = 0;
     }
 
+  /* Leave update groups. */
+  bgp_updgrp_leave (peer);
+
   /* Stop read and write threads when exists. */
   BGP_READ_OFF (peer->t_read);
   BGP_WRITE_OFF (peer->t_write);
@@ -512,6 +531,8 @@ bgp_stop (struct peer *peer)
   peer->packet_size = 0;
 
   /* Clear input and output buffer.  */
+  if (peer->rbuf)
+    stream_reset (peer->rbuf);
   if (peer->ibuf)
     stream_reset (peer->ibuf);
   if (peer->work)
@@ -871,6 +892,9 @@ bgp_establish (struct peer *peer)
 	    || CHECK_FLAG (peer->af_cap[afi][safi], PEER_CAP_ORF_PREFIX_SM_OLD_RCV))
 	  SET_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_ORF_WAIT_REFRESH);
 
+  /* Join update groups before the initial table is queued. */
+  bgp_updgrp_refresh (peer->bgp);
+
   bgp_announce_route_all (peer);
 
   BGP_TIMER_ON (peer->t_routeadv, bgp_routeadv_timer, 1);
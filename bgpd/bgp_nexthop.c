@@ -50,6 +50,9 @@ static struct thread *bgp_scan_thread = NULL;
 /* BGP import thread */
 static struct thread *bgp_import_thread = NULL;
 
+/* Connected route change, single-hop EBGP paths to recheck. */
+static struct thread *bgp_onlink_thread = NULL;
+
 /* BGP scan interval. */
 static int bgp_scan_interval;
 
@@ -58,14 +61,15 @@ static int bgp_import_interval;
 
 /* Route table for next-hop lookup cache. */
 static struct bgp_table *bgp_nexthop_cache_table[AFI_MAX];
-static struct bgp_table *cache1_table[AFI_MAX];
-static struct bgp_table *cache2_table[AFI_MAX];
 
 /* Route table for connected route. */
 static struct bgp_table *bgp_connected_table[AFI_MAX];
 
 /* BGP nexthop lookup query client. */
 struct zclient *zlookup = NULL;
+
+/* Nexthops are registered with zebra over the main client. */
+extern struct zclient *zclient;
 
 /* Add nexthop to the end of the list.  */
 static void
@@ -107,6 +111,48 @@ bnc_free (struct bgp_nexthop_cache *bnc)
   bnc_nexthop_free (bnc);
   XFREE (MTYPE_BGP_NEXTHOP_CACHE, bnc);
 }
+
+/* Read the metric and nexthops of a nexthop lookup reply or update. */
+static void
+bnc_nexthop_read (struct stream *s, struct bgp_nexthop_cache *bnc)
+{
+  struct nexthop *nexthop;
+  int i;
+
+  bnc->metric = stream_getl (s);
+  bnc->nexthop_num = stream_getc (s);
+  bnc->valid = bnc->nexthop_num ? 1 : 0;
+
+  for (i = 0; i < bnc->nexthop_num; i++)
+    {
+      nexthop = XCALLOC (MTYPE_NEXTHOP, sizeof (struct nexthop));
+      nexthop->type = stream_getc (s);
+      switch (nexthop->type)
+	{
+	case ZEBRA_NEXTHOP_IPV4:
+	  nexthop->gate.ipv4.s_addr = stream_get_ipv4 (s);
+	  break;
+#ifdef HAVE_IPV6
+	case ZEBRA_NEXTHOP_IPV6:
+	  stream_get (&nexthop->gate.ipv6, s, 16);
+	  break;
+	case ZEBRA_NEXTHOP_IPV6_IFINDEX:
+	case ZEBRA_NEXTHOP_IPV6_IFNAME:
+	  stream_get (&nexthop->gate.ipv6, s, 16);
+	  nexthop->ifindex = stream_getl (s);
+	  break;
+#endif /* HAVE_IPV6 */
+	case ZEBRA_NEXTHOP_IFINDEX:
+	case ZEBRA_NEXTHOP_IFNAME:
+	  nexthop->ifindex = stream_getl (s);
+	  break;
+	default:
+	  /* do nothing */
+	  break;
+	}
+      bnc_nexthop_add (bnc, nexthop);
+    }
+}
 
 static int
 bgp_nexthop_same (struct nexthop *next1, struct nexthop *next2)
@@ -212,176 +258,285 @@ bgp_nexthop_onlink (afi_t afi, struct attr *attr)
   return 0;
 }
 
-#ifdef HAVE_IPV6
-/* Check specified next-hop is reachable or not. */
-static int
-bgp_nexthop_lookup_ipv6 (struct peer *peer, struct bgp_info *ri, int *changed,
-			 int *metricchanged)
+/* Tell zebra whether we want updates for a nexthop. */
+static void
+bnc_register (struct bgp_nexthop_cache *bnc, int command)
 {
-  struct bgp_node *rn;
-  struct prefix p;
+  if (zclient && zclient->sock >= 0)
+    zebra_nexthop_send (command, zclient, &bnc->node->p);
+}
+
+/* Add ri, which is on rn, to the paths using bnc. */
+static void
+bnc_path_link (struct bgp_nexthop_cache *bnc, struct bgp_node *rn,
+	       struct bgp_info *ri)
+{
+  struct bgp_info_extra *extra;
+
+  extra = bgp_info_extra_get (ri);
+  if (extra->bnc == bnc)
+    return;
+  if (extra->bnc)
+    bgp_nexthop_unlink (ri);
+
+  extra->bnc = bnc;
+  extra->bnc_rn = rn;
+  extra->bnc_prev = NULL;
+  extra->bnc_next = bnc->paths;
+  if (bnc->paths)
+    bnc->paths->extra->bnc_prev = ri;
+  bnc->paths = ri;
+  bnc->path_count++;
+}
+
+/* ri no longer uses the nexthop it was last looked up for.  Nexthops
+   are forgotten, and zebra told so, once no path uses them. */
+void
+bgp_nexthop_unlink (struct bgp_info *ri)
+{
+  struct bgp_info_extra *extra = ri->extra;
   struct bgp_nexthop_cache *bnc;
-  struct attr *attr;
-  
-  /* If lookup is not enabled, return valid. */
-  if (zlookup->sock < 0)
+
+  if (! extra || ! (bnc = extra->bnc))
+    return;
+
+  if (extra->bnc_next)
+    extra->bnc_next->extra->bnc_prev = extra->bnc_prev;
+  if (extra->bnc_prev)
+    extra->bnc_prev->extra->bnc_next = extra->bnc_next;
+  else
+    bnc->paths = extra->bnc_next;
+  extra->bnc = NULL;
+  extra->bnc_next = extra->bnc_prev = NULL;
+  extra->bnc_rn = NULL;
+  bnc->path_count--;
+
+  if (! bnc->paths)
     {
-      if (ri->extra)
-        ri->extra->igpmetric = 0;
-      return 1;
+      bnc_register (bnc, ZEBRA_NEXTHOP_UNREGISTER);
+      bnc->node->info = NULL;
+      bgp_unlock_node (bnc->node);
+      bnc_free (bnc);
     }
+}
+
+/* Check specified next-hop is reachable or not, and track it for ri,
+   which is on rn.  zebra is asked how a nexthop resolves when it is
+   first used, and sends updates for it from then on.  While zebra can't
+   be reached the nexthop is taken as valid, and it is still tracked so
+   that it is registered, and the paths using it corrected, once zebra
+   is back. */
+int
+bgp_nexthop_lookup (afi_t afi, struct bgp_node *rn, struct bgp_info *ri)
+{
+  struct bgp_node *bn;
+  struct prefix p;
+  struct bgp_nexthop_cache *bnc;
   
-  /* Only check IPv6 global address only nexthop. */
-  attr = ri->attr;
+  memset (&p, 0, sizeof (struct prefix));
+#ifdef HAVE_IPV6
+  if (afi == AFI_IP6)
+    {
+      struct attr *attr = ri->attr;
 
-  if (attr->extra->mp_nexthop_len != 16 
-      || IN6_IS_ADDR_LINKLOCAL (&attr->extra->mp_nexthop_global))
-    return 1;
+      /* Only check IPv6 global address only nexthop. */
+      if (attr->extra->mp_nexthop_len != 16 
+	  || IN6_IS_ADDR_LINKLOCAL (&attr->extra->mp_nexthop_global))
+	{
+	  bgp_nexthop_unlink (ri);
+	  return 1;
+	}
 
-  memset (&p, 0, sizeof (struct prefix));
-  p.family = AF_INET6;
-  p.prefixlen = IPV6_MAX_BITLEN;
-  p.u.prefix6 = attr->extra->mp_nexthop_global;
+      p.family = AF_INET6;
+      p.prefixlen = IPV6_MAX_BITLEN;
+      p.u.prefix6 = attr->extra->mp_nexthop_global;
+    }
+  else
+#endif /* HAVE_IPV6 */
+    {
+      p.family = AF_INET;
+      p.prefixlen = IPV4_MAX_BITLEN;
+      p.u.prefix4 = ri->attr->nexthop;
+    }
 
   /* IBGP or ebgp-multihop */
-  rn = bgp_node_get (bgp_nexthop_cache_table[AFI_IP6], &p);
+  bn = bgp_node_get (bgp_nexthop_cache_table[afi], &p);
 
-  if (rn->info)
+  if (bn->info)
     {
-      bnc = rn->info;
-      bgp_unlock_node (rn);
+      bnc = bn->info;
+      bgp_unlock_node (bn);
     }
   else
     {
-      if (NULL == (bnc = zlookup_query_ipv6 (&attr->extra->mp_nexthop_global)))
-	bnc = bnc_new ();
+      bnc = NULL;
+      if (zlookup->sock >= 0)
+	{
+#ifdef HAVE_IPV6
+	  if (afi == AFI_IP6)
+	    bnc = zlookup_query_ipv6 (&p.u.prefix6);
+	  else
+#endif /* HAVE_IPV6 */
+	    bnc = zlookup_query (p.u.prefix4);
+	}
       else
 	{
-	  if (changed)
-	    {
-	      struct bgp_table *old;
-	      struct bgp_node *oldrn;
+	  /* Unresolved until zebra answers. */
+	  bnc = bnc_new ();
+	  bnc->valid = 1;
+	}
+      if (bnc == NULL)
+	bnc = bnc_new ();
+      bnc->node = bn;
+      bn->info = bnc;
+      bnc_register (bnc, ZEBRA_NEXTHOP_REGISTER);
+    }
 
-	      if (bgp_nexthop_cache_table[AFI_IP6] == cache1_table[AFI_IP6])
-		old = cache2_table[AFI_IP6];
-	      else
-		old = cache1_table[AFI_IP6];
+  bnc_path_link (bnc, rn, ri);
 
-	      oldrn = bgp_node_lookup (old, &p);
-	      if (oldrn)
-		{
-		  struct bgp_nexthop_cache *oldbnc = oldrn->info;
+  if (bnc->valid && bnc->metric)
+    ri->extra->igpmetric = bnc->metric;
+  else
+    ri->extra->igpmetric = 0;
 
-		  bnc->changed = bgp_nexthop_cache_different (bnc, oldbnc);
+  return bnc->valid;
+}
 
-		  if (bnc->metric != oldbnc->metric)
-		    bnc->metricchanged = 1;
+/* Register every nexthop in use, e.g. after zebra restarts.  zebra
+   replies with how each resolves, which brings the cache up to date. */
+void
+bgp_nexthop_register_all (struct zclient *zclient)
+{
+  struct bgp_node *rn;
+  afi_t afi;
 
-                  bgp_unlock_node (oldrn);
-		}
-	    }
-	}
-      rn->info = bnc;
-    }
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    if (bgp_nexthop_cache_table[afi])
+      for (rn = bgp_table_top (bgp_nexthop_cache_table[afi]); rn;
+	   rn = bgp_route_next (rn))
+	if (rn->info)
+	  bnc_register (rn->info, ZEBRA_NEXTHOP_REGISTER);
+}
 
-  if (changed)
-    *changed = bnc->changed;
+/* A path's nexthop has changed, update the path to match. */
+static void
+bgp_nexthop_path_update (struct bgp_nexthop_cache *bnc, struct bgp_info *bi,
+			 afi_t afi)
+{
+  struct bgp_node *rn = bi->extra->bnc_rn;
+  struct bgp *bgp = bi->peer->bgp;
+  int current;
 
-  if (metricchanged)
-    *metricchanged = bnc->metricchanged;
+  /* Withdrawn, it'll be looked up again if it comes back. */
+  if (CHECK_FLAG (bi->flags, BGP_INFO_REMOVED | BGP_INFO_HISTORY))
+    return;
+
+  current = CHECK_FLAG (bi->flags, BGP_INFO_VALID) ? 1 : 0;
+
+  if (bnc->changed)
+    SET_FLAG (bi->flags, BGP_INFO_IGP_CHANGED);
+  else
+    UNSET_FLAG (bi->flags, BGP_INFO_IGP_CHANGED);
 
   if (bnc->valid && bnc->metric)
-    (bgp_info_extra_get (ri))->igpmetric = bnc->metric;
-  else if (ri->extra)
-    ri->extra->igpmetric = 0;
+    bi->extra->igpmetric = bnc->metric;
+  else
+    bi->extra->igpmetric = 0;
 
-  return bnc->valid;
+  if (bnc->valid != current)
+    {
+      if (current)
+	{
+	  bgp_aggregate_decrement (bgp, &rn->p, bi, afi, SAFI_UNICAST);
+	  bgp_info_unset_flag (rn, bi, BGP_INFO_VALID);
+	}
+      else
+	{
+	  bgp_info_set_flag (rn, bi, BGP_INFO_VALID);
+	  bgp_aggregate_increment (bgp, &rn->p, bi, afi, SAFI_UNICAST);
+	}
+    }
+
+  bgp_process (bgp, rn, afi, SAFI_UNICAST);
 }
-#endif /* HAVE_IPV6 */
 
-/* Check specified next-hop is reachable or not. */
+/* ZEBRA_NEXTHOP_UPDATE: a nexthop in use resolves differently.  Only
+   the paths using it are looked at again. */
 int
-bgp_nexthop_lookup (afi_t afi, struct peer *peer, struct bgp_info *ri,
-		    int *changed, int *metricchanged)
+bgp_nexthop_update (int command, struct zclient *zclient,
+		    zebra_size_t length)
 {
-  struct bgp_node *rn;
+  struct stream *s = zclient->ibuf;
   struct prefix p;
+  struct bgp_node *rn;
   struct bgp_nexthop_cache *bnc;
-  struct in_addr addr;
-  
-  /* If lookup is not enabled, return valid. */
-  if (zlookup->sock < 0)
+  struct bgp_nexthop_cache *new;
+  struct bgp_info *bi;
+  struct bgp_info *next;
+  afi_t afi;
+
+  memset (&p, 0, sizeof (struct prefix));
+  p.family = stream_getc (s);
+  if (p.family == AF_INET)
     {
-      if (ri->extra)
-        ri->extra->igpmetric = 0;
-      return 1;
+      afi = AFI_IP;
+      p.prefixlen = IPV4_MAX_BITLEN;
+      p.u.prefix4.s_addr = stream_get_ipv4 (s);
     }
-  
 #ifdef HAVE_IPV6
-  if (afi == AFI_IP6)
-    return bgp_nexthop_lookup_ipv6 (peer, ri, changed, metricchanged);
+  else if (p.family == AF_INET6)
+    {
+      afi = AFI_IP6;
+      p.prefixlen = IPV6_MAX_BITLEN;
+      stream_get (&p.u.prefix6, s, 16);
+    }
 #endif /* HAVE_IPV6 */
+  else
+    return 0;
 
-  addr = ri->attr->nexthop;
-
-  memset (&p, 0, sizeof (struct prefix));
-  p.family = AF_INET;
-  p.prefixlen = IPV4_MAX_BITLEN;
-  p.u.prefix4 = addr;
+  /* It may have gone unused since. */
+  rn = bgp_node_lookup (bgp_nexthop_cache_table[afi], &p);
+  if (! rn)
+    return 0;
+  bnc = rn->info;
+  bgp_unlock_node (rn);
 
-  /* IBGP or ebgp-multihop */
-  rn = bgp_node_get (bgp_nexthop_cache_table[AFI_IP], &p);
+  new = bnc_new ();
+  bnc_nexthop_read (s, new);
 
-  if (rn->info)
+  bnc->changed = bgp_nexthop_cache_different (bnc, new);
+  bnc->metricchanged = (bnc->metric != new->metric);
+  if (! bnc->changed && ! bnc->metricchanged && bnc->valid == new->valid)
     {
-      bnc = rn->info;
-      bgp_unlock_node (rn);
+      bnc_free (new);
+      return 0;
     }
-  else
-    {
-      if (NULL == (bnc = zlookup_query (addr)))
-	bnc = bnc_new ();
-      else
-	{
-	  if (changed)
-	    {
-	      struct bgp_table *old;
-	      struct bgp_node *oldrn;
-
-	      if (bgp_nexthop_cache_table[AFI_IP] == cache1_table[AFI_IP])
-		old = cache2_table[AFI_IP];
-	      else
-		old = cache1_table[AFI_IP];
 
-	      oldrn = bgp_node_lookup (old, &p);
-	      if (oldrn)
-		{
-		  struct bgp_nexthop_cache *oldbnc = oldrn->info;
-
-		  bnc->changed = bgp_nexthop_cache_different (bnc, oldbnc);
+  bnc_nexthop_free (bnc);
+  bnc->valid = new->valid;
+  bnc->metric = new->metric;
+  bnc->nexthop_num = new->nexthop_num;
+  bnc->nexthop = new->nexthop;
+  new->nexthop = NULL;
+  bnc_free (new);
 
-		  if (bnc->metric != oldbnc->metric)
-		    bnc->metricchanged = 1;
+  if (BGP_DEBUG (events, EVENTS))
+    {
+      char buf[INET6_ADDRSTRLEN];
 
-                  bgp_unlock_node (oldrn);
-		}
-	    }
-	}
-      rn->info = bnc;
+      zlog_debug ("nexthop %s %s, metric %u, %lu paths to update",
+		  inet_ntop (p.family, &p.u.prefix, buf, INET6_ADDRSTRLEN),
+		  bnc->valid ? "reachable" : "unreachable", bnc->metric,
+		  bnc->path_count);
     }
 
-  if (changed)
-    *changed = bnc->changed;
-
-  if (metricchanged)
-    *metricchanged = bnc->metricchanged;
-
-  if (bnc->valid && bnc->metric)
-    (bgp_info_extra_get(ri))->igpmetric = bnc->metric;
-  else if (ri->extra)
-    ri->extra->igpmetric = 0;
+  for (bi = bnc->paths; bi; bi = next)
+    {
+      next = bi->extra->bnc_next;
+      bgp_nexthop_path_update (bnc, bi, afi);
+    }
 
-  return bnc->valid;
+  return 0;
 }
 
 /* Reset and free all BGP nexthop cache. */
@@ -390,16 +545,22 @@ bgp_nexthop_cache_reset (struct bgp_table *table)
 {
   struct bgp_node *rn;
   struct bgp_nexthop_cache *bnc;
+  struct bgp_info *bi;
 
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
     if ((bnc = rn->info) != NULL)
       {
+	for (bi = bnc->paths; bi; bi = bi->extra->bnc_next)
+	  bi->extra->bnc = NULL;
 	bnc_free (bnc);
 	rn->info = NULL;
 	bgp_unlock_node (rn);
       }
 }
 
+/* Nexthop reachability is kept up to date by zebra, this is left to
+   check for maximum prefix overflow and, with dampening, to reuse and
+   expire dampened routes. */
 static void
 bgp_scan (afi_t afi, safi_t safi)
 {
@@ -409,16 +570,7 @@ bgp_scan (afi_t afi, safi_t safi)
   struct bgp_info *next;
   struct peer *peer;
   struct listnode *node, *nnode;
-  int valid;
-  int current;
-  int changed;
-  int metricchanged;
-
-  /* Change cache. */
-  if (bgp_nexthop_cache_table[afi] == cache1_table[afi])
-    bgp_nexthop_cache_table[afi] = cache2_table[afi];
-  else
-    bgp_nexthop_cache_table[afi] = cache1_table[afi];
+  int damped;
 
   /* Get default bgp. */
   bgp = bgp_get_default ();
@@ -439,64 +591,30 @@ bgp_scan (afi_t afi, safi_t safi)
 	bgp_maximum_prefix_overflow (peer, afi, SAFI_MPLS_VPN, 1);
     }
 
+  if (! CHECK_FLAG (bgp->af_flags[afi][SAFI_UNICAST], BGP_CONFIG_DAMPENING))
+    return;
+
   for (rn = bgp_table_top (bgp->rib[afi][SAFI_UNICAST]); rn;
        rn = bgp_route_next (rn))
     {
+      damped = 0;
       for (bi = rn->info; bi; bi = next)
 	{
 	  next = bi->next;
 
-	  if (bi->type == ZEBRA_ROUTE_BGP && bi->sub_type == BGP_ROUTE_NORMAL)
+	  if (bi->type == ZEBRA_ROUTE_BGP && bi->sub_type == BGP_ROUTE_NORMAL
+	      && bi->extra && bi->extra->damp_info)
 	    {
-	      changed = 0;
-	      metricchanged = 0;
-
-	      if (peer_sort (bi->peer) == BGP_PEER_EBGP && bi->peer->ttl == 1)
-		valid = bgp_nexthop_onlink (afi, bi->attr);
-	      else
-		valid = bgp_nexthop_lookup (afi, bi->peer, bi,
-					    &changed, &metricchanged);
-
-	      current = CHECK_FLAG (bi->flags, BGP_INFO_VALID) ? 1 : 0;
-
-	      if (changed)
-		SET_FLAG (bi->flags, BGP_INFO_IGP_CHANGED);
-	      else
-		UNSET_FLAG (bi->flags, BGP_INFO_IGP_CHANGED);
-
-	      if (valid != current)
-		{
-		  if (CHECK_FLAG (bi->flags, BGP_INFO_VALID))
-		    {
-		      bgp_aggregate_decrement (bgp, &rn->p, bi,
-					       afi, SAFI_UNICAST);
-		      bgp_info_unset_flag (rn, bi, BGP_INFO_VALID);
-		    }
-		  else
-		    {
-		      bgp_info_set_flag (rn, bi, BGP_INFO_VALID);
-		      bgp_aggregate_increment (bgp, &rn->p, bi,
-					       afi, SAFI_UNICAST);
-		    }
-		}
-
-              if (CHECK_FLAG (bgp->af_flags[afi][SAFI_UNICAST],
-		  BGP_CONFIG_DAMPENING)
-                  &&  bi->extra && bi->extra->damp_info )
-                if (bgp_damp_scan (bi, afi, SAFI_UNICAST))
-		  bgp_aggregate_increment (bgp, &rn->p, bi,
-					   afi, SAFI_UNICAST);
+	      damped = 1;
+	      if (bgp_damp_scan (bi, afi, SAFI_UNICAST))
+		bgp_aggregate_increment (bgp, &rn->p, bi,
+					 afi, SAFI_UNICAST);
 	    }
 	}
-      bgp_process (bgp, rn, afi, SAFI_UNICAST);
+      if (damped)
+	bgp_process (bgp, rn, afi, SAFI_UNICAST);
     }
 
-  /* Flash old cache. */
-  if (bgp_nexthop_cache_table[afi] == cache1_table[afi])
-    bgp_nexthop_cache_reset (cache2_table[afi]);
-  else
-    bgp_nexthop_cache_reset (cache1_table[afi]);
-
   if (BGP_DEBUG (events, EVENTS))
     {
       if (afi == AFI_IP)
@@ -506,7 +624,7 @@ bgp_scan (afi_t afi, safi_t safi)
     }
 }
 
-/* BGP scan thread.  This thread check nexthop reachability. */
+/* BGP scan thread. */
 static int
 bgp_scan_timer (struct thread *t)
 {
@@ -525,6 +643,85 @@ bgp_scan_timer (struct thread *t)
   return 0;
 }
 
+/* Single-hop EBGP paths are not tracked through zebra, their nexthop
+   only has to be on a connected network.  Check them again after the
+   connected routes change. */
+static void
+bgp_onlink_recheck (struct bgp *bgp, afi_t afi)
+{
+  struct bgp_node *rn;
+  struct bgp_info *bi;
+  int valid;
+  int current;
+  int changed;
+
+  for (rn = bgp_table_top (bgp->rib[afi][SAFI_UNICAST]); rn;
+       rn = bgp_route_next (rn))
+    {
+      changed = 0;
+      for (bi = rn->info; bi; bi = bi->next)
+	{
+	  if (bi->type != ZEBRA_ROUTE_BGP || bi->sub_type != BGP_ROUTE_NORMAL)
+	    continue;
+	  if (CHECK_FLAG (bi->flags, BGP_INFO_REMOVED | BGP_INFO_HISTORY))
+	    continue;
+	  if (peer_sort (bi->peer) != BGP_PEER_EBGP || bi->peer->ttl != 1
+	      || CHECK_FLAG (bi->peer->flags, PEER_FLAG_DISABLE_CONNECTED_CHECK))
+	    continue;
+
+	  valid = bgp_nexthop_onlink (afi, bi->attr);
+	  current = CHECK_FLAG (bi->flags, BGP_INFO_VALID) ? 1 : 0;
+	  if (valid == current)
+	    continue;
+
+	  if (current)
+	    {
+	      bgp_aggregate_decrement (bgp, &rn->p, bi, afi, SAFI_UNICAST);
+	      bgp_info_unset_flag (rn, bi, BGP_INFO_VALID);
+	    }
+	  else
+	    {
+	      bgp_info_set_flag (rn, bi, BGP_INFO_VALID);
+	      bgp_aggregate_increment (bgp, &rn->p, bi, afi, SAFI_UNICAST);
+	    }
+	  changed = 1;
+	}
+      if (changed)
+	bgp_process (bgp, rn, afi, SAFI_UNICAST);
+    }
+}
+
+static int
+bgp_onlink_timer (struct thread *t)
+{
+  struct bgp *bgp;
+
+  bgp_onlink_thread = NULL;
+
+  bgp = bgp_get_default ();
+  if (bgp == NULL)
+    return 0;
+
+  if (BGP_DEBUG (events, EVENTS))
+    zlog_debug ("connected routes changed, checking single-hop EBGP paths");
+
+  bgp_onlink_recheck (bgp, AFI_IP);
+#ifdef HAVE_IPV6
+  bgp_onlink_recheck (bgp, AFI_IP6);
+#endif /* HAVE_IPV6 */
+
+  return 0;
+}
+
+/* Several addresses usually come and go together, check once for all
+   of them. */
+static void
+bgp_connected_changed (void)
+{
+  if (! bgp_onlink_thread)
+    bgp_onlink_thread = thread_add_event (master, bgp_onlink_timer, NULL, 0);
+}
+
 struct bgp_connected_ref
 {
   unsigned int refcnt;
@@ -569,6 +766,7 @@ bgp_connected_add (struct connected *ifc)
 	  bc->refcnt = 1;
 	  rn->info = bc;
 	}
+      bgp_connected_changed ();
     }
 #ifdef HAVE_IPV6
   else if (addr->family == AF_INET6)
@@ -594,6 +792,7 @@ bgp_connected_add (struct connected *ifc)
 	  bc->refcnt = 1;
 	  rn->info = bc;
 	}
+      bgp_connected_changed ();
     }
 #endif /* HAVE_IPV6 */
 }
@@ -635,6 +834,7 @@ bgp_connected_delete (struct connected *ifc)
 	}
       bgp_unlock_node (rn);
       bgp_unlock_node (rn);
+      bgp_connected_changed ();
     }
 #ifdef HAVE_IPV6
   else if (addr->family == AF_INET6)
@@ -661,6 +861,7 @@ bgp_connected_delete (struct connected *ifc)
 	}
       bgp_unlock_node (rn);
       bgp_unlock_node (rn);
+      bgp_connected_changed ();
     }
 #endif /* HAVE_IPV6 */
 }
@@ -698,10 +899,6 @@ zlookup_read (void)
   uint16_t command;
   int nbytes;
   struct in_addr raddr;
-  uint32_t metric;
-  int i;
-  u_char nexthop_num;
-  struct nexthop *nexthop;
   struct bgp_nexthop_cache *bnc;
 
   s = zlookup->ibuf;
@@ -724,38 +921,14 @@ zlookup_read (void)
   command = stream_getw (s);
   
   raddr.s_addr = stream_get_ipv4 (s);
-  metric = stream_getl (s);
-  nexthop_num = stream_getc (s);
 
-  if (nexthop_num)
+  bnc = bnc_new ();
+  bnc_nexthop_read (s, bnc);
+  if (! bnc->valid)
     {
-      bnc = bnc_new ();
-      bnc->valid = 1;
-      bnc->metric = metric;
-      bnc->nexthop_num = nexthop_num;
-
-      for (i = 0; i < nexthop_num; i++)
-	{
-	  nexthop = XCALLOC (MTYPE_NEXTHOP, sizeof (struct nexthop));
-	  nexthop->type = stream_getc (s);
-	  switch (nexthop->type)
-	    {
-	    case ZEBRA_NEXTHOP_IPV4:
-	      nexthop->gate.ipv4.s_addr = stream_get_ipv4 (s);
-	      break;
-	    case ZEBRA_NEXTHOP_IFINDEX:
-	    case ZEBRA_NEXTHOP_IFNAME:
-	      nexthop->ifindex = stream_getl (s);
-	      break;
-            default:
-              /* do nothing */
-              break;
-	    }
-	  bnc_nexthop_add (bnc, nexthop);
-	}
+      bnc_free (bnc);
+      return NULL;
     }
-  else
-    return NULL;
 
   return bnc;
 }
@@ -806,10 +979,6 @@ zlookup_read_ipv6 (void)
   uint16_t  command;
   int nbytes;
   struct in6_addr raddr;
-  uint32_t metric;
-  int i;
-  u_char nexthop_num;
-  struct nexthop *nexthop;
   struct bgp_nexthop_cache *bnc;
 
   s = zlookup->ibuf;
@@ -833,43 +1002,13 @@ zlookup_read_ipv6 (void)
   
   stream_get (&raddr, s, 16);
 
-  metric = stream_getl (s);
-  nexthop_num = stream_getc (s);
-
-  if (nexthop_num)
+  bnc = bnc_new ();
+  bnc_nexthop_read (s, bnc);
+  if (! bnc->valid)
     {
-      bnc = bnc_new ();
-      bnc->valid = 1;
-      bnc->metric = metric;
-      bnc->nexthop_num = nexthop_num;
-
-      for (i = 0; i < nexthop_num; i++)
-	{
-	  nexthop = XCALLOC (MTYPE_NEXTHOP, sizeof (struct nexthop));
-	  nexthop->type = stream_getc (s);
-	  switch (nexthop->type)
-	    {
-	    case ZEBRA_NEXTHOP_IPV6:
-	      stream_get (&nexthop->gate.ipv6, s, 16);
-	      break;
-	    case ZEBRA_NEXTHOP_IPV6_IFINDEX:
-	    case ZEBRA_NEXTHOP_IPV6_IFNAME:
-	      stream_get (&nexthop->gate.ipv6, s, 16);
-	      nexthop->ifindex = stream_getl (s);
-	      break;
-	    case ZEBRA_NEXTHOP_IFINDEX:
-	    case ZEBRA_NEXTHOP_IFNAME:
-	      nexthop->ifindex = stream_getl (s);
-	      break;
-	    default:
-	      /* do nothing */
-	      break;
-	    }
-	  bnc_nexthop_add (bnc, nexthop);
-	}
+      bnc_free (bnc);
+      return NULL;
     }
-  else
-    return NULL;
 
   return bnc;
 }
@@ -1192,7 +1331,7 @@ show_ip_bgp_scan_tables (struct vty *vty, const char detail)
   struct bgp_node *rn;
   struct bgp_nexthop_cache *bnc;
   char buf[INET6_ADDRSTRLEN];
-  u_char i;
+  struct nexthop *nexthop;
 
   if (bgp_scan_thread)
     vty_out (vty, "BGP scan is running%s", VTY_NEWLINE);
@@ -1209,17 +1348,17 @@ show_ip_bgp_scan_tables (struct vty *vty, const char detail)
 	  vty_out (vty, " %s valid [IGP metric %d]%s",
 		   inet_ntop (AF_INET, &rn->p.u.prefix4, buf, INET6_ADDRSTRLEN), bnc->metric, VTY_NEWLINE);
 	  if (detail)
-	    for (i = 0; i < bnc->nexthop_num; i++)
-	      switch (bnc->nexthop[i].type)
+	    for (nexthop = bnc->nexthop; nexthop; nexthop = nexthop->next)
+	      switch (nexthop->type)
 	      {
 	      case NEXTHOP_TYPE_IPV4:
-		vty_out (vty, "  gate %s%s", inet_ntop (AF_INET, &bnc->nexthop[i].gate.ipv4, buf, INET6_ADDRSTRLEN), VTY_NEWLINE);
+		vty_out (vty, "  gate %s%s", inet_ntop (AF_INET, &nexthop->gate.ipv4, buf, INET6_ADDRSTRLEN), VTY_NEWLINE);
 		break;
 	      case NEXTHOP_TYPE_IFINDEX:
-		vty_out (vty, "  ifidx %u%s", bnc->nexthop[i].ifindex, VTY_NEWLINE);
+		vty_out (vty, "  ifidx %u%s", nexthop->ifindex, VTY_NEWLINE);
 		break;
 	      default:
-		vty_out (vty, "  invalid nexthop type %u%s", bnc->nexthop[i].type, VTY_NEWLINE);
+		vty_out (vty, "  invalid nexthop type %u%s", nexthop->type, VTY_NEWLINE);
 	      }
 	}
 	else
@@ -1240,17 +1379,17 @@ show_ip_bgp_scan_tables (struct vty *vty, const char detail)
 		     inet_ntop (AF_INET6, &rn->p.u.prefix6, buf, INET6_ADDRSTRLEN),
 		     bnc->metric, VTY_NEWLINE);
 	    if (detail)
-	      for (i = 0; i < bnc->nexthop_num; i++)
-		switch (bnc->nexthop[i].type)
+	      for (nexthop = bnc->nexthop; nexthop; nexthop = nexthop->next)
+		switch (nexthop->type)
 		{
 		case NEXTHOP_TYPE_IPV6:
-		  vty_out (vty, "  gate %s%s", inet_ntop (AF_INET6, &bnc->nexthop[i].gate.ipv6, buf, INET6_ADDRSTRLEN), VTY_NEWLINE);
+		  vty_out (vty, "  gate %s%s", inet_ntop (AF_INET6, &nexthop->gate.ipv6, buf, INET6_ADDRSTRLEN), VTY_NEWLINE);
 		  break;
 		case NEXTHOP_TYPE_IFINDEX:
-		  vty_out (vty, "  ifidx %u%s", bnc->nexthop[i].ifindex, VTY_NEWLINE);
+		  vty_out (vty, "  ifidx %u%s", nexthop->ifindex, VTY_NEWLINE);
 		  break;
 		default:
-		  vty_out (vty, "  invalid nexthop type %u%s", bnc->nexthop[i].type, VTY_NEWLINE);
+		  vty_out (vty, "  invalid nexthop type %u%s", nexthop->type, VTY_NEWLINE);
 		}
 	  }
 	  else
@@ -1326,16 +1465,12 @@ bgp_scan_init (void)
   bgp_scan_interval = BGP_SCAN_INTERVAL_DEFAULT;
   bgp_import_interval = BGP_IMPORT_INTERVAL_DEFAULT;
 
-  cache1_table[AFI_IP] = bgp_table_init (AFI_IP, SAFI_UNICAST);
-  cache2_table[AFI_IP] = bgp_table_init (AFI_IP, SAFI_UNICAST);
-  bgp_nexthop_cache_table[AFI_IP] = cache1_table[AFI_IP];
+  bgp_nexthop_cache_table[AFI_IP] = bgp_table_init (AFI_IP, SAFI_UNICAST);
 
   bgp_connected_table[AFI_IP] = bgp_table_init (AFI_IP, SAFI_UNICAST);
 
 #ifdef HAVE_IPV6
-  cache1_table[AFI_IP6] = bgp_table_init (AFI_IP6, SAFI_UNICAST);
-  cache2_table[AFI_IP6] = bgp_table_init (AFI_IP6, SAFI_UNICAST);
-  bgp_nexthop_cache_table[AFI_IP6] = cache1_table[AFI_IP6];
+  bgp_nexthop_cache_table[AFI_IP6] = bgp_table_init (AFI_IP6, SAFI_UNICAST);
   bgp_connected_table[AFI_IP6] = bgp_table_init (AFI_IP6, SAFI_UNICAST);
 #endif /* HAVE_IPV6 */
 
@@ -1358,27 +1493,19 @@ bgp_scan_init (void)
 void
 bgp_scan_finish (void)
 {
-  /* Only the current one needs to be reset. */
-  bgp_nexthop_cache_reset (bgp_nexthop_cache_table[AFI_IP]);
-
-  bgp_table_unlock (cache1_table[AFI_IP]);
-  cache1_table[AFI_IP] = NULL;
+  THREAD_OFF (bgp_onlink_thread);
 
-  bgp_table_unlock (cache2_table[AFI_IP]);
-  cache2_table[AFI_IP] = NULL;
+  bgp_nexthop_cache_reset (bgp_nexthop_cache_table[AFI_IP]);
+  bgp_table_unlock (bgp_nexthop_cache_table[AFI_IP]);
+  bgp_nexthop_cache_table[AFI_IP] = NULL;
 
   bgp_table_unlock (bgp_connected_table[AFI_IP]);
   bgp_connected_table[AFI_IP] = NULL;
 
 #ifdef HAVE_IPV6
-  /* Only the current one needs to be reset. */
   bgp_nexthop_cache_reset (bgp_nexthop_cache_table[AFI_IP6]);
-
-  bgp_table_unlock (cache1_table[AFI_IP6]);
-  cache1_table[AFI_IP6] = NULL;
-
-  bgp_table_unlock (cache2_table[AFI_IP6]);
-  cache2_table[AFI_IP6] = NULL;
+  bgp_table_unlock (bgp_nexthop_cache_table[AFI_IP6]);
+  bgp_nexthop_cache_table[AFI_IP6] = NULL;
 
   bgp_table_unlock (bgp_connected_table[AFI_IP6]);
   bgp_connected_table[AFI_IP6] = NULL;
@@ -44,12 +44,23 @@ struct bgp_nexthop_cache
   /* Nexthop number and nexthop linked list.*/
   u_char nexthop_num;
   struct nexthop *nexthop;
+
+  /* Node in the nexthop cache. */
+  struct bgp_node *node;
+
+  /* Paths using this nexthop, re-evaluated when zebra says it changed. */
+  struct bgp_info *paths;
+  unsigned long path_count;
 };
 
+struct zclient;
+
 extern void bgp_scan_init (void);
 extern void bgp_scan_finish (void);
-extern int bgp_nexthop_lookup (afi_t, struct peer *peer, struct bgp_info *,
-			int *, int *);
+extern int bgp_nexthop_lookup (afi_t, struct bgp_node *, struct bgp_info *);
+extern void bgp_nexthop_unlink (struct bgp_info *);
+extern int bgp_nexthop_update (int, struct zclient *, zebra_size_t);
+extern void bgp_nexthop_register_all (struct zclient *);
 extern void bgp_connected_add (struct connected *c);
 extern void bgp_connected_delete (struct connected *c);
 extern int bgp_multiaccess_check_v4 (struct in_addr, char *);
@@ -47,8 +47,11 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_mplsvpn.h"
 #include "bgpd/bgp_advertise.h"
 #include "bgpd/bgp_vty.h"
+#include "bgpd/bgp_updgrp.h"
 
 int stream_put_prefix (struct stream *, struct prefix *);
+
+static void bgp_read_buffered_on (struct peer *);
 
 /* Set up BGP packet marker and packet type. */
 static int
@@ -137,6 +140,9 @@ bgp_connect_check (struct peer *peer)
     }
 }
 
+/* Prefixes in the UPDATE being built, for bgp_updgrp_packet_add. */
+static struct bgp_node *update_rn[BGP_MAX_PACKET_SIZE];
+
 /* Make BGP update packet.  */
 static struct stream *
 bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
@@ -147,8 +153,13 @@ bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
   struct stream *packet;
   struct bgp_node *rn = NULL;
   struct bgp_info *binfo = NULL;
+  struct stream *shared;
+  unsigned int shared_count = 0;
+  struct attr *attr = NULL;
+  struct peer *first_from = NULL;
   bgp_size_t total_attr_len = 0;
   unsigned long pos;
+  unsigned int count = 0;
   char buf[BUFSIZ];
 
   s = peer->work;
@@ -156,6 +167,18 @@ bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
 
   adv = FIFO_HEAD (&peer->sync[afi][safi]->update);
 
+  /* Another member of the update group may already have been sent
+   * exactly this UPDATE.  If so, only the adj-out bookkeeping below is
+   * done, and the packet is copied.
+   */
+  shared = bgp_updgrp_packet_lookup (peer, afi, safi, adv, &shared_count);
+  if (adv)
+    {
+      attr = adv->baa->attr;
+      if (adv->binfo)
+        first_from = adv->binfo->peer;
+    }
+
   while (adv)
     {
       assert (adv->rn);
@@ -164,12 +187,17 @@ bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
       if (adv->binfo)
         binfo = adv->binfo;
 
+      if (shared)
+	{
+	  if (count == shared_count)
+	    break;
+	}
       /* When remaining space can't include NLRI and it's length.  */
-      if (STREAM_REMAIN (s) <= BGP_NLRI_LENGTH + PSIZE (rn->p.prefixlen))
+      else if (STREAM_REMAIN (s) <= BGP_NLRI_LENGTH + PSIZE (rn->p.prefixlen))
 	break;
 
       /* If packet is empty, set attribute. */
-      if (stream_empty (s))
+      if (! shared && stream_empty (s))
 	{
 	  struct prefix_rd *prd = NULL;
 	  u_char *tag = NULL;
@@ -195,8 +223,9 @@ bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
 	  stream_putw_at (s, pos, total_attr_len);
 	}
 
-      if (afi == AFI_IP && safi == SAFI_UNICAST)
+      if (afi == AFI_IP && safi == SAFI_UNICAST && ! shared)
 	stream_put_prefix (s, &rn->p);
+      update_rn[count++] = rn;
       
       if (BGP_DEBUG (update, UPDATE_OUT))
 	zlog (peer->log, LOG_DEBUG, "%s send UPDATE %s/%d",
@@ -217,11 +246,20 @@ bgp_update_packet (struct peer *peer, afi_t afi, safi_t safi)
       if (! (afi == AFI_IP && safi == SAFI_UNICAST))
 	break;
     }
+
+  if (shared)
+    {
+      bgp_packet_add (peer, shared);
+      BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
+      return shared;
+    }
 	 
   if (! stream_empty (s))
     {
       bgp_packet_set_size (s);
       packet = stream_dup (s);
+      bgp_updgrp_packet_add (peer, afi, safi, packet, attr,
+			     first_from, update_rn, count);
       bgp_packet_add (peer, packet);
       BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
       stream_reset (s);
@@ -1357,7 +1395,10 @@ bgp_open_receive (struct peer *peer, bgp_size_t size)
       realpeer->fd = peer->fd;
       peer->fd = -1;
 
-      /* Transfer input buffer. */
+      /* Transfer input buffers, with anything read after the OPEN. */
+      stream_free (realpeer->rbuf);
+      realpeer->rbuf = peer->rbuf;
+      peer->rbuf = NULL;
       stream_free (realpeer->ibuf);
       realpeer->ibuf = peer->ibuf;
       realpeer->packet_size = peer->packet_size;
@@ -1376,6 +1417,8 @@ bgp_open_receive (struct peer *peer, bgp_size_t size)
 		    peer->fd);
 	  return -1;
 	}
+      if (STREAM_READABLE (peer->rbuf))
+	bgp_read_buffered_on (peer);
       BGP_READ_ON (peer->t_read, bgp_read, peer->fd);
     }
 
@@ -1484,10 +1527,6 @@ bgp_open_receive (struct peer *peer, bgp_size_t size)
 
   BGP_EVENT_ADD (peer, Receive_OPEN_message);
 
-  peer->packet_size = 0;
-  if (peer->ibuf)
-    stream_reset (peer->ibuf);
-
   return 0;
 }
 
@@ -1506,7 +1545,7 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
   struct bgp_nlri withdraw;
   struct bgp_nlri mp_update;
   struct bgp_nlri mp_withdraw;
-  char attrstr[BUFSIZ] = "";
+  char attrstr[BUFSIZ];
 
   /* Status must be Established. */
   if (peer->status != Established) 
@@ -1623,6 +1662,7 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
   if (attr_parse_ret == BGP_ATTR_PARSE_WITHDRAW
       || BGP_DEBUG (update, UPDATE_IN))
     {
+      attrstr[0] = '\0';
       ret= bgp_dump_attr (peer, &attr, attrstr, BUFSIZ);
       int lvl = (attr_parse_ret == BGP_ATTR_PARSE_WITHDRAW)
                  ? LOG_ERR : LOG_DEBUG;
@@ -2113,6 +2153,7 @@ bgp_route_refresh_receive (struct peer *peer, bgp_size_t size)
 		}
 	      peer->orf_plist[afi][safi] =
 			 prefix_list_lookup (AFI_ORF_PREFIX, name);
+	      bgp_updgrp_config_change ();
 	    }
 	  stream_forward_getp (s, orf_len);
 	}
@@ -2277,21 +2318,22 @@ bgp_capability_receive (struct peer *peer, bgp_size_t size)
   return bgp_capability_msg_parse (peer, pnt, size);
 }
 
-/* BGP read utility function. */
+/* Read what the peer has sent into peer->rbuf, as much as there is
+ * room for after any part message left from the last read.  Returns 0
+ * if something was read, -1 otherwise.
+ */
 static int
 bgp_read_packet (struct peer *peer)
 {
   int nbytes;
-  int readsize;
-
-  readsize = peer->packet_size - stream_get_endp (peer->ibuf);
 
-  /* If size is zero then return. */
-  if (! readsize)
+  stream_pulldown (peer->rbuf);
+  if (STREAM_WRITEABLE (peer->rbuf) == 0)
     return 0;
 
   /* Read packet from fd. */
-  nbytes = stream_read_try (peer->ibuf, peer->fd, readsize);
+  nbytes = stream_read_try (peer->rbuf, peer->fd,
+			    STREAM_WRITEABLE (peer->rbuf));
 
   /* If read byte is smaller than zero then error occured. */
   if (nbytes < 0) 
@@ -2340,10 +2382,6 @@ bgp_read_packet (struct peer *peer)
       return -1;
     }
 
-  /* We read partial packet. */
-  if (stream_get_endp (peer->ibuf) != peer->packet_size)
-    return -1;
-
   return 0;
 }
 
@@ -2351,62 +2389,76 @@ bgp_read_packet (struct peer *peer)
 static int
 bgp_marker_all_one (struct stream *s, int length)
 {
+  u_char *marker = stream_pnt (s);
   int i;
 
   for (i = 0; i < length; i++)
-    if (s->data[i] != 0xff)
+    if (marker[i] != 0xff)
       return 0;
 
   return 1;
 }
 
-/* Starting point of packet process function. */
+/* Does peer->rbuf hold a whole message? */
+static int
+bgp_read_complete (struct peer *peer)
+{
+  struct stream *s = peer->rbuf;
+
+  if (s == NULL || STREAM_READABLE (s) < BGP_HEADER_SIZE)
+    return 0;
+
+  return STREAM_READABLE (s)
+	 >= stream_getw_from (s, stream_get_getp (s) + BGP_MARKER_SIZE);
+}
+
+/* Is there input from the peer waiting to be dealt with, either unread
+ * on its socket or read but not yet handled?
+ */
 int
-bgp_read (struct thread *thread)
+bgp_read_pending (struct peer *peer)
 {
-  int ret;
+  int avail = 0;
+
+  if (bgp_read_complete (peer))
+    return 1;
+
+  if (peer->fd < 0)
+    return 0;
+
+  if (ioctl (peer->fd, FIONREAD, &avail) < 0)
+    return 0;
+
+  return avail > 0;
+}
+
+/* Frame and process the next message in peer->rbuf.  The handlers read
+ * it where it lies, through peer->ibuf.  Returns 0 if a whole message
+ * was there and handled, -1 if more data is needed or the message was
+ * rejected.
+ */
+static int
+bgp_read_message (struct peer *peer)
+{
+  struct stream *rbuf = peer->rbuf;
+  struct stream *s;
   u_char type = 0;
-  struct peer *peer;
   bgp_size_t size;
+  size_t getp;
   char notify_data_length[2];
 
-  /* Yes first of all get peer pointer. */
-  peer = THREAD_ARG (thread);
-  peer->t_read = NULL;
+  if (STREAM_READABLE (rbuf) < BGP_HEADER_SIZE)
+    return -1;
 
-  /* For non-blocking IO check. */
-  if (peer->status == Connect)
-    {
-      bgp_connect_check (peer);
-      goto done;
-    }
-  else
-    {
-      if (peer->fd < 0)
-	{
-	  zlog_err ("bgp_read peer's fd is negative value %d", peer->fd);
-	  return -1;
-	}
-      BGP_READ_ON (peer->t_read, bgp_read, peer->fd);
-    }
+  /* Get size and type. */
+  getp = stream_get_getp (rbuf);
+  size = stream_getw_from (rbuf, getp + BGP_MARKER_SIZE);
+  type = stream_getc_from (rbuf, getp + BGP_MARKER_SIZE + 2);
 
-  /* Read packet header to determine type of the packet */
+  /* Check the header once, when it has first been read. */
   if (peer->packet_size == 0)
-    peer->packet_size = BGP_HEADER_SIZE;
-
-  if (stream_get_endp (peer->ibuf) < BGP_HEADER_SIZE)
     {
-      ret = bgp_read_packet (peer);
-
-      /* Header read error or partial read packet. */
-      if (ret < 0) 
-	goto done;
-
-      /* Get size and type. */
-      stream_forward_getp (peer->ibuf, BGP_MARKER_SIZE);
-      memcpy (notify_data_length, stream_pnt (peer->ibuf), 2);
-      size = stream_getw (peer->ibuf);
-      type = stream_getc (peer->ibuf);
+      memcpy (notify_data_length, stream_pnt (rbuf) + BGP_MARKER_SIZE, 2);
 
       if (BGP_DEBUG (normal, NORMAL) && type != 2 && type != 0)
 	zlog_debug ("%s rcv message type %d, length (excl. header) %d",
@@ -2414,7 +2466,7 @@ bgp_read (struct thread *thread)
 
       /* Marker check */
       if (((type == BGP_MSG_OPEN) || (type == BGP_MSG_KEEPALIVE))
-	  && ! bgp_marker_all_one (peer->ibuf, BGP_MARKER_SIZE))
+	  && ! bgp_marker_all_one (rbuf, BGP_MARKER_SIZE))
 	{
 	  bgp_notify_send (peer,
 			   BGP_NOTIFY_HEADER_ERR, 
@@ -2467,18 +2519,20 @@ bgp_read (struct thread *thread)
       peer->packet_size = size;
     }
 
-  ret = bgp_read_packet (peer);
-  if (ret < 0) 
-    goto done;
+  /* Wait for the rest of the message. */
+  if (STREAM_READABLE (rbuf) < size)
+    return -1;
+  peer->packet_size = 0;
 
-  /* Get size and type again. */
-  size = stream_getw_from (peer->ibuf, BGP_MARKER_SIZE);
-  type = stream_getc_from (peer->ibuf, BGP_MARKER_SIZE + 2);
+  /* Point the input stream at the message, just past its header. */
+  s = peer->ibuf;
+  stream_view (s, rbuf, size);
+  stream_forward_getp (s, BGP_HEADER_SIZE);
 
   /* BGP packet dump function. */
-  bgp_dump_packet (peer, type, peer->ibuf);
+  bgp_dump_packet (peer, type, s);
   
-  size = (peer->packet_size - BGP_HEADER_SIZE);
+  size -= BGP_HEADER_SIZE;
 
   /* Read rest of the packet and call each sort of packet routine */
   switch (type) 
@@ -2509,10 +2563,83 @@ bgp_read (struct thread *thread)
       break;
     }
 
-  /* Clear input buffer. */
-  peer->packet_size = 0;
-  if (peer->ibuf)
-    stream_reset (peer->ibuf);
+  /* Clear input buffer.  An OPEN may have handed it to another peer. */
+  stream_unview (s);
+
+  return 0;
+
+ done:
+  /* The session is going down, drop anything read after the header. */
+  stream_reset (rbuf);
+  return -1;
+}
+
+/* Handle the whole messages read into peer->rbuf.  Once a message has
+ * left the session short of Established, the FSM events it raised must
+ * run before the next can be handled, so come back for the rest after
+ * them.  Once a NOTIFICATION has been sent the session is over, even if
+ * the stop event has not run yet, and the rest is dropped.
+ */
+static void
+bgp_read_messages (struct peer *peer)
+{
+  int fd = peer->fd;
+  u_int32_t notify_out;
+
+  for (;;)
+    {
+      notify_out = peer->notify_out;
+      if (bgp_read_message (peer) != 0)
+	break;
+      if (peer->fd != fd)
+	return;
+      if (peer->notify_out != notify_out)
+	{
+	  if (peer->rbuf)
+	    stream_reset (peer->rbuf);
+	  return;
+	}
+      if (peer->status != Established)
+	break;
+    }
+
+  if (bgp_read_complete (peer))
+    bgp_read_buffered_on (peer);
+}
+
+/* Starting point of packet process function.  One read takes in all the
+ * socket has, up to BGP_READ_BUFSIZ, and the messages in it are handled
+ * in place.  A peer sending a full table then costs one wakeup and one
+ * read for several messages, while other peers (and their keepalives)
+ * are still serviced in between.
+ */
+int
+bgp_read (struct thread *thread)
+{
+  struct peer *peer;
+
+  /* Yes first of all get peer pointer. */
+  peer = THREAD_ARG (thread);
+  peer->t_read = NULL;
+
+  /* For non-blocking IO check. */
+  if (peer->status == Connect)
+    {
+      bgp_connect_check (peer);
+      goto done;
+    }
+  else
+    {
+      if (peer->fd < 0)
+	{
+	  zlog_err ("bgp_read peer's fd is negative value %d", peer->fd);
+	  return -1;
+	}
+      BGP_READ_ON (peer->t_read, bgp_read, peer->fd);
+    }
+
+  if (bgp_read_packet (peer) == 0)
+    bgp_read_messages (peer);
 
  done:
   if (CHECK_FLAG (peer->sflags, PEER_STATUS_ACCEPT_PEER))
@@ -2523,3 +2650,39 @@ bgp_read (struct thread *thread)
     }
   return 0;
 }
+
+/* Handle messages left in peer->rbuf by an earlier read, without
+ * reading the socket, which may be in blocking mode.
+ */
+static int
+bgp_read_buffered (struct thread *thread)
+{
+  struct peer *peer;
+
+  peer = THREAD_ARG (thread);
+  peer->t_read = NULL;
+
+  if (peer->fd < 0)
+    return 0;
+  BGP_READ_ON (peer->t_read, bgp_read, peer->fd);
+
+  bgp_read_messages (peer);
+
+  if (CHECK_FLAG (peer->sflags, PEER_STATUS_ACCEPT_PEER))
+    {
+      if (BGP_DEBUG (events, EVENTS))
+	zlog_debug ("%s [Event] Accepting BGP peer delete", peer->host);
+      peer_delete (peer);
+    }
+  return 0;
+}
+
+/* Come back to bgp_read_buffered instead of waiting on the socket, after
+ * the events already queued.
+ */
+static void
+bgp_read_buffered_on (struct peer *peer)
+{
+  BGP_READ_OFF (peer->t_read);
+  peer->t_read = thread_add_event (master, bgp_read_buffered, peer, 0);
+}
@@ -26,6 +26,11 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #define BGP_UNFEASIBLE_LEN    2U
 #define BGP_WRITE_PACKET_MAX 10U
 
+/* Size of a peer's receive buffer.  Messages are parsed where they
+ * were read into it, as many as one read brought in.
+ */
+#define BGP_READ_BUFSIZ      (8 * BGP_MAX_PACKET_SIZE)
+
 /* When to refresh */
 #define REFRESH_IMMEDIATE 1
 #define REFRESH_DEFER     2 
@@ -40,6 +45,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 /* Packet send and receive function prototypes. */
 extern int bgp_read (struct thread *);
 extern int bgp_write (struct thread *);
+extern int bgp_read_pending (struct peer *);
 
 extern void bgp_keepalive_send (struct peer *);
 extern void bgp_open_send (struct peer *);
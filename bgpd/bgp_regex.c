@@ -79,15 +79,166 @@ bgp_regcomp (const char *regstr)
   return regex;
 }
 
+void
+bgp_regex_free (regex_t *regex)
+{
+  regfree (regex);
+  XFREE (MTYPE_BGP_REGEXP, regex);
+}
+
+/* Characters `_' matches, other than the beginning and end of line. */
+#define ASPATH_REGEX_DELIM(C)	((C) != '\0' && strchr (",{}() ", (C)))
+
+/* Most AS path filters are written as one or a few ASNs between `_',
+   `^' and `$', e.g. "_65000_", "^65000_", "_65000$" or "^65000_65001_".
+   Note those so they can be matched by comparing the ASNs in the path
+   string, which gives the same result as regexec() for much less work. */
+static void
+aspath_regex_fast (struct aspath_regex *ar, const char *regstr)
+{
+  const char *p = regstr;
+  const char *start;
+  char *q;
+
+  if (strcmp (regstr, ".*") == 0)
+    {
+      ar->fast = ASPATH_REGEX_ANY;
+      return;
+    }
+  if (strcmp (regstr, "^$") == 0)
+    {
+      ar->fast = ASPATH_REGEX_EMPTY;
+      return;
+    }
+
+  if (*p == '^')
+    ar->anchor_start = 1;
+  else if (*p != '_')
+    return;
+  p++;
+
+  /* The ASNs are copied out as separate strings. */
+  q = ar->tokens = XMALLOC (MTYPE_BGP_REGEXP, strlen (regstr) + 1);
+
+  while (1)
+    {
+      if (ar->count == ASPATH_REGEX_TOKEN_MAX || ! isdigit ((int) *p))
+	return;
+
+      start = p;
+      while (isdigit ((int) *p))
+	p++;
+      ar->token[ar->count] = q;
+      ar->token_len[ar->count] = p - start;
+      ar->count++;
+      memcpy (q, start, p - start);
+      q += p - start;
+      *q++ = '\0';
+
+      if (*p == '_')
+	{
+	  if (*++p == '\0')
+	    break;
+	}
+      else if (*p == '$' && p[1] == '\0')
+	{
+	  ar->anchor_end = 1;
+	  break;
+	}
+      else
+	return;
+    }
+
+  ar->fast = ASPATH_REGEX_TOKENS;
+}
+
+/* Do the ASNs of a fast form match the path string from p on? */
+static int
+aspath_regex_match_at (struct aspath_regex *ar, const char *p)
+{
+  int i;
+
+  for (i = 0; i < ar->count; i++)
+    {
+      if (strncmp (p, ar->token[i], ar->token_len[i]) != 0)
+	return 0;
+      p += ar->token_len[i];
+
+      if (i < ar->count - 1)
+	{
+	  if (! ASPATH_REGEX_DELIM (*p))
+	    return 0;
+	  p++;
+	}
+    }
+
+  if (ar->anchor_end)
+    return *p == '\0';
+  return *p == '\0' || ASPATH_REGEX_DELIM (*p);
+}
+
+struct aspath_regex *
+bgp_aspath_regcomp (const char *regstr)
+{
+  struct aspath_regex *ar;
+
+  ar = XCALLOC (MTYPE_BGP_REGEXP, sizeof (struct aspath_regex));
+  ar->str = XSTRDUP (MTYPE_BGP_REGEXP, regstr);
+
+  aspath_regex_fast (ar, ar->str);
+  if (ar->fast)
+    return ar;
+
+  ar->count = 0;
+  ar->anchor_start = ar->anchor_end = 0;
+  if (ar->tokens)
+    XFREE (MTYPE_BGP_REGEXP, ar->tokens);
+  ar->tokens = NULL;
+  ar->reg = bgp_regcomp (regstr);
+  if (ar->reg == NULL)
+    {
+      bgp_aspath_regex_free (ar);
+      return NULL;
+    }
+
+  return ar;
+}
+
+/* Match an AS path, returning 0 or REG_NOMATCH like regexec(). */
 int
-bgp_regexec (regex_t *regex, struct aspath *aspath)
+bgp_aspath_regexec (struct aspath_regex *ar, struct aspath *aspath)
 {
-  return regexec (regex, aspath->str, 0, NULL, 0);
+  const char *str = aspath->str;
+  const char *p;
+
+  switch (ar->fast)
+    {
+    case ASPATH_REGEX_ANY:
+      return 0;
+    case ASPATH_REGEX_EMPTY:
+      return str[0] == '\0' ? 0 : REG_NOMATCH;
+    case ASPATH_REGEX_TOKENS:
+      if (ar->anchor_start)
+	return aspath_regex_match_at (ar, str) ? 0 : REG_NOMATCH;
+      /* Only look where the first ASN appears.  An empty path can't
+	 match, there's at least one ASN. */
+      for (p = str; (p = strstr (p, ar->token[0])) != NULL; p++)
+	if ((p == str || ASPATH_REGEX_DELIM (p[-1]))
+	    && aspath_regex_match_at (ar, p))
+	  return 0;
+      return REG_NOMATCH;
+    default:
+      return regexec (ar->reg, str, 0, NULL, 0);
+    }
 }
 
 void
-bgp_regex_free (regex_t *regex)
+bgp_aspath_regex_free (struct aspath_regex *ar)
 {
-  regfree (regex);
-  XFREE (MTYPE_BGP_REGEXP, regex);
+  if (ar->reg)
+    bgp_regex_free (ar->reg);
+  if (ar->tokens)
+    XFREE (MTYPE_BGP_REGEXP, ar->tokens);
+  XFREE (MTYPE_BGP_REGEXP, ar->str);
+  XFREE (MTYPE_BGP_REGEXP, ar);
 }
@@ -33,8 +33,41 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 # endif /* HAVE_GNU_REGEX */
 #endif /* HAVE_LIBPCREPOSIX */
 
+/* AS path regular expression.  The common forms are matched by
+   comparing ASNs rather than with regexec(). */
+#define ASPATH_REGEX_TOKEN_MAX	8
+
+struct aspath_regex
+{
+  /* What was configured. */
+  char *str;
+
+  /* Compiled regular expression, unless it is one of the fast forms. */
+  regex_t *reg;
+
+  /* Fast form, if any. */
+#define ASPATH_REGEX_ANY	1	/* .* */
+#define ASPATH_REGEX_EMPTY	2	/* ^$ */
+#define ASPATH_REGEX_TOKENS	3	/* (^|_)ASN(_ASN)*(_|$) */
+  u_char fast;
+
+  u_char anchor_start;
+  u_char anchor_end;
+
+  /* ASNs of the token form, as strings in tokens. */
+  char *tokens;
+  int count;
+  const char *token[ASPATH_REGEX_TOKEN_MAX];
+  size_t token_len[ASPATH_REGEX_TOKEN_MAX];
+};
+
 extern void bgp_regex_free (regex_t *regex);
 extern regex_t *bgp_regcomp (const char *str);
-extern int bgp_regexec (regex_t *regex, struct aspath *aspath);
+
+struct aspath;
+
+extern struct aspath_regex *bgp_aspath_regcomp (const char *);
+extern int bgp_aspath_regexec (struct aspath_regex *, struct aspath *);
+extern void bgp_aspath_regex_free (struct aspath_regex *);
 
 #endif /* _QUAGGA_BGP_REGEX_H */
@@ -19,6 +19,9 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 02111-1307, USA.  */
 
 #include <zebra.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif /* HAVE_PTHREAD */
 
 #include "prefix.h"
 #include "linklist.h"
@@ -54,6 +57,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_advertise.h"
 #include "bgpd/bgp_zebra.h"
 #include "bgpd/bgp_vty.h"
+#include "bgpd/bgp_updgrp.h"
 
 /* Extern from bgp_dump.c */
 extern const char *bgp_origin_str[];
@@ -139,6 +143,7 @@ bgp_info_free (struct bgp_info *binfo)
   if (binfo->attr)
     bgp_attr_unintern (&binfo->attr);
   
+  bgp_nexthop_unlink (binfo);
   bgp_info_extra_free (&binfo->extra);
 
   peer_unlock (binfo->peer); /* bgp_info peer reference */
@@ -210,6 +215,7 @@ bgp_info_reap (struct bgp_node *rn, struct bgp_info *ri)
   else
     rn->info = ri->next;
   
+  bgp_nexthop_unlink (ri);
   bgp_info_unlock (ri);
   bgp_unlock_node (rn);
 }
@@ -753,9 +759,52 @@ bgp_import_modifier (struct peer *rsclient, struct peer *peer,
   return RMAP_PERMIT;
 }
 
+/* The parts of the announce check that depend on who the peer is,
+   rather than on its configuration.  These are done for each member of
+   an update group, the rest only once for the group.  */
 static int
-bgp_announce_check (struct bgp_info *ri, struct peer *peer, struct prefix *p,
-		    struct attr *attr, afi_t afi, safi_t safi)
+bgp_announce_check_peer (struct bgp_info *ri, struct peer *peer,
+			 struct prefix *p)
+{
+  char buf[SU_ADDRSTRLEN];
+
+  /* Do not send back route to sender. */
+  if (ri->peer == peer)
+    return 0;
+
+  /* If peer's id and route's nexthop are same. draft-ietf-idr-bgp4-23 5.1.3 */
+  if (p->family == AF_INET
+      && IPV4_ADDR_SAME(&peer->remote_id, &ri->attr->nexthop))
+    return 0;
+#ifdef HAVE_IPV6
+  if (p->family == AF_INET6
+     && IPV6_ADDR_SAME(&peer->remote_id, &ri->attr->nexthop))
+    return 0;
+#endif
+
+  /* If the attribute has originator-id and it is same as remote
+     peer's id. */
+  if (ri->attr->flag & ATTR_FLAG_BIT (BGP_ATTR_ORIGINATOR_ID))
+    {
+      if (IPV4_ADDR_SAME (&peer->remote_id, &ri->attr->extra->originator_id))
+	{
+	  if (BGP_DEBUG (filter, FILTER))  
+	    zlog (peer->log, LOG_DEBUG,
+		  "%s [Update:SEND] %s/%d originator-id is same as remote router-id",
+		  peer->host,
+		  inet_ntop(p->family, &p->u.prefix, buf, SU_ADDRSTRLEN),
+		  p->prefixlen);
+	  return 0;
+	}
+    }
+
+  return 1;
+}
+
+static int
+bgp_announce_check_policy (struct bgp_info *ri, struct peer *peer,
+			   struct prefix *p, struct attr *attr,
+			   afi_t afi, safi_t safi)
 {
   int ret;
   char buf[SU_ADDRSTRLEN];
@@ -776,20 +825,6 @@ bgp_announce_check (struct bgp_info *ri, struct peer *peer, struct prefix *p,
   if (CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_RSERVER_CLIENT))
     return 0;
 
-  /* Do not send back route to sender. */
-  if (from == peer)
-    return 0;
-
-  /* If peer's id and route's nexthop are same. draft-ietf-idr-bgp4-23 5.1.3 */
-  if (p->family == AF_INET
-      && IPV4_ADDR_SAME(&peer->remote_id, &ri->attr->nexthop))
-    return 0;
-#ifdef HAVE_IPV6
-  if (p->family == AF_INET6
-     && IPV6_ADDR_SAME(&peer->remote_id, &ri->attr->nexthop))
-    return 0;
-#endif
-
   /* Aggregate-address suppress check. */
   if (ri->extra && ri->extra->suppress)
     if (! UNSUPPRESS_MAP_NAME (filter))
@@ -817,22 +852,6 @@ bgp_announce_check (struct bgp_info *ri, struct peer *peer, struct prefix *p,
   if (! transparent && bgp_community_filter (peer, ri->attr)) 
     return 0;
 
-  /* If the attribute has originator-id and it is same as remote
-     peer's id. */
-  if (ri->attr->flag & ATTR_FLAG_BIT (BGP_ATTR_ORIGINATOR_ID))
-    {
-      if (IPV4_ADDR_SAME (&peer->remote_id, &ri->attr->extra->originator_id))
-	{
-	  if (BGP_DEBUG (filter, FILTER))  
-	    zlog (peer->log, LOG_DEBUG,
-		  "%s [Update:SEND] %s/%d originator-id is same as remote router-id",
-		  peer->host,
-		  inet_ntop(p->family, &p->u.prefix, buf, SU_ADDRSTRLEN),
-		  p->prefixlen);
-	  return 0;
-	}
-    }
- 
   /* ORF prefix-list filter check */
   if (CHECK_FLAG (peer->af_cap[afi][safi], PEER_CAP_ORF_PREFIX_RM_ADV)
       && (CHECK_FLAG (peer->af_cap[afi][safi], PEER_CAP_ORF_PREFIX_SM_RCV)
@@ -1060,6 +1079,14 @@ bgp_announce_check (struct bgp_info *ri, struct peer *peer, struct prefix *p,
   return 1;
 }
 
+static int
+bgp_announce_check (struct bgp_info *ri, struct peer *peer, struct prefix *p,
+		    struct attr *attr, afi_t afi, safi_t safi)
+{
+  return bgp_announce_check_peer (ri, peer, p)
+    && bgp_announce_check_policy (ri, peer, p, attr, afi, safi);
+}
+
 static int
 bgp_announce_check_rsclient (struct bgp_info *ri, struct peer *rsclient,
         struct prefix *p, struct attr *attr, afi_t afi, safi_t safi)
@@ -1264,15 +1291,21 @@ struct bgp_info_pair
   struct bgp_info *new;
 };
 
+/* Select the best path for a node.  This only reads and writes the
+ * bgp_info list of the node it is given - the DMED flags are node local
+ * and don't affect prefix counts - so it is safe to run for several
+ * nodes in parallel.  Reaping of removed routes is left to
+ * bgp_best_selection_reap.
+ */
 static void
-bgp_best_selection (struct bgp *bgp, struct bgp_node *rn, struct bgp_info_pair *result)
+bgp_best_selection_compute (struct bgp *bgp, struct bgp_node *rn,
+                            struct bgp_info_pair *result)
 {
   struct bgp_info *new_select;
   struct bgp_info *old_select;
   struct bgp_info *ri;
   struct bgp_info *ri1;
   struct bgp_info *ri2;
-  struct bgp_info *nextri = NULL;
   
   /* bgp deterministic-med */
   new_select = NULL;
@@ -1313,22 +1346,13 @@ bgp_best_selection (struct bgp *bgp, struct bgp_node *rn, struct bgp_info_pair *
   /* Check old selected route and new selected route. */
   old_select = NULL;
   new_select = NULL;
-  for (ri = rn->info; (ri != NULL) && (nextri = ri->next, 1); ri = nextri)
+  for (ri = rn->info; ri; ri = ri->next)
     {
       if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
 	old_select = ri;
 
       if (BGP_INFO_HOLDDOWN (ri))
-        {
-          /* reap REMOVED routes, if needs be 
-           * selected route must stay for a while longer though
-           */
-          if (CHECK_FLAG (ri->flags, BGP_INFO_REMOVED)
-              && (ri != old_select))
-              bgp_info_reap (rn, ri);
-          
-          continue;
-        }
+        continue;
 
       if (bgp_flag_check (bgp, BGP_FLAG_DETERMINISTIC_MED)
           && (! CHECK_FLAG (ri->flags, BGP_INFO_DMED_SELECTED)))
@@ -1349,6 +1373,31 @@ bgp_best_selection (struct bgp *bgp, struct bgp_node *rn, struct bgp_info_pair *
     return;
 }
 
+/* reap REMOVED routes, if needs be 
+ * selected route must stay for a while longer though
+ */
+static void
+bgp_best_selection_reap (struct bgp_node *rn)
+{
+  struct bgp_info *ri;
+  struct bgp_info *nextri;
+
+  for (ri = rn->info; ri; ri = nextri)
+    {
+      nextri = ri->next;
+      if (CHECK_FLAG (ri->flags, BGP_INFO_REMOVED)
+          && ! CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+        bgp_info_reap (rn, ri);
+    }
+}
+
+static void
+bgp_best_selection (struct bgp *bgp, struct bgp_node *rn, struct bgp_info_pair *result)
+{
+  bgp_best_selection_compute (bgp, rn, result);
+  bgp_best_selection_reap (rn);
+}
+
 static int
 bgp_process_announce_selected (struct peer *peer, struct bgp_info *selected,
                                struct bgp_node *rn, afi_t afi, safi_t safi)
@@ -1397,12 +1446,66 @@ bgp_process_announce_selected (struct peer *peer, struct bgp_info *selected,
   return 0;
 }
 
+/* Announce a selected route to the members of an update group.  The
+   outbound policy is run once, for the first member that passes the
+   per peer checks, and the result used for all of them.  */
+static void
+bgp_process_announce_updgrp (struct bgp_updgrp *updgrp,
+			     struct bgp_info *selected,
+			     struct bgp_node *rn, afi_t afi, safi_t safi)
+{
+  struct listnode *node, *nnode;
+  struct peer *peer;
+  struct prefix *p = &rn->p;
+  struct attr attr = { 0 };
+  int checked = 0;
+  int announce = 0;
+
+  for (ALL_LIST_ELEMENTS (updgrp->peer, node, nnode, peer))
+    {
+      if (peer->status != Established || ! peer->afc_nego[afi][safi])
+	continue;
+
+      /* First update is deferred until ORF or ROUTE-REFRESH is received */
+      if (CHECK_FLAG (peer->af_sflags[afi][safi],
+		      PEER_STATUS_ORF_WAIT_REFRESH))
+	continue;
+
+      if (selected && bgp_announce_check_peer (selected, peer, p))
+	{
+	  if (! checked)
+	    {
+	      announce = bgp_announce_check_policy (selected, peer, p, &attr,
+						    afi, safi);
+	      checked = 1;
+	      updgrp->policy_run++;
+	    }
+	  else
+	    updgrp->policy_shared++;
+
+	  if (announce)
+	    {
+	      bgp_adj_out_set (rn, peer, p, &attr, afi, safi, selected);
+	      continue;
+	    }
+	}
+      bgp_adj_out_unset (rn, peer, p, afi, safi);
+    }
+
+  bgp_attr_extra_free (&attr);
+}
+
 struct bgp_process_queue 
 {
   struct bgp *bgp;
   struct bgp_node *rn;
   afi_t afi;
   safi_t safi;
+
+  /* Set once the node has been processed as part of a parallel batch. */
+  u_char flags;
+#define BGP_PROCESS_QUEUE_DONE		(1 << 0)
+  struct bgp_info_pair result;
 };
 
 static wq_item_status
@@ -1465,10 +1568,13 @@ bgp_process_rsclient (struct work_queue *wq, void *data)
   return WQ_SUCCESS;
 }
 
-static wq_item_status
-bgp_process_main (struct work_queue *wq, void *data)
+/* Act on the result of best path selection for a node of a main table:
+ * update the adj-out of every peer and the FIB.
+ */
+static void
+bgp_process_main_selected (struct bgp_process_queue *pq,
+                           struct bgp_info_pair *old_and_new)
 {
-  struct bgp_process_queue *pq = data;
   struct bgp *bgp = pq->bgp;
   struct bgp_node *rn = pq->rn;
   afi_t afi = pq->afi;
@@ -1476,14 +1582,11 @@ bgp_process_main (struct work_queue *wq, void *data)
   struct prefix *p = &rn->p;
   struct bgp_info *new_select;
   struct bgp_info *old_select;
-  struct bgp_info_pair old_and_new;
   struct listnode *node, *nnode;
-  struct peer *peer;
+  struct bgp_updgrp *updgrp;
   
-  /* Best path selection. */
-  bgp_best_selection (bgp, rn, &old_and_new);
-  old_select = old_and_new.old;
-  new_select = old_and_new.new;
+  old_select = old_and_new->old;
+  new_select = old_and_new->new;
 
   /* Nothing to do. */
   if (old_select && old_select == new_select)
@@ -1491,10 +1594,13 @@ bgp_process_main (struct work_queue *wq, void *data)
       if (! CHECK_FLAG (old_select->flags, BGP_INFO_ATTR_CHANGED))
         {
           if (CHECK_FLAG (old_select->flags, BGP_INFO_IGP_CHANGED))
-            bgp_zebra_announce (p, old_select, bgp);
+            {
+              bgp_zebra_announce (p, old_select, bgp);
+              UNSET_FLAG (old_select->flags, BGP_INFO_IGP_CHANGED);
+            }
           
           UNSET_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED);
-          return WQ_SUCCESS;
+          return;
         }
     }
 
@@ -1507,11 +1613,10 @@ bgp_process_main (struct work_queue *wq, void *data)
     }
 
 
-  /* Check each BGP peer. */
-  for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
-    {
-      bgp_process_announce_selected (peer, new_select, rn, afi, safi);
-    }
+  /* Check each BGP update group. */
+  if (bgp->updgrp[afi][safi])
+    for (ALL_LIST_ELEMENTS (bgp->updgrp[afi][safi], node, nnode, updgrp))
+      bgp_process_announce_updgrp (updgrp, new_select, rn, afi, safi);
 
   /* FIB update. */
   if (safi == SAFI_UNICAST && ! bgp->name &&
@@ -1536,6 +1641,245 @@ bgp_process_main (struct work_queue *wq, void *data)
     bgp_info_reap (rn, old_select);
   
   UNSET_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED);
+}
+
+#ifdef HAVE_PTHREAD
+/* Parallel best path selection.
+ *
+ * When "bgp parallel-bestpath" is configured, the first item run off
+ * the process queue pulls up to BGP_PROCESS_BATCH queued nodes along
+ * with it.  Best path selection for the batch is shared out over a pool
+ * of threads, each taking every n'th node.  Only
+ * bgp_best_selection_compute runs on the pool; reaping, adj-out updates
+ * and zebra announcements are then done on the main thread, in queue
+ * order, exactly as the serial path would have done them.  The pool
+ * threads never allocate, intern or log.
+ *
+ * The whole batch is finished within the one work queue callback, so
+ * no UPDATE can be processed between selection and its use.  The rest
+ * of the batch is left on the queue marked BGP_PROCESS_QUEUE_DONE, and
+ * is simply deleted when its turn comes.
+ */
+#define BGP_PROCESS_BATCH 256
+
+static struct
+{
+  int wanted;			/* configured thread count, incl. main */
+  int nthreads;			/* running threads, incl. main */
+  pthread_t *threads;
+
+  pthread_mutex_t mtx;
+  pthread_cond_t start;
+  pthread_cond_t done;
+  unsigned long generation;
+  int running;
+  int shutdown;
+
+  struct bgp_process_queue *batch[BGP_PROCESS_BATCH];
+  int count;
+} bestpath_pool =
+{
+  .wanted = 1,
+  .nthreads = 1,
+  .mtx = PTHREAD_MUTEX_INITIALIZER,
+  .start = PTHREAD_COND_INITIALIZER,
+  .done = PTHREAD_COND_INITIALIZER,
+};
+
+static void
+bgp_bestpath_pool_run (int id)
+{
+  struct bgp_process_queue *pq;
+  int i;
+
+  for (i = id; i < bestpath_pool.count; i += bestpath_pool.nthreads)
+    {
+      pq = bestpath_pool.batch[i];
+      bgp_best_selection_compute (pq->bgp, pq->rn, &pq->result);
+    }
+}
+
+static void *
+bgp_bestpath_pool_thread (void *arg)
+{
+  int id = (intptr_t) arg;
+  unsigned long generation = 0;
+
+  pthread_mutex_lock (&bestpath_pool.mtx);
+  while (1)
+    {
+      while (bestpath_pool.generation == generation
+             && ! bestpath_pool.shutdown)
+        pthread_cond_wait (&bestpath_pool.start, &bestpath_pool.mtx);
+
+      if (bestpath_pool.shutdown)
+        break;
+      generation = bestpath_pool.generation;
+
+      pthread_mutex_unlock (&bestpath_pool.mtx);
+      bgp_bestpath_pool_run (id);
+      pthread_mutex_lock (&bestpath_pool.mtx);
+
+      if (--bestpath_pool.running == 0)
+        pthread_cond_signal (&bestpath_pool.done);
+    }
+  pthread_mutex_unlock (&bestpath_pool.mtx);
+
+  return NULL;
+}
+
+static void
+bgp_bestpath_pool_stop (void)
+{
+  int i;
+
+  if (bestpath_pool.nthreads <= 1)
+    return;
+
+  pthread_mutex_lock (&bestpath_pool.mtx);
+  bestpath_pool.shutdown = 1;
+  pthread_cond_broadcast (&bestpath_pool.start);
+  pthread_mutex_unlock (&bestpath_pool.mtx);
+
+  for (i = 1; i < bestpath_pool.nthreads; i++)
+    pthread_join (bestpath_pool.threads[i], NULL);
+
+  XFREE (MTYPE_TMP, bestpath_pool.threads);
+  bestpath_pool.nthreads = 1;
+  bestpath_pool.shutdown = 0;
+}
+
+/* Threads are started lazily, from the event loop, so that they
+ * survive bgpd daemonising after the configuration is read.
+ */
+static void
+bgp_bestpath_pool_start (void)
+{
+  sigset_t all, old;
+  int i;
+  int ret;
+
+  bgp_bestpath_pool_stop ();
+
+  if (bestpath_pool.wanted <= 1)
+    return;
+
+  bestpath_pool.threads = XCALLOC (MTYPE_TMP,
+                                   sizeof (pthread_t) * bestpath_pool.wanted);
+
+  /* Signals are for the main thread only. */
+  sigfillset (&all);
+  pthread_sigmask (SIG_BLOCK, &all, &old);
+
+  for (i = 1; i < bestpath_pool.wanted; i++)
+    if ((ret = pthread_create (&bestpath_pool.threads[i], NULL,
+                               bgp_bestpath_pool_thread,
+                               (void *) (intptr_t) i)) != 0)
+      {
+        zlog_err ("%s: can't create thread: %s", __func__,
+                  safe_strerror (ret));
+        break;
+      }
+  bestpath_pool.nthreads = i;
+
+  pthread_sigmask (SIG_SETMASK, &old, NULL);
+}
+
+void
+bgp_process_threads_set (int nthreads)
+{
+  bestpath_pool.wanted = nthreads;
+}
+
+int
+bgp_process_threads_get (void)
+{
+  return bestpath_pool.wanted;
+}
+
+static void
+bgp_process_main_batch (struct work_queue *wq)
+{
+  struct listnode *node;
+  struct work_queue_item *item;
+  struct bgp_process_queue *pq;
+  int i;
+
+  if (bestpath_pool.nthreads != bestpath_pool.wanted)
+    bgp_bestpath_pool_start ();
+
+  /* The item being run is at the head of the queue. */
+  bestpath_pool.count = 0;
+  for (ALL_LIST_ELEMENTS_RO (wq->items, node, item))
+    {
+      if (bestpath_pool.count == BGP_PROCESS_BATCH)
+        break;
+      bestpath_pool.batch[bestpath_pool.count++] = item->data;
+    }
+
+  if (bestpath_pool.nthreads > 1 && bestpath_pool.count > 1)
+    {
+      pthread_mutex_lock (&bestpath_pool.mtx);
+      bestpath_pool.running = bestpath_pool.nthreads - 1;
+      bestpath_pool.generation++;
+      pthread_cond_broadcast (&bestpath_pool.start);
+      pthread_mutex_unlock (&bestpath_pool.mtx);
+
+      bgp_bestpath_pool_run (0);
+
+      pthread_mutex_lock (&bestpath_pool.mtx);
+      while (bestpath_pool.running)
+        pthread_cond_wait (&bestpath_pool.done, &bestpath_pool.mtx);
+      pthread_mutex_unlock (&bestpath_pool.mtx);
+    }
+  else
+    bgp_bestpath_pool_run (0);
+
+  for (i = 0; i < bestpath_pool.count; i++)
+    {
+      pq = bestpath_pool.batch[i];
+      bgp_best_selection_reap (pq->rn);
+      bgp_process_main_selected (pq, &pq->result);
+      SET_FLAG (pq->flags, BGP_PROCESS_QUEUE_DONE);
+    }
+}
+#endif /* HAVE_PTHREAD */
+
+static wq_item_status
+bgp_process_main (struct work_queue *wq, void *data)
+{
+  static unsigned long updgrp_runs = -1UL;
+  struct bgp_process_queue *pq = data;
+  struct bgp_info_pair old_and_new;
+  struct listnode *node;
+  struct bgp *bgp;
+
+  /* Update groups are brought up to date at the start of each run of
+   * the queue; neither peer state nor configuration can change during
+   * one.
+   */
+  if (updgrp_runs != wq->runs)
+    {
+      for (ALL_LIST_ELEMENTS_RO (bm->bgp, node, bgp))
+        bgp_updgrp_refresh (bgp);
+      updgrp_runs = wq->runs;
+    }
+
+  if (CHECK_FLAG (pq->flags, BGP_PROCESS_QUEUE_DONE))
+    return WQ_SUCCESS;
+
+#ifdef HAVE_PTHREAD
+  if (bestpath_pool.wanted > 1 || bestpath_pool.nthreads > 1)
+    {
+      bgp_process_main_batch (wq);
+      return WQ_SUCCESS;
+    }
+#endif /* HAVE_PTHREAD */
+
+  /* Best path selection. */
+  bgp_best_selection (pq->bgp, pq->rn, &old_and_new);
+  bgp_process_main_selected (pq, &old_and_new);
+
   return WQ_SUCCESS;
 }
 
@@ -2202,13 +2546,16 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
 	      || (peer_sort (peer) == BGP_PEER_EBGP && peer->ttl != 1)
 	      || CHECK_FLAG (peer->flags, PEER_FLAG_DISABLE_CONNECTED_CHECK)))
 	{
-	  if (bgp_nexthop_lookup (afi, peer, ri, NULL, NULL))
+	  if (bgp_nexthop_lookup (afi, rn, ri))
 	    bgp_info_set_flag (rn, ri, BGP_INFO_VALID);
 	  else
 	    bgp_info_unset_flag (rn, ri, BGP_INFO_VALID);
 	}
       else
-        bgp_info_set_flag (rn, ri, BGP_INFO_VALID);
+        {
+          bgp_nexthop_unlink (ri);
+          bgp_info_set_flag (rn, ri, BGP_INFO_VALID);
+        }
 
       /* Process change. */
       bgp_aggregate_increment (bgp, p, ri, afi, safi);
@@ -2249,7 +2596,7 @@ bgp_update_main (struct peer *peer, struct prefix *p, struct attr *attr,
 	  || (peer_sort (peer) == BGP_PEER_EBGP && peer->ttl != 1)
 	  || CHECK_FLAG (peer->flags, PEER_FLAG_DISABLE_CONNECTED_CHECK)))
     {
-      if (bgp_nexthop_lookup (afi, peer, new, NULL, NULL))
+      if (bgp_nexthop_lookup (afi, rn, new))
 	bgp_info_set_flag (rn, new, BGP_INFO_VALID);
       else
         bgp_info_unset_flag (rn, new, BGP_INFO_VALID);
@@ -2455,11 +2802,17 @@ bgp_default_originate (struct peer *peer, afi_t afi, safi_t safi, int withdraw)
   if (withdraw)
     {
       if (CHECK_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_DEFAULT_ORIGINATE))
-	bgp_default_withdraw_send (peer, afi, safi);
+	{
+	  bgp_default_withdraw_send (peer, afi, safi);
+	  bgp_updgrp_config_change ();
+	}
       UNSET_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_DEFAULT_ORIGINATE);
     }
   else
     {
+      if (! CHECK_FLAG (peer->af_sflags[afi][safi],
+			PEER_STATUS_DEFAULT_ORIGINATE))
+	bgp_updgrp_config_change ();
       SET_FLAG (peer->af_sflags[afi][safi], PEER_STATUS_DEFAULT_ORIGINATE);
       bgp_default_update_send (peer, &attr, afi, safi, from);
     }
@@ -2583,19 +2936,15 @@ bgp_soft_reconfig_table (struct peer *peer, afi_t afi, safi_t safi,
     table = peer->bgp->rib[afi][safi];
 
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    for (ain = rn->adj_in; ain; ain = ain->next)
+    if ((ain = bgp_adj_in_find (rn, peer)) != NULL)
       {
-	if (ain->peer == peer)
+	ret = bgp_update (peer, &rn->p, ain->attr, afi, safi,
+			  ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL,
+			  NULL, NULL, 1);
+	if (ret < 0)
 	  {
-	    ret = bgp_update (peer, &rn->p, ain->attr, afi, safi,
-			      ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL,
-			      NULL, NULL, 1);
-	    if (ret < 0)
-	      {
-		bgp_unlock_node (rn);
-		return;
-	      }
-	    continue;
+	    bgp_unlock_node (rn);
+	    return;
 	  }
       }
 }
@@ -2770,20 +3119,26 @@ bgp_clear_route_table (struct peer *peer, afi_t afi, safi_t safi,
             break;
           }
 
-      for (ain = rn->adj_in; ain; ain = ain->next)
-        if (ain->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
-          {
-            bgp_adj_in_remove (rn, ain);
-            bgp_unlock_node (rn);
-            break;
-          }
-      for (aout = rn->adj_out; aout; aout = aout->next)
-        if (aout->peer == peer || purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
-          {
-            bgp_adj_out_remove (rn, aout, peer, afi, safi);
-            bgp_unlock_node (rn);
-            break;
-          }
+      if (purpose == BGP_CLEAR_ROUTE_MY_RSCLIENT)
+        {
+          ain = rn->adj_in;
+          aout = rn->adj_out;
+        }
+      else
+        {
+          ain = bgp_adj_in_find (rn, peer);
+          aout = bgp_adj_out_find (rn, peer);
+        }
+      if (ain)
+        {
+          bgp_adj_in_remove (rn, ain);
+          bgp_unlock_node (rn);
+        }
+      if (aout)
+        {
+          bgp_adj_out_remove (rn, aout, peer, afi, safi);
+          bgp_unlock_node (rn);
+        }
     }
   return;
 }
@@ -2885,13 +3240,11 @@ bgp_clear_adj_in (struct peer *peer, afi_t afi, safi_t safi)
   table = peer->bgp->rib[afi][safi];
 
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    for (ain = rn->adj_in; ain ; ain = ain->next)
-      if (ain->peer == peer)
-	{
-          bgp_adj_in_remove (rn, ain);
-          bgp_unlock_node (rn);
-          break;
-	}
+    if ((ain = bgp_adj_in_find (rn, peer)) != NULL)
+      {
+        bgp_adj_in_remove (rn, ain);
+        bgp_unlock_node (rn);
+      }
 }
 
 void
@@ -5939,13 +6292,13 @@ route_vty_out_detail (struct vty *vty, struct bgp *bgp, struct prefix *p,
 	  
       /* Line 4 display Community */
       if (attr->community)
-	vty_out (vty, "      Community: %s%s", attr->community->str,
+	vty_out (vty, "      Community: %s%s", community_str (attr->community),
 		 VTY_NEWLINE);
 	  
       /* Line 5 display Extended-community */
       if (attr->flag & ATTR_FLAG_BIT(BGP_ATTR_EXT_COMMUNITIES))
 	vty_out (vty, "      Extended Community: %s%s", 
-	         attr->extra->ecommunity->str, VTY_NEWLINE);
+	         ecommunity_str (attr->extra->ecommunity), VTY_NEWLINE);
 	  
       /* Line 6 display Originator, Cluster-id */
       if ((attr->flag & ATTR_FLAG_BIT(BGP_ATTR_ORIGINATOR_ID)) ||
@@ -6056,9 +6409,9 @@ bgp_show_table (struct vty *vty, struct bgp_table *table, struct in_addr *router
 	    if (type == bgp_show_type_regexp
 		|| type == bgp_show_type_flap_regexp)
 	      {
-		regex_t *regex = output_arg;
+		struct aspath_regex *regex = output_arg;
 		    
-		if (bgp_regexec (regex, ri->attr->aspath) == REG_NOMATCH)
+		if (bgp_aspath_regexec (regex, ri->attr->aspath) == REG_NOMATCH)
 		  continue;
 	      }
 	    if (type == bgp_show_type_prefix_list
@@ -6964,7 +7317,7 @@ bgp_show_regexp (struct vty *vty, int argc, const char **argv, afi_t afi,
   struct buffer *b;
   char *regstr;
   int first;
-  regex_t *regex;
+  struct aspath_regex *regex;
   int rc;
   
   first = 0;
@@ -6987,7 +7340,7 @@ bgp_show_regexp (struct vty *vty, int argc, const char **argv, afi_t afi,
   regstr = buffer_getstr (b);
   buffer_free (b);
 
-  regex = bgp_regcomp (regstr);
+  regex = bgp_aspath_regcomp (regstr);
   XFREE(MTYPE_TMP, regstr);
   if (! regex)
     {
@@ -6997,7 +7350,7 @@ bgp_show_regexp (struct vty *vty, int argc, const char **argv, afi_t afi,
     }
 
   rc = bgp_show (vty, NULL, afi, safi, type, regex);
-  bgp_regex_free (regex);
+  bgp_aspath_regex_free (regex);
   return rc;
 }
 
@@ -9498,12 +9851,10 @@ bgp_peer_count_walker (struct thread *t)
   
   for (rn = bgp_table_top (pc->table); rn; rn = bgp_route_next (rn))
     {
-      struct bgp_adj_in *ain;
       struct bgp_info *ri;
       
-      for (ain = rn->adj_in; ain; ain = ain->next)
-        if (ain->peer == peer)
-          pc->count[PCOUNT_ADJ_IN]++;
+      if (bgp_adj_in_find (rn, peer))
+        pc->count[PCOUNT_ADJ_IN]++;
 
       for (ri = rn->info; ri; ri = ri->next)
         {
@@ -11883,6 +12234,19 @@ DEFUN (show_ip_bgp_flap_statistics,
                    bgp_show_type_flap_statistics, NULL);
 }
 
+DEFUN (show_ip_bgp_dampening_statistics,
+       show_ip_bgp_dampening_statistics_cmd,
+       "show ip bgp dampening statistics",
+       SHOW_STR
+       IP_STR
+       BGP_STR
+       "Route-flap dampening\n"
+       "Dampening memory use and reuse sweeps\n")
+{
+  bgp_damp_show_statistics (vty);
+  return CMD_SUCCESS;
+}
+
 /* Display specified route of BGP table. */
 static int
 bgp_clear_damp_route (struct vty *vty, const char *view_name, 
@@ -12398,6 +12762,7 @@ bgp_route_init (void)
   install_element (VIEW_NODE, &show_ip_bgp_ipv4_neighbor_received_prefix_filter_cmd);
   install_element (VIEW_NODE, &show_ip_bgp_dampened_paths_cmd);
   install_element (VIEW_NODE, &show_ip_bgp_flap_statistics_cmd);
+  install_element (VIEW_NODE, &show_ip_bgp_dampening_statistics_cmd);
   install_element (VIEW_NODE, &show_ip_bgp_flap_address_cmd);
   install_element (VIEW_NODE, &show_ip_bgp_flap_prefix_cmd);
   install_element (VIEW_NODE, &show_ip_bgp_flap_cidr_only_cmd);
@@ -12531,6 +12896,7 @@ bgp_route_init (void)
   install_element (ENABLE_NODE, &show_ip_bgp_ipv4_neighbor_received_prefix_filter_cmd);
   install_element (ENABLE_NODE, &show_ip_bgp_dampened_paths_cmd);
   install_element (ENABLE_NODE, &show_ip_bgp_flap_statistics_cmd);
+  install_element (ENABLE_NODE, &show_ip_bgp_dampening_statistics_cmd);
   install_element (ENABLE_NODE, &show_ip_bgp_flap_address_cmd);
   install_element (ENABLE_NODE, &show_ip_bgp_flap_prefix_cmd);
   install_element (ENABLE_NODE, &show_ip_bgp_flap_cidr_only_cmd);
@@ -12971,4 +13337,8 @@ bgp_route_finish (void)
 {
   bgp_table_unlock (bgp_distance_table);
   bgp_distance_table = NULL;
+
+#ifdef HAVE_PTHREAD
+  bgp_bestpath_pool_stop ();
+#endif /* HAVE_PTHREAD */
 }
@@ -38,6 +38,13 @@ struct bgp_info_extra
   /* Nexthop reachability check.  */
   u_int32_t igpmetric;
 
+  /* Nexthop cache entry this path is tracked by, with the other paths
+     using it, and the node the path is on.  */
+  struct bgp_nexthop_cache *bnc;
+  struct bgp_info *bnc_next;
+  struct bgp_info *bnc_prev;
+  struct bgp_node *bnc_rn;
+
   /* MPLS label.  */
   u_char tag[3];  
 };
@@ -218,6 +225,10 @@ extern int bgp_withdraw (struct peer *, struct prefix *, struct attr *,
 
 /* for bgp_nexthop and bgp_damp */
 extern void bgp_process (struct bgp *, struct bgp_node *, afi_t, safi_t);
+#ifdef HAVE_PTHREAD
+extern void bgp_process_threads_set (int);
+extern int bgp_process_threads_get (void);
+#endif /* HAVE_PTHREAD */
 extern int bgp_config_write_network (struct vty *, struct bgp *, afi_t, safi_t, int *);
 extern int bgp_config_write_distance (struct vty *, struct bgp *);
 
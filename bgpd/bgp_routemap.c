@@ -52,6 +52,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_mplsvpn.h"
 #include "bgpd/bgp_ecommunity.h"
 #include "bgpd/bgp_vty.h"
+#include "bgpd/bgp_updgrp.h"
 
 /* Memo of route-map commands.
 
@@ -598,13 +599,25 @@ route_match_aspath_free (void *rule)
   XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
 }
 
+/* The result depends only on the interned AS path. */
+static unsigned long
+route_match_aspath_key (route_map_object_t type, void *object)
+{
+  struct bgp_info *bgp_info = object;
+
+  if (type != RMAP_BGP || ! bgp_info->attr->aspath)
+    return 0;
+  return bgp_info->attr->aspath->serial;
+}
+
 /* Route map commands for aspath matching. */
 struct route_map_rule_cmd route_match_aspath_cmd = 
 {
   "as-path",
   route_match_aspath,
   route_match_aspath_compile,
-  route_match_aspath_free
+  route_match_aspath_free,
+  route_match_aspath_key
 };
 
 /* `match community COMMUNIY' */
@@ -682,13 +695,25 @@ route_match_community_free (void *rule)
   XFREE (MTYPE_ROUTE_MAP_COMPILED, rcom);
 }
 
+/* The result depends only on the interned communities. */
+static unsigned long
+route_match_community_key (route_map_object_t type, void *object)
+{
+  struct bgp_info *bgp_info = object;
+
+  if (type != RMAP_BGP || ! bgp_info->attr->community)
+    return 0;
+  return bgp_info->attr->community->serial;
+}
+
 /* Route map commands for community matching. */
 struct route_map_rule_cmd route_match_community_cmd = 
 {
   "community",
   route_match_community,
   route_match_community_compile,
-  route_match_community_free
+  route_match_community_free,
+  route_match_community_key
 };
 
 /* Match function for extcommunity match. */
@@ -731,13 +756,26 @@ route_match_ecommunity_free (void *rule)
   XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
 }
 
+/* The result depends only on the interned extended communities. */
+static unsigned long
+route_match_ecommunity_key (route_map_object_t type, void *object)
+{
+  struct bgp_info *bgp_info = object;
+
+  if (type != RMAP_BGP || ! bgp_info->attr->extra
+      || ! bgp_info->attr->extra->ecommunity)
+    return 0;
+  return bgp_info->attr->extra->ecommunity->serial;
+}
+
 /* Route map commands for community matching. */
 struct route_map_rule_cmd route_match_ecommunity_cmd = 
 {
   "extcommunity",
   route_match_ecommunity,
   route_match_ecommunity_compile,
-  route_match_ecommunity_free
+  route_match_ecommunity_free,
+  route_match_ecommunity_key
 };
 
 /* `match nlri` and `set nlri` are replaced by `address-family ipv4`
@@ -2312,6 +2350,9 @@ bgp_route_map_update (const char *unused)
   struct bgp_node *bn;
   struct bgp_static *bgp_static;
 
+  /* Outbound route-map names may resolve differently now. */
+  bgp_updgrp_config_change ();
+
   /* For neighbor route-map updates. */
   for (ALL_LIST_ELEMENTS (bm->bgp, mnode, mnnode, bgp))
     {
@@ -2411,6 +2452,14 @@ bgp_route_map_update (const char *unused)
 	}
     }
 }
+
+/* Hook function for changes to the rules of a route-map. */
+static void
+bgp_route_map_event (route_map_event_t event, const char *name)
+{
+  /* Outbound route-maps may or may not look at the peer now. */
+  bgp_updgrp_config_change ();
+}
 
 DEFUN (match_peer,
        match_peer_cmd,
@@ -3845,6 +3894,7 @@ bgp_route_map_init (void)
   route_map_init_vty ();
   route_map_add_hook (bgp_route_map_update);
   route_map_delete_hook (bgp_route_map_update);
+  route_map_event_hook (bgp_route_map_event);
 
   route_map_install_match (&route_match_peer_cmd);
   route_map_install_match (&route_match_ip_address_cmd);
@@ -61,6 +61,9 @@ struct bgp_node
 
   struct bgp_adj_in *adj_in;
 
+  /* Index of adj_out and adj_in by peer, for nodes with many. */
+  struct bgp_adj_index *adj_index;
+
   struct bgp_node *prn;
 
   int lock;
@@ -0,0 +1,577 @@
+/* BGP update groups
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/* Established peers are put into update groups, per address family,
+ * according to everything that affects what is sent to them apart from
+ * their identity: peer type and AS, outbound filters, the relevant
+ * flags and capabilities, and the local address of the session.
+ *
+ * bgp_process_main runs the outbound policy once per group rather than
+ * once per peer, and only applies the identity checks (don't send a
+ * route back to where it came from, and so on) per member.
+ *
+ * The UPDATEs themselves are still built from each peer's own adj-out,
+ * as members drain at different rates.  But the UPDATEs built for one
+ * member are kept until the others have caught up, and when another
+ * member's queue starts with the same attribute and the same run of
+ * prefixes, the packet is copied instead of encoded again.
+ *
+ * EBGP peers and peers which have sent an ORF prefix list each get a
+ * group of their own; what is sent to them depends on their address.
+ */
+
+#include <zebra.h>
+
+#include "command.h"
+#include "hash.h"
+#include "linklist.h"
+#include "memory.h"
+#include "prefix.h"
+#include "routemap.h"
+#include "sockunion.h"
+#include "stream.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_advertise.h"
+#include "bgpd/bgp_vty.h"
+#include "bgpd/bgp_updgrp.h"
+
+/* Bumped whenever configuration which goes into the keys changes.  A
+ * peer whose updgrp_gen matches is known to still belong to its group,
+ * without building its key again.
+ */
+static unsigned long bgp_updgrp_gen = 1;
+
+/* Peer or route-map configuration has changed, group keys have to be
+ * checked again.
+ */
+void
+bgp_updgrp_config_change (void)
+{
+  bgp_updgrp_gen++;
+}
+
+static void
+bgp_updgrp_key_make (struct peer *peer, afi_t afi, safi_t safi,
+                     struct bgp_updgrp_key *key)
+{
+  struct bgp_filter *filter = &peer->filter[afi][safi];
+
+  memset (key, 0, sizeof (struct bgp_updgrp_key));
+
+  key->sort = peer_sort (peer);
+  key->as = peer->as;
+  key->local_as = peer->local_as;
+  key->change_local_as = peer->change_local_as;
+  key->af_flags = peer->af_flags[afi][safi];
+  key->af_sflags = peer->af_sflags[afi][safi] & PEER_STATUS_DEFAULT_ORIGINATE;
+  key->cap = peer->cap & PEER_CAP_AS4_RCV;
+
+  if (key->sort == BGP_PEER_EBGP || peer->orf_plist[afi][safi])
+    key->owner = peer;
+
+  /* Route maps which look at the peer itself. */
+  if (filter->map[RMAP_OUT].name
+      && (route_map_has_rule (filter->map[RMAP_OUT].name, "peer", NULL)
+          || route_map_has_rule (filter->map[RMAP_OUT].name, "ip next-hop",
+                                 "peer-address")))
+    key->owner = peer;
+
+  if (peer->su_local)
+    key->local = *peer->su_local;
+  key->nexthop = peer->nexthop.v4;
+#ifdef HAVE_IPV6
+  key->nexthop_global = peer->nexthop.v6_global;
+  key->nexthop_local = peer->nexthop.v6_local;
+#endif /* HAVE_IPV6 */
+  key->shared_network = peer->shared_network;
+
+  key->dlist = filter->dlist[FILTER_OUT].name;
+  key->plist = filter->plist[FILTER_OUT].name;
+  key->aslist = filter->aslist[FILTER_OUT].name;
+  key->rmap = filter->map[RMAP_OUT].name;
+  key->usmap = filter->usmap.name;
+}
+
+static int
+bgp_updgrp_name_same (const char *n1, const char *n2)
+{
+  if (n1 == NULL || n2 == NULL)
+    return n1 == n2;
+  return strcmp (n1, n2) == 0;
+}
+
+static int
+bgp_updgrp_key_same (struct bgp_updgrp_key *k1, struct bgp_updgrp_key *k2)
+{
+  return k1->sort == k2->sort
+    && k1->as == k2->as
+    && k1->local_as == k2->local_as
+    && k1->change_local_as == k2->change_local_as
+    && k1->af_flags == k2->af_flags
+    && k1->af_sflags == k2->af_sflags
+    && k1->cap == k2->cap
+    && k1->owner == k2->owner
+    && sockunion_same (&k1->local, &k2->local)
+    && IPV4_ADDR_SAME (&k1->nexthop, &k2->nexthop)
+#ifdef HAVE_IPV6
+    && IPV6_ADDR_SAME (&k1->nexthop_global, &k2->nexthop_global)
+    && IPV6_ADDR_SAME (&k1->nexthop_local, &k2->nexthop_local)
+#endif /* HAVE_IPV6 */
+    && k1->shared_network == k2->shared_network
+    && bgp_updgrp_name_same (k1->dlist, k2->dlist)
+    && bgp_updgrp_name_same (k1->plist, k2->plist)
+    && bgp_updgrp_name_same (k1->aslist, k2->aslist)
+    && bgp_updgrp_name_same (k1->rmap, k2->rmap)
+    && bgp_updgrp_name_same (k1->usmap, k2->usmap);
+}
+
+static char *
+bgp_updgrp_name_dup (const char *name)
+{
+  return name ? XSTRDUP (MTYPE_BGP_UPDGRP, name) : NULL;
+}
+
+static void
+bgp_updgrp_name_free (char *name)
+{
+  if (name)
+    XFREE (MTYPE_BGP_UPDGRP, name);
+}
+
+static unsigned int
+bgp_updgrp_packet_hash_key (void *p)
+{
+  struct bgp_updgrp_packet *pkt = p;
+
+  return ((uintptr_t) pkt->rn[0] >> 4) ^ ((uintptr_t) pkt->attr >> 4);
+}
+
+static int
+bgp_updgrp_packet_hash_cmp (const void *p1, const void *p2)
+{
+  const struct bgp_updgrp_packet *pkt1 = p1;
+  const struct bgp_updgrp_packet *pkt2 = p2;
+
+  return pkt1->rn[0] == pkt2->rn[0]
+    && pkt1->attr == pkt2->attr
+    && pkt1->from == pkt2->from;
+}
+
+static void
+bgp_updgrp_packet_free (struct bgp_updgrp *updgrp,
+                        struct bgp_updgrp_packet *pkt)
+{
+  unsigned int i;
+
+  hash_release (updgrp->packet_hash, pkt);
+  listnode_delete (updgrp->packets, pkt);
+
+  for (i = 0; i < pkt->count; i++)
+    bgp_unlock_node (pkt->rn[i]);
+  XFREE (MTYPE_BGP_UPDGRP, pkt->rn);
+  bgp_attr_unintern (&pkt->attr);
+  if (pkt->from)
+    peer_unlock (pkt->from);
+  stream_free (pkt->packet);
+
+  XFREE (MTYPE_BGP_UPDGRP, pkt);
+}
+
+static struct bgp_updgrp *
+bgp_updgrp_new (struct bgp *bgp, afi_t afi, safi_t safi,
+                struct bgp_updgrp_key *key)
+{
+  struct bgp_updgrp *updgrp;
+
+  updgrp = XCALLOC (MTYPE_BGP_UPDGRP, sizeof (struct bgp_updgrp));
+  updgrp->id = ++bgp->updgrp_id;
+  updgrp->bgp = bgp;
+  updgrp->afi = afi;
+  updgrp->safi = safi;
+  updgrp->uptime = bgp_clock ();
+  updgrp->peer = list_new ();
+  updgrp->packets = list_new ();
+  updgrp->packet_hash = hash_create (bgp_updgrp_packet_hash_key,
+                                     bgp_updgrp_packet_hash_cmp);
+  updgrp->packet_hash->name = "BGP update group packets";
+
+  updgrp->key = *key;
+  updgrp->key.dlist = bgp_updgrp_name_dup (key->dlist);
+  updgrp->key.plist = bgp_updgrp_name_dup (key->plist);
+  updgrp->key.aslist = bgp_updgrp_name_dup (key->aslist);
+  updgrp->key.rmap = bgp_updgrp_name_dup (key->rmap);
+  updgrp->key.usmap = bgp_updgrp_name_dup (key->usmap);
+
+  if (! bgp->updgrp[afi][safi])
+    bgp->updgrp[afi][safi] = list_new ();
+  listnode_add (bgp->updgrp[afi][safi], updgrp);
+
+  return updgrp;
+}
+
+static void
+bgp_updgrp_free (struct bgp_updgrp *updgrp)
+{
+  struct bgp *bgp = updgrp->bgp;
+
+  listnode_delete (bgp->updgrp[updgrp->afi][updgrp->safi], updgrp);
+
+  while (listcount (updgrp->packets))
+    bgp_updgrp_packet_free (updgrp, listgetdata (listhead (updgrp->packets)));
+  list_delete (updgrp->packets);
+  hash_free (updgrp->packet_hash);
+
+  bgp_updgrp_name_free (updgrp->key.dlist);
+  bgp_updgrp_name_free (updgrp->key.plist);
+  bgp_updgrp_name_free (updgrp->key.aslist);
+  bgp_updgrp_name_free (updgrp->key.rmap);
+  bgp_updgrp_name_free (updgrp->key.usmap);
+
+  list_delete (updgrp->peer);
+  XFREE (MTYPE_BGP_UPDGRP, updgrp);
+}
+
+static void
+bgp_updgrp_leave_af (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_updgrp *updgrp = peer->updgrp[afi][safi];
+
+  if (! updgrp)
+    return;
+
+  peer->updgrp[afi][safi] = NULL;
+  listnode_delete (updgrp->peer, peer);
+  if (listcount (updgrp->peer) == 0)
+    bgp_updgrp_free (updgrp);
+}
+
+/* Take the peer out of all its update groups. */
+void
+bgp_updgrp_leave (struct peer *peer)
+{
+  afi_t afi;
+  safi_t safi;
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      bgp_updgrp_leave_af (peer, afi, safi);
+}
+
+/* Free all update groups of the instance.  Its peers, which hold a
+ * reference on it, are gone already.
+ */
+void
+bgp_updgrp_finish (struct bgp *bgp)
+{
+  afi_t afi;
+  safi_t safi;
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      {
+	if (! bgp->updgrp[afi][safi])
+	  continue;
+
+	while (listcount (bgp->updgrp[afi][safi]))
+	  bgp_updgrp_free (listgetdata (listhead (bgp->updgrp[afi][safi])));
+	list_delete (bgp->updgrp[afi][safi]);
+	bgp->updgrp[afi][safi] = NULL;
+      }
+}
+
+/* Bring group membership up to date for all peers of the instance.
+ * Called before outbound processing, so that peers which have come up
+ * or had their configuration changed since are in the right group.
+ */
+void
+bgp_updgrp_refresh (struct bgp *bgp)
+{
+  struct listnode *node, *nnode;
+  struct listnode *gnode;
+  struct peer *peer;
+  struct bgp_updgrp *updgrp;
+  struct bgp_updgrp_key key;
+  afi_t afi;
+  safi_t safi;
+
+  for (ALL_LIST_ELEMENTS (bgp->peer, node, nnode, peer))
+    for (afi = AFI_IP; afi < AFI_MAX; afi++)
+      for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+	{
+	  if (peer->status != Established || ! peer->afc_nego[afi][safi])
+	    {
+	      bgp_updgrp_leave_af (peer, afi, safi);
+	      continue;
+	    }
+
+	  updgrp = peer->updgrp[afi][safi];
+	  if (updgrp && peer->updgrp_gen[afi][safi] == bgp_updgrp_gen)
+	    continue;
+
+	  bgp_updgrp_key_make (peer, afi, safi, &key);
+	  peer->updgrp_gen[afi][safi] = bgp_updgrp_gen;
+
+	  if (updgrp && bgp_updgrp_key_same (&updgrp->key, &key))
+	    continue;
+
+	  bgp_updgrp_leave_af (peer, afi, safi);
+
+	  gnode = NULL;
+	  if (bgp->updgrp[afi][safi])
+	    for (ALL_LIST_ELEMENTS_RO (bgp->updgrp[afi][safi], gnode, updgrp))
+	      if (bgp_updgrp_key_same (&updgrp->key, &key))
+		break;
+	  if (! gnode)
+	    updgrp = bgp_updgrp_new (bgp, afi, safi, &key);
+
+	  listnode_add (updgrp->peer, peer);
+	  peer->updgrp[afi][safi] = updgrp;
+	}
+}
+
+/* The group whose UPDATEs can be reused for this peer, if any. */
+static struct bgp_updgrp *
+bgp_updgrp_packet_group (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_updgrp *updgrp = peer->updgrp[afi][safi];
+  struct bgp_updgrp_key key;
+
+  /* The attributes of other address families are encoded along with
+   * their NLRI, in MP_REACH_NLRI.
+   */
+  if (! updgrp || afi != AFI_IP || safi != SAFI_UNICAST)
+    return NULL;
+
+  if (peer->updgrp_gen[afi][safi] == bgp_updgrp_gen)
+    return updgrp;
+
+  /* Configuration has changed since the last refresh. */
+  bgp_updgrp_key_make (peer, afi, safi, &key);
+  if (! bgp_updgrp_key_same (&updgrp->key, &key))
+    return NULL;
+
+  peer->updgrp_gen[afi][safi] = bgp_updgrp_gen;
+  return updgrp;
+}
+
+/* Find an UPDATE already built for another member which is exactly
+ * what bgp_update_packet would build from this peer's queue: the same
+ * attribute, and the same prefixes in the same order.
+ */
+struct stream *
+bgp_updgrp_packet_lookup (struct peer *peer, afi_t afi, safi_t safi,
+                          struct bgp_advertise *adv, unsigned int *count)
+{
+  struct bgp_updgrp *updgrp;
+  struct bgp_updgrp_packet *pkt;
+  struct bgp_updgrp_packet ref;
+  struct bgp_advertise *next;
+  struct bgp_node *rn;
+  struct stream *packet;
+  unsigned int i;
+
+  if (! adv || ! adv->baa || ! adv->baa->attr)
+    return NULL;
+  if (! (updgrp = bgp_updgrp_packet_group (peer, afi, safi)))
+    return NULL;
+
+  rn = adv->rn;
+  ref.rn = &rn;
+  ref.attr = adv->baa->attr;
+  ref.from = adv->binfo ? adv->binfo->peer : NULL;
+  if (! (pkt = hash_lookup (updgrp->packet_hash, &ref)))
+    return NULL;
+
+  /* After the first, bgp_update_packet takes the remaining
+   * advertisements with the same attribute in list order.
+   */
+  next = adv->baa->adv;
+  for (i = 1; i < pkt->count; i++, next = next->next)
+    {
+      if (next == adv)
+	next = next->next;
+      if (! next || next->rn != pkt->rn[i])
+	return NULL;
+    }
+
+  updgrp->packet_copied++;
+  *count = pkt->count;
+  packet = stream_dup (pkt->packet);
+
+  if (--pkt->pending == 0)
+    bgp_updgrp_packet_free (updgrp, pkt);
+
+  return packet;
+}
+
+/* Remember an UPDATE built for a member of the peer's group. */
+void
+bgp_updgrp_packet_add (struct peer *peer, afi_t afi, safi_t safi,
+                       struct stream *packet, struct attr *attr,
+                       struct peer *from, struct bgp_node **rn,
+                       unsigned int count)
+{
+  struct bgp_updgrp *updgrp;
+  struct bgp_updgrp_packet *pkt;
+  struct bgp_updgrp_packet *old;
+  unsigned int i;
+
+  if (! (updgrp = bgp_updgrp_packet_group (peer, afi, safi)))
+    return;
+
+  updgrp->packet_built++;
+
+  /* Nobody to share with. */
+  if (listcount (updgrp->peer) < 2 || count == 0)
+    return;
+
+  /* Members which fall too far behind, or whose queues differ, build
+   * their own.
+   */
+  if (listcount (updgrp->packets) >= BGP_UPDGRP_PACKETS)
+    bgp_updgrp_packet_free (updgrp, listgetdata (listhead (updgrp->packets)));
+
+  pkt = XCALLOC (MTYPE_BGP_UPDGRP, sizeof (struct bgp_updgrp_packet));
+  pkt->count = count;
+  pkt->rn = XMALLOC (MTYPE_BGP_UPDGRP, sizeof (struct bgp_node *) * count);
+  for (i = 0; i < count; i++)
+    pkt->rn[i] = bgp_lock_node (rn[i]);
+  pkt->attr = bgp_attr_intern (attr);
+  pkt->from = from ? peer_lock (from) : NULL;
+  pkt->packet = stream_dup (packet);
+  pkt->pending = listcount (updgrp->peer) - 1;
+
+  /* A newer UPDATE starting the same way replaces an older one. */
+  old = hash_lookup (updgrp->packet_hash, pkt);
+  if (old)
+    bgp_updgrp_packet_free (updgrp, old);
+
+  hash_get (updgrp->packet_hash, pkt, hash_alloc_intern);
+  listnode_add (updgrp->packets, pkt);
+}
+
+static void
+bgp_updgrp_show (struct vty *vty, struct bgp_updgrp *updgrp)
+{
+  struct listnode *node;
+  struct peer *peer;
+  char timebuf[BGP_UPTIME_LEN];
+  int col;
+
+  vty_out (vty, "Update group %u, %s, %s%s", updgrp->id,
+	   afi_safi_print (updgrp->afi, updgrp->safi),
+	   updgrp->key.sort == BGP_PEER_IBGP ? "internal"
+	   : updgrp->key.sort == BGP_PEER_CONFED ? "confed-external"
+	   : "external", VTY_NEWLINE);
+  vty_out (vty, "  Created: %s%s",
+	   peer_uptime (updgrp->uptime, timebuf, BGP_UPTIME_LEN), VTY_NEWLINE);
+  if (updgrp->key.rmap)
+    vty_out (vty, "  Outgoing route-map: %s%s", updgrp->key.rmap,
+	     VTY_NEWLINE);
+  vty_out (vty, "  Outbound policy: %lu evaluated, %lu shared%s",
+	   updgrp->policy_run, updgrp->policy_shared, VTY_NEWLINE);
+  vty_out (vty, "  UPDATE messages: %lu built, %lu replicated%s",
+	   updgrp->packet_built, updgrp->packet_copied, VTY_NEWLINE);
+  vty_out (vty, "  Members (%u):", listcount (updgrp->peer));
+
+  col = 0;
+  for (ALL_LIST_ELEMENTS_RO (updgrp->peer, node, peer))
+    {
+      if (col++ % 4 == 0)
+	vty_out (vty, "%s   ", VTY_NEWLINE);
+      vty_out (vty, " %-16s", peer->host);
+    }
+  vty_out (vty, "%s%s", VTY_NEWLINE, VTY_NEWLINE);
+}
+
+static int
+bgp_updgrp_show_vty (struct vty *vty, const char *name)
+{
+  struct bgp *bgp;
+  struct bgp_updgrp *updgrp;
+  struct listnode *node;
+  afi_t afi;
+  safi_t safi;
+
+  if (name)
+    {
+      bgp = bgp_lookup_by_name (name);
+      if (! bgp)
+	{
+	  vty_out (vty, "%% No such BGP instance exist%s", VTY_NEWLINE);
+	  return CMD_WARNING;
+	}
+    }
+  else
+    bgp = bgp_get_default ();
+
+  if (! bgp)
+    {
+      vty_out (vty, "No BGP process is configured%s", VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+
+  bgp_updgrp_refresh (bgp);
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      if (bgp->updgrp[afi][safi])
+	for (ALL_LIST_ELEMENTS_RO (bgp->updgrp[afi][safi], node, updgrp))
+	  bgp_updgrp_show (vty, updgrp);
+
+  return CMD_SUCCESS;
+}
+
+DEFUN (show_ip_bgp_updgrp,
+       show_ip_bgp_updgrp_cmd,
+       "show ip bgp update-groups",
+       SHOW_STR
+       IP_STR
+       BGP_STR
+       "Detailed info about BGP update groups\n")
+{
+  return bgp_updgrp_show_vty (vty, NULL);
+}
+
+DEFUN (show_ip_bgp_instance_updgrp,
+       show_ip_bgp_instance_updgrp_cmd,
+       "show ip bgp view WORD update-groups",
+       SHOW_STR
+       IP_STR
+       BGP_STR
+       "BGP view\n"
+       "View name\n"
+       "Detailed info about BGP update groups\n")
+{
+  return bgp_updgrp_show_vty (vty, argv[0]);
+}
+
+void
+bgp_updgrp_init (void)
+{
+  install_element (VIEW_NODE, &show_ip_bgp_updgrp_cmd);
+  install_element (VIEW_NODE, &show_ip_bgp_instance_updgrp_cmd);
+  install_element (ENABLE_NODE, &show_ip_bgp_updgrp_cmd);
+  install_element (ENABLE_NODE, &show_ip_bgp_instance_updgrp_cmd);
+}
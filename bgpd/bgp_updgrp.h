@@ -0,0 +1,117 @@
+/* BGP update groups
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _QUAGGA_BGP_UPDGRP_H
+#define _QUAGGA_BGP_UPDGRP_H
+
+struct bgp_advertise;
+
+/* Everything about a peer that can change what is sent to it for an
+ * address family, other than its identity.  Peers with equal keys get
+ * the same outbound policy result and the same UPDATE encoding.
+ */
+struct bgp_updgrp_key
+{
+  int sort;
+  as_t as;
+  as_t local_as;
+  as_t change_local_as;
+  u_int32_t af_flags;
+  u_int16_t af_sflags;
+  u_int16_t cap;
+
+  /* Set for peers which can't share with anyone else. */
+  struct peer *owner;
+
+  union sockunion local;
+  struct in_addr nexthop;
+#ifdef HAVE_IPV6
+  struct in6_addr nexthop_global;
+  struct in6_addr nexthop_local;
+#endif /* HAVE_IPV6 */
+  int shared_network;
+
+  /* Outbound filter names. */
+  char *dlist;
+  char *plist;
+  char *aslist;
+  char *rmap;
+  char *usmap;
+};
+
+/* An UPDATE built for one member, kept until the other members which
+ * have the same advertisements queued have been sent a copy.
+ */
+struct bgp_updgrp_packet
+{
+  struct stream *packet;
+  struct attr *attr;
+  struct peer *from;
+  struct bgp_node **rn;
+  unsigned int count;
+
+  /* Members yet to take a copy. */
+  unsigned int pending;
+};
+
+/* Most UPDATEs kept per group.  Members can be a whole table apart,
+ * e.g. when their route advertisement timers fire at different times.
+ */
+#define BGP_UPDGRP_PACKETS	256
+
+struct bgp_updgrp
+{
+  unsigned int id;
+  struct bgp *bgp;
+  afi_t afi;
+  safi_t safi;
+  struct bgp_updgrp_key key;
+  time_t uptime;
+
+  /* Member peers. */
+  struct list *peer;
+
+  /* UPDATEs built for one member and not yet taken by all the others,
+   * oldest first, and indexed by their first prefix.
+   */
+  struct list *packets;
+  struct hash *packet_hash;
+
+  /* Statistics. */
+  unsigned long policy_run;	/* outbound policy evaluations */
+  unsigned long policy_shared;	/* evaluations saved by sharing */
+  unsigned long packet_built;	/* UPDATEs encoded */
+  unsigned long packet_copied;	/* UPDATEs replicated */
+};
+
+extern void bgp_updgrp_init (void);
+extern void bgp_updgrp_config_change (void);
+extern void bgp_updgrp_refresh (struct bgp *);
+extern void bgp_updgrp_leave (struct peer *);
+extern void bgp_updgrp_finish (struct bgp *);
+extern struct stream *bgp_updgrp_packet_lookup (struct peer *, afi_t, safi_t,
+                                                struct bgp_advertise *,
+                                                unsigned int *);
+extern void bgp_updgrp_packet_add (struct peer *, afi_t, safi_t,
+                                   struct stream *, struct attr *,
+                                   struct peer *, struct bgp_node **,
+                                   unsigned int);
+
+#endif /* _QUAGGA_BGP_UPDGRP_H */
@@ -285,6 +285,41 @@ DEFUN (no_bgp_config_type,
   return CMD_SUCCESS;
 }
 
+#ifdef HAVE_PTHREAD
+DEFUN (bgp_parallel_bestpath,
+       bgp_parallel_bestpath_cmd,
+       "bgp parallel-bestpath <2-64>",
+       BGP_STR
+       "Run best path selection on several threads\n"
+       "Number of threads\n")
+{
+  int nthreads;
+
+  VTY_GET_INTEGER_RANGE ("thread count", nthreads, argv[0], 2, 64);
+  bgp_process_threads_set (nthreads);
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_bgp_parallel_bestpath,
+       no_bgp_parallel_bestpath_cmd,
+       "no bgp parallel-bestpath",
+       NO_STR
+       BGP_STR
+       "Run best path selection on several threads\n")
+{
+  bgp_process_threads_set (1);
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_bgp_parallel_bestpath,
+       no_bgp_parallel_bestpath_val_cmd,
+       "no bgp parallel-bestpath <2-64>",
+       NO_STR
+       BGP_STR
+       "Run best path selection on several threads\n"
+       "Number of threads\n")
+#endif /* HAVE_PTHREAD */
+
 DEFUN (no_synchronization,
        no_synchronization_cmd,
        "no synchronization",
@@ -6701,11 +6736,6 @@ DEFUN (show_bgp_memory,
              mtype_memstr (memstrbuf, sizeof (memstrbuf),
                            count * sizeof (struct hash)),
              VTY_NEWLINE);
-  if ((count = mtype_stats_alloc (MTYPE_HASH_BACKET)))
-    vty_out (vty, "%ld hash buckets, using %s of memory%s", count,
-             mtype_memstr (memstrbuf, sizeof (memstrbuf),
-                           count * sizeof (struct hash_backet)),
-             VTY_NEWLINE);
   if ((count = mtype_stats_alloc (MTYPE_BGP_REGEXP)))
     vty_out (vty, "%ld compiled regexes, using %s of memory%s", count,
              mtype_memstr (memstrbuf, sizeof (memstrbuf),
@@ -8905,6 +8935,13 @@ bgp_vty_init (void)
   install_element (CONFIG_NODE, &bgp_config_type_cmd);
   install_element (CONFIG_NODE, &no_bgp_config_type_cmd);
 
+#ifdef HAVE_PTHREAD
+  /* "bgp parallel-bestpath" commands. */
+  install_element (CONFIG_NODE, &bgp_parallel_bestpath_cmd);
+  install_element (CONFIG_NODE, &no_bgp_parallel_bestpath_cmd);
+  install_element (CONFIG_NODE, &no_bgp_parallel_bestpath_val_cmd);
+#endif /* HAVE_PTHREAD */
+
   /* Dummy commands (Currently not supported) */
   install_element (BGP_NODE, &no_synchronization_cmd);
   install_element (BGP_NODE, &no_auto_summary_cmd);
@@ -57,6 +57,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_advertise.h"
 #include "bgpd/bgp_network.h"
 #include "bgpd/bgp_vty.h"
+#include "bgpd/bgp_updgrp.h"
 #ifdef HAVE_SNMP
 #include "bgpd/bgp_snmp.h"
 #endif /* HAVE_SNMP */
@@ -280,6 +281,8 @@ bgp_confederation_id_set (struct bgp *bgp, as_t as)
   struct listnode *node, *nnode;
   int already_confed;
 
+  bgp_updgrp_config_change ();
+
   if (as == 0)
     return BGP_ERR_INVALID_AS;
 
@@ -340,6 +343,8 @@ bgp_confederation_id_unset (struct bgp *bgp)
   struct peer *peer;
   struct listnode *node, *nnode;
 
+  bgp_updgrp_config_change ();
+
   bgp->confed_id = 0;
   bgp_config_unset (bgp, BGP_CONFIG_CONFEDERATION);
       
@@ -386,6 +391,8 @@ bgp_confederation_peers_add (struct bgp *bgp, as_t as)
   struct peer *peer;
   struct listnode *node, *nnode;
 
+  bgp_updgrp_config_change ();
+
   if (! bgp)
     return BGP_ERR_INVALID_BGP;
 
@@ -436,6 +443,8 @@ bgp_confederation_peers_remove (struct bgp *bgp, as_t as)
   struct peer *peer;
   struct listnode *node, *nnode;
 
+  bgp_updgrp_config_change ();
+
   if (! bgp)
     return -1;
 
@@ -819,6 +828,7 @@ peer_new (struct bgp *bgp)
   SET_FLAG (peer->sflags, PEER_STATUS_CAPABILITY_OPEN);
 
   /* Create buffers.  */
+  peer->rbuf = stream_new (BGP_READ_BUFSIZ);
   peer->ibuf = stream_new (BGP_MAX_PACKET_SIZE);
   peer->obuf = stream_fifo_new ();
   peer->work = stream_new (BGP_MAX_PACKET_SIZE);
@@ -898,6 +908,8 @@ peer_as_change (struct peer *peer, as_t as)
 {
   int type;
 
+  bgp_updgrp_config_change ();
+
   /* Stop peer. */
   if (! CHECK_FLAG (peer->sflags, PEER_STATUS_GROUP))
     {
@@ -1255,6 +1267,8 @@ peer_delete (struct peer *peer)
         bgp_table_finish (&peer->rib[afi][safi]);
 
   /* Buffers.  */
+  if (peer->rbuf)
+    stream_free (peer->rbuf);
   if (peer->ibuf)
     stream_free (peer->ibuf);
   if (peer->obuf)
@@ -1262,7 +1276,7 @@ peer_delete (struct peer *peer)
   if (peer->work)
     stream_free (peer->work);
   peer->obuf = NULL;
-  peer->work = peer->ibuf = NULL;
+  peer->work = peer->ibuf = peer->rbuf = NULL;
 
   /* Local and remote addresses. */
   if (peer->su_local)
@@ -1739,6 +1753,8 @@ peer_group_bind (struct bgp *bgp, union sockunion *su,
   struct peer *peer;
   int first_member = 0;
 
+  bgp_updgrp_config_change ();
+
   /* Check peer group's address family.  */
   if (! group->conf->afc[afi][safi])
     return BGP_ERR_PEER_GROUP_AF_UNCONFIGURED;
@@ -1881,6 +1897,8 @@ peer_group_unbind (struct bgp *bgp, struct peer *peer,
   if (! peer->af_group[afi][safi])
       return 0;
 
+  bgp_updgrp_config_change ();
+
   if (group != peer->group)
     return BGP_ERR_PEER_GROUP_MISMATCH;
 
@@ -2137,6 +2155,9 @@ bgp_free (struct bgp *bgp)
 
   if (bgp->name)
     free (bgp->name);
+
+  /* Before the tables, queued UPDATEs hold on to their nodes. */
+  bgp_updgrp_finish (bgp);
   
   for (afi = AFI_IP; afi < AFI_MAX; afi++)
     for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
@@ -2147,6 +2168,8 @@ bgp_free (struct bgp *bgp)
           bgp_table_finish (&bgp->aggregate[afi][safi]) ;
 	if (bgp->rib[afi][safi])
           bgp_table_finish (&bgp->rib[afi][safi]);
+	if (bgp->updgrp[afi][safi])
+	  list_delete (bgp->updgrp[afi][safi]);
       }
   XFREE (MTYPE_BGP, bgp);
 }
@@ -2537,6 +2560,8 @@ peer_af_flag_modify (struct peer *peer, afi_t afi, safi_t safi, u_int32_t flag,
   struct peer_group *group;
   struct peer_flag_action action;
 
+  bgp_updgrp_config_change ();
+
   memset (&action, 0, sizeof (struct peer_flag_action));
   size = sizeof peer_af_flag_action_list / sizeof (struct peer_flag_action);
   
@@ -3011,6 +3036,8 @@ peer_default_originate_set (struct peer *peer, afi_t afi, safi_t safi,
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_updgrp_config_change ();
+
   /* Adress family must be activated.  */
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
@@ -3067,6 +3094,8 @@ peer_default_originate_unset (struct peer *peer, afi_t afi, safi_t safi)
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_updgrp_config_change ();
+
   /* Adress family must be activated.  */
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
@@ -3398,6 +3427,8 @@ peer_local_as_set (struct peer *peer, as_t as, int no_prepend)
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_updgrp_config_change ();
+
   if (peer_sort (peer) != BGP_PEER_EBGP
       && peer_sort (peer) != BGP_PEER_INTERNAL)
     return BGP_ERR_LOCAL_AS_ALLOWED_ONLY_FOR_EBGP;
@@ -3461,6 +3492,8 @@ peer_local_as_unset (struct peer *peer)
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_updgrp_config_change ();
+
   if (peer_group_active (peer))
     return BGP_ERR_INVALID_FOR_PEER_GROUP_MEMBER;
 
@@ -3616,6 +3649,8 @@ peer_distribute_set (struct peer *peer, afi_t afi, safi_t safi, int direct,
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_updgrp_config_change ();
+
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
 
@@ -3663,6 +3698,8 @@ peer_distribute_unset (struct peer *peer, afi_t afi, safi_t safi, int direct)
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_updgrp_config_change ();
+
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
 
@@ -3776,6 +3813,8 @@ peer_prefix_list_set (struct peer *peer, afi_t afi, safi_t safi, int direct,
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_updgrp_config_change ();
+
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
 
@@ -3822,6 +3861,8 @@ peer_prefix_list_unset (struct peer *peer, afi_t afi, safi_t safi, int direct)
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_updgrp_config_change ();
+
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
 
@@ -3934,6 +3975,8 @@ peer_aslist_set (struct peer *peer, afi_t afi, safi_t safi, int direct,
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_updgrp_config_change ();
+
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
 
@@ -3977,6 +4020,8 @@ peer_aslist_unset (struct peer *peer,afi_t afi, safi_t safi, int direct)
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_updgrp_config_change ();
+
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
 
@@ -4089,6 +4134,8 @@ peer_route_map_set (struct peer *peer, afi_t afi, safi_t safi, int direct,
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_updgrp_config_change ();
+
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
 
@@ -4136,6 +4183,8 @@ peer_route_map_unset (struct peer *peer, afi_t afi, safi_t safi, int direct)
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_updgrp_config_change ();
+
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
 
@@ -4197,6 +4246,8 @@ peer_unsuppress_map_set (struct peer *peer, afi_t afi, safi_t safi,
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_updgrp_config_change ();
+
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
 
@@ -4238,6 +4289,8 @@ peer_unsuppress_map_unset (struct peer *peer, afi_t afi, safi_t safi)
   struct peer_group *group;
   struct listnode *node, *nnode;
 
+  bgp_updgrp_config_change ();
+
   if (! peer->afc[afi][safi])
     return BGP_ERR_PEER_INACTIVE;
   
@@ -5151,6 +5204,16 @@ bgp_config_write (struct vty *vty)
       write++;
     }
 
+#ifdef HAVE_PTHREAD
+  /* BGP parallel best path selection. */
+  if (bgp_process_threads_get () > 1)
+    {
+      vty_out (vty, "bgp parallel-bestpath %d%s", bgp_process_threads_get (),
+               VTY_NEWLINE);
+      write++;
+    }
+#endif /* HAVE_PTHREAD */
+
   /* BGP configuration. */
   for (ALL_LIST_ELEMENTS (bm->bgp, mnode, mnnode, bgp))
     {
@@ -5345,6 +5408,7 @@ bgp_init (void)
   bgp_attr_init ();
   bgp_debug_init ();
   bgp_dump_init ();
+  bgp_updgrp_init ();
   bgp_route_init ();
   bgp_route_map_init ();
   bgp_scan_init ();
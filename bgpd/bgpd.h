@@ -162,6 +162,10 @@ struct bgp
   /* BGP graceful restart */
   u_int32_t restart_time;
   u_int32_t stalepath_time;
+
+  /* Update groups.  */
+  struct list *updgrp[AFI_MAX][SAFI_MAX];
+  unsigned int updgrp_id;
 };
 
 /* BGP peer-group support. */
@@ -288,7 +292,9 @@ struct peer
   /* Peer specific RIB when configured as route-server-client. */
   struct bgp_table *rib[AFI_MAX][SAFI_MAX];
 
-  /* Packet receive and send buffer. */
+  /* Packet receive and send buffer.  While a message is handled ibuf
+     is a view of it in rbuf, where it was read. */
+  struct stream *rbuf;
   struct stream *ibuf;
   struct stream_fifo *obuf;
   struct stream *work;
@@ -299,6 +305,7 @@ struct peer
 
   /* Peer index, used for dumping TABLE_DUMP_V2 format */
   uint16_t table_dump_index;
+  u_int32_t table_dump_gen;
 
   /* Peer information */
   int fd;			/* File descriptor */
@@ -483,6 +490,10 @@ struct peer
   /* Announcement attribute hash.  */
   struct hash *hash[AFI_MAX][SAFI_MAX];
 
+  /* Update group, and the key generation it was last checked at.  */
+  struct bgp_updgrp *updgrp[AFI_MAX][SAFI_MAX];
+  unsigned long updgrp_gen[AFI_MAX][SAFI_MAX];
+
   /* Notify data. */
   struct bgp_notify notify;
 
@@ -719,6 +730,7 @@ struct bgp_nlri
 #define BGP_DEFAULT_IBGP_ROUTEADV                5
 #define BGP_CLEAR_CONNECT_RETRY                 20
 #define BGP_DEFAULT_CONNECT_RETRY              120
+#define BGP_HOLDTIME_GRACE                       1
 
 /* BGP default local preference.  */
 #define BGP_DEFAULT_LOCAL_PREF                 100
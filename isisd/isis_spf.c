@@ -33,6 +33,8 @@
 #include "hash.h"
 #include "if.h"
 #include "table.h"
+#include "pqueue.h"
+#include "jhash.h"
 
 #include "isis_constants.h"
 #include "isis_common.h"
@@ -188,6 +190,82 @@ vid2string (struct isis_vertex *vertex, u_char * buff)
 }
 #endif /* EXTREME_DEBUG */
 
+/*
+ * TENT is a heap, lowest d(N) first and by vertextype on tie break
+ */
+static int
+isis_tent_cmp (void *node1, void *node2)
+{
+  struct isis_vertex *v1 = node1;
+  struct isis_vertex *v2 = node2;
+
+  if (v1->d_N != v2->d_N)
+    return (v1->d_N < v2->d_N) ? -1 : 1;
+
+  return (int) v1->type - (int) v2->type;
+}
+
+static void
+isis_tent_update (void *node, int position)
+{
+  struct isis_vertex *vertex = node;
+
+  vertex->tent_pos = position;
+}
+
+/*
+ * Vertices of TENT and PATHS are indexed by their id and type
+ */
+static unsigned int
+isis_vertex_hash_key (void *arg)
+{
+  struct isis_vertex *vertex = arg;
+
+  switch (vertex->type)
+    {
+    case VTYPE_ES:
+    case VTYPE_NONPSEUDO_IS:
+    case VTYPE_NONPSEUDO_TE_IS:
+      return jhash (vertex->N.id, ISIS_SYS_ID_LEN, vertex->type);
+    case VTYPE_PSEUDO_IS:
+    case VTYPE_PSEUDO_TE_IS:
+      return jhash (vertex->N.id, ISIS_SYS_ID_LEN + 1, vertex->type);
+    default:
+      return jhash (&vertex->N.prefix.u.prefix,
+		    PSIZE (vertex->N.prefix.prefixlen),
+		    (vertex->type << 16) | (vertex->N.prefix.family << 8)
+		    | vertex->N.prefix.prefixlen);
+    }
+}
+
+static int
+isis_vertex_hash_cmp (const void *arg1, const void *arg2)
+{
+  const struct isis_vertex *v1 = arg1;
+  const struct isis_vertex *v2 = arg2;
+  const struct prefix *p1, *p2;
+
+  if (v1->type != v2->type)
+    return 0;
+
+  switch (v1->type)
+    {
+    case VTYPE_ES:
+    case VTYPE_NONPSEUDO_IS:
+    case VTYPE_NONPSEUDO_TE_IS:
+      return memcmp (v1->N.id, v2->N.id, ISIS_SYS_ID_LEN) == 0;
+    case VTYPE_PSEUDO_IS:
+    case VTYPE_PSEUDO_TE_IS:
+      return memcmp (v1->N.id, v2->N.id, ISIS_SYS_ID_LEN + 1) == 0;
+    default:
+      p1 = &v1->N.prefix;
+      p2 = &v2->N.prefix;
+      return (p1->family == p2->family && p1->prefixlen == p2->prefixlen
+	      && memcmp (&p1->u.prefix, &p2->u.prefix,
+			 PSIZE (p1->prefixlen)) == 0);
+    }
+}
+
 static struct isis_spftree *
 isis_spftree_new ()
 {
@@ -200,7 +278,11 @@ isis_spftree_new ()
       return NULL;
     }
 
-  tree->tents = list_new ();
+  tree->tents = pqueue_create ();
+  tree->tents->cmp = isis_tent_cmp;
+  tree->tents->update = isis_tent_update;
+  tree->vertices = hash_create (isis_vertex_hash_key, isis_vertex_hash_cmp);
+  tree->vertices->name = "IS-IS SPF vertices";
   tree->paths = list_new ();
   return tree;
 }
@@ -219,10 +301,10 @@ isis_vertex_del (struct isis_vertex *vertex)
 static void
 isis_spftree_del (struct isis_spftree *spftree)
 {
-  spftree->tents->del = (void (*)(void *)) isis_vertex_del;
-  list_delete (spftree->tents);
-
-  spftree->paths->del = (void (*)(void *)) isis_vertex_del;
+  /* TENT and PATHS only hold vertices of the index. */
+  hash_clean (spftree->vertices, (void (*)(void *)) isis_vertex_del);
+  hash_free (spftree->vertices);
+  pqueue_delete (spftree->tents);
   list_delete (spftree->paths);
 
   XFREE (MTYPE_ISIS_SPFTREE, spftree);
@@ -258,18 +340,10 @@ spftree_area_init (struct isis_area *area)
   return;
 }
 
-static struct isis_vertex *
-isis_vertex_new (void *id, enum vertextype vtype)
+static void
+isis_vertex_id_init (struct isis_vertex *vertex, void *id,
+		     enum vertextype vtype)
 {
-  struct isis_vertex *vertex;
-
-  vertex = XCALLOC (MTYPE_ISIS_VERTEX, sizeof (struct isis_vertex));
-  if (vertex == NULL)
-    {
-      zlog_err ("isis_vertex_new Out of memory!");
-      return NULL;
-    }
-
   vertex->type = vtype;
   switch (vtype)
     {
@@ -295,7 +369,22 @@ isis_vertex_new (void *id, enum vertextype vtype)
     default:
       zlog_err ("WTF!");
     }
+}
+
+static struct isis_vertex *
+isis_vertex_new (void *id, enum vertextype vtype)
+{
+  struct isis_vertex *vertex;
+
+  vertex = XCALLOC (MTYPE_ISIS_VERTEX, sizeof (struct isis_vertex));
+  if (vertex == NULL)
+    {
+      zlog_err ("isis_vertex_new Out of memory!");
+      return NULL;
+    }
 
+  isis_vertex_id_init (vertex, id, vtype);
+  vertex->tent_pos = -1;
   vertex->Adj_N = list_new ();
 
   return vertex;
@@ -330,6 +419,7 @@ isis_spf_add_self (struct isis_spftree *spftree, struct isis_area *area,
 
   vertex->lsp = lsp;
 
+  hash_get (spftree->vertices, vertex, hash_alloc_intern);
   listnode_add (spftree->paths, vertex);
 
 #ifdef EXTREME_DEBUG
@@ -341,48 +431,17 @@ isis_spf_add_self (struct isis_spftree *spftree, struct isis_area *area,
   return;
 }
 
+/*
+ * Find a vertex in TENT or PATHS, vertices in TENT have a tent_pos
+ */
 static struct isis_vertex *
-isis_find_vertex (struct list *list, void *id, enum vertextype vtype)
+isis_find_vertex (struct isis_spftree *spftree, void *id,
+		  enum vertextype vtype)
 {
-  struct listnode *node;
-  struct isis_vertex *vertex;
-  struct prefix *p1, *p2;
-
-  for (ALL_LIST_ELEMENTS_RO (list, node, vertex))
-    {
-      if (vertex->type != vtype)
-	continue;
-      switch (vtype)
-	{
-	case VTYPE_ES:
-	case VTYPE_NONPSEUDO_IS:
-	case VTYPE_NONPSEUDO_TE_IS:
-	  if (memcmp ((u_char *) id, vertex->N.id, ISIS_SYS_ID_LEN) == 0)
-	    return vertex;
-	  break;
-	case VTYPE_PSEUDO_IS:
-	case VTYPE_PSEUDO_TE_IS:
-	  if (memcmp ((u_char *) id, vertex->N.id, ISIS_SYS_ID_LEN + 1) == 0)
-	    return vertex;
-	  break;
-	case VTYPE_IPREACH_INTERNAL:
-	case VTYPE_IPREACH_EXTERNAL:
-	case VTYPE_IPREACH_TE:
-#ifdef HAVE_IPV6
-	case VTYPE_IP6REACH_INTERNAL:
-	case VTYPE_IP6REACH_EXTERNAL:
-#endif /* HAVE_IPV6 */
-	  p1 = (struct prefix *) id;
-	  p2 = (struct prefix *) &vertex->N.id;
-	  if (p1->family == p2->family && p1->prefixlen == p2->prefixlen &&
-	      memcmp (&p1->u.prefix, &p2->u.prefix,
-		      PSIZE (p1->prefixlen)) == 0)
-	    return vertex;
-	  break;
-	}
-    }
+  struct isis_vertex lookup;
 
-  return NULL;
+  isis_vertex_id_init (&lookup, id, vtype);
+  return hash_lookup (spftree->vertices, &lookup);
 }
 
 /*
@@ -393,8 +452,7 @@ isis_spf_add2tent (struct isis_spftree *spftree, enum vertextype vtype,
 		   void *id, struct isis_adjacency *adj, u_int32_t cost,
 		   int depth, int family)
 {
-  struct isis_vertex *vertex, *v;
-  struct listnode *node;
+  struct isis_vertex *vertex;
 #ifdef EXTREME_DEBUG
   u_char buff[BUFSIZ];
 #endif
@@ -410,47 +468,30 @@ isis_spf_add2tent (struct isis_spftree *spftree, enum vertextype vtype,
 	      vtype2string (vertex->type), vid2string (vertex, buff),
 	      vertex->depth, vertex->d_N);
 #endif /* EXTREME_DEBUG */
-  listnode_add (spftree->tents, vertex);
-  if (list_isempty (spftree->tents))
-    {
-      listnode_add (spftree->tents, vertex);
-      return vertex;
-    }
-  
-  /* XXX: This cant use the standard ALL_LIST_ELEMENT macro */
-  for (node = listhead (spftree->tents); node; node = listnextnode (node))
-    {
-      v = listgetdata (node);
-      if (v->d_N > vertex->d_N)
-	{
-	  list_add_node_prev (spftree->tents, node, vertex);
-	  break;
-	}
-      else if (v->d_N == vertex->d_N)
-	{
-	  /*  Tie break, add according to type */
-	  while (v && v->d_N == vertex->d_N && v->type > vertex->type)
-	    {
-	      if (v->type > vertex->type)
-		{
-		  break;
-		}
-              /* XXX: this seems dubious, node is the loop iterator */
-	      node = listnextnode (node);
-	      (node) ? (v = listgetdata (node)) : (v = NULL);
-	    }
-	  list_add_node_prev (spftree->tents, node, vertex);
-	  break;
-	}
-      else if (node->next == NULL)
-	{
-	  list_add_node_next (spftree->tents, node, vertex);
-	  break;
-	}
-    }
+  hash_get (spftree->vertices, vertex, hash_alloc_intern);
+  pqueue_enqueue (vertex, spftree->tents);
+
   return vertex;
 }
 
+/*
+ * A shorter path to a vertex in TENT was found, which replaces its
+ * adjacencies
+ */
+static void
+isis_spf_tent_update (struct isis_spftree *spftree,
+		      struct isis_vertex *vertex, struct isis_adjacency *adj,
+		      u_int32_t cost, int depth)
+{
+  list_delete_all_node (vertex->Adj_N);
+  if (adj)
+    listnode_add (vertex->Adj_N, adj);
+  vertex->d_N = cost;
+  vertex->depth = depth;
+
+  pqueue_update (vertex->tent_pos, spftree->tents);
+}
+
 static struct isis_vertex *
 isis_spf_add_local (struct isis_spftree *spftree, enum vertextype vtype,
 		    void *id, struct isis_adjacency *adj, u_int32_t cost,
@@ -458,7 +499,11 @@ isis_spf_add_local (struct isis_spftree *spftree, enum vertextype vtype,
 {
   struct isis_vertex *vertex;
 
-  vertex = isis_find_vertex (spftree->tents, id, vtype);
+  vertex = isis_find_vertex (spftree, id, vtype);
+
+  /* Only this IS itself can be in PATHS yet. */
+  if (vertex && vertex->tent_pos < 0)
+    return vertex;
 
   if (vertex)
     {
@@ -473,15 +518,11 @@ isis_spf_add_local (struct isis_spftree *spftree, enum vertextype vtype,
 	}
       /*         f) */
       else if (vertex->d_N > cost)
-	{
-	  listnode_delete (spftree->tents, vertex);
-	  goto add2tent;
-	}
+	isis_spf_tent_update (spftree, vertex, adj, cost, 1);
       /*       e) do nothing */
       return vertex;
     }
 
-add2tent:
   return isis_spf_add2tent (spftree, vtype, id, adj, cost, 1, family);
 }
 
@@ -499,8 +540,8 @@ process_N (struct isis_spftree *spftree, enum vertextype vtype, void *id,
   if (dist > MAX_PATH_METRIC)
     return;
   /*       c)    */
-  vertex = isis_find_vertex (spftree->paths, id, vtype);
-  if (vertex)
+  vertex = isis_find_vertex (spftree, id, vtype);
+  if (vertex && vertex->tent_pos < 0)
     {
 #ifdef EXTREME_DEBUG
       zlog_debug ("ISIS-Spf: process_N  %s %s dist %d already found from PATH",
@@ -510,7 +551,6 @@ process_N (struct isis_spftree *spftree, enum vertextype vtype, void *id,
       return;
     }
 
-  vertex = isis_find_vertex (spftree->tents, id, vtype);
   /*       d)    */
   if (vertex)
     {
@@ -536,7 +576,8 @@ process_N (struct isis_spftree *spftree, enum vertextype vtype, void *id,
 	}
       else
 	{
-	  listnode_delete (spftree->tents, vertex);
+	  isis_spf_tent_update (spftree, vertex, adj, dist, depth);
+	  return;
 	}
     }
 
@@ -715,10 +756,8 @@ pseudofragloop:
 	/* Two way connectivity */
 	if (!memcmp (is_neigh->neigh_id, isis->sysid, ISIS_SYS_ID_LEN))
 	  continue;
-	if (isis_find_vertex
-	    (spftree->tents, (void *) is_neigh->neigh_id, vtype) == NULL
-	    && isis_find_vertex (spftree->paths, (void *) is_neigh->neigh_id,
-			       vtype) == NULL)
+	if (isis_find_vertex (spftree, (void *) is_neigh->neigh_id,
+			      vtype) == NULL)
 	  {
 	    /* C.2.5 i) */
 	    isis_spf_add2tent (spftree, vtype, is_neigh->neigh_id, lsp->adj,
@@ -733,10 +772,8 @@ pseudofragloop:
 	/* Two way connectivity */
 	if (!memcmp (te_is_neigh->neigh_id, isis->sysid, ISIS_SYS_ID_LEN))
 	  continue;
-	if (isis_find_vertex
-	    (spftree->tents, (void *) te_is_neigh->neigh_id, vtype) == NULL
-	    && isis_find_vertex (spftree->paths, (void *) te_is_neigh->neigh_id,
-				 vtype) == NULL)
+	if (isis_find_vertex (spftree, (void *) te_is_neigh->neigh_id,
+			      vtype) == NULL)
 	  {
 	    /* C.2.5 i) */
 	    isis_spf_add2tent (spftree, vtype, te_is_neigh->neigh_id, lsp->adj,
@@ -965,10 +1002,10 @@ add_to_paths (struct isis_spftree *spftree, struct isis_vertex *vertex,
 static void
 init_spt (struct isis_spftree *spftree)
 {
-  spftree->tents->del = spftree->paths->del = (void (*)(void *)) isis_vertex_del;
-  list_delete_all_node (spftree->tents);
+  /* TENT and PATHS only hold vertices of the index. */
+  hash_clean (spftree->vertices, (void (*)(void *)) isis_vertex_del);
+  spftree->tents->size = 0;
   list_delete_all_node (spftree->paths);
-  spftree->tents->del = spftree->paths->del = NULL;
 
   return;
 }
@@ -977,7 +1014,6 @@ static int
 isis_run_spf (struct isis_area *area, int level, int family)
 {
   int retval = ISIS_OK;
-  struct listnode *node;
   struct isis_vertex *vertex;
   struct isis_spftree *spftree = NULL;
   u_char lsp_id[ISIS_SYS_ID_LEN + 2];
@@ -1024,20 +1060,17 @@ isis_run_spf (struct isis_area *area, int level, int family)
   /*
    * C.2.7 Step 2
    */
-  if (listcount (spftree->tents) == 0)
+  if (spftree->tents->size == 0)
     {
       zlog_warn ("ISIS-Spf: TENT is empty");
       goto out;
     }
 
-  while (listcount (spftree->tents) > 0)
+  while (spftree->tents->size > 0)
     {
-      node = listhead (spftree->tents);
-      vertex = listgetdata (node);
       /* Remove from tent list */
-      list_delete_node (spftree->tents, node);
-      if (isis_find_vertex (spftree->paths, vertex->N.id, vertex->type))
-	continue;
+      vertex = pqueue_dequeue (spftree->tents);
+      vertex->tent_pos = -1;
       add_to_paths (spftree, vertex, area, level);
       if (vertex->type == VTYPE_PSEUDO_IS ||
 	  vertex->type == VTYPE_NONPSEUDO_IS)
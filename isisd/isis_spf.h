@@ -57,6 +57,7 @@ struct isis_vertex
   struct isis_lsp *lsp;
   u_int32_t d_N;		/* d(N) Distance from this IS      */
   u_int16_t depth;		/* The depth in the imaginary tree */
+  int tent_pos;			/* Position in TENT, -1 if not there */
 
   struct list *Adj_N;		/* {Adj(N)}  */
 };
@@ -67,7 +68,8 @@ struct isis_spftree
   time_t lastrun;		/* for scheduling */
   int pending;			/* already scheduled */
   struct list *paths;		/* the SPT */
-  struct list *tents;		/* TENT */
+  struct pqueue *tents;		/* TENT, ordered by d(N) and type */
+  struct hash *vertices;	/* TENT and PATHS, by id and type */
 
   u_int32_t timerun;		/* statistics */
 };
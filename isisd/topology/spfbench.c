@@ -0,0 +1,336 @@
+/*
+ * IS-IS Rout(e)ing protocol - topology/spfbench.c
+ *                             SPF benchmark on generated topologies
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public Licenseas published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/*
+ * Builds the level-1 LSP database of a grid generated by spgrid, one
+ * LSP per node with its IS neighbours and a /24, reached through a
+ * point-to-point adjacency to node 1.  Then times SPF runs over it and
+ * checks the distances found against a plain Dijkstra over the arcs.
+ *
+ * usage: spfbench [X Y seed [spgrid params]]
+ */
+
+#include <zebra.h>
+
+#include "thread.h"
+#include "linklist.h"
+#include "vty.h"
+#include "log.h"
+#include "memory.h"
+#include "prefix.h"
+#include "hash.h"
+#include "if.h"
+#include "table.h"
+
+#include "isis_constants.h"
+#include "isis_common.h"
+#include "dict.h"
+#include "isisd.h"
+#include "isis_misc.h"
+#include "isis_adjacency.h"
+#include "isis_circuit.h"
+#include "isis_csm.h"
+#include "isis_tlv.h"
+#include "isis_lsp.h"
+#include "isis_spf.h"
+#include "isis_network.h"
+
+#include "spgrid.h"
+
+extern struct isis *isis;
+struct thread_master *master;
+
+void isis_new (unsigned long);
+struct isis_area *isis_area_create (void);
+
+/* Circuits are never brought up here, so no sockets are needed. */
+int
+isis_sock_init (struct isis_circuit *circuit)
+{
+  return ISIS_ERROR;
+}
+
+#define SPF_RUNS	10
+
+static const char *default_params[] =
+  { "50", "50", "1", "-cd", "-cl8", "-cm1", "-il8", "-im1", "-ax2500" };
+
+static u_char base_id[ISIS_SYS_ID_LEN] = { 0xFE, 0xED, 0xFE, 0xED, 0, 0 };
+static u_char self_id[ISIS_SYS_ID_LEN] = { 0, 0, 0, 0, 0, 1 };
+
+static void
+node_id (u_char *id, long node)
+{
+  memcpy (id, base_id, ISIS_SYS_ID_LEN);
+  id[ISIS_SYS_ID_LEN - 1] = node & 0xFF;
+  id[ISIS_SYS_ID_LEN - 2] = (node >> 8) & 0xFF;
+}
+
+static void
+add_neigh (struct list *neighs, long node, long metric)
+{
+  struct is_neigh *is_neigh;
+
+  is_neigh = XCALLOC (MTYPE_ISIS_TLV, sizeof (struct is_neigh));
+  node_id (is_neigh->neigh_id, node);
+  is_neigh->metrics.metric_default = metric;
+  is_neigh->metrics.metric_delay = METRICS_UNSUPPORTED;
+  is_neigh->metrics.metric_expense = METRICS_UNSUPPORTED;
+  is_neigh->metrics.metric_error = METRICS_UNSUPPORTED;
+  listnode_add (neighs, is_neigh);
+}
+
+static void
+build_lsps (struct isis_area *area, struct list *topology, long nodes,
+	    struct isis_adjacency *adj)
+{
+  struct listnode *node;
+  struct arc *arc;
+  struct isis_lsp *lsp, **lsps;
+  struct ipv4_reachability *ipreach;
+  u_char lspid[ISIS_SYS_ID_LEN + 2];
+  long i;
+
+  lsps = XCALLOC (MTYPE_TMP, sizeof (struct isis_lsp *) * (nodes + 1));
+
+  for (i = 1; i <= nodes; i++)
+    {
+      node_id (lspid, i);
+      LSP_PSEUDO_ID (lspid) = 0;
+      LSP_FRAGMENT (lspid) = 0;
+      lsp = lsp_new (lspid, MAX_AGE, 1, IS_LEVEL_1, 0, 1);
+      lsp->area = area;
+      lsp->adj = adj;
+
+      lsp->tlv_data.nlpids = XCALLOC (MTYPE_ISIS_TLV, sizeof (struct nlpids));
+      lsp->tlv_data.nlpids->count = 1;
+      lsp->tlv_data.nlpids->nlpids[0] = NLPID_IP;
+      lsp->tlv_data.is_neighs = list_new ();
+
+      ipreach = XCALLOC (MTYPE_ISIS_TLV, sizeof (struct ipv4_reachability));
+      ipreach->prefix.s_addr = htonl (0x0A000000 | (i << 8));
+      ipreach->mask.s_addr = htonl (0xFFFFFF00);
+      ipreach->metrics.metric_default = 1;
+      lsp->tlv_data.ipv4_int_reachs = list_new ();
+      listnode_add (lsp->tlv_data.ipv4_int_reachs, ipreach);
+
+      lsp_insert (lsp, area->lspdb[0]);
+      lsps[i] = lsp;
+    }
+
+  for (ALL_LIST_ELEMENTS_RO (topology, node, arc))
+    {
+      add_neigh (lsps[arc->from_node]->tlv_data.is_neighs,
+		 arc->to_node, arc->distance);
+      add_neigh (lsps[arc->to_node]->tlv_data.is_neighs,
+		 arc->from_node, arc->distance);
+    }
+
+  XFREE (MTYPE_TMP, lsps);
+}
+
+/* Distances from this IS, through the adjacency to node 1. */
+static void
+reference_spf (struct list *topology, long nodes, u_int32_t metric,
+	       u_int32_t *dist)
+{
+  struct listnode *node;
+  struct arc *arc;
+  char *done;
+  long i, v;
+
+  done = XCALLOC (MTYPE_TMP, nodes + 1);
+  for (i = 1; i <= nodes; i++)
+    dist[i] = UINT32_MAX;
+  dist[1] = metric;
+
+  for (;;)
+    {
+      for (v = 0, i = 1; i <= nodes; i++)
+	if (!done[i] && dist[i] != UINT32_MAX
+	    && (v == 0 || dist[i] < dist[v]))
+	  v = i;
+      if (v == 0)
+	break;
+      done[v] = 1;
+
+      for (ALL_LIST_ELEMENTS_RO (topology, node, arc))
+	{
+	  if (arc->from_node == v
+	      && dist[v] + arc->distance <= MAX_PATH_METRIC
+	      && dist[v] + arc->distance < dist[arc->to_node])
+	    dist[arc->to_node] = dist[v] + arc->distance;
+	  if (arc->to_node == v
+	      && dist[v] + arc->distance <= MAX_PATH_METRIC
+	      && dist[v] + arc->distance < dist[arc->from_node])
+	    dist[arc->from_node] = dist[v] + arc->distance;
+	}
+    }
+
+  XFREE (MTYPE_TMP, done);
+}
+
+/* Compare the IS vertices found by the last run with the reference. */
+static unsigned int
+check_paths (struct isis_spftree *spftree, long nodes, u_int32_t *dist)
+{
+  struct listnode *node;
+  struct isis_vertex *vertex;
+  unsigned int wrong = 0;
+  long i, found = 0, reachable = 0;
+
+  for (i = 1; i <= nodes; i++)
+    if (dist[i] != UINT32_MAX)
+      reachable++;
+
+  for (ALL_LIST_ELEMENTS_RO (spftree->paths, node, vertex))
+    {
+      if (vertex->type != VTYPE_NONPSEUDO_IS
+	  || memcmp (vertex->N.id, base_id, ISIS_SYS_ID_LEN - 2))
+	continue;
+
+      i = (vertex->N.id[ISIS_SYS_ID_LEN - 2] << 8)
+	  | vertex->N.id[ISIS_SYS_ID_LEN - 1];
+      found++;
+      if (i < 1 || i > nodes || vertex->d_N != dist[i])
+	wrong++;
+    }
+
+  if (found != reachable)
+    wrong++;
+  return wrong;
+}
+
+int
+main (int argc, const char **argv)
+{
+  struct isis_area *area;
+  struct isis_circuit *circuit;
+  struct isis_adjacency *adj;
+  struct isis_spftree *spftree;
+  struct vty *vty;
+  struct list *topology;
+  struct listnode *node;
+  struct arc *arc;
+  struct timeval start, now;
+  unsigned long usec, total = 0, best = ULONG_MAX;
+  u_char id[ISIS_SYS_ID_LEN];
+  u_int32_t *dist;
+  unsigned int wrong = 0;
+  long nodes = 0;
+  int i;
+
+  if (argc < 4)
+    {
+      argc = sizeof (default_params) / sizeof (default_params[0]);
+      argv = default_params;
+    }
+  else
+    {
+      argc--;
+      argv++;
+    }
+
+  master = thread_master_create ();
+  zlog_default = openzlog ("spfbench", ZLOG_ISIS,
+			   LOG_CONS | LOG_NDELAY | LOG_PID, LOG_DAEMON);
+  zlog_set_level (NULL, ZLOG_DEST_SYSLOG, ZLOG_DISABLED);
+
+  /* The topology.  spgrid prints its usage through a shell vty. */
+  vty = vty_new ();
+  vty->type = VTY_SHELL;
+  topology = list_new ();
+  if (spgrid_check_params (vty, argc, argv))
+    return 2;
+  gen_spgrid_topology (vty, topology);
+  for (ALL_LIST_ELEMENTS_RO (topology, node, arc))
+    {
+      if (arc->from_node > nodes)
+	nodes = arc->from_node;
+      if (arc->to_node > nodes)
+	nodes = arc->to_node;
+    }
+
+  /* This IS, with one level-1 area and one adjacency into the grid. */
+  isis_new (0);
+  memcpy (isis->sysid, self_id, ISIS_SYS_ID_LEN);
+  isis->sysid_set = 1;
+  /* isis_spf_schedule waits for a minute after start-up. */
+  isis->uptime = time (NULL) - 3600;
+
+  area = isis_area_create ();
+  area->area_tag = strdup ("bench");
+  area->is_type = IS_LEVEL_1;
+  area->ip_circuits = 1;
+  listnode_add (isis->area_list, area);
+
+  circuit = isis_circuit_new ();
+  circuit->state = C_STATE_UP;
+  circuit->circuit_is_type = IS_LEVEL_1;
+  circuit->circ_type = CIRCUIT_T_P2P;
+  circuit->ip_router = 1;
+  circuit->ip_addrs = list_new ();
+  circuit->area = area;
+  listnode_add (area->circuit_list, circuit);
+
+  node_id (id, 1);
+  adj = isis_new_adj (id, NULL, 1, circuit);
+  adj->sys_type = ISIS_SYSTYPE_L1_IS;
+  adj->adj_state = ISIS_ADJ_UP;
+  adj->nlpids.count = 1;
+  adj->nlpids.nlpids[0] = NLPID_IP;
+  circuit->u.p2p.neighbor = adj;
+
+  build_lsps (area, topology, nodes, adj);
+
+  /* Timed runs. */
+  spftree = area->spftree[0];
+  for (i = 0; i < SPF_RUNS; i++)
+    {
+      spftree->lastrun = 0;
+      spftree->pending = 0;
+
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+      isis_spf_schedule (area, 1);
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+
+      usec = (now.tv_sec - start.tv_sec) * 1000000
+	     + (now.tv_usec - start.tv_usec);
+      total += usec;
+      if (usec < best)
+	best = usec;
+    }
+
+  printf ("%ld nodes, %d arcs, %d vertices in PATHS\n", nodes,
+	  listcount (topology), listcount (spftree->paths));
+  printf ("SPF: %lu usec mean, %lu usec best over %d runs\n",
+	  total / SPF_RUNS, best, SPF_RUNS);
+
+  dist = XCALLOC (MTYPE_TMP, sizeof (u_int32_t) * (nodes + 1));
+  reference_spf (topology, nodes, circuit->te_metric[0], dist);
+  wrong = check_paths (spftree, nodes, dist);
+  XFREE (MTYPE_TMP, dist);
+
+  if (wrong)
+    {
+      printf ("%u distances differ from the reference\n", wrong);
+      return 1;
+    }
+  return 0;
+}
@@ -610,13 +610,43 @@ ALIAS (no_distribute_list_prefix, no_ipv6_distribute_list_prefix_cmd,
        "Filter outgoing routing updates\n"
        "Interface name\n")
 
+/* Argument of the hash iterators below.  */
+struct distribute_walk
+{
+  struct vty *vty;
+  enum distribute_type type;
+  int write;
+};
+
+static void
+config_show_distribute_iterator (struct hash_backet *mp, void *arg)
+{
+  struct distribute_walk *walk = arg;
+  struct vty *vty = walk->vty;
+  struct distribute *dist = mp->data;
+
+  if (dist->ifname)
+    if (dist->list[walk->type] || dist->prefix[walk->type])
+      {
+	vty_out (vty, "    %s filtered by", dist->ifname);
+	if (dist->list[walk->type])
+	  vty_out (vty, " %s", dist->list[walk->type]);
+	if (dist->prefix[walk->type])
+	  vty_out (vty, "%s (prefix-list) %s",
+		   dist->list[walk->type] ? "," : "",
+		   dist->prefix[walk->type]);
+	vty_out (vty, "%s", VTY_NEWLINE);
+      }
+}
+
 int
 config_show_distribute (struct vty *vty)
 {
-  unsigned int i;
-  struct hash_backet *mp;
+  struct distribute_walk walk;
   struct distribute *dist;
 
+  walk.vty = vty;
+
   /* Output filter configuration. */
   dist = distribute_lookup (NULL);
   if (dist && (dist->list[DISTRIBUTE_OUT] || dist->prefix[DISTRIBUTE_OUT]))
@@ -633,24 +663,8 @@ config_show_distribute (struct vty *vty)
   else
     vty_out (vty, "  Outgoing update filter list for all interface is not set%s", VTY_NEWLINE);
 
-  for (i = 0; i < disthash->size; i++)
-    for (mp = disthash->index[i]; mp; mp = mp->next)
-      {
-	dist = mp->data;
-	if (dist->ifname)
-	  if (dist->list[DISTRIBUTE_OUT] || dist->prefix[DISTRIBUTE_OUT])
-	    {
-	      vty_out (vty, "    %s filtered by", dist->ifname);
-	      if (dist->list[DISTRIBUTE_OUT])
-		vty_out (vty, " %s", dist->list[DISTRIBUTE_OUT]);
-	      if (dist->prefix[DISTRIBUTE_OUT])
-		vty_out (vty, "%s (prefix-list) %s",
-			 dist->list[DISTRIBUTE_OUT] ? "," : "",
-			 dist->prefix[DISTRIBUTE_OUT]);
-	      vty_out (vty, "%s", VTY_NEWLINE);
-	    }
-      }
-
+  walk.type = DISTRIBUTE_OUT;
+  hash_iterate (disthash, config_show_distribute_iterator, &walk);
 
   /* Input filter configuration. */
   dist = distribute_lookup (NULL);
@@ -668,79 +682,68 @@ config_show_distribute (struct vty *vty)
   else
     vty_out (vty, "  Incoming update filter list for all interface is not set%s", VTY_NEWLINE);
 
-  for (i = 0; i < disthash->size; i++)
-    for (mp = disthash->index[i]; mp; mp = mp->next)
-      {
-	dist = mp->data;
-	if (dist->ifname)
-	  if (dist->list[DISTRIBUTE_IN] || dist->prefix[DISTRIBUTE_IN])
-	    {
-	      vty_out (vty, "    %s filtered by", dist->ifname);
-	      if (dist->list[DISTRIBUTE_IN])
-		vty_out (vty, " %s", dist->list[DISTRIBUTE_IN]);
-	      if (dist->prefix[DISTRIBUTE_IN])
-		vty_out (vty, "%s (prefix-list) %s",
-			 dist->list[DISTRIBUTE_IN] ? "," : "",
-			 dist->prefix[DISTRIBUTE_IN]);
-	      vty_out (vty, "%s", VTY_NEWLINE);
-	    }
-      }
+  walk.type = DISTRIBUTE_IN;
+  hash_iterate (disthash, config_show_distribute_iterator, &walk);
   return 0;
 }
 
+static void
+config_write_distribute_iterator (struct hash_backet *mp, void *arg)
+{
+  struct distribute_walk *walk = arg;
+  struct vty *vty = walk->vty;
+  struct distribute *dist;
+
+  dist = mp->data;
+
+  if (dist->list[DISTRIBUTE_IN])
+    {
+      vty_out (vty, " distribute-list %s in %s%s", 
+	       dist->list[DISTRIBUTE_IN],
+	       dist->ifname ? dist->ifname : "",
+	       VTY_NEWLINE);
+      walk->write++;
+    }
+
+  if (dist->list[DISTRIBUTE_OUT])
+    {
+      vty_out (vty, " distribute-list %s out %s%s", 
+
+	       dist->list[DISTRIBUTE_OUT],
+	       dist->ifname ? dist->ifname : "",
+	       VTY_NEWLINE);
+      walk->write++;
+    }
+
+  if (dist->prefix[DISTRIBUTE_IN])
+    {
+      vty_out (vty, " distribute-list prefix %s in %s%s",
+	       dist->prefix[DISTRIBUTE_IN],
+	       dist->ifname ? dist->ifname : "",
+	       VTY_NEWLINE);
+      walk->write++;
+    }
+
+  if (dist->prefix[DISTRIBUTE_OUT])
+    {
+      vty_out (vty, " distribute-list prefix %s out %s%s",
+	       dist->prefix[DISTRIBUTE_OUT],
+	       dist->ifname ? dist->ifname : "",
+	       VTY_NEWLINE);
+      walk->write++;
+    }
+}
+
 /* Configuration write function. */
 int
 config_write_distribute (struct vty *vty)
 {
-  unsigned int i;
-  struct hash_backet *mp;
-  int write = 0;
+  struct distribute_walk walk;
 
-  for (i = 0; i < disthash->size; i++)
-    for (mp = disthash->index[i]; mp; mp = mp->next)
-      {
-	struct distribute *dist;
-
-	dist = mp->data;
-
-	if (dist->list[DISTRIBUTE_IN])
-	  {
-	    vty_out (vty, " distribute-list %s in %s%s", 
-		     dist->list[DISTRIBUTE_IN],
-		     dist->ifname ? dist->ifname : "",
-		     VTY_NEWLINE);
-	    write++;
-	  }
-
-	if (dist->list[DISTRIBUTE_OUT])
-	  {
-	    vty_out (vty, " distribute-list %s out %s%s", 
-
-		     dist->list[DISTRIBUTE_OUT],
-		     dist->ifname ? dist->ifname : "",
-		     VTY_NEWLINE);
-	    write++;
-	  }
-
-	if (dist->prefix[DISTRIBUTE_IN])
-	  {
-	    vty_out (vty, " distribute-list prefix %s in %s%s",
-		     dist->prefix[DISTRIBUTE_IN],
-		     dist->ifname ? dist->ifname : "",
-		     VTY_NEWLINE);
-	    write++;
-	  }
-
-	if (dist->prefix[DISTRIBUTE_OUT])
-	  {
-	    vty_out (vty, " distribute-list prefix %s out %s%s",
-		     dist->prefix[DISTRIBUTE_OUT],
-		     dist->ifname ? dist->ifname : "",
-		     VTY_NEWLINE);
-	    write++;
-	  }
-      }
-  return write;
+  walk.vty = vty;
+  walk.write = 0;
+  hash_iterate (disthash, config_write_distribute_iterator, &walk);
+  return walk.write;
 }
 
 /* Clear all distribute list. */
@@ -756,6 +759,7 @@ distribute_list_init (int node)
 {
   disthash = hash_create (distribute_hash_make,
                           (int (*) (const void *, const void *)) distribute_cmp);
+  disthash->name = "Distribute lists";
 
   if(node==RIP_NODE) {
     install_element (RIP_NODE, &distribute_list_all_cmd);
@@ -23,6 +23,38 @@
 
 #include "hash.h"
 #include "memory.h"
+#include "command.h"
+#include "vty.h"
+
+/* The table grows once more than three quarters of its slots are
+   used, to twice as many slots as it has entries.  */
+#define HASH_LOAD_NUM	3
+#define HASH_LOAD_DEN	4
+#define HASH_MIN_SIZE	8
+
+/* Number of old slots moved on each hash_get or hash_release while
+   the table grows.  */
+#define HASH_REHASH_STEP 32
+
+/* Data of a slot whose entry was released.  Lookups must probe past
+   it, inserts may reuse it.  */
+static char hash_deleted;
+#define HASH_DELETED	((void *) &hash_deleted)
+#define HASH_LIVE(hb)	((hb)->data != NULL && (hb)->data != HASH_DELETED)
+
+/* All hash tables, for "show hashtable".  */
+static struct hash *hash_list;
+
+/* Smallest power of two not less than size.  */
+static unsigned int
+hash_roundup (unsigned long size)
+{
+  unsigned int n = HASH_MIN_SIZE;
+
+  while (n < size && (n << 1) != 0)
+    n <<= 1;
+  return n;
+}
 
 /* Allocate a new hash.  */
 struct hash *
@@ -31,14 +63,19 @@ hash_create_size (unsigned int size, unsigned int (*hash_key) (void *),
 {
   struct hash *hash;
 
-  hash = XMALLOC (MTYPE_HASH, sizeof (struct hash));
+  hash = XCALLOC (MTYPE_HASH, sizeof (struct hash));
+  hash->size = hash_roundup (size);
   hash->index = XCALLOC (MTYPE_HASH_INDEX,
-			 sizeof (struct hash_backet *) * size);
-  hash->size = size;
+			 sizeof (struct hash_backet) * hash->size);
   hash->hash_key = hash_key;
   hash->hash_cmp = hash_cmp;
   hash->count = 0;
 
+  hash->next = hash_list;
+  if (hash_list)
+    hash_list->prev = hash;
+  hash_list = hash;
+
   return hash;
 }
 
@@ -59,6 +96,106 @@ hash_alloc_intern (void *arg)
   return arg;
 }
 
+/* Find the slot holding data in the given slots.  Linear probing from
+   the key's home slot, up to the first slot never used.  */
+static struct hash_backet *
+hash_find (struct hash *hash, struct hash_backet *index, unsigned int size,
+	   unsigned int key, void *data)
+{
+  unsigned int i;
+  unsigned int mask = size - 1;
+  struct hash_backet *hb;
+
+  for (i = key & mask; (hb = &index[i])->data != NULL; i = (i + 1) & mask)
+    if (hb->data != HASH_DELETED && hb->key == key
+	&& (*hash->hash_cmp) (hb->data, data))
+      return hb;
+  return NULL;
+}
+
+/* Return the first free slot for key, which may be one of a released
+   entry.  */
+static struct hash_backet *
+hash_free_slot (struct hash_backet *index, unsigned int size,
+		unsigned int key)
+{
+  unsigned int i;
+  unsigned int mask = size - 1;
+
+  for (i = key & mask; HASH_LIVE (&index[i]); i = (i + 1) & mask)
+    ;
+  return &index[i];
+}
+
+/* Move up to slots of the old index into the current one.  Backets
+   keep their keys, so moving them does not call hash_key.  */
+static void
+hash_rehash_step (struct hash *hash, unsigned int slots)
+{
+  struct hash_backet *hb, *to;
+
+  while (slots-- && hash->old_pos < hash->old_size)
+    {
+      hb = &hash->old_index[hash->old_pos++];
+      if (! HASH_LIVE (hb))
+	continue;
+
+      to = hash_free_slot (hash->index, hash->size, hb->key);
+      if (to->data == NULL)
+	hash->used++;
+      *to = *hb;
+
+      /* Leave a released mark, so probing the old slots still works.  */
+      hb->data = HASH_DELETED;
+      hash->old_count--;
+    }
+
+  if (hash->old_pos == hash->old_size)
+    {
+      XFREE (MTYPE_HASH_INDEX, hash->old_index);
+      hash->old_index = NULL;
+      hash->old_size = 0;
+      hash->old_pos = 0;
+      hash->old_count = 0;
+    }
+}
+
+/* Start moving the entries to a new index with room for twice as many.
+   This also drops the marks left by released entries.  */
+static void
+hash_expand (struct hash *hash)
+{
+  if (hash->old_index)
+    hash_rehash_step (hash, hash->old_size);
+
+  hash->old_index = hash->index;
+  hash->old_size = hash->size;
+  hash->old_pos = 0;
+  hash->old_count = hash->count;
+
+  hash->size = hash_roundup ((hash->count + 1) * 2);
+  hash->index = XCALLOC (MTYPE_HASH_INDEX,
+			 sizeof (struct hash_backet) * hash->size);
+  hash->used = 0;
+  hash->expands++;
+}
+
+/* Find data in the current or, while growing, the old index.  */
+static struct hash_backet *
+hash_find_key (struct hash *hash, unsigned int key, void *data, int *old)
+{
+  struct hash_backet *hb;
+
+  *old = 0;
+  hb = hash_find (hash, hash->index, hash->size, key, data);
+  if (hb == NULL && hash->old_index)
+    {
+      hb = hash_find (hash, hash->old_index, hash->old_size, key, data);
+      *old = 1;
+    }
+  return hb;
+}
+
 /* Lookup and return hash backet in hash.  If there is no
    corresponding hash backet and alloc_func is specified, create new
    hash backet.  */
@@ -66,16 +203,18 @@ void *
 hash_get (struct hash *hash, void *data, void * (*alloc_func) (void *))
 {
   unsigned int key;
-  unsigned int index;
+  int old;
   void *newdata;
   struct hash_backet *backet;
 
   key = (*hash->hash_key) (data);
-  index = key % hash->size;
 
-  for (backet = hash->index[index]; backet != NULL; backet = backet->next) 
-    if (backet->key == key && (*hash->hash_cmp) (backet->data, data))
-      return backet->data;
+  if (hash->old_index && ! hash->iterating)
+    hash_rehash_step (hash, HASH_REHASH_STEP);
+
+  backet = hash_find_key (hash, key, data, &old);
+  if (backet)
+    return backet->data;
 
   if (alloc_func)
     {
@@ -83,13 +222,22 @@ hash_get (struct hash *hash, void *data, void * (*alloc_func) (void *))
       if (newdata == NULL)
 	return NULL;
 
-      backet = XMALLOC (MTYPE_HASH_BACKET, sizeof (struct hash_backet));
+      if (! hash->iterating
+	  && (hash->used + hash->old_count + 1) * HASH_LOAD_DEN
+	     > (unsigned long) hash->size * HASH_LOAD_NUM)
+	hash_expand (hash);
+
+      /* At least one slot must stay unused to end probing.  Only an
+         iterator adding many entries can get this far.  */
+      assert (hash->used + 1 < hash->size);
+
+      backet = hash_free_slot (hash->index, hash->size, key);
+      if (backet->data == NULL)
+	hash->used++;
       backet->data = newdata;
       backet->key = key;
-      backet->next = hash->index[index];
-      hash->index[index] = backet;
       hash->count++;
-      return backet->data;
+      return newdata;
     }
   return NULL;
 }
@@ -120,50 +268,52 @@ hash_release (struct hash *hash, void *data)
 {
   void *ret;
   unsigned int key;
-  unsigned int index;
+  int old;
   struct hash_backet *backet;
-  struct hash_backet *pp;
 
   key = (*hash->hash_key) (data);
-  index = key % hash->size;
 
-  for (backet = pp = hash->index[index]; backet; backet = backet->next)
-    {
-      if (backet->key == key && (*hash->hash_cmp) (backet->data, data)) 
-	{
-	  if (backet == pp) 
-	    hash->index[index] = backet->next;
-	  else 
-	    pp->next = backet->next;
-
-	  ret = backet->data;
-	  XFREE (MTYPE_HASH_BACKET, backet);
-	  hash->count--;
-	  return ret;
-	}
-      pp = backet;
-    }
-  return NULL;
+  if (hash->old_index && ! hash->iterating)
+    hash_rehash_step (hash, HASH_REHASH_STEP);
+
+  backet = hash_find_key (hash, key, data, &old);
+  if (backet == NULL)
+    return NULL;
+
+  ret = backet->data;
+  backet->data = HASH_DELETED;
+  hash->count--;
+  if (old)
+    hash->old_count--;
+  return ret;
 }
 
-/* Iterator function for hash.  */
+/* Iterator function for hash.  func may release the entry it is given,
+   or add entries, but the table does not grow until this returns.  */
 void
 hash_iterate (struct hash *hash, 
 	      void (*func) (struct hash_backet *, void *), void *arg)
 {
   unsigned int i;
   struct hash_backet *hb;
-  struct hash_backet *hbnext;
+
+  hash->iterating++;
+
+  for (i = 0; i < hash->old_size; i++)
+    {
+      hb = &hash->old_index[i];
+      if (HASH_LIVE (hb))
+	(*func) (hb, arg);
+    }
 
   for (i = 0; i < hash->size; i++)
-    for (hb = hash->index[i]; hb; hb = hbnext)
-      {
-	/* get pointer to next hash backet here, in case (*func)
-	 * decides to delete hb by calling hash_release
-	 */
-	hbnext = hb->next;
+    {
+      hb = &hash->index[i];
+      if (HASH_LIVE (hb))
 	(*func) (hb, arg);
-      }
+    }
+
+  hash->iterating--;
 }
 
 /* Clean up hash.  */
@@ -172,22 +322,29 @@ hash_clean (struct hash *hash, void (*free_func) (void *))
 {
   unsigned int i;
   struct hash_backet *hb;
-  struct hash_backet *next;
+
+  for (i = 0; i < hash->old_size; i++)
+    {
+      hb = &hash->old_index[i];
+      if (free_func && HASH_LIVE (hb))
+	(*free_func) (hb->data);
+    }
+  if (hash->old_index)
+    XFREE (MTYPE_HASH_INDEX, hash->old_index);
+  hash->old_index = NULL;
+  hash->old_size = 0;
+  hash->old_pos = 0;
+  hash->old_count = 0;
 
   for (i = 0; i < hash->size; i++)
     {
-      for (hb = hash->index[i]; hb; hb = next)
-	{
-	  next = hb->next;
-	      
-	  if (free_func)
-	    (*free_func) (hb->data);
-
-	  XFREE (MTYPE_HASH_BACKET, hb);
-	  hash->count--;
-	}
-      hash->index[i] = NULL;
+      hb = &hash->index[i];
+      if (free_func && HASH_LIVE (hb))
+	(*free_func) (hb->data);
+      hb->data = NULL;
     }
+  hash->used = 0;
+  hash->count = 0;
 }
 
 /* Free hash memory.  You may call hash_clean before call this
@@ -195,6 +352,73 @@ hash_clean (struct hash *hash, void (*free_func) (void *))
 void
 hash_free (struct hash *hash)
 {
+  if (hash->prev)
+    hash->prev->next = hash->next;
+  else
+    hash_list = hash->next;
+  if (hash->next)
+    hash->next->prev = hash->prev;
+
+  if (hash->old_index)
+    XFREE (MTYPE_HASH_INDEX, hash->old_index);
   XFREE (MTYPE_HASH_INDEX, hash->index);
   XFREE (MTYPE_HASH, hash);
 }
+
+/* Add the probe lengths of the entries in the given slots.  */
+static void
+hash_probe_stats (struct hash_backet *index, unsigned int size,
+		  unsigned long *live, unsigned long *deleted,
+		  unsigned long *probes, unsigned int *max)
+{
+  unsigned int i, len;
+
+  for (i = 0; i < size; i++)
+    {
+      if (index[i].data == HASH_DELETED)
+	(*deleted)++;
+      if (! HASH_LIVE (&index[i]))
+	continue;
+
+      len = (i - index[i].key) & (size - 1);
+      (*live)++;
+      *probes += len;
+      if (len > *max)
+	*max = len;
+    }
+}
+
+DEFUN (show_hashtable,
+       show_hashtable_cmd,
+       "show hashtable",
+       SHOW_STR
+       "Hash table statistics\n")
+{
+  struct hash *hash;
+  unsigned long live, deleted, probes;
+  unsigned int max;
+
+  vty_out (vty, "%-24s %9s %9s %5s %7s %6s %6s %7s%s",
+	   "Name", "Entries", "Slots", "Load", "Deleted",
+	   "Probe", "Max", "Expands", VTY_NEWLINE);
+
+  for (hash = hash_list; hash; hash = hash->next)
+    {
+      live = deleted = probes = 0;
+      max = 0;
+      hash_probe_stats (hash->index, hash->size,
+			&live, &deleted, &probes, &max);
+      if (hash->old_index)
+	hash_probe_stats (hash->old_index, hash->old_size,
+			  &live, &deleted, &probes, &max);
+
+      vty_out (vty, "%-24s %9lu %9u %4lu%% %7lu %6.2f %6u %7lu%s%s",
+	       hash->name ? hash->name : "-",
+	       hash->count, hash->size,
+	       (hash->used * 100) / hash->size, deleted,
+	       live ? (double) probes / live : 0.0, max, hash->expands,
+	       hash->old_index ? " (growing)" : "",
+	       VTY_NEWLINE);
+    }
+  return CMD_SUCCESS;
+}
@@ -21,29 +21,40 @@ Boston, MA 02111-1307, USA.  */
 #ifndef _ZEBRA_HASH_H
 #define _ZEBRA_HASH_H
 
-/* Default hash table size.  */ 
-#define HASHTABSIZE     1024
+/* Default initial hash table size.  Tables grow as entries are
+   added, so this is kept small.  */ 
+#define HASHTABSIZE     64
 
+/* A slot in the hash table.  Entries are kept in the slots themselves
+   (open addressing), so a pointer to a backet is only good until the
+   table is next changed.  */
 struct hash_backet
 {
-  /* Linked list.  */
-  struct hash_backet *next;
-
   /* Hash key. */
   unsigned int key;
 
-  /* Data.  */
+  /* Data, NULL if the slot has never been used.  */
   void *data;
 };
 
 struct hash
 {
-  /* Hash backet. */
-  struct hash_backet **index;
+  /* Hash slots, a power of two of them. */
+  struct hash_backet *index;
 
   /* Hash table size. */
   unsigned int size;
 
+  /* Slots in use, including those of released entries. */
+  unsigned long used;
+
+  /* While the table grows, the previous slots.  Entries are moved from
+     here a few at a time as the table is used.  */
+  struct hash_backet *old_index;
+  unsigned int old_size;
+  unsigned int old_pos;
+  unsigned long old_count;
+
   /* Key make function. */
   unsigned int (*hash_key) (void *);
 
@@ -52,6 +63,19 @@ struct hash
 
   /* Backet alloc. */
   unsigned long count;
+
+  /* Name shown by "show hashtable", may be NULL. */
+  const char *name;
+
+  /* Number of times the table has grown. */
+  unsigned long expands;
+
+  /* Non-zero while hash_iterate runs, the table does not grow then. */
+  unsigned int iterating;
+
+  /* List of all hash tables. */
+  struct hash *prev;
+  struct hash *next;
 };
 
 extern struct hash *hash_create (unsigned int (*) (void *), 
@@ -72,4 +96,6 @@ extern void hash_free (struct hash *);
 
 extern unsigned int string_hash_make (const char *);
 
+extern struct cmd_element show_hashtable_cmd;
+
 #endif /* _ZEBRA_HASH_H */
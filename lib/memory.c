@@ -26,6 +26,13 @@
 #include <malloc.h>
 #endif /* !HAVE_STDLIB_H || HAVE_MALLINFO */
 
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif /* HAVE_MMAP */
+
 #include "log.h"
 #include "memory.h"
 
@@ -58,6 +65,209 @@ zerror (const char *fname, int type, size_t size)
   abort();
 }
 
+/*
+ * Slab allocation of fixed size objects.
+ *
+ * Types flagged MEMORY_SLAB in memtypes.c are carved out of MSLAB_SIZE
+ * blocks rather than malloc'd one by one, which saves the per-object
+ * malloc overhead and fragmentation for types of which a full table
+ * creates millions.  Slabs are mmap'd directly, aligned on MSLAB_SIZE
+ * so the slab an object belongs to can be found from its address, and
+ * are given back to the system once empty.
+ *
+ * The object size is set by the first allocation of the type, later
+ * allocations must be no larger.
+ */
+#define MSLAB_SIZE	(256 * 1024)
+#define MSLAB_ALIGN	8
+#define MSLAB_ROUNDUP(X) (((X) + MSLAB_ALIGN - 1) & ~(MSLAB_ALIGN - 1))
+#define MSLAB_HDRSIZE	MSLAB_ROUNDUP (sizeof (struct mslab))
+#define MSLAB_OF(P)	((struct mslab *) ((uintptr_t) (P) & ~(MSLAB_SIZE - 1)))
+
+struct mslab
+{
+  struct mslab *next;		/* partial slabs of the cache */
+  struct mslab *prev;
+  void *free;			/* freed objects, available for reuse */
+  unsigned int carved;		/* objects carved from the slab so far */
+  unsigned int inuse;
+  int type;
+};
+
+static struct mcache
+{
+  int enabled;
+  size_t size;			/* object size */
+  unsigned int per_slab;	/* objects per slab */
+  struct mslab *partial;	/* slabs with objects available */
+  unsigned long slabs;
+} mcache[MTYPE_MAX];
+
+static int mcache_inited;
+
+/* Pick up the MEMORY_SLAB types.  Done on first allocation, so that
+ * no object of a slab type could have been malloc'd.
+ */
+static void
+mslab_init (void)
+{
+#if defined(HAVE_MMAP) && defined(MAP_ANONYMOUS)
+  struct mlist *ml;
+  struct memory_list *m;
+
+  for (ml = mlists; ml->list; ml++)
+    for (m = ml->list; m->index >= 0; m++)
+      if (m->index && (m->flags & MEMORY_SLAB))
+        mcache[m->index].enabled = 1;
+#endif /* HAVE_MMAP && MAP_ANONYMOUS */
+  mcache_inited = 1;
+}
+
+#if defined(HAVE_MMAP) && defined(MAP_ANONYMOUS)
+/* Map a new MSLAB_SIZE aligned slab.  Mapping twice the size and trimming
+ * the excess is needed, as mmap only guarantees page alignment.  mmap'd
+ * memory is zero filled, so the slab header starts out cleared.
+ */
+static struct mslab *
+mslab_map (void)
+{
+  char *block, *slab;
+
+  block = mmap (NULL, 2 * MSLAB_SIZE, PROT_READ|PROT_WRITE,
+                MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if (block == MAP_FAILED)
+    return NULL;
+
+  slab = (char *) MSLAB_OF (block + MSLAB_SIZE - 1);
+  if (slab > block)
+    munmap (block, slab - block);
+  munmap (slab + MSLAB_SIZE, block + 2 * MSLAB_SIZE - (slab + MSLAB_SIZE));
+
+  return (struct mslab *) slab;
+}
+
+static void
+mslab_unmap (struct mslab *slab)
+{
+  munmap (slab, MSLAB_SIZE);
+}
+#else
+/* Never called, as no type is slab enabled without mmap. */
+static struct mslab *
+mslab_map (void)
+{
+  return NULL;
+}
+
+static void
+mslab_unmap (struct mslab *slab)
+{
+}
+#endif /* HAVE_MMAP && MAP_ANONYMOUS */
+
+static int
+mslab_type (int type)
+{
+  if (!mcache_inited)
+    mslab_init ();
+  return mcache[type].enabled;
+}
+
+static void
+mslab_unlink (struct mcache *mc, struct mslab *slab)
+{
+  if (slab->next)
+    slab->next->prev = slab->prev;
+  if (slab->prev)
+    slab->prev->next = slab->next;
+  else
+    mc->partial = slab->next;
+  slab->next = slab->prev = NULL;
+}
+
+static void
+mslab_link (struct mcache *mc, struct mslab *slab)
+{
+  slab->prev = NULL;
+  slab->next = mc->partial;
+  if (mc->partial)
+    mc->partial->prev = slab;
+  mc->partial = slab;
+}
+
+static void *
+mslab_alloc (int type, size_t size)
+{
+  struct mcache *mc = &mcache[type];
+  struct mslab *slab;
+  void *obj;
+
+  if (!mc->size)
+    {
+      mc->size = MSLAB_ROUNDUP (size > sizeof (void *)
+                                ? size : sizeof (void *));
+      mc->per_slab = (MSLAB_SIZE - MSLAB_HDRSIZE) / mc->size;
+      assert (mc->per_slab > 0);
+    }
+  else if (size > mc->size)
+    {
+      zlog_err ("%s: memory type %d is slab allocated at %lu bytes,"
+                " %lu requested", __func__, type,
+                (unsigned long) mc->size, (unsigned long) size);
+      zerror ("slab", type, size);
+    }
+
+  if ((slab = mc->partial) == NULL)
+    {
+      slab = mslab_map ();
+      if (slab == NULL)
+        zerror ("mmap", type, MSLAB_SIZE);
+
+      slab->type = type;
+      mslab_link (mc, slab);
+      mc->slabs++;
+    }
+
+  if (slab->free)
+    {
+      obj = slab->free;
+      slab->free = *(void **) obj;
+    }
+  else
+    obj = (char *) slab + MSLAB_HDRSIZE + (slab->carved++ * mc->size);
+
+  if (++slab->inuse == mc->per_slab)
+    mslab_unlink (mc, slab);
+
+  return obj;
+}
+
+static void
+mslab_free (int type, void *ptr)
+{
+  struct mcache *mc = &mcache[type];
+  struct mslab *slab = MSLAB_OF (ptr);
+
+  assert (slab->type == type);
+
+  /* Full slab is about to have space again */
+  if (slab->inuse == mc->per_slab)
+    mslab_link (mc, slab);
+
+  *(void **) ptr = slab->free;
+  slab->free = ptr;
+
+  /* Give empty slabs back, but keep the last one around to avoid
+   * thrashing on alloc/free of a single object.
+   */
+  if (--slab->inuse == 0 && (mc->partial != slab || slab->next))
+    {
+      mslab_unlink (mc, slab);
+      mslab_unmap (slab);
+      mc->slabs--;
+    }
+}
+
 /*
  * Allocate memory of a given size, to be tracked by a given type.
  * Effects: Returns a pointer to usable memory.  If memory cannot
@@ -68,7 +278,10 @@ zmalloc (int type, size_t size)
 {
   void *memory;
 
-  memory = malloc (size);
+  if (mslab_type (type))
+    memory = mslab_alloc (type, size);
+  else
+    memory = malloc (size);
 
   if (memory == NULL)
     zerror ("malloc", type, size);
@@ -86,7 +299,13 @@ zcalloc (int type, size_t size)
 {
   void *memory;
 
-  memory = calloc (1, size);
+  if (mslab_type (type))
+    {
+      memory = mslab_alloc (type, size);
+      memset (memory, 0, size);
+    }
+  else
+    memory = calloc (1, size);
 
   if (memory == NULL)
     zerror ("calloc", type, size);
@@ -108,6 +327,16 @@ zrealloc (int type, void *ptr, size_t size)
 {
   void *memory;
 
+  /* Slab objects are of a fixed size, they can't be grown. */
+  if (mslab_type (type))
+    {
+      if (ptr == NULL)
+        return zmalloc (type, size);
+      if (size > mcache[type].size)
+        zerror ("realloc", type, size);
+      return ptr;
+    }
+
   memory = realloc (ptr, size);
   if (memory == NULL)
     zerror ("realloc", type, size);
@@ -129,7 +358,10 @@ zfree (int type, void *ptr)
   if (ptr != NULL)
     {
       alloc_dec (type);
-      free (ptr);
+      if (mslab_type (type))
+        mslab_free (type, ptr);
+      else
+        free (ptr);
     }
 }
 
@@ -144,6 +376,9 @@ zstrdup (int type, const char *str)
 {
   void *dup;
 
+  if (mslab_type (type))
+    return strcpy (zmalloc (type, strlen (str) + 1), str);
+
   dup = strdup (str);
   if (dup == NULL)
     zerror ("strdup", type, strlen (str));
@@ -351,6 +586,36 @@ show_memory_vty (struct vty *vty, struct memory_list *list)
   return needsep;
 }
 
+static int
+show_memory_slab (struct vty *vty)
+{
+  struct mlist *ml;
+  struct memory_list *m;
+  size_t size;
+  unsigned long slabs, objs;
+  int header = 0;
+
+  for (ml = mlists; ml->list; ml++)
+    for (m = ml->list; m->index >= 0; m++)
+      {
+        if (!m->index || !mtype_stats_slab (m->index, &size, &slabs, &objs)
+            || !slabs)
+          continue;
+
+        if (!header)
+          {
+            vty_out (vty, "Slab allocator statistics:%s", VTY_NEWLINE);
+            vty_out (vty, "%-30s: %8s %10s %8s %9s%s", "  Type", "Size",
+                     "In use", "Slabs", "Occupancy", VTY_NEWLINE);
+            header = 1;
+          }
+        vty_out (vty, "  %-28s: %8lu %10ld %8lu %8.1f%%%s",
+                 m->format, (unsigned long) size, mstat[m->index].alloc,
+                 slabs, 100.0 * mstat[m->index].alloc / objs, VTY_NEWLINE);
+      }
+  return header;
+}
+
 #ifdef HAVE_MALLINFO
 static int
 show_memory_mallinfo (struct vty *vty)
@@ -405,6 +670,10 @@ DEFUN (show_memory_all,
 #ifdef HAVE_MALLINFO
   needsep = show_memory_mallinfo (vty);
 #endif /* HAVE_MALLINFO */
+
+  if (needsep)
+    show_separator (vty);
+  needsep = show_memory_slab (vty);
   
   for (ml = mlists; ml->list; ml++)
     {
@@ -613,3 +882,16 @@ mtype_stats_alloc (int type)
 {
   return mstat[type].alloc;
 }
+
+int
+mtype_stats_slab (int type, size_t *size, unsigned long *slabs,
+                  unsigned long *objs)
+{
+  if (!mslab_type (type))
+    return 0;
+
+  *size = mcache[type].size;
+  *slabs = mcache[type].slabs;
+  *objs = mcache[type].slabs * mcache[type].per_slab;
+  return 1;
+}
@@ -26,8 +26,12 @@ struct memory_list
 {
   int index;
   const char *format;
+  int flags;
 };
 
+/* memory_list flags */
+#define MEMORY_SLAB	(1 << 0) /* fixed size objects, allocate from slabs */
+
 struct mlist {
   struct memory_list *list;
   const char *name;
@@ -88,6 +92,10 @@ extern void log_memstats_stderr (const char *);
 /* return number of allocations outstanding for the type */
 extern unsigned long mtype_stats_alloc (int);
 
+/* Slab usage for the type: object size, slabs allocated and the number of
+ * objects they can hold.  Returns 0 if the type is not slab allocated. */
+extern int mtype_stats_slab (int, size_t *, unsigned long *, unsigned long *);
+
 /* Human friendly string for given byte count */
 #define MTYPE_MEMSTR_LEN 20
 extern const char *mtype_memstr (char *, size_t, unsigned long);
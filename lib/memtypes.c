@@ -5,6 +5,10 @@
  *
  * The script is sensitive to the format (though not whitespace), see
  * the top of memtypes.awk for more details.
+ *
+ * Types which are only ever allocated at one fixed size, and of which
+ * there may be very many, can be flagged MEMORY_SLAB to have them
+ * allocated from slabs rather than individually by malloc, see memory.c.
  */
 
 #include "zebra.h"
@@ -22,6 +26,7 @@ struct memory_list memory_list_lib[] =
   { MTYPE_THREAD_MASTER,	"Thread master"			},
   { MTYPE_THREAD_STATS,		"Thread stats"			},
   { MTYPE_THREAD_FUNCNAME,	"Thread function name" 		},
+  { MTYPE_THREAD_FD,		"Thread fd table"		},
   { MTYPE_VTY,			"VTY"				},
   { MTYPE_VTY_OUT_BUF,		"VTY output buffer"		},
   { MTYPE_VTY_HIST,		"VTY history"			},
@@ -32,15 +37,16 @@ struct memory_list memory_list_lib[] =
   { MTYPE_BUFFER_DATA,		"Buffer data"			},
   { MTYPE_STREAM,		"Stream"			},
   { MTYPE_STREAM_DATA,		"Stream data"			},
+  { MTYPE_STREAM_POOL,		"Stream data pool",	MEMORY_SLAB	},
   { MTYPE_STREAM_FIFO,		"Stream FIFO"			},
   { MTYPE_PREFIX,		"Prefix"			},
   { MTYPE_PREFIX_IPV4,		"Prefix IPv4"			},
   { MTYPE_PREFIX_IPV6,		"Prefix IPv6"			},
   { MTYPE_HASH,			"Hash"				},
-  { MTYPE_HASH_BACKET,		"Hash Bucket"			},
   { MTYPE_HASH_INDEX,		"Hash Index"			},
   { MTYPE_ROUTE_TABLE,		"Route table"			},
-  { MTYPE_ROUTE_NODE,		"Route node"			},
+  { MTYPE_ROUTE_NODE,		"Route node",		MEMORY_SLAB	},
+  { MTYPE_ROUTE_TABLE_INDEX,	"Route table index"		},
   { MTYPE_DISTRIBUTE,		"Distribute list"		},
   { MTYPE_DISTRIBUTE_IFNAME,	"Dist-list ifname"		},
   { MTYPE_ACCESS_LIST,		"Access List"			},
@@ -55,6 +61,7 @@ struct memory_list memory_list_lib[] =
   { MTYPE_ROUTE_MAP_RULE,	"Route map rule"		},
   { MTYPE_ROUTE_MAP_RULE_STR,	"Route map rule str"		},
   { MTYPE_ROUTE_MAP_COMPILED,	"Route map compiled"		},
+  { MTYPE_ROUTE_MAP_CACHE,	"Route map rule cache"		},
   { MTYPE_DESC,			"Command desc"			},
   { MTYPE_KEY,			"Key"				},
   { MTYPE_KEYCHAIN,		"Key chain"			},
@@ -78,9 +85,11 @@ struct memory_list memory_list_zebra[] =
   { MTYPE_RTADV_PREFIX,		"Router Advertisement Prefix"	},
   { MTYPE_VRF,			"VRF"				},
   { MTYPE_VRF_NAME,		"VRF name"			},
-  { MTYPE_NEXTHOP,		"Nexthop"			},
-  { MTYPE_RIB,			"RIB"				},
-  { MTYPE_RIB_QUEUE,		"RIB process work queue"	},
+  { MTYPE_NEXTHOP,		"Nexthop",		MEMORY_SLAB	},
+  { MTYPE_RIB,			"RIB",			MEMORY_SLAB	},
+  { MTYPE_RIB_QUEUE,		"RIB queue entry",	MEMORY_SLAB	},
+  { MTYPE_FIB_UPDATE,		"FIB update"			},
+  { MTYPE_RNH,			"Registered nexthop"		},
   { MTYPE_STATIC_IPV4,		"Static IPv4 route"		},
   { MTYPE_STATIC_IPV6,		"Static IPv6 route"		},
   { -1, NULL },
@@ -95,7 +104,7 @@ struct memory_list memory_list_bgp[] =
   { MTYPE_PEER_GROUP,		"Peer group"			},
   { MTYPE_PEER_DESC,		"Peer description"		},
   { MTYPE_PEER_PASSWORD,	"Peer password string"		},
-  { MTYPE_ATTR,			"BGP attribute"			},
+  { MTYPE_ATTR,			"BGP attribute",	MEMORY_SLAB	},
   { MTYPE_ATTR_EXTRA,		"BGP extra attributes"		},
   { MTYPE_AS_PATH,		"BGP aspath"			},
   { MTYPE_AS_SEG,		"BGP aspath seg"		},
@@ -103,20 +112,23 @@ struct memory_list memory_list_bgp[] =
   { MTYPE_AS_STR,		"BGP aspath str"		},
   { 0, NULL },
   { MTYPE_BGP_TABLE,		"BGP table"			},
-  { MTYPE_BGP_NODE,		"BGP node"			},
-  { MTYPE_BGP_ROUTE,		"BGP route"			},
+  { MTYPE_BGP_NODE,		"BGP node",		MEMORY_SLAB	},
+  { MTYPE_BGP_ROUTE,		"BGP route",		MEMORY_SLAB	},
   { MTYPE_BGP_ROUTE_EXTRA,	"BGP ancillary route info"	},
   { MTYPE_BGP_CONN,		"BGP connected"			},
   { MTYPE_BGP_STATIC,		"BGP static"			},
   { MTYPE_BGP_ADVERTISE_ATTR,	"BGP adv attr"			},
-  { MTYPE_BGP_ADVERTISE,	"BGP adv"			},
+  { MTYPE_BGP_ADVERTISE,	"BGP adv",		MEMORY_SLAB	},
   { MTYPE_BGP_SYNCHRONISE,	"BGP synchronise"		},
-  { MTYPE_BGP_ADJ_IN,		"BGP adj in"			},
-  { MTYPE_BGP_ADJ_OUT,		"BGP adj out"			},
+  { MTYPE_BGP_ADJ_IN,		"BGP adj in",		MEMORY_SLAB	},
+  { MTYPE_BGP_ADJ_OUT,		"BGP adj out",		MEMORY_SLAB	},
+  { MTYPE_BGP_ADJ_INDEX,	"BGP adj index"			},
+  { MTYPE_BGP_UPDGRP,		"BGP update group"		},
   { 0, NULL },
   { MTYPE_AS_LIST,		"BGP AS list"			},
   { MTYPE_AS_FILTER,		"BGP AS filter"			},
   { MTYPE_AS_FILTER_STR,	"BGP AS filter str"		},
+  { MTYPE_AS_LIST_MEMO,		"BGP AS list results"		},
   { 0, NULL },
   { MTYPE_COMMUNITY,		"community"			},
   { MTYPE_COMMUNITY_VAL,	"community val"			},
@@ -131,6 +143,7 @@ struct memory_list memory_list_bgp[] =
   { MTYPE_COMMUNITY_LIST_ENTRY,	"community-list entry"		},
   { MTYPE_COMMUNITY_LIST_CONFIG,  "community-list config"	},
   { MTYPE_COMMUNITY_LIST_HANDLER, "community-list handler"	},
+  { MTYPE_COMMUNITY_LIST_VALUE,	"community-list value"		},
   { 0, NULL },
   { MTYPE_CLUSTER,		"Cluster list"			},
   { MTYPE_CLUSTER_VAL,		"Cluster list val"		},
@@ -185,7 +198,7 @@ struct memory_list memory_list_ospf[] =
   { MTYPE_OSPF_NEIGHBOR,      "OSPF neighbor"			},
   { MTYPE_OSPF_ROUTE,         "OSPF route"			},
   { MTYPE_OSPF_TMP,           "OSPF tmp mem"			},
-  { MTYPE_OSPF_LSA,           "OSPF LSA"			},
+  { MTYPE_OSPF_LSA,           "OSPF LSA",		MEMORY_SLAB	},
   { MTYPE_OSPF_LSA_DATA,      "OSPF LSA data"			},
   { MTYPE_OSPF_LSDB,          "OSPF LSDB"			},
   { MTYPE_OSPF_PACKET,        "OSPF packet"			},
@@ -29,6 +29,7 @@
 #include "buffer.h"
 #include "stream.h"
 #include "log.h"
+#include "table.h"
 
 /* Each prefix-list's entry. */
 struct prefix_list_entry
@@ -48,8 +49,14 @@ struct prefix_list_entry
 
   struct prefix_list_entry *next;
   struct prefix_list_entry *prev;
+
+  /* Next entry with the same prefix in the trie, by sequence number. */
+  struct prefix_list_entry *trie_next;
 };
 
+/* The trie for a prefix family. */
+#define PREFIX_LIST_TRIE(P, F)	((P)->trie[(F) == AF_INET6])
+
 /* List of struct prefix_list. */
 struct prefix_list_list
 {
@@ -301,6 +308,11 @@ prefix_list_delete (struct prefix_list *plist)
       plist->count--;
     }
 
+  if (plist->trie[0])
+    route_table_finish (plist->trie[0]);
+  if (plist->trie[1])
+    route_table_finish (plist->trie[1]);
+
   master = plist->master;
 
   if (plist->type == PREFIX_TYPE_NUMBER)
@@ -384,11 +396,9 @@ prefix_new_seq_get (struct prefix_list *plist)
 
   maxseq = newseq = 0;
 
-  for (pentry = plist->head; pentry; pentry = pentry->next)
-    {
-      if (maxseq < pentry->seq)
-	maxseq = pentry->seq;
-    }
+  /* Entries are sorted by sequence number. */
+  if ((pentry = plist->tail) != NULL)
+    maxseq = pentry->seq;
 
   newseq = ((maxseq / 5) * 5) + 5;
   
@@ -401,19 +411,97 @@ prefix_seq_check (struct prefix_list *plist, int seq)
 {
   struct prefix_list_entry *pentry;
 
+  if (! plist->tail || plist->tail->seq < seq)
+    return NULL;
+
   for (pentry = plist->head; pentry; pentry = pentry->next)
     if (pentry->seq == seq)
       return pentry;
   return NULL;
 }
 
+/* The trie node holding entries for the prefix, or NULL.  Takes a
+   lock on the node. */
+static struct route_node *
+prefix_list_trie_lookup (struct prefix_list *plist, struct prefix *prefix)
+{
+  struct route_table *table;
+  struct prefix p;
+
+  table = PREFIX_LIST_TRIE (plist, prefix->family);
+  if (! table)
+    return NULL;
+
+  prefix_copy (&p, prefix);
+  apply_mask (&p);
+  return route_node_lookup (table, &p);
+}
+
+static void
+prefix_list_trie_add (struct prefix_list *plist,
+		      struct prefix_list_entry *pentry)
+{
+  struct route_table **table;
+  struct route_node *rn;
+  struct prefix_list_entry **pp;
+  struct prefix p;
+
+  table = &PREFIX_LIST_TRIE (plist, pentry->prefix.family);
+  if (! *table)
+    *table = route_table_init ();
+
+  prefix_copy (&p, &pentry->prefix);
+  apply_mask (&p);
+  rn = route_node_get (*table, &p);
+
+  /* The node keeps one lock while it has entries. */
+  if (rn->info)
+    route_unlock_node (rn);
+
+  for (pp = (struct prefix_list_entry **) &rn->info;
+       *pp && (*pp)->seq < pentry->seq; pp = &(*pp)->trie_next)
+    ;
+  pentry->trie_next = *pp;
+  *pp = pentry;
+}
+
+static void
+prefix_list_trie_delete (struct prefix_list *plist,
+			 struct prefix_list_entry *pentry)
+{
+  struct route_node *rn;
+  struct prefix_list_entry **pp;
+
+  rn = prefix_list_trie_lookup (plist, &pentry->prefix);
+  if (! rn)
+    return;
+
+  for (pp = (struct prefix_list_entry **) &rn->info; *pp;
+       pp = &(*pp)->trie_next)
+    if (*pp == pentry)
+      {
+	*pp = pentry->trie_next;
+	break;
+      }
+
+  route_unlock_node (rn);
+  if (! rn->info)
+    route_unlock_node (rn);
+}
+
 static struct prefix_list_entry *
 prefix_list_entry_lookup (struct prefix_list *plist, struct prefix *prefix,
 			  enum prefix_list_type type, int seq, int le, int ge)
 {
   struct prefix_list_entry *pentry;
+  struct route_node *rn;
 
-  for (pentry = plist->head; pentry; pentry = pentry->next)
+  rn = prefix_list_trie_lookup (plist, prefix);
+  if (! rn)
+    return NULL;
+  route_unlock_node (rn);
+
+  for (pentry = rn->info; pentry; pentry = pentry->trie_next)
     if (prefix_same (&pentry->prefix, prefix) && pentry->type == type)
       {
 	if (seq >= 0 && pentry->seq != seq)
@@ -446,6 +534,7 @@ prefix_list_entry_delete (struct prefix_list *plist,
   else
     plist->tail = pentry->prev;
 
+  prefix_list_trie_delete (plist, pentry);
   prefix_list_entry_free (pentry);
 
   plist->count--;
@@ -478,10 +567,13 @@ prefix_list_entry_add (struct prefix_list *plist,
   if (replace)
     prefix_list_entry_delete (plist, replace, 0);
 
-  /* Check insert point. */
-  for (point = plist->head; point; point = point->next)
-    if (point->seq >= pentry->seq)
-      break;
+  /* Check insert point.  Entries are mostly added in order. */
+  if (plist->tail && plist->tail->seq < pentry->seq)
+    point = NULL;
+  else
+    for (point = plist->head; point; point = point->next)
+      if (point->seq >= pentry->seq)
+	break;
 
   /* In case of this is the first element of the list. */
   pentry->next = point;
@@ -507,6 +599,8 @@ prefix_list_entry_add (struct prefix_list *plist,
       plist->tail = pentry;
     }
 
+  prefix_list_trie_add (plist, pentry);
+
   /* Increment count. */
   plist->count++;
 
@@ -560,10 +654,16 @@ prefix_list_entry_match (struct prefix_list_entry *pentry, struct prefix *p)
   return 1;
 }
 
+/* Only entries whose prefix covers p can match it, and those are on
+   the path from the top of the trie down to p.  Of the entries which
+   match, the one with the lowest sequence number applies. */
 enum prefix_list_type
 prefix_list_apply (struct prefix_list *plist, void *object)
 {
   struct prefix_list_entry *pentry;
+  struct prefix_list_entry *best = NULL;
+  struct route_table *table;
+  struct route_node *rn;
   struct prefix *p;
 
   p = (struct prefix *) object;
@@ -574,16 +674,33 @@ prefix_list_apply (struct prefix_list *plist, void *object)
   if (plist->count == 0)
     return PREFIX_PERMIT;
 
-  for (pentry = plist->head; pentry; pentry = pentry->next)
+  table = PREFIX_LIST_TRIE (plist, p->family);
+  rn = table ? table->top : NULL;
+
+  while (rn && rn->p.prefixlen <= p->prefixlen && prefix_match (&rn->p, p))
     {
-      pentry->refcnt++;
-      if (prefix_list_entry_match (pentry, p))
+      for (pentry = rn->info; pentry; pentry = pentry->trie_next)
 	{
-	  pentry->hitcnt++;
-	  return pentry->type;
+	  if (best && pentry->seq > best->seq)
+	    break;
+	  pentry->refcnt++;
+	  if (prefix_list_entry_match (pentry, p))
+	    {
+	      best = pentry;
+	      break;
+	    }
 	}
+
+      if (rn->p.prefixlen == p->prefixlen)
+	break;
+      rn = rn->link[prefix_bit (&p->u.prefix, rn->p.prefixlen)];
     }
 
+  if (best)
+    {
+      best->hitcnt++;
+      return best->type;
+    }
   return PREFIX_DENY;
 }
 
@@ -628,6 +745,7 @@ prefix_entry_dup_check (struct prefix_list *plist,
 			struct prefix_list_entry *new)
 {
   struct prefix_list_entry *pentry;
+  struct route_node *rn;
   int seq = 0;
 
   if (new->seq == -1)
@@ -635,7 +753,13 @@ prefix_entry_dup_check (struct prefix_list *plist,
   else
     seq = new->seq;
 
-  for (pentry = plist->head; pentry; pentry = pentry->next)
+  /* Only entries with the same prefix can be duplicates. */
+  rn = prefix_list_trie_lookup (plist, &new->prefix);
+  if (! rn)
+    return NULL;
+  route_unlock_node (rn);
+
+  for (pentry = rn->info; pentry; pentry = pentry->trie_next)
     {
       if (prefix_same (&pentry->prefix, &new->prefix)
 	  && pentry->type == new->type
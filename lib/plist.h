@@ -52,6 +52,9 @@ struct prefix_list
   struct prefix_list_entry *head;
   struct prefix_list_entry *tail;
 
+  /* Entries by prefix, for IPv4 and IPv6. */
+  struct route_table *trie[2];
+
   struct prefix_list *next;
   struct prefix_list *prev;
 };
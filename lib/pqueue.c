@@ -168,3 +168,38 @@ pqueue_dequeue (struct pqueue *queue)
   trickle_down (0, queue);
   return data;
 }
+
+/* Remove the node at 'index' from the heap.  The caller is expected to
+   track the position of its nodes through the update() hook, which
+   makes this O(log n) rather than needing a search of the array.  */
+void
+pqueue_remove_at (int index, struct pqueue *queue)
+{
+  /* Removing the last node needs no reordering.  */
+  if (index == --queue->size)
+    return;
+
+  queue->array[index] = queue->array[queue->size];
+
+  if (index > 0
+      && (*queue->cmp) (queue->array[index],
+                        queue->array[PARENT_OF (index)]) < 0)
+    trickle_up (index, queue);
+  else
+    trickle_down (index, queue);
+}
+
+/* Restore the heap order after the key of the node at 'index' changed,
+   eg to lower the distance of a candidate in a shortest path search.
+   Like pqueue_remove_at(), this relies on the update() hook for the
+   index.  */
+void
+pqueue_update (int index, struct pqueue *queue)
+{
+  if (index > 0
+      && (*queue->cmp) (queue->array[index],
+                        queue->array[PARENT_OF (index)]) < 0)
+    trickle_up (index, queue);
+  else
+    trickle_down (index, queue);
+}
@@ -47,11 +47,26 @@ struct route_map_rule
   /* Pre-compiled match rule. */
   void *value;
 
+  /* Results by cache key, see func_cache_key. */
+  struct route_map_rule_cache *cache;
+  unsigned int cache_gen;
+
   /* Linked list. */
   struct route_map_rule *next;
   struct route_map_rule *prev;
 };
 
+#define ROUTE_MAP_RULE_CACHE_SIZE	256
+
+struct route_map_rule_cache
+{
+  unsigned long key;
+  route_map_result_t result;
+};
+
+/* Rule caches made before the last route_map_cache_flush () are stale. */
+static unsigned int route_map_cache_gen;
+
 /* Making route map list. */
 struct route_map_list
 {
@@ -158,6 +173,40 @@ route_map_lookup_by_name (const char *name)
   return NULL;
 }
 
+static int
+route_map_rule_list_has (struct route_map_rule_list *list, const char *cmd,
+                         const char *rule_str)
+{
+  struct route_map_rule *rule;
+
+  for (rule = list->head; rule; rule = rule->next)
+    if (strcmp (rule->cmd->str, cmd) == 0
+        && (rule_str == NULL
+            || (rule->rule_str && strcmp (rule->rule_str, rule_str) == 0)))
+      return 1;
+  return 0;
+}
+
+/* Does the named route map have a match or set rule for the command,
+   with the given argument if one is given?  Route maps which call
+   others are assumed to.  */
+int
+route_map_has_rule (const char *name, const char *cmd, const char *rule_str)
+{
+  struct route_map *map;
+  struct route_map_index *index;
+
+  if ((map = route_map_lookup_by_name (name)) == NULL)
+    return 0;
+
+  for (index = map->head; index; index = index->next)
+    if (index->nextrm
+        || route_map_rule_list_has (&index->match_list, cmd, rule_str)
+        || route_map_rule_list_has (&index->set_list, cmd, rule_str))
+      return 1;
+  return 0;
+}
+
 /* Lookup route map.  If there isn't route map create one and return
    it. */
 static struct route_map *
@@ -246,6 +295,11 @@ vty_show_route_map_entry (struct vty *vty, struct route_map *map)
       else if (index->exitpolicy == RMAP_EXIT)
         vty_out (vty, "    Exit routemap%s", VTY_NEWLINE);
     }
+
+  if (map->cache_lookups)
+    vty_out (vty, "route-map %s, match cache: %lu lookups, %lu hits (%lu%%)%s",
+             map->name, map->cache_lookups, map->cache_hits,
+             map->cache_hits * 100 / map->cache_lookups, VTY_NEWLINE);
 }
 
 static int
@@ -488,6 +542,9 @@ route_map_rule_delete (struct route_map_rule_list *list,
   if (rule->rule_str)
     XFREE (MTYPE_ROUTE_MAP_RULE_STR, rule->rule_str);
 
+  if (rule->cache)
+    XFREE (MTYPE_ROUTE_MAP_CACHE, rule->cache);
+
   if (rule->next)
     rule->next->prev = rule->prev;
   else
@@ -739,8 +796,45 @@ route_map_delete_set (struct route_map_index *index, const char *set_name,
    We need to make sure our route-map processing matches the above
 */
 
+/* Apply a match rule, or find its result for the object in the rule's
+   cache if it has one. */
+static route_map_result_t
+route_map_apply_rule (struct route_map *map, struct route_map_rule *match,
+                      struct prefix *prefix, route_map_object_t type,
+                      void *object)
+{
+  struct route_map_rule_cache *entry;
+  unsigned long key;
+
+  if (! match->cmd->func_cache_key
+      || ! (key = (*match->cmd->func_cache_key) (type, object)))
+    return (*match->cmd->func_apply) (match->value, prefix, type, object);
+
+  if (! match->cache)
+    match->cache = XCALLOC (MTYPE_ROUTE_MAP_CACHE, ROUTE_MAP_RULE_CACHE_SIZE
+                            * sizeof (struct route_map_rule_cache));
+  else if (match->cache_gen != route_map_cache_gen)
+    memset (match->cache, 0, ROUTE_MAP_RULE_CACHE_SIZE
+                             * sizeof (struct route_map_rule_cache));
+  match->cache_gen = route_map_cache_gen;
+
+  map->cache_lookups++;
+  entry = &match->cache[key & (ROUTE_MAP_RULE_CACHE_SIZE - 1)];
+  if (entry->key == key)
+    {
+      map->cache_hits++;
+      return entry->result;
+    }
+
+  entry->key = key;
+  entry->result = (*match->cmd->func_apply) (match->value, prefix,
+                                             type, object);
+  return entry->result;
+}
+
 static route_map_result_t
-route_map_apply_match (struct route_map_rule_list *match_list,
+route_map_apply_match (struct route_map *map,
+                       struct route_map_rule_list *match_list,
                        struct prefix *prefix, route_map_object_t type,
                        void *object)
 {
@@ -760,8 +854,7 @@ route_map_apply_match (struct route_map_rule_list *match_list,
              RMAP_MATCH, return, otherwise continue on to next match 
              statement. All match statements must match for end-result
              to be a match. */
-          ret = (*match->cmd->func_apply) (match->value, prefix,
-                                           type, object);
+          ret = route_map_apply_rule (map, match, prefix, type, object);
           if (ret != RMAP_MATCH)
             return ret;
         }
@@ -794,7 +887,8 @@ route_map_apply (struct route_map *map, struct prefix *prefix,
   for (index = map->head; index; index = index->next)
     {
       /* Apply this index. */
-      ret = route_map_apply_match (&index->match_list, prefix, type, object);
+      ret = route_map_apply_match (map, &index->match_list, prefix,
+                                   type, object);
 
       /* Now we apply the matrix from above */
       if (ret == RMAP_NOMATCH)
@@ -882,6 +976,12 @@ route_map_event_hook (void (*func) (route_map_event_t, const char *))
   route_map_master.event_hook = func;
 }
 
+void
+route_map_cache_flush (void)
+{
+  route_map_cache_gen++;
+}
+
 void
 route_map_init (void)
 {
@@ -86,6 +86,13 @@ struct route_map_rule_cmd
 
   /* Free allocated value by func_compile (). */
   void (*func_free)(void *);
+
+  /* Optional, for match rules whose result depends only on a part of
+     the object that is shared and never changes, e.g. an interned BGP
+     AS path.  Returns a number identifying that part, or 0 if there
+     is none, and the result is then remembered for the number until
+     route_map_cache_flush (). */
+  unsigned long (*func_cache_key)(route_map_object_t, void *);
 };
 
 /* Route map apply error. */
@@ -148,6 +155,10 @@ struct route_map
   /* Make linked list. */
   struct route_map *next;
   struct route_map *prev;
+
+  /* Match rule results looked up, and found, in their caches. */
+  unsigned long cache_lookups;
+  unsigned long cache_hits;
 };
 
 /* Prototypes. */
@@ -184,6 +195,10 @@ extern void route_map_install_set (struct route_map_rule_cmd *cmd);
 /* Lookup route map by name. */
 extern struct route_map * route_map_lookup_by_name (const char *name);
 
+/* Does the route map use the given match or set rule? */
+extern int route_map_has_rule (const char *name, const char *cmd,
+                               const char *rule_str);
+
 /* Apply route map to the object. */
 extern route_map_result_t route_map_apply (struct route_map *map,
                                            struct prefix *,
@@ -194,4 +209,7 @@ extern void route_map_add_hook (void (*func) (const char *));
 extern void route_map_delete_hook (void (*func) (const char *));
 extern void route_map_event_hook (void (*func) (route_map_event_t, const char *));
 
+/* Something match rules depend on, e.g. a filter list, has changed. */
+extern void route_map_cache_flush (void);
+
 #endif /* _ZEBRA_ROUTEMAP_H */
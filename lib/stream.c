@@ -85,6 +85,28 @@
       } \
   } while (0);
 
+/* STREAM_POOL_BUFSIZ buffers, those of every received and sent BGP
+ * message, come from their own slab allocated type rather than a
+ * malloc and a free of each.
+ */
+static u_char *
+stream_data_new (size_t size)
+{
+  if (size == STREAM_POOL_BUFSIZ)
+    return XMALLOC (MTYPE_STREAM_POOL, size);
+
+  return XMALLOC (MTYPE_STREAM_DATA, size);
+}
+
+static void
+stream_data_free (u_char *data, size_t size)
+{
+  if (size == STREAM_POOL_BUFSIZ)
+    XFREE (MTYPE_STREAM_POOL, data);
+  else
+    XFREE (MTYPE_STREAM_DATA, data);
+}
+
 /* Make stream buffer. */
 struct stream *
 stream_new (size_t size)
@@ -104,7 +126,7 @@ stream_new (size_t size)
   if (s == NULL)
     return s;
   
-  if ( (s->data = XMALLOC (MTYPE_STREAM_DATA, size)) == NULL)
+  if ( (s->data = stream_data_new (size)) == NULL)
     {
       XFREE (MTYPE_STREAM, s);
       return NULL;
@@ -121,7 +143,10 @@ stream_free (struct stream *s)
   if (!s)
     return;
   
-  XFREE (MTYPE_STREAM_DATA, s->data);
+  if (s->own)
+    stream_data_free (s->own, s->ownsize);
+  else
+    stream_data_free (s->data, s->size);
   XFREE (MTYPE_STREAM, s);
 }
 
@@ -159,8 +184,17 @@ stream_resize (struct stream *s, size_t newsize)
 {
   u_char *newdata;
   STREAM_VERIFY_SANE (s);
+  assert (s->own == NULL);
   
-  newdata = XREALLOC (MTYPE_STREAM_DATA, s->data, newsize);
+  /* Slab objects can't be reallocated, copy in and out of those. */
+  if (s->size == STREAM_POOL_BUFSIZ || newsize == STREAM_POOL_BUFSIZ)
+    {
+      newdata = stream_data_new (newsize);
+      memcpy (newdata, s->data, MIN (s->size, newsize));
+      stream_data_free (s->data, s->size);
+    }
+  else
+    newdata = XREALLOC (MTYPE_STREAM_DATA, s->data, newsize);
   
   if (newdata == NULL)
     return s->size;
@@ -178,6 +212,41 @@ stream_resize (struct stream *s, size_t newsize)
   return s->size;
 }
 
+void
+stream_view (struct stream *s, struct stream *src, size_t size)
+{
+  STREAM_VERIFY_SANE (src);
+
+  if (STREAM_READABLE (src) < size)
+    {
+      STREAM_BOUND_WARN (src, "view");
+      size = STREAM_READABLE (src);
+    }
+
+  if (s->own == NULL)
+    {
+      s->own = s->data;
+      s->ownsize = s->size;
+    }
+
+  s->data = src->data + src->getp;
+  s->size = s->endp = size;
+  s->getp = 0;
+  src->getp += size;
+}
+
+void
+stream_unview (struct stream *s)
+{
+  if (s->own == NULL)
+    return;
+
+  s->data = s->own;
+  s->size = s->ownsize;
+  s->own = NULL;
+  s->getp = s->endp = 0;
+}
+
 size_t
 stream_get_getp (struct stream *s)
 {
@@ -882,6 +951,22 @@ stream_reset (struct stream *s)
   s->getp = s->endp = 0;
 }
 
+/* Move the data not yet read to the start of the stream, to make room
+   for more at the end. */
+void
+stream_pulldown (struct stream *s)
+{
+  size_t len;
+
+  STREAM_VERIFY_SANE (s);
+
+  len = s->endp - s->getp;
+  if (s->getp && len)
+    memmove (s->data, s->data + s->getp, len);
+  s->getp = 0;
+  s->endp = len;
+}
+
 /* Write stream contens to the file discriptor. */
 int
 stream_flush (struct stream *s, int fd)
@@ -104,6 +104,10 @@ struct stream
   size_t endp;		/* last valid data position */
   size_t size;		/* size of data segment */
   unsigned char *data; /* data pointer */
+
+  /* The stream's own buffer, set aside while it is a view */
+  unsigned char *own;
+  size_t ownsize;
 };
 
 /* First in first out queue structure. */
@@ -115,6 +119,12 @@ struct stream_fifo
   struct stream *tail;
 };
 
+/* Buffers of this size, that of the largest BGP message and used by
+ * most protocols for one packet, are slab allocated as
+ * MTYPE_STREAM_POOL, see "show memory" for how many are in use.
+ */
+#define STREAM_POOL_BUFSIZ	4096
+
 /* Utility macros. */
 #define STREAM_SIZE(S)  ((S)->size)
   /* number of bytes which can still be written */
@@ -140,6 +150,14 @@ extern void stream_free (struct stream *);
 extern struct stream * stream_copy (struct stream *, struct stream *src);
 extern struct stream *stream_dup (struct stream *);
 extern size_t stream_resize (struct stream *, size_t);
+
+/* Make the stream a view of the next size bytes to be read from src,
+ * without copying them, and move src's getp past them.  The view reads
+ * them as if they were all it held.  stream_unview gives the stream its
+ * own buffer back, empty.
+ */
+extern void stream_view (struct stream *, struct stream *src, size_t);
+extern void stream_unview (struct stream *);
 extern size_t stream_get_getp (struct stream *);
 extern size_t stream_get_endp (struct stream *);
 extern size_t stream_get_size (struct stream *);
@@ -204,6 +222,8 @@ extern size_t stream_write (struct stream *, const void *, size_t);
 
 /* reset the stream. See Note above */
 extern void stream_reset (struct stream *);
+/* move unread data to the start, making room behind it */
+extern void stream_pulldown (struct stream *);
 extern int stream_flush (struct stream *, int);
 extern int stream_empty (struct stream *); /* is the stream empty? */
 
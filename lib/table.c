@@ -45,12 +45,116 @@ route_table_finish (struct route_table *rt)
   route_table_free (rt);
 }
 
+/* Index slot of a prefix: its first ROUTE_TABLE_INDEX_BITS bits. */
+static unsigned int
+route_index_slot (const struct prefix *p)
+{
+  const u_char *pnt = &p->u.prefix;
+
+  return (pnt[0] << 8) | pnt[1];
+}
+
+/* Point the index slots covered by a new node at it, where it is
+   deeper than what they had. */
+static void
+route_index_add (struct route_table *table, struct route_node *node)
+{
+  unsigned int slot;
+  unsigned int n;
+
+  if (node->p.family != table->index_family
+      || node->p.prefixlen > ROUTE_TABLE_INDEX_BITS)
+    return;
+
+  n = 1 << (ROUTE_TABLE_INDEX_BITS - node->p.prefixlen);
+  slot = route_index_slot (&node->p) & ~(n - 1);
+
+  for (; n; n--, slot++)
+    if (table->index[slot] == NULL
+	|| table->index[slot]->p.prefixlen < node->p.prefixlen)
+      table->index[slot] = node;
+}
+
+/* A node is going from the tree, point its index slots at its
+   parent. */
+static void
+route_index_del (struct route_table *table, struct route_node *node,
+		 struct route_node *parent)
+{
+  unsigned int slot;
+  unsigned int n;
+
+  if (node->p.family != table->index_family
+      || node->p.prefixlen > ROUTE_TABLE_INDEX_BITS)
+    return;
+
+  n = 1 << (ROUTE_TABLE_INDEX_BITS - node->p.prefixlen);
+  slot = route_index_slot (&node->p) & ~(n - 1);
+
+  for (; n; n--, slot++)
+    if (table->index[slot] == node)
+      table->index[slot] = parent;
+}
+
+/* Build the index of a table which has grown large. */
+static void
+route_index_build (struct route_table *table, u_char family)
+{
+  struct route_node *node;
+  struct route_node *next;
+
+  table->index = XCALLOC (MTYPE_ROUTE_TABLE_INDEX,
+			  sizeof (struct route_node *)
+			  << ROUTE_TABLE_INDEX_BITS);
+  table->index_family = family;
+
+  /* Nodes of at most ROUTE_TABLE_INDEX_BITS are all near the top. */
+  for (node = table->top; node; node = next)
+    {
+      route_index_add (table, node);
+
+      if (node->l_left && node->p.prefixlen < ROUTE_TABLE_INDEX_BITS)
+	next = node->l_left;
+      else if (node->l_right && node->p.prefixlen < ROUTE_TABLE_INDEX_BITS)
+	next = node->l_right;
+      else
+	{
+	  next = NULL;
+	  while (node->parent)
+	    {
+	      if (node->parent->l_left == node && node->parent->l_right)
+		{
+		  next = node->parent->l_right;
+		  break;
+		}
+	      node = node->parent;
+	    }
+	}
+    }
+}
+
+/* Where to start looking for a prefix. */
+static struct route_node *
+route_index_start (const struct route_table *table, const struct prefix *p)
+{
+  struct route_node *node;
+
+  if (table->index && p->family == table->index_family
+      && p->prefixlen >= ROUTE_TABLE_INDEX_BITS
+      && (node = table->index[route_index_slot (p)]) != NULL)
+    return node;
+
+  return table->top;
+}
+
 /* Allocate new route node. */
 static struct route_node *
-route_node_new (void)
+route_node_new (struct route_table *table)
 {
   struct route_node *node;
   node = XCALLOC (MTYPE_ROUTE_NODE, sizeof (struct route_node));
+  node->table = table;
+  table->count++;
   return node;
 }
 
@@ -60,10 +164,9 @@ route_node_set (struct route_table *table, struct prefix *prefix)
 {
   struct route_node *node;
   
-  node = route_node_new ();
+  node = route_node_new (table);
 
   prefix_copy (&node->p, prefix);
-  node->table = table;
 
   return node;
 }
@@ -72,6 +175,7 @@ route_node_set (struct route_table *table, struct prefix *prefix)
 static void
 route_node_free (struct route_node *node)
 {
+  node->table->count--;
   XFREE (MTYPE_ROUTE_NODE, node);
 }
 
@@ -120,6 +224,8 @@ route_table_free (struct route_table *rt)
 	}
     }
  
+  if (rt->index)
+    XFREE (MTYPE_ROUTE_TABLE_INDEX, rt->index);
   XFREE (MTYPE_ROUTE_TABLE, rt);
   return;
 }
@@ -197,10 +303,11 @@ struct route_node *
 route_node_match (const struct route_table *table, const struct prefix *p)
 {
   struct route_node *node;
+  struct route_node *start;
   struct route_node *matched;
 
   matched = NULL;
-  node = table->top;
+  start = node = route_index_start (table, p);
 
   /* Walk down tree.  If there is matched route then store it to
      matched. */
@@ -216,6 +323,15 @@ route_node_match (const struct route_table *table, const struct prefix *p)
       node = node->link[prefix_bit(&p->u.prefix, node->p.prefixlen)];
     }
 
+  /* Started part way down, the match may be above. */
+  if (! matched && start)
+    for (node = start->parent; node; node = node->parent)
+      if (node->info)
+	{
+	  matched = node;
+	  break;
+	}
+
   /* If matched route found, return it. */
   if (matched)
     return route_lock_node (matched);
@@ -259,7 +375,7 @@ route_node_lookup (struct route_table *table, struct prefix *p)
 {
   struct route_node *node;
 
-  node = table->top;
+  node = route_index_start (table, p);
 
   while (node && node->p.prefixlen <= p->prefixlen && 
 	 prefix_match (&node->p, p))
@@ -281,8 +397,8 @@ route_node_get (struct route_table *table, struct prefix *p)
   struct route_node *node;
   struct route_node *match;
 
-  match = NULL;
-  node = table->top;
+  node = route_index_start (table, p);
+  match = node ? node->parent : NULL;
   while (node && node->p.prefixlen <= p->prefixlen && 
 	 prefix_match (&node->p, p))
     {
@@ -303,10 +419,9 @@ route_node_get (struct route_table *table, struct prefix *p)
     }
   else
     {
-      new = route_node_new ();
+      new = route_node_new (table);
       route_common (&node->p, p, &new->p);
       new->p.family = p->family;
-      new->table = table;
       set_link (new, node);
 
       if (match)
@@ -314,6 +429,9 @@ route_node_get (struct route_table *table, struct prefix *p)
       else
 	table->top = new;
 
+      if (table->index)
+	route_index_add (table, new);
+
       if (new->p.prefixlen != p->prefixlen)
 	{
 	  match = new;
@@ -321,6 +439,12 @@ route_node_get (struct route_table *table, struct prefix *p)
 	  set_link (match, new);
 	}
     }
+
+  if (table->index)
+    route_index_add (table, new);
+  else if (table->count >= ROUTE_TABLE_INDEX_MIN)
+    route_index_build (table, p->family);
+
   route_lock_node (new);
   
   return new;
@@ -359,6 +483,9 @@ route_node_delete (struct route_node *node)
   else
     node->table->top = child;
 
+  if (node->table->index)
+    route_index_del (node->table, node, parent);
+
   route_node_free (node);
 
   /* If parent node is stub then delete it also. */
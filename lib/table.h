@@ -27,8 +27,21 @@
 struct route_table
 {
   struct route_node *top;
+
+  /* Number of nodes. */
+  unsigned long count;
+
+  /* Once there are many nodes, the deepest node of at most
+     ROUTE_TABLE_INDEX_BITS covering each value of the first
+     ROUTE_TABLE_INDEX_BITS bits, for one address family.  Lookups
+     start from there rather than from the top of the tree.  */
+  struct route_node **index;
+  u_char index_family;
 };
 
+#define ROUTE_TABLE_INDEX_BITS	16
+#define ROUTE_TABLE_INDEX_MIN	4096
+
 /* Each routing entry. */
 struct route_node
 {
@@ -29,6 +29,7 @@
 #include "hash.h"
 #include "command.h"
 #include "sigevent.h"
+#include "pqueue.h"
 
 /* Recent absolute time of day */
 struct timeval recent_time;
@@ -41,6 +42,9 @@ static unsigned short timers_inited;
 
 static struct hash *cpu_record = NULL;
 
+/* Maximum number of ready fds to be fetched by one epoll_wait() */
+#define THREAD_EPOLL_EVENTS 256
+
 /* Struct timeval's tv_usec one second value.  */
 #define TIMER_SECOND_MICRO 1000000L
 
@@ -209,6 +213,18 @@ quagga_time (time_t *t)
   return tv.tv_sec;
 }
 
+/* Microseconds since START, a time from quagga_gettime
+ * (QUAGGA_CLK_MONOTONIC).
+ */
+unsigned long
+quagga_elapsed (const struct timeval *start)
+{
+  struct timeval now;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  return timeval_elapsed (now, *start);
+}
+
 /* Public export of recent_relative_time by value */
 struct timeval
 recent_relative_time (void)
@@ -483,29 +499,75 @@ thread_master_debug (struct thread_master *m)
   thread_list_debug (&m->read);
   printf ("writelist : ");
   thread_list_debug (&m->write);
-  printf ("timerlist : ");
-  thread_list_debug (&m->timer);
+  printf ("timerqueue: size [%d]\n", m->timer->size);
   printf ("eventlist : ");
   thread_list_debug (&m->event);
   printf ("unuselist : ");
   thread_list_debug (&m->unuse);
-  printf ("bgndlist : ");
-  thread_list_debug (&m->background);
+  printf ("bgndqueue : size [%d]\n", m->background->size);
   printf ("total alloc: [%ld]\n", m->alloc);
   printf ("-----------\n");
 }
 
+/* Timer queue ordering: earliest expiry at the top of the heap. */
+static int
+thread_timer_cmp (void *a, void *b)
+{
+  struct thread *thread_a = a;
+  struct thread *thread_b = b;
+
+  return timeval_cmp (thread_a->u.sands, thread_b->u.sands);
+}
+
+/* Keep track of where each timer sits in the heap, so that it can be
+ * cancelled without searching the queue.
+ */
+static void
+thread_timer_update (void *node, int actual_position)
+{
+  struct thread *thread = node;
+
+  thread->index = actual_position;
+}
+
 /* Allocate new thread master.  */
 struct thread_master *
 thread_master_create ()
 {
+  struct thread_master *rv;
+
   if (cpu_record == NULL) 
-    cpu_record 
-      = hash_create_size (1011, (unsigned int (*) (void *))cpu_record_hash_key, 
-                          (int (*) (const void *, const void *))cpu_record_hash_cmp);
+    {
+      cpu_record 
+        = hash_create_size (1011, (unsigned int (*) (void *))cpu_record_hash_key, 
+                            (int (*) (const void *, const void *))cpu_record_hash_cmp);
+      cpu_record->name = "Thread CPU records";
+    }
     
-  return (struct thread_master *) XCALLOC (MTYPE_THREAD_MASTER,
-					   sizeof (struct thread_master));
+  rv = XCALLOC (MTYPE_THREAD_MASTER, sizeof (struct thread_master));
+
+  /* Timers are kept in binary heaps, giving O(log n) insert and cancel,
+   * rather than the sorted lists they used to be kept on.
+   */
+  rv->timer = pqueue_create ();
+  rv->background = pqueue_create ();
+  rv->timer->cmp = rv->background->cmp = thread_timer_cmp;
+  rv->timer->update = rv->background->update = thread_timer_update;
+
+#ifdef HAVE_EPOLL
+  /* Fall back to select() if the kernel does not support epoll. */
+  if ((rv->epoll_fd = epoll_create (THREAD_EPOLL_EVENTS)) < 0)
+    zlog_warn ("epoll_create failed, falling back to select(): %s",
+               safe_strerror (errno));
+  else
+    {
+      fcntl (rv->epoll_fd, F_SETFD, FD_CLOEXEC);
+      rv->events = XCALLOC (MTYPE_THREAD_FD, THREAD_EPOLL_EVENTS
+                                             * sizeof (struct epoll_event));
+    }
+#endif /* HAVE_EPOLL */
+
+  return rv;
 }
 
 /* Add a new thread to the list.  */
@@ -522,22 +584,6 @@ thread_list_add (struct thread_list *list, struct thread *thread)
   list->count++;
 }
 
-/* Add a new thread just before the point.  */
-static void
-thread_list_add_before (struct thread_list *list, 
-			struct thread *point, 
-			struct thread *thread)
-{
-  thread->next = point;
-  thread->prev = point->prev;
-  if (point->prev)
-    point->prev->next = thread;
-  else
-    list->head = thread;
-  point->prev = thread;
-  list->count++;
-}
-
 /* Delete a thread from the list. */
 static struct thread *
 thread_list_delete (struct thread_list *list, struct thread *thread)
@@ -585,17 +631,50 @@ thread_list_free (struct thread_master *m, struct thread_list *list)
     }
 }
 
+/* Free all threads on a timer queue, and the queue itself. */
+static void
+thread_queue_free (struct thread_master *m, struct pqueue *queue)
+{
+  int i;
+
+  for (i = 0; i < queue->size; i++)
+    {
+      struct thread *t = queue->array[i];
+
+      if (t->funcname)
+        XFREE (MTYPE_THREAD_FUNCNAME, t->funcname);
+      XFREE (MTYPE_THREAD, t);
+      m->alloc--;
+    }
+
+  pqueue_delete (queue);
+}
+
 /* Stop thread scheduler. */
 void
 thread_master_free (struct thread_master *m)
 {
   thread_list_free (m, &m->read);
   thread_list_free (m, &m->write);
-  thread_list_free (m, &m->timer);
+  thread_queue_free (m, m->timer);
   thread_list_free (m, &m->event);
   thread_list_free (m, &m->ready);
   thread_list_free (m, &m->unuse);
-  thread_list_free (m, &m->background);
+  thread_queue_free (m, m->background);
+
+#ifdef HAVE_EPOLL
+  if (m->epoll_fd >= 0)
+    {
+      close (m->epoll_fd);
+      XFREE (MTYPE_THREAD_FD, m->events);
+    }
+  if (m->fd_read)
+    XFREE (MTYPE_THREAD_FD, m->fd_read);
+  if (m->fd_write)
+    XFREE (MTYPE_THREAD_FD, m->fd_write);
+  if (m->fd_added)
+    XFREE (MTYPE_THREAD_FD, m->fd_added);
+#endif /* HAVE_EPOLL */
   
   XFREE (MTYPE_THREAD_MASTER, m);
 
@@ -685,12 +764,137 @@ thread_get (struct thread_master *m, u_char type,
   thread->master = m;
   thread->func = func;
   thread->arg = arg;
+  thread->index = -1;
   
   thread->funcname = strip_funcname(funcname);
 
   return thread;
 }
 
+#ifdef HAVE_EPOLL
+/* Make sure the per-fd thread tables can be indexed by fd. */
+static void
+thread_fd_grow (struct thread_master *m, int fd)
+{
+  int size = m->fd_size ? m->fd_size : FD_SETSIZE;
+
+  while (size <= fd)
+    size *= 2;
+
+  if (size == m->fd_size)
+    return;
+
+  m->fd_read = XREALLOC (MTYPE_THREAD_FD, m->fd_read,
+                         size * sizeof (struct thread *));
+  m->fd_write = XREALLOC (MTYPE_THREAD_FD, m->fd_write,
+                          size * sizeof (struct thread *));
+  m->fd_added = XREALLOC (MTYPE_THREAD_FD, m->fd_added, size);
+  memset (m->fd_read + m->fd_size, 0,
+          (size - m->fd_size) * sizeof (struct thread *));
+  memset (m->fd_write + m->fd_size, 0,
+          (size - m->fd_size) * sizeof (struct thread *));
+  memset (m->fd_added + m->fd_size, 0, size - m->fd_size);
+  m->fd_size = size;
+}
+
+/* Arm fd in the epoll set for the threads now waiting on it.
+ *
+ * fds are registered with EPOLLONESHOT, so the kernel disarms an fd
+ * once it has been reported, and it stays in the set until it's closed.
+ * Rescheduling a read or write after it fired then costs one
+ * EPOLL_CTL_MOD, and cancelling one costs nothing: an fd nobody waits
+ * on any more is reported at most once more, and ignored.
+ */
+static void
+thread_epoll_arm (struct thread_master *m, int fd)
+{
+  struct epoll_event ev;
+  int op;
+
+  memset (&ev, 0, sizeof (ev));
+  ev.data.fd = fd;
+  ev.events = EPOLLONESHOT;
+  if (m->fd_read[fd])
+    ev.events |= EPOLLIN;
+  if (m->fd_write[fd])
+    ev.events |= EPOLLOUT;
+
+  op = m->fd_added[fd] ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+  m->fd_added[fd] = 1;
+
+  if (epoll_ctl (m->epoll_fd, op, fd, &ev) == 0)
+    return;
+
+  /* Closing an fd drops it from the epoll set, and it may since have
+   * been reused.
+   */
+  if (op == EPOLL_CTL_MOD && errno == ENOENT
+      && epoll_ctl (m->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0)
+    return;
+  if (op == EPOLL_CTL_ADD && errno == EEXIST
+      && epoll_ctl (m->epoll_fd, EPOLL_CTL_MOD, fd, &ev) == 0)
+    return;
+
+  m->fd_added[fd] = 0;
+  zlog_warn ("epoll_ctl (%d) failed for fd %d: %s",
+             op, fd, safe_strerror (errno));
+}
+#endif /* HAVE_EPOLL */
+
+/* Is a thread of the given type already waiting on fd? */
+static int
+thread_fd_isset (struct thread_master *m, int type, int fd)
+{
+#ifdef HAVE_EPOLL
+  if (m->epoll_fd >= 0)
+    {
+      if (fd >= m->fd_size)
+        return 0;
+      return (type == THREAD_READ ? m->fd_read[fd] : m->fd_write[fd]) != NULL;
+    }
+#endif /* HAVE_EPOLL */
+  return FD_ISSET (fd, type == THREAD_READ ? &m->readfd : &m->writefd);
+}
+
+/* Start waiting on the fd of a read or write thread. */
+static void
+thread_fd_set (struct thread_master *m, struct thread *thread)
+{
+  int fd = THREAD_FD (thread);
+
+#ifdef HAVE_EPOLL
+  if (m->epoll_fd >= 0)
+    {
+      thread_fd_grow (m, fd);
+      if (thread->type == THREAD_READ)
+        m->fd_read[fd] = thread;
+      else
+        m->fd_write[fd] = thread;
+      thread_epoll_arm (m, fd);
+      return;
+    }
+#endif /* HAVE_EPOLL */
+  FD_SET (fd, thread->type == THREAD_READ ? &m->readfd : &m->writefd);
+}
+
+/* Stop waiting on the fd of a read or write thread. */
+static void
+thread_fd_clr (struct thread_master *m, int type, int fd)
+{
+#ifdef HAVE_EPOLL
+  if (m->epoll_fd >= 0)
+    {
+      /* Left armed, see thread_epoll_arm. */
+      if (type == THREAD_READ)
+        m->fd_read[fd] = NULL;
+      else
+        m->fd_write[fd] = NULL;
+      return;
+    }
+#endif /* HAVE_EPOLL */
+  FD_CLR (fd, type == THREAD_READ ? &m->readfd : &m->writefd);
+}
+
 /* Add new read thread. */
 struct thread *
 funcname_thread_add_read (struct thread_master *m, 
@@ -700,15 +904,15 @@ funcname_thread_add_read (struct thread_master *m,
 
   assert (m != NULL);
 
-  if (FD_ISSET (fd, &m->readfd))
+  if (thread_fd_isset (m, THREAD_READ, fd))
     {
       zlog (NULL, LOG_WARNING, "There is already read fd [%d]", fd);
       return NULL;
     }
 
   thread = thread_get (m, THREAD_READ, func, arg, funcname);
-  FD_SET (fd, &m->readfd);
   thread->u.fd = fd;
+  thread_fd_set (m, thread);
   thread_list_add (&m->read, thread);
 
   return thread;
@@ -723,15 +927,15 @@ funcname_thread_add_write (struct thread_master *m,
 
   assert (m != NULL);
 
-  if (FD_ISSET (fd, &m->writefd))
+  if (thread_fd_isset (m, THREAD_WRITE, fd))
     {
       zlog (NULL, LOG_WARNING, "There is already write fd [%d]", fd);
       return NULL;
     }
 
   thread = thread_get (m, THREAD_WRITE, func, arg, funcname);
-  FD_SET (fd, &m->writefd);
   thread->u.fd = fd;
+  thread_fd_set (m, thread);
   thread_list_add (&m->write, thread);
 
   return thread;
@@ -746,16 +950,15 @@ funcname_thread_add_timer_timeval (struct thread_master *m,
                                   const char* funcname)
 {
   struct thread *thread;
-  struct thread_list *list;
+  struct pqueue *queue;
   struct timeval alarm_time;
-  struct thread *tt;
 
   assert (m != NULL);
 
   assert (type == THREAD_TIMER || type == THREAD_BACKGROUND);
   assert (time_relative);
   
-  list = ((type == THREAD_TIMER) ? &m->timer : &m->background);
+  queue = ((type == THREAD_TIMER) ? m->timer : m->background);
   thread = thread_get (m, type, func, arg, funcname);
 
   /* Do we need jitter here? */
@@ -764,15 +967,7 @@ funcname_thread_add_timer_timeval (struct thread_master *m,
   alarm_time.tv_usec = relative_time.tv_usec + time_relative->tv_usec;
   thread->u.sands = timeval_adjust(alarm_time);
 
-  /* Sort by timeval. */
-  for (tt = list->head; tt; tt = tt->next)
-    if (timeval_cmp (thread->u.sands, tt->u.sands) <= 0)
-      break;
-
-  if (tt)
-    thread_list_add_before (list, tt, thread);
-  else
-    thread_list_add (list, thread);
+  pqueue_enqueue (thread, queue);
 
   return thread;
 }
@@ -858,22 +1053,23 @@ funcname_thread_add_event (struct thread_master *m,
 void
 thread_cancel (struct thread *thread)
 {
-  struct thread_list *list;
+  struct thread_list *list = NULL;
+  struct pqueue *queue = NULL;
   
   switch (thread->type)
     {
     case THREAD_READ:
-      assert (FD_ISSET (thread->u.fd, &thread->master->readfd));
-      FD_CLR (thread->u.fd, &thread->master->readfd);
+      assert (thread_fd_isset (thread->master, THREAD_READ, thread->u.fd));
+      thread_fd_clr (thread->master, THREAD_READ, thread->u.fd);
       list = &thread->master->read;
       break;
     case THREAD_WRITE:
-      assert (FD_ISSET (thread->u.fd, &thread->master->writefd));
-      FD_CLR (thread->u.fd, &thread->master->writefd);
+      assert (thread_fd_isset (thread->master, THREAD_WRITE, thread->u.fd));
+      thread_fd_clr (thread->master, THREAD_WRITE, thread->u.fd);
       list = &thread->master->write;
       break;
     case THREAD_TIMER:
-      list = &thread->master->timer;
+      queue = thread->master->timer;
       break;
     case THREAD_EVENT:
       list = &thread->master->event;
@@ -882,13 +1078,22 @@ thread_cancel (struct thread *thread)
       list = &thread->master->ready;
       break;
     case THREAD_BACKGROUND:
-      list = &thread->master->background;
+      queue = thread->master->background;
       break;
     default:
       return;
       break;
     }
-  thread_list_delete (list, thread);
+
+  if (queue)
+    {
+      assert (thread->index >= 0);
+      assert (thread == queue->array[thread->index]);
+      pqueue_remove_at (thread->index, queue);
+      thread->index = -1;
+    }
+  else
+    thread_list_delete (list, thread);
   thread->type = THREAD_UNUSED;
   thread_add_unuse (thread->master, thread);
 }
@@ -920,11 +1125,12 @@ thread_cancel_event (struct thread_master *m, void *arg)
 }
 
 static struct timeval *
-thread_timer_wait (struct thread_list *tlist, struct timeval *timer_val)
+thread_timer_wait (struct pqueue *queue, struct timeval *timer_val)
 {
-  if (!thread_empty (tlist))
+  if (queue->size)
     {
-      *timer_val = timeval_subtract (tlist->head->u.sands, relative_time);
+      struct thread *next_timer = queue->array[0];
+      *timer_val = timeval_subtract (next_timer->u.sands, relative_time);
       return timer_val;
     }
   return NULL;
@@ -967,18 +1173,90 @@ thread_process_fd (struct thread_list *list, fd_set *fdset, fd_set *mfdset)
   return ready;
 }
 
+#ifdef HAVE_EPOLL
+/* Move the threads for the fds epoll_wait() reported to the ready list.
+ * Only ready fds are visited, unlike the select() path which has to scan
+ * every read and write thread.  Reads are queued ahead of writes, as
+ * they would be with select().  A reported fd is disarmed, so it is
+ * armed again for whichever thread on it is still waiting.
+ */
+static int
+thread_process_epoll (struct thread_master *m, int num)
+{
+  struct thread *thread;
+  int i, fd, ready = 0;
+
+  for (i = 0; i < num; i++)
+    {
+      fd = m->events[i].data.fd;
+      if (fd < m->fd_size && (thread = m->fd_read[fd]) != NULL
+          && (m->events[i].events & (EPOLLIN|EPOLLHUP|EPOLLERR)))
+        {
+          thread_fd_clr (m, THREAD_READ, fd);
+          thread_list_delete (&m->read, thread);
+          thread_list_add (&m->ready, thread);
+          thread->type = THREAD_READY;
+          ready++;
+        }
+    }
+
+  for (i = 0; i < num; i++)
+    {
+      fd = m->events[i].data.fd;
+      if (fd < m->fd_size && (thread = m->fd_write[fd]) != NULL
+          && (m->events[i].events & (EPOLLOUT|EPOLLHUP|EPOLLERR)))
+        {
+          thread_fd_clr (m, THREAD_WRITE, fd);
+          thread_list_delete (&m->write, thread);
+          thread_list_add (&m->ready, thread);
+          thread->type = THREAD_READY;
+          ready++;
+        }
+    }
+
+  for (i = 0; i < num; i++)
+    {
+      fd = m->events[i].data.fd;
+      if (fd < m->fd_size && (m->fd_read[fd] || m->fd_write[fd]))
+        thread_epoll_arm (m, fd);
+    }
+  return ready;
+}
+
+/* epoll equivalent of the select() call in thread_fetch */
+static int
+thread_epoll_wait (struct thread_master *m, struct timeval *timer_wait)
+{
+  int timeout = -1;
+
+  /* Round up, so as not to spin until a sub-millisecond timer pops. */
+  if (timer_wait)
+    {
+      if (timer_wait->tv_sec >= INT_MAX / 1000 - 1)
+        timeout = INT_MAX;
+      else
+        timeout = timer_wait->tv_sec * 1000
+                  + (timer_wait->tv_usec + 999) / 1000;
+    }
+
+  return epoll_wait (m->epoll_fd, m->events, THREAD_EPOLL_EVENTS, timeout);
+}
+#endif /* HAVE_EPOLL */
+
 /* Add all timers that have popped to the ready list. */
 static unsigned int
-thread_timer_process (struct thread_list *list, struct timeval *timenow)
+thread_timer_process (struct pqueue *queue, struct timeval *timenow)
 {
   struct thread *thread;
   unsigned int ready = 0;
   
-  for (thread = list->head; thread; thread = thread->next)
+  while (queue->size)
     {
+      thread = queue->array[0];
       if (timeval_cmp (*timenow, thread->u.sands) < 0)
         return ready;
-      thread_list_delete (list, thread);
+      pqueue_dequeue (queue);
+      thread->index = -1;
       thread->type = THREAD_READY;
       thread_list_add (&thread->master->ready, thread);
       ready++;
@@ -1038,31 +1316,42 @@ thread_fetch (struct thread_master *m, struct thread *fetch)
       /* Normal event are the next highest priority.  */
       thread_process (&m->event);
       
-      /* Structure copy.  */
-      readfd = m->readfd;
-      writefd = m->writefd;
-      exceptfd = m->exceptfd;
-      
       /* Calculate select wait timer if nothing else to do */
       if (m->ready.count == 0)
         {
           quagga_get_relative (NULL);
-          timer_wait = thread_timer_wait (&m->timer, &timer_val);
-          timer_wait_bg = thread_timer_wait (&m->background, &timer_val_bg);
+          timer_wait = thread_timer_wait (m->timer, &timer_val);
+          timer_wait_bg = thread_timer_wait (m->background, &timer_val_bg);
           
           if (timer_wait_bg &&
               (!timer_wait || (timeval_cmp (*timer_wait, *timer_wait_bg) > 0)))
             timer_wait = timer_wait_bg;
         }
       
-      num = select (FD_SETSIZE, &readfd, &writefd, &exceptfd, timer_wait);
+#ifdef HAVE_EPOLL
+      if (m->epoll_fd >= 0)
+        num = thread_epoll_wait (m, timer_wait);
+      else
+#endif /* HAVE_EPOLL */
+        {
+          /* Structure copy.  */
+          readfd = m->readfd;
+          writefd = m->writefd;
+          exceptfd = m->exceptfd;
+      
+          num = select (FD_SETSIZE, &readfd, &writefd, &exceptfd, timer_wait);
+        }
       
       /* Signals should get quick treatment */
       if (num < 0)
         {
           if (errno == EINTR)
             continue; /* signal received - process it */
-          zlog_warn ("select() error: %s", safe_strerror (errno));
+          zlog_warn ("%s error: %s",
+#ifdef HAVE_EPOLL
+                     m->epoll_fd >= 0 ? "epoll_wait()" :
+#endif /* HAVE_EPOLL */
+                     "select()", safe_strerror (errno));
             return NULL;
         }
 
@@ -1070,15 +1359,22 @@ thread_fetch (struct thread_master *m, struct thread *fetch)
          priority than I/O threads, so let's push them onto the ready
 	 list in front of the I/O threads. */
       quagga_get_relative (NULL);
-      thread_timer_process (&m->timer, &relative_time);
+      thread_timer_process (m->timer, &relative_time);
       
       /* Got IO, process it */
       if (num > 0)
         {
-          /* Normal priority read thead. */
-          thread_process_fd (&m->read, &readfd, &m->readfd);
-          /* Write thead. */
-          thread_process_fd (&m->write, &writefd, &m->writefd);
+#ifdef HAVE_EPOLL
+          if (m->epoll_fd >= 0)
+            thread_process_epoll (m, num);
+          else
+#endif /* HAVE_EPOLL */
+            {
+              /* Normal priority read thead. */
+              thread_process_fd (&m->read, &readfd, &m->readfd);
+              /* Write thead. */
+              thread_process_fd (&m->write, &writefd, &m->writefd);
+            }
         }
 
 #if 0
@@ -1091,7 +1387,7 @@ thread_fetch (struct thread_master *m, struct thread *fetch)
 #endif
 
       /* Background timer/events, lowest priority */
-      thread_timer_process (&m->background, &relative_time);
+      thread_timer_process (m->background, &relative_time);
       
       if ((thread = thread_trim_head (&m->ready)) != NULL)
         return thread_run (m, thread, fetch);
@@ -41,19 +41,29 @@ struct thread_list
   int count;
 };
 
+struct pqueue;
+
 /* Master of the theads. */
 struct thread_master
 {
   struct thread_list read;
   struct thread_list write;
-  struct thread_list timer;
+  struct pqueue *timer;
   struct thread_list event;
   struct thread_list ready;
   struct thread_list unuse;
-  struct thread_list background;
+  struct pqueue *background;
   fd_set readfd;
   fd_set writefd;
   fd_set exceptfd;
+#ifdef HAVE_EPOLL
+  int epoll_fd;			/* -1 if unavailable, select() is used */
+  struct thread **fd_read;	/* read thread for each fd */
+  struct thread **fd_write;	/* write thread for each fd */
+  unsigned char *fd_added;	/* whether each fd is in the epoll set */
+  int fd_size;			/* size of the fd_read/fd_write arrays */
+  struct epoll_event *events;
+#endif /* HAVE_EPOLL */
   unsigned long alloc;
 };
 
@@ -77,6 +87,7 @@ struct thread
   RUSAGE_T ru;			/* Indepth usage info.  */
   struct cpu_thread_history *hist; /* cache pointer to cpu_history */
   char* funcname;
+  int index;			/* position in timer queue, or -1 */
 };
 
 struct cpu_thread_history 
@@ -205,6 +216,7 @@ extern struct cmd_element clear_thread_cpu_cmd;
  */
 extern int quagga_gettime (enum quagga_clkid, struct timeval *);
 extern time_t quagga_time (time_t *);
+extern unsigned long quagga_elapsed (const struct timeval *);
 
 /* Returns elapsed real (wall clock) time. */
 extern unsigned long thread_consumed_time(RUSAGE_T *after, RUSAGE_T *before,
@@ -55,11 +55,30 @@ zclient_new ()
 
   zclient->ibuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
   zclient->obuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  zclient->batch = stream_new (ZEBRA_MAX_PACKET_SIZ);
   zclient->wb = buffer_new(0);
 
   return zclient;
 }
 
+/* Write out the routes still batched, such as the withdrawals made on
+   the way out, rather than drop them with the client.  Unlike
+   zclient_batch_flush, a failure is not acted on here. */
+static void
+zclient_batch_drain (struct zclient *zclient)
+{
+  struct stream *s = zclient->batch;
+
+  THREAD_OFF(zclient->t_batch);
+  if (zclient->sock < 0 || ! s || stream_empty (s))
+    return;
+
+  stream_putw_at (s, 0, stream_get_endp (s));
+  buffer_write (zclient->wb, zclient->sock, STREAM_DATA(s),
+		stream_get_endp (s));
+  stream_reset (s);
+}
+
 /* This function is only called when exiting, because
    many parts of the code do not check for I/O errors, so they could
    reference an invalid pointer if the structure was ever freed.
@@ -68,10 +87,14 @@ zclient_new ()
 void
 zclient_free (struct zclient *zclient)
 {
+  zclient_batch_drain (zclient);
+
   if (zclient->ibuf)
     stream_free(zclient->ibuf);
   if (zclient->obuf)
     stream_free(zclient->obuf);
+  if (zclient->batch)
+    stream_free(zclient->batch);
   if (zclient->wb)
     buffer_free(zclient->wb);
 
@@ -117,6 +140,8 @@ zclient_stop (struct zclient *zclient)
   if (zclient_debug)
     zlog_debug ("zclient stopped");
 
+  zclient_batch_drain (zclient);
+
   /* Stop threads. */
   THREAD_OFF(zclient->t_read);
   THREAD_OFF(zclient->t_connect);
@@ -125,6 +150,7 @@ zclient_stop (struct zclient *zclient)
   /* Reset streams. */
   stream_reset(zclient->ibuf);
   stream_reset(zclient->obuf);
+  stream_reset(zclient->batch);
 
   /* Empty the write buffer. */
   buffer_reset(zclient->wb);
@@ -268,13 +294,11 @@ zclient_flush_data(struct thread *thread)
   return 0;
 }
 
-int
-zclient_send_message(struct zclient *zclient)
+static int
+zclient_write (struct zclient *zclient, struct stream *s)
 {
-  if (zclient->sock < 0)
-    return -1;
-  switch (buffer_write(zclient->wb, zclient->sock, STREAM_DATA(zclient->obuf),
-		       stream_get_endp(zclient->obuf)))
+  switch (buffer_write(zclient->wb, zclient->sock, STREAM_DATA(s),
+		       stream_get_endp(s)))
     {
     case BUFFER_ERROR:
       zlog_warn("%s: buffer_write failed to zclient fd %d, closing",
@@ -292,6 +316,77 @@ zclient_send_message(struct zclient *zclient)
   return 0;
 }
 
+/* Send the routes gathered so far. */
+static int
+zclient_batch_flush (struct zclient *zclient)
+{
+  struct stream *s = zclient->batch;
+  int ret;
+
+  THREAD_OFF(zclient->t_batch);
+  if (stream_empty (s))
+    return 0;
+
+  stream_putw_at (s, 0, stream_get_endp (s));
+  ret = zclient_write (zclient, s);
+  stream_reset (s);
+  return ret;
+}
+
+static int
+zclient_batch_timer (struct thread *thread)
+{
+  struct zclient *zclient = THREAD_ARG(thread);
+
+  zclient->t_batch = NULL;
+  if (zclient->sock < 0)
+    return -1;
+  return zclient_batch_flush (zclient);
+}
+
+/* Add the route message in zclient->obuf to the batch, which is sent
+   once the current thread is done, or before any other message.  A
+   full table then goes to zebra in messages of up to
+   ZEBRA_MAX_PACKET_SIZ rather than in one message per route. */
+static int
+zclient_batch_message (struct zclient *zclient)
+{
+  struct stream *s = zclient->batch;
+  uint16_t command;
+  size_t len;
+
+  if (zclient->sock < 0)
+    return -1;
+
+  command = stream_getw_from (zclient->obuf, 4);
+  len = stream_get_endp (zclient->obuf) - ZEBRA_HEADER_SIZE;
+
+  if (! stream_empty (s)
+      && (stream_getw_from (s, 4) != command || STREAM_WRITEABLE (s) < len))
+    if (zclient_batch_flush (zclient) < 0)
+      return -1;
+
+  if (stream_empty (s))
+    zclient_create_header (s, command);
+  stream_put (s, STREAM_DATA(zclient->obuf) + ZEBRA_HEADER_SIZE, len);
+
+  if (! zclient->t_batch)
+    zclient->t_batch = thread_add_event (master, zclient_batch_timer,
+					 zclient, 0);
+  return 0;
+}
+
+int
+zclient_send_message(struct zclient *zclient)
+{
+  if (zclient->sock < 0)
+    return -1;
+  /* Keep the order messages were made in. */
+  if (zclient_batch_flush (zclient) < 0)
+    return -1;
+  return zclient_write (zclient, zclient->obuf);
+}
+
 void
 zclient_create_header (struct stream *s, uint16_t command)
 {
@@ -395,6 +490,9 @@ zclient_start (struct zclient *zclient)
   if (zclient->default_information)
     zebra_message_send (zclient, ZEBRA_REDISTRIBUTE_DEFAULT_ADD);
 
+  if (zclient->zebra_connected)
+    (*zclient->zebra_connected) (zclient);
+
   return 0;
 }
 
@@ -515,7 +613,7 @@ zapi_ipv4_route (u_char cmd, struct zclient *zclient, struct prefix_ipv4 *p,
   /* Put length at the first point of the stream. */
   stream_putw_at (s, 0, stream_get_endp (s));
 
-  return zclient_send_message(zclient);
+  return zclient_batch_message(zclient);
 }
 
 #ifdef HAVE_IPV6
@@ -568,7 +666,7 @@ zapi_ipv6_route (u_char cmd, struct zclient *zclient, struct prefix_ipv6 *p,
   /* Put length at the first point of the stream. */
   stream_putw_at (s, 0, stream_get_endp (s));
 
-  return zclient_send_message(zclient);
+  return zclient_batch_message(zclient);
 }
 #endif /* HAVE_IPV6 */
 
@@ -594,6 +692,28 @@ zebra_redistribute_send (int command, struct zclient *zclient, int type)
   return zclient_send_message(zclient);
 }
 
+/*
+ * send a ZEBRA_NEXTHOP_REGISTER or ZEBRA_NEXTHOP_UNREGISTER for a host
+ * address.  Once registered, zebra sends a ZEBRA_NEXTHOP_UPDATE with
+ * the route resolving the address whenever that changes.
+ */
+int
+zebra_nexthop_send (int command, struct zclient *zclient, struct prefix *p)
+{
+  struct stream *s;
+
+  s = zclient->obuf;
+  stream_reset (s);
+
+  zclient_create_header (s, command);
+  stream_putc (s, p->family);
+  stream_put (s, &p->u.prefix, PSIZE (p->prefixlen));
+
+  stream_putw_at (s, 0, stream_get_endp (s));
+
+  return zclient_send_message(zclient);
+}
+
 /* Router-id update from zebra daemon. */
 void
 zebra_router_id_update_read (struct stream *s, struct prefix *rid)
@@ -973,6 +1093,10 @@ zclient_read (struct thread *thread)
       if (zclient->ipv6_route_delete)
 	(*zclient->ipv6_route_delete) (command, zclient, length);
       break;
+    case ZEBRA_NEXTHOP_UPDATE:
+      if (zclient->nexthop_update)
+	(*zclient->nexthop_update) (command, zclient, length);
+      break;
     default:
       break;
     }
@@ -25,8 +25,9 @@
 /* For struct interface and struct connected. */
 #include "if.h"
 
-/* For input/output buffer to zebra. */
-#define ZEBRA_MAX_PACKET_SIZ          4096
+/* For input/output buffer to zebra.  The most a message can be, given
+   its 16 bit length. */
+#define ZEBRA_MAX_PACKET_SIZ          65535
 
 /* Zebra header size. */
 #define ZEBRA_HEADER_SIZE             6
@@ -53,6 +54,11 @@ struct zclient
   /* Buffer of data waiting to be written to zebra. */
   struct buffer *wb;
 
+  /* Route messages not yet sent, gathered in one message of the same
+     command, and the event that sends them. */
+  struct stream *batch;
+  struct thread *t_batch;
+
   /* Read and connect thread. */
   struct thread *t_read;
   struct thread *t_connect;
@@ -79,6 +85,11 @@ struct zclient
   int (*ipv4_route_delete) (int, struct zclient *, uint16_t);
   int (*ipv6_route_add) (int, struct zclient *, uint16_t);
   int (*ipv6_route_delete) (int, struct zclient *, uint16_t);
+  int (*nexthop_update) (int, struct zclient *, uint16_t);
+
+  /* Called once the connection to zebra is up, to resend state zebra
+     keeps per client. */
+  void (*zebra_connected) (struct zclient *);
 };
 
 /* Zebra API message flag. */
@@ -133,6 +144,9 @@ extern void zclient_serv_path_set  (char *path);
 /* Send redistribute command to zebra daemon. Do not update zclient state. */
 extern int zebra_redistribute_send (int command, struct zclient *, int type);
 
+/* Send a nexthop (un)register command for one address to zebra. */
+extern int zebra_nexthop_send (int command, struct zclient *, struct prefix *);
+
 /* If state has changed, update state and call zebra_redistribute_send. */
 extern void zclient_redistribute (int command, struct zclient *, int type);
 
@@ -54,6 +54,9 @@ typedef int socklen_t;
 #ifdef HAVE_SYS_SELECT_H
 #include <sys/select.h>
 #endif /* HAVE_SYS_SELECT_H */
+#ifdef HAVE_EPOLL
+#include <sys/epoll.h>
+#endif /* HAVE_EPOLL */
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/param.h>
@@ -418,7 +421,10 @@ struct in_pktinfo
 #define ZEBRA_ROUTER_ID_DELETE            21
 #define ZEBRA_ROUTER_ID_UPDATE            22
 #define ZEBRA_HELLO                       23
-#define ZEBRA_MESSAGE_MAX                 24
+#define ZEBRA_NEXTHOP_REGISTER            24
+#define ZEBRA_NEXTHOP_UNREGISTER          25
+#define ZEBRA_NEXTHOP_UPDATE              26
+#define ZEBRA_MESSAGE_MAX                 27
 
 /* Marker value used in new Zserv, in the byte location corresponding
  * the command value in the old zserv header. To allow old and new
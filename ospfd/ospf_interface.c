@@ -328,6 +328,9 @@ ospf_if_free (struct ospf_interface *oi)
   listnode_delete (oi->ospf->oiflist, oi);
   listnode_delete (oi->area->oiflist, oi);
 
+  /* Nexthops in the kept shortest-path tree may point to it. */
+  ospf_spf_tree_free (oi->area);
+
   thread_cancel_event (master, oi);
 
   memset (oi, 0, sizeof (*oi));
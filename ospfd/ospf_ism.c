@@ -577,6 +577,9 @@ ism_change_state (struct ospf_interface *oi, int state)
   else if (old_state == ISM_Down)
     oi->area->act_ints++;
 
+  /* Nexthops in the kept shortest-path tree may use this interface. */
+  oi->area->spf_changed = 1;
+
   /* schedule router-LSA originate. */
   ospf_router_lsa_update_area (oi->area);
 
@@ -2389,8 +2389,16 @@ ospf_router_lsa_install (struct ospf *ospf, struct ospf_lsa *new,
 
       ospf_refresher_register_lsa (ospf, new);
     }
-  if (rt_recalc)
-    ospf_spf_calculate_schedule (ospf);
+
+  /* The shortest-path trees of other areas depend on this one only
+     through summary-LSAs, and a new instance which changes only stub
+     links leaves even this area's tree as it is. */
+  if (rt_recalc == OSPF_SPF_PARTIAL)
+    ospf_spf_schedule_partial (ospf);
+  else if (rt_recalc == OSPF_SPF_INCREMENTAL)
+    ospf_spf_schedule_router (area);
+  else if (rt_recalc)
+    ospf_spf_schedule_area (area);
 
   return new;
 }
@@ -2425,7 +2433,7 @@ ospf_network_lsa_install (struct ospf *ospf,
       ospf_refresher_register_lsa (ospf, new);
     }
   if (rt_recalc)
-    ospf_spf_calculate_schedule (ospf);
+    ospf_spf_schedule_area (new->area);
 
   return new;
 }
@@ -2448,7 +2456,7 @@ ospf_summary_lsa_install (struct ospf *ospf, struct ospf_lsa *new,
       /* This doesn't exist yet... */
       ospf_summary_incremental_update(new); */
 #else /* #if 0 */
-      ospf_spf_calculate_schedule (ospf);
+      ospf_spf_schedule_partial (ospf);
 #endif /* #if 0 */
  
       if (IS_DEBUG_OSPF (lsa, LSA_INSTALL))
@@ -2481,7 +2489,7 @@ ospf_summary_asbr_lsa_install (struct ospf *ospf, struct ospf_lsa *new,
 	 - RFC 2328 Section 16.5 implies it should be */
       /* ospf_ase_calculate_schedule(); */
 #else  /* #if 0 */
-      ospf_spf_calculate_schedule (ospf);
+      ospf_spf_schedule_partial (ospf);
 #endif /* #if 0 */
     }
 
@@ -2645,7 +2653,24 @@ ospf_lsa_install (struct ospf *ospf, struct ospf_interface *oi,
   /* Do comparision and record if recalc needed. */
   rt_recalc = 0;
   if (  old == NULL || ospf_lsa_different(old, lsa))
-    rt_recalc = 1;
+    rt_recalc = OSPF_SPF_FULL;
+
+  /* A router-LSA which only changed its stub links needs no new
+     shortest-path tree, just routes calculated from the one kept.  One
+     which changed its other links may only need its vertex, or those
+     of its neighbours, attached to that tree anew. */
+  if (rt_recalc && lsa->data->type == OSPF_ROUTER_LSA
+      && ! IS_LSA_MAXAGE (lsa))
+    {
+      if (old && ! IS_LSA_MAXAGE (old)
+          && ! ospf_router_lsa_topo_different (old, lsa))
+        rt_recalc = OSPF_SPF_PARTIAL;
+      else
+        {
+          rt_recalc = OSPF_SPF_INCREMENTAL;
+          ospf_spf_router_changed (old, lsa);
+        }
+    }
 
   /*
      Sequence number check (Section 14.1 of rfc 2328)
@@ -2952,8 +2977,12 @@ ospf_lsa_maxage_walker_remover (struct ospf *ospf, struct ospf_lsa *lsa)
           case OSPF_AS_NSSA_LSA:
 	    ospf_ase_incremental_update (ospf, lsa);
             break;
+          case OSPF_SUMMARY_LSA:
+          case OSPF_ASBR_SUMMARY_LSA:
+	    ospf_spf_schedule_partial (ospf);
+            break;
           default:
-	    ospf_spf_calculate_schedule (ospf);
+	    ospf_spf_schedule_area (lsa->area);
             break;
           }
 	ospf_lsa_maxage (ospf, lsa);
@@ -47,11 +47,20 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "ospfd/ospf_dump.h"
 
 static void ospf_vertex_free (void *);
-/* List of allocated vertices, to simplify cleanup of SPF.
- * Not thread-safe obviously. If it ever needs to be, it'd have to be
- * dynamically allocated at begin of ospf_spf_calculate
+/* List of vertices allocated for the tree being calculated, which the
+ * area keeps until the tree is freed, see ospf_spf_tree_free.
+ * Not thread-safe obviously.
  */
-static struct list vertex_list = { .del = ospf_vertex_free };
+static struct list *vertex_list;
+
+const struct message ospf_spf_type_msg[] =
+{
+  { 0,                    "none" },
+  { OSPF_SPF_PARTIAL,     "partial" },
+  { OSPF_SPF_INCREMENTAL, "incremental" },
+  { OSPF_SPF_FULL,        "full" },
+};
+const int ospf_spf_type_msg_max = OSPF_SPF_FULL + 1;
 
 /* Heap related functions, for the managment of the candidates, to
  * be used with pqueue. */
@@ -171,12 +180,13 @@ ospf_vertex_new (struct ospf_lsa *lsa)
   new->stat = &(lsa->stat);
   new->type = lsa->data->type;
   new->id = lsa->data->id;
+  new->adv_router = lsa->data->adv_router;
   new->lsa = lsa->data;
   new->children = list_new ();
   new->parents = list_new ();
   new->parents->del = vertex_parent_free;
   
-  listnode_add (&vertex_list, new);
+  listnode_add (vertex_list, new);
   
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("%s: Created %s vertex %s", __func__,
@@ -190,10 +200,11 @@ ospf_vertex_free (void *data)
 {
   struct vertex *v = data;
   
+  /* The LSA may have gone by now, only the copied id is safe to use. */
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("%s: Free %s vertex %s", __func__,
                 v->type == OSPF_VERTEX_ROUTER ? "Router" : "Network",
-                inet_ntoa (v->lsa->id));
+                inet_ntoa (v->id));
   
   /* There should be no parents potentially holding references to this vertex
    * Children however may still be there, but presumably referenced by other
@@ -1104,6 +1115,632 @@ ospf_rtrs_print (struct route_table *rtrs)
 }
 #endif
 
+/* Release the router-LSAs recorded by ospf_spf_router_changed. */
+static void
+ospf_spf_routers_free (struct ospf_area *area)
+{
+  struct listnode *node;
+  struct ospf_lsa *lsa;
+
+  if (area->spf_routers == NULL)
+    return;
+
+  for (ALL_LIST_ELEMENTS_RO (area->spf_routers, node, lsa))
+    ospf_lsa_unlock (&lsa);
+
+  list_delete (area->spf_routers);
+  area->spf_routers = NULL;
+}
+
+/* Free the shortest-path tree kept for an area, whose next calculation
+ * then reruns Dijkstra.  Needed whenever the vertices may refer to
+ * interfaces or LSAs which go away.
+ */
+void
+ospf_spf_tree_free (struct ospf_area *area)
+{
+  /* Free nexthop information, canonical versions of which are attached
+   * the first level of router vertices attached to the root vertex, see
+   * ospf_nexthop_calculation.
+   */
+  if (area->spf)
+    ospf_canonical_nexthops_free (area->spf);
+  area->spf = NULL;
+
+  if (area->spf_order)
+    list_delete (area->spf_order);
+  area->spf_order = NULL;
+
+  /* List has ospf_vertex_free as deconstructor. */
+  if (area->spf_vertices)
+    list_delete (area->spf_vertices);
+  area->spf_vertices = NULL;
+
+  ospf_spf_routers_free (area);
+}
+
+/* Point the vertices of the tree kept for an area at the current
+ * instances of their LSAs, which may have been refreshed or changed
+ * their stub links since.  Returns -1 if one has gone, in which case
+ * the tree has to be rebuilt.
+ */
+static int
+ospf_spf_tree_refresh (struct ospf_area *area)
+{
+  struct listnode *node, *pnode;
+  struct vertex *v;
+  struct vertex_parent *vp;
+  struct ospf_lsa *lsa;
+
+  for (ALL_LIST_ELEMENTS_RO (area->spf_vertices, node, v))
+    {
+      lsa = ospf_lsdb_lookup_by_id (area->lsdb, v->type, v->id,
+                                    v->adv_router);
+      if (lsa == NULL || IS_LSA_MAXAGE (lsa))
+        return -1;
+
+      v->lsa = lsa->data;
+      v->stat = &lsa->stat;
+      UNSET_FLAG (v->flags, OSPF_VERTEX_PROCESSED);
+    }
+
+  /* Links move in a router-LSA when stub links come and go. */
+  for (ALL_LIST_ELEMENTS_RO (area->spf_order, node, v))
+    for (ALL_LIST_ELEMENTS_RO (v->parents, pnode, vp))
+      vp->backlink = ospf_lsa_has_link (v->lsa, vp->parent->lsa);
+
+  return 0;
+}
+
+/* Find the vertex of a router or network on the tree kept for an area. */
+static struct vertex *
+ospf_spf_vertex_lookup (struct ospf_area *area, u_char type,
+                        struct in_addr id)
+{
+  struct listnode *node;
+  struct vertex *v = area->spf;
+
+  if (v->type == type && IPV4_ADDR_SAME (&v->id, &id))
+    return v;
+
+  for (ALL_LIST_ELEMENTS_RO (area->spf_order, node, v))
+    if (v->type == type && IPV4_ADDR_SAME (&v->id, &id))
+      return v;
+
+  return NULL;
+}
+
+/* Return 1 if vertex V is a parent of vertex W. */
+static int
+ospf_spf_vertex_is_parent (struct vertex *v, struct vertex *w)
+{
+  struct listnode *node;
+  struct vertex_parent *vp;
+
+  for (ALL_LIST_ELEMENTS_RO (w->parents, node, vp))
+    if (vp->parent == v)
+      return 1;
+
+  return 0;
+}
+
+/* Find the next link of a router-LSA of the same type and to the same
+ * vertex as the given one, starting at *p.
+ */
+static struct router_lsa_link *
+ospf_spf_link_next (u_char **p, u_char *lim, struct router_lsa_link *key)
+{
+  struct router_lsa_link *l;
+
+  while (*p + OSPF_ROUTER_LSA_LINK_SIZE <= lim)
+    {
+      l = (struct router_lsa_link *) *p;
+      *p += (OSPF_ROUTER_LSA_LINK_SIZE +
+             (l->m[0].tos_count * OSPF_ROUTER_LSA_TOS_SIZE));
+
+      if (*p > lim)
+        break;
+
+      if (l->m[0].type == key->m[0].type
+          && IPV4_ADDR_SAME (&l->link_id, &key->link_id))
+        return l;
+    }
+
+  return NULL;
+}
+
+/* Return 1 if two router-LSAs have the same links of the same type and
+ * to the same vertex as the given one.
+ */
+static int
+ospf_spf_links_same (struct lsa_header *a, struct lsa_header *b,
+                     struct router_lsa_link *key)
+{
+  u_char *pa = ((u_char *) a) + OSPF_LSA_HEADER_SIZE + 4;
+  u_char *pb = ((u_char *) b) + OSPF_LSA_HEADER_SIZE + 4;
+  u_char *lima = ((u_char *) a) + ntohs (a->length);
+  u_char *limb = ((u_char *) b) + ntohs (b->length);
+  struct router_lsa_link *la, *lb;
+
+  for (;;)
+    {
+      la = ospf_spf_link_next (&pa, lima, key);
+      lb = ospf_spf_link_next (&pb, limb, key);
+
+      if (la == NULL || lb == NULL)
+        return la == lb;
+
+      if (la->m[0].tos_count != lb->m[0].tos_count
+          || memcmp (la, lb, OSPF_ROUTER_LSA_LINK_SIZE +
+                     la->m[0].tos_count * OSPF_ROUTER_LSA_TOS_SIZE))
+        return 0;
+    }
+}
+
+/* Consider the links of tree vertex W to vertex V, for the paths to V
+ * through W as ospf_spf_next would.  Without add, lower *distance to
+ * the shortest of them, or set it if 0.  With add, make W a parent of V
+ * for those as short as *distance.  Returns the number of parents
+ * added, or -1 for a virtual link, whose nexthops come from another
+ * area.
+ */
+static int
+ospf_spf_path_via (struct ospf_area *area, struct vertex *w,
+                   struct vertex *v, u_int32_t *distance, int add)
+{
+  struct router_lsa_link *l;
+  u_char *p, *lim;
+  u_char type;
+  u_int32_t d;
+  int added = 0;
+
+  if (ospf_lsa_has_link (v->lsa, w->lsa) < 0)
+    return 0;
+
+  if (w->type == OSPF_VERTEX_NETWORK)
+    {
+      if (ospf_lsa_has_link (w->lsa, v->lsa) < 0)
+        return 0;
+
+      if (! add)
+        {
+          if (*distance == 0 || w->distance < *distance)
+            *distance = w->distance;
+          return 0;
+        }
+      if (w->distance == *distance)
+        added = ospf_nexthop_calculation (area, w, v, NULL, *distance);
+      return added;
+    }
+
+  type = LSA_LINK_TYPE_TRANSIT;
+  if (v->type == OSPF_VERTEX_ROUTER)
+    type = LSA_LINK_TYPE_POINTOPOINT;
+
+  p = ((u_char *) w->lsa) + OSPF_LSA_HEADER_SIZE + 4;
+  lim = ((u_char *) w->lsa) + ntohs (w->lsa->length);
+
+  while (p < lim)
+    {
+      l = (struct router_lsa_link *) p;
+      p += (OSPF_ROUTER_LSA_LINK_SIZE +
+            (l->m[0].tos_count * OSPF_ROUTER_LSA_TOS_SIZE));
+
+      if (! IPV4_ADDR_SAME (&l->link_id, &v->id))
+        continue;
+
+      if (v->type == OSPF_VERTEX_ROUTER
+          && l->m[0].type == LSA_LINK_TYPE_VIRTUALLINK)
+        return -1;
+
+      if (l->m[0].type != type)
+        continue;
+
+      if (w != area->spf
+          && ntohs (l->m[0].metric) >= OSPF_OUTPUT_COST_INFINITE)
+        continue;
+
+      d = w->distance + ntohs (l->m[0].metric);
+      if (! add)
+        {
+          if (*distance == 0 || d < *distance)
+            *distance = d;
+        }
+      else if (d == *distance)
+        added += ospf_nexthop_calculation (area, w, v, l, d);
+    }
+
+  return added;
+}
+
+/* Add the vertex of a router or network to those ospf_spf_tree_update
+ * attaches to the tree anew, creating it if it is not on the tree and
+ * its LSA is there to do so.  Returns -1 for the root or a vertex with
+ * children, whose paths would change with its own.
+ */
+static int
+ospf_spf_reattach_add (struct ospf_area *area, struct list *reattach,
+                       u_char type, struct in_addr id)
+{
+  struct listnode *node;
+  struct ospf_lsa *lsa;
+  struct vertex *v;
+
+  for (ALL_LIST_ELEMENTS_RO (reattach, node, v))
+    if (v->type == type && IPV4_ADDR_SAME (&v->id, &id))
+      return 0;
+
+  v = ospf_spf_vertex_lookup (area, type, id);
+  if (v == area->spf)
+    return -1;
+
+  if (v == NULL)
+    {
+      lsa = ospf_lsa_lookup_by_id (area, type, id);
+      if (lsa == NULL || IS_LSA_MAXAGE (lsa))
+        return 0;
+
+      vertex_list = area->spf_vertices;
+      v = ospf_vertex_new (lsa);
+      vertex_list = NULL;
+    }
+  else if (listcount (v->children))
+    return -1;
+
+  listnode_add (reattach, v);
+  return 0;
+}
+
+/* Link L of router vertex R, to some vertex X, changed.  Add X to the
+ * vertices to attach anew if R is its parent or it is not on the tree,
+ * and R if X is its parent or may now be.  Whether X now has a shorter
+ * path through R is left to ospf_spf_reattach_check.
+ */
+static int
+ospf_spf_link_changed (struct ospf_area *area, struct list *reattach,
+                       struct vertex *r, struct router_lsa_link *l)
+{
+  struct vertex *x;
+  u_int32_t distance = 0;
+  u_char type;
+
+  switch (l->m[0].type)
+    {
+    case LSA_LINK_TYPE_POINTOPOINT:
+      type = OSPF_VERTEX_ROUTER;
+      break;
+    case LSA_LINK_TYPE_TRANSIT:
+      type = OSPF_VERTEX_NETWORK;
+      break;
+    case LSA_LINK_TYPE_STUB:
+      return 0;
+    default:
+      return -1;
+    }
+
+  x = ospf_spf_vertex_lookup (area, type, l->link_id);
+  if (x == NULL)
+    return ospf_spf_reattach_add (area, reattach, type, l->link_id);
+
+  if (x != area->spf && ospf_spf_vertex_is_parent (r, x)
+      && ospf_spf_reattach_add (area, reattach, x->type, x->id) < 0)
+    return -1;
+
+  if (r == area->spf)
+    return 0;
+
+  if (! ospf_spf_vertex_is_parent (x, r))
+    {
+      if (ospf_spf_path_via (area, x, r, &distance, 0) < 0)
+        return -1;
+      if (distance == 0 || distance > r->distance)
+        return 0;
+    }
+
+  return ospf_spf_reattach_add (area, reattach, r->type, r->id);
+}
+
+/* Compare the links of two instances of the router-LSA of vertex R,
+ * other than stub links, and note those of the first which the second
+ * does not have as they were.
+ */
+static int
+ospf_spf_links_changed (struct ospf_area *area, struct list *reattach,
+                        struct vertex *r, struct lsa_header *a,
+                        struct lsa_header *b)
+{
+  struct router_lsa_link *l;
+  u_char *p, *lim;
+
+  p = ((u_char *) a) + OSPF_LSA_HEADER_SIZE + 4;
+  lim = ((u_char *) a) + ntohs (a->length);
+
+  while (p + OSPF_ROUTER_LSA_LINK_SIZE <= lim)
+    {
+      l = (struct router_lsa_link *) p;
+      p += (OSPF_ROUTER_LSA_LINK_SIZE +
+            (l->m[0].tos_count * OSPF_ROUTER_LSA_TOS_SIZE));
+
+      if (l->m[0].type == LSA_LINK_TYPE_STUB
+          || ospf_spf_links_same (a, b, l))
+        continue;
+
+      if (ospf_spf_link_changed (area, reattach, r, l) < 0)
+        return -1;
+    }
+
+  return 0;
+}
+
+/* Take a childless vertex off the tree, freeing the nexthops it does
+ * not inherit, see ospf_canonical_nexthops_free.
+ */
+static void
+ospf_spf_detach (struct ospf_area *area, struct vertex *v)
+{
+  struct listnode *node;
+  struct vertex_parent *vp;
+
+  for (ALL_LIST_ELEMENTS_RO (v->parents, node, vp))
+    {
+      listnode_delete (vp->parent->children, v);
+
+      if (vp->nexthop
+          && (vp->parent == area->spf
+              || (vp->parent->type == OSPF_VERTEX_NETWORK
+                  && ospf_spf_vertex_is_parent (area->spf, vp->parent))))
+        vertex_nexthop_free (vp->nexthop);
+    }
+
+  ospf_spf_flush_parents (v);
+  v->distance = 0;
+  listnode_delete (area->spf_order, v);
+}
+
+/* Attach a vertex to the tree through the vertices with the shortest
+ * paths to it, and put it in the order ospf_spf_calculate would have
+ * added it.  Returns 0 if no vertex of the tree has a path to it, -1 if
+ * the nexthops could not be calculated.
+ */
+static int
+ospf_spf_reattach (struct ospf_area *area, struct vertex *v)
+{
+  struct listnode *node;
+  struct vertex *w;
+  u_int32_t distance = 0;
+  int add, ret, added = 0;
+
+  for (add = 0; add <= 1; add++)
+    {
+      w = area->spf;
+      node = listhead (area->spf_order);
+      for (;;)
+        {
+          if ((ret = ospf_spf_path_via (area, w, v, &distance, add)) < 0)
+            return -1;
+          added += ret;
+
+          if (node == NULL)
+            break;
+          w = listgetdata (node);
+          node = listnextnode (node);
+        }
+
+      if (distance == 0)
+        return 0;
+    }
+
+  if (added == 0)
+    return -1;
+
+  ospf_vertex_add_parent (v);
+
+  /* Network vertices come before router vertices of the same cost. */
+  for (ALL_LIST_ELEMENTS_RO (area->spf_order, node, w))
+    if (w->distance > v->distance
+        || (w->distance == v->distance && v->type == OSPF_VERTEX_NETWORK
+            && w->type == OSPF_VERTEX_ROUTER))
+      break;
+
+  if (node)
+    list_add_node_prev (area->spf_order, node, v);
+  else
+    listnode_add (area->spf_order, v);
+
+  return 1;
+}
+
+/* Return -1 if the links of vertex V give another vertex a path as
+ * short as those it has on the tree, but not through V, which would
+ * change the tree beyond the vertices attached anew.
+ */
+static int
+ospf_spf_reattach_check (struct ospf_area *area, struct vertex *v)
+{
+  struct router_lsa_link *l;
+  struct ospf_lsa *w_lsa;
+  struct vertex *w;
+  struct in_addr id;
+  u_char *p, *lim;
+  u_char type;
+  u_int32_t distance;
+
+  p = ((u_char *) v->lsa) + OSPF_LSA_HEADER_SIZE + 4;
+  lim = ((u_char *) v->lsa) + ntohs (v->lsa->length);
+
+  while (p < lim)
+    {
+      if (v->type == OSPF_VERTEX_ROUTER)
+        {
+          l = (struct router_lsa_link *) p;
+          p += (OSPF_ROUTER_LSA_LINK_SIZE +
+                (l->m[0].tos_count * OSPF_ROUTER_LSA_TOS_SIZE));
+
+          switch (l->m[0].type)
+            {
+            case LSA_LINK_TYPE_POINTOPOINT:
+              type = OSPF_VERTEX_ROUTER;
+              break;
+            case LSA_LINK_TYPE_TRANSIT:
+              type = OSPF_VERTEX_NETWORK;
+              break;
+            case LSA_LINK_TYPE_VIRTUALLINK:
+              return -1;
+            default:
+              continue;
+            }
+
+          if (v != area->spf
+              && ntohs (l->m[0].metric) >= OSPF_OUTPUT_COST_INFINITE)
+            continue;
+
+          id = l->link_id;
+          distance = v->distance + ntohs (l->m[0].metric);
+        }
+      else
+        {
+          id = *(struct in_addr *) p;
+          p += sizeof (struct in_addr);
+
+          type = OSPF_VERTEX_ROUTER;
+          distance = v->distance;
+        }
+
+      w_lsa = ospf_lsa_lookup_by_id (area, type, id);
+      if (w_lsa == NULL || IS_LSA_MAXAGE (w_lsa)
+          || ospf_lsa_has_link (w_lsa->data, v->lsa) < 0)
+        continue;
+
+      w = ospf_spf_vertex_lookup (area, type, id);
+      if (w == NULL)
+        return -1;
+      if (w == area->spf)
+        continue;
+
+      if (distance < w->distance
+          || (distance == w->distance && ! ospf_spf_vertex_is_parent (v, w)))
+        return -1;
+    }
+
+  return 0;
+}
+
+/* Update the tree kept for an area after router-LSAs changed links
+ * other than stub links, by attaching anew only the vertices whose
+ * paths those links may have changed: the routers themselves, and the
+ * vertices across the links which changed.  Those must have no
+ * children.  Returns 1 if the tree was updated, or -1 if the change
+ * reaches further and Dijkstra has to be rerun.
+ */
+static int
+ospf_spf_tree_update (struct ospf_area *area)
+{
+  struct list *reattach;
+  struct listnode *node, *nnode;
+  struct ospf_lsa *old;
+  struct vertex *v;
+  int ret = -1;
+
+  if (ospf_spf_tree_refresh (area) < 0)
+    return -1;
+
+  reattach = list_new ();
+
+  /* The recorded instances are those the tree was built from. */
+  for (ALL_LIST_ELEMENTS_RO (area->spf_routers, node, old))
+    {
+      v = ospf_spf_vertex_lookup (area, OSPF_VERTEX_ROUTER, old->data->id);
+      if (v == NULL)
+        {
+          if (ospf_spf_reattach_add (area, reattach, OSPF_VERTEX_ROUTER,
+                                     old->data->id) < 0)
+            goto out;
+          continue;
+        }
+
+      if (ospf_spf_links_changed (area, reattach, v, old->data, v->lsa) < 0
+          || ospf_spf_links_changed (area, reattach, v, v->lsa, old->data) < 0)
+        goto out;
+    }
+
+  for (ALL_LIST_ELEMENTS_RO (reattach, node, v))
+    ospf_spf_detach (area, v);
+
+  for (ALL_LIST_ELEMENTS (reattach, node, nnode, v))
+    switch (ospf_spf_reattach (area, v))
+      {
+      case 0:
+        /* No longer reachable. */
+        list_delete_node (reattach, node);
+        listnode_delete (area->spf_vertices, v);
+        ospf_vertex_free (v);
+        break;
+      case -1:
+        goto out;
+      }
+
+  for (ALL_LIST_ELEMENTS_RO (reattach, node, v))
+    if (ospf_spf_reattach_check (area, v) < 0)
+      goto out;
+
+  for (ALL_LIST_ELEMENTS_RO (area->spf_routers, node, old))
+    {
+      v = ospf_spf_vertex_lookup (area, OSPF_VERTEX_ROUTER, old->data->id);
+      if (v && ospf_spf_reattach_check (area, v) < 0)
+        goto out;
+    }
+
+  if (IS_DEBUG_OSPF_EVENT)
+    zlog_debug ("ospf_spf_tree_update: %u vertices attached anew in area %s",
+                listcount (reattach), inet_ntoa (area->area_id));
+
+  ret = 1;
+
+ out:
+  list_delete (reattach);
+  return ret;
+}
+
+/* Calculate the routes of an area from the tree kept for it, in the
+ * same order as ospf_spf_calculate does while building the tree.
+ */
+static void
+ospf_spf_tree_routes (struct ospf_area *area, struct route_table *new_table,
+                      struct route_table *new_rtrs)
+{
+  struct listnode *node;
+  struct vertex *v;
+
+  if (IS_DEBUG_OSPF_EVENT)
+    zlog_debug ("ospf_spf_tree_routes: reusing tree for area %s",
+               inet_ntoa (area->area_id));
+
+  area->abr_count = 0;
+  area->asbr_count = 0;
+  area->transit = OSPF_TRANSIT_FALSE;
+  area->shortcut_capability = 1;
+
+  v = area->spf;
+  for (node = listhead (area->spf_order); ; node = listnextnode (node))
+    {
+      /* As in ospf_spf_next, for the vertex added last. */
+      if (v->type == OSPF_VERTEX_ROUTER
+          && IS_ROUTER_LSA_VIRTUAL ((struct router_lsa *) v->lsa))
+        area->transit = OSPF_TRANSIT_TRUE;
+
+      if (node == NULL)
+        break;
+      v = listgetdata (node);
+
+      if (v->type == OSPF_VERTEX_ROUTER)
+        ospf_intra_add_router (new_rtrs, v, area);
+      else
+        ospf_intra_add_transit (new_table, v, area);
+    }
+
+  ospf_spf_process_stubs (area, area->spf, new_table, 0);
+}
+
 /* Calculating the shortest-path tree for an area. */
 static void
 ospf_spf_calculate (struct ospf_area *area, struct route_table *new_table,
@@ -1133,6 +1770,14 @@ ospf_spf_calculate (struct ospf_area *area, struct route_table *new_table,
   /* RFC2328 16.1. (1). */
   /* Initialize the algorithm's data structures. */
   
+  /* The tree of the previous calculation is rebuilt from scratch. */
+  ospf_spf_tree_free (area);
+  area->spf_changed = 0;
+  area->spf_vertices = list_new ();
+  area->spf_vertices->del = ospf_vertex_free;
+  area->spf_order = list_new ();
+  vertex_list = area->spf_vertices;
+
   /* This function scans all the LSA database and set the stat field to
    * LSA_SPF_NOT_EXPLORED. */
   ospf_lsdb_clean_stat (area->lsdb);
@@ -1175,6 +1820,7 @@ ospf_spf_calculate (struct ospf_area *area, struct route_table *new_table,
       *(v->stat) = LSA_SPF_IN_SPFTREE;
 
       ospf_vertex_add_parent (v);
+      listnode_add (area->spf_order, v);
 
       /* RFC2328 16.1. (4). */
       if (v->type == OSPF_VERTEX_ROUTER)
@@ -1200,19 +1846,13 @@ ospf_spf_calculate (struct ospf_area *area, struct route_table *new_table,
   pqueue_delete (candidate);
   
   ospf_vertex_dump (__func__, area->spf, 0, 1);
-  /* Free nexthop information, canonical versions of which are attached
-   * the first level of router vertices attached to the root vertex, see
-   * ospf_nexthop_calculation.
-   */
-  ospf_canonical_nexthops_free (area->spf);
-  
-  /* Free SPF vertices, but not the list. List has ospf_vertex_free
-   * as deconstructor.
-   */
-  list_delete_all_node (&vertex_list);
+
+  /* The tree is kept, for runs which only recalculate routes. */
+  vertex_list = NULL;
   
   /* Increment SPF Calculation Counter. */
   area->spf_calculation++;
+  area->ospf->spf_tree_count++;
 
   quagga_gettime (QUAGGA_CLK_MONOTONIC, &area->ospf->ts_spf);
 
@@ -1221,6 +1861,176 @@ ospf_spf_calculate (struct ospf_area *area, struct route_table *new_table,
                 mtype_stats_alloc(MTYPE_OSPF_VERTEX));
 }
 
+/* Calculate the routes of an area, rerunning Dijkstra only if its
+ * topology changed or the tree kept for it can no longer be used.
+ */
+static void
+ospf_spf_area_calculate (struct ospf_area *area,
+                         struct route_table *new_table,
+                         struct route_table *new_rtrs)
+{
+  struct ospf *ospf = area->ospf;
+  int ret;
+
+  if (area->spf_changed || area->spf == NULL)
+    ret = -1;
+  else if (area->spf_routers && listcount (area->spf_routers))
+    ret = ospf_spf_tree_update (area);
+  else
+    ret = ospf_spf_tree_refresh (area);
+
+  ospf_spf_routers_free (area);
+
+  if (ret < 0)
+    ospf_spf_calculate (area, new_table, new_rtrs);
+  else
+    {
+      ospf_spf_tree_routes (area, new_table, new_rtrs);
+
+      if (ret == 0)
+        {
+          ospf->spf_tree_reused++;
+          return;
+        }
+      ospf->spf_tree_updated++;
+    }
+
+  /* Virtual links take their nexthops from the tree of the transit
+   * area, so the backbone tree has to follow it.
+   */
+  if (area->transit == OSPF_TRANSIT_TRUE
+      && ospf->backbone && ospf->backbone != area)
+    ospf->backbone->spf_changed = 1;
+}
+
+/* Return 1 if the router routes of two tables differ. */
+static int
+ospf_spf_rtrs_different (struct route_table *old_rtrs,
+                         struct route_table *new_rtrs)
+{
+  struct route_node *rn, *rn2;
+  struct listnode *n1, *n2, *p1, *p2;
+  struct ospf_route *or1, *or2;
+  struct ospf_path *path1, *path2;
+  unsigned long count = 0;
+
+  for (rn = route_top (new_rtrs); rn; rn = route_next (rn))
+    {
+      if (rn->info == NULL)
+        continue;
+      count++;
+
+      rn2 = route_node_lookup (old_rtrs, &rn->p);
+      if (rn2 == NULL)
+        {
+          route_unlock_node (rn);
+          return 1;
+        }
+      route_unlock_node (rn2);
+      if (rn2->info == NULL
+          || listcount ((struct list *) rn->info)
+             != listcount ((struct list *) rn2->info))
+        {
+          route_unlock_node (rn);
+          return 1;
+        }
+
+      for (n1 = listhead ((struct list *) rn->info),
+           n2 = listhead ((struct list *) rn2->info);
+           n1 && n2; n1 = listnextnode (n1), n2 = listnextnode (n2))
+        {
+          or1 = listgetdata (n1);
+          or2 = listgetdata (n2);
+          if (or1->cost != or2->cost
+              || or1->path_type != or2->path_type
+              || or1->u.std.flags != or2->u.std.flags
+              || ! IPV4_ADDR_SAME (&or1->u.std.area_id, &or2->u.std.area_id)
+              || listcount (or1->paths) != listcount (or2->paths))
+            {
+              route_unlock_node (rn);
+              return 1;
+            }
+
+          for (p1 = listhead (or1->paths), p2 = listhead (or2->paths);
+               p1 && p2; p1 = listnextnode (p1), p2 = listnextnode (p2))
+            {
+              path1 = listgetdata (p1);
+              path2 = listgetdata (p2);
+              if (! IPV4_ADDR_SAME (&path1->nexthop, &path2->nexthop)
+                  || path1->ifindex != path2->ifindex)
+                {
+                  route_unlock_node (rn);
+                  return 1;
+                }
+            }
+        }
+    }
+
+  for (rn = route_top (old_rtrs); rn; rn = route_next (rn))
+    if (rn->info)
+      count--;
+
+  return count != 0;
+}
+
+/* Return 1 if the external routes have to be recalculated after the
+ * intra and inter-area routes changed to new_table and new_rtrs.
+ * External routes depend on the routes to ASBRs and to forwarding
+ * addresses, and a prefix which is no longer reachable inside the AS
+ * may be reachable by an external route.
+ */
+static int
+ospf_spf_ase_needed (struct ospf *ospf, struct route_table *new_table,
+                     struct route_table *new_rtrs)
+{
+  struct route_node *rn, *rn2;
+  struct ospf_lsa *lsa;
+
+  /* Type-7 routes are not tracked by prefix, and their forwarding
+   * addresses are mandatory.
+   */
+  if (ospf->new_table == NULL || ospf->new_rtrs == NULL || ospf->anyNSSA)
+    return 1;
+
+  if (ospf_spf_rtrs_different (ospf->new_rtrs, new_rtrs))
+    return 1;
+
+  for (rn = route_top (ospf->new_table); rn; rn = route_next (rn))
+    {
+      if (rn->info == NULL)
+        continue;
+
+      rn2 = route_node_lookup (new_table, &rn->p);
+      if (rn2)
+        {
+          route_unlock_node (rn2);
+          if (rn2->info)
+            continue;
+        }
+
+      rn2 = route_node_lookup (ospf->external_lsas, &rn->p);
+      if (rn2)
+        {
+          route_unlock_node (rn2);
+          if (rn2->info && listcount ((struct list *) rn2->info))
+            {
+              route_unlock_node (rn);
+              return 1;
+            }
+        }
+    }
+
+  /* Forwarding addresses are resolved through any route. */
+  LSDB_LOOP (EXTERNAL_LSDB (ospf), rn, lsa)
+    if (((struct as_external_lsa *) lsa->data)->e[0].fwd_addr.s_addr)
+      {
+        route_unlock_node (rn);
+        return 1;
+      }
+
+  return 0;
+}
+
 /* Timer for SPF calculation. */
 static int
 ospf_spf_calculate_timer (struct thread *thread)
@@ -1229,11 +2039,19 @@ ospf_spf_calculate_timer (struct thread *thread)
   struct route_table *new_table, *new_rtrs;
   struct ospf_area *area;
   struct listnode *node, *nnode;
+  struct timeval start, result;
+  u_int32_t trees, updated;
+  unsigned long msec;
 
   if (IS_DEBUG_OSPF_EVENT)
     zlog_debug ("SPF: Timer (SPF calculation expire)");
 
   ospf->t_spf_calc = NULL;
+  ospf->spf_pending = 0;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  trees = ospf->spf_tree_count;
+  updated = ospf->spf_tree_updated;
 
   /* Allocate new table tree. */
   new_table = route_table_init ();
@@ -1250,12 +2068,12 @@ ospf_spf_calculate_timer (struct thread *thread)
       if (ospf->backbone && ospf->backbone == area)
         continue;
       
-      ospf_spf_calculate (area, new_table, new_rtrs);
+      ospf_spf_area_calculate (area, new_table, new_rtrs);
     }
   
   /* SPF for backbone, if required */
   if (ospf->backbone)
-    ospf_spf_calculate (ospf->backbone, new_table, new_rtrs);
+    ospf_spf_area_calculate (ospf->backbone, new_table, new_rtrs);
   
   ospf_vl_shut_unapproved (ospf);
 
@@ -1268,8 +2086,10 @@ ospf_spf_calculate_timer (struct thread *thread)
 
   /* If new Router Route is installed,
      then schedule re-calculate External routes. */
-  if (1)
+  if (ospf_spf_ase_needed (ospf, new_table, new_rtrs))
     ospf_ase_calculate_schedule (ospf);
+  else
+    ospf->spf_ase_skipped++;
 
   ospf_ase_calculate_timer_add (ospf);
 
@@ -1290,26 +2110,54 @@ ospf_spf_calculate_timer (struct thread *thread)
   if (IS_OSPF_ABR (ospf))
     ospf_abr_task (ospf);
 
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &ospf->ts_spf);
+  result = tv_sub (ospf->ts_spf, start);
+  msec = (result.tv_sec * 1000) + (result.tv_usec / 1000);
+
+  ospf->spf_last_msec = msec;
+  if (ospf->spf_tree_count != trees)
+    {
+      ospf->spf_last_type = OSPF_SPF_FULL;
+      ospf->spf_full_count++;
+      if (msec > ospf->spf_full_max_msec)
+        ospf->spf_full_max_msec = msec;
+    }
+  else if (ospf->spf_tree_updated != updated)
+    {
+      ospf->spf_last_type = OSPF_SPF_INCREMENTAL;
+      ospf->spf_incremental_count++;
+      if (msec > ospf->spf_incremental_max_msec)
+        ospf->spf_incremental_max_msec = msec;
+    }
+  else
+    {
+      ospf->spf_last_type = OSPF_SPF_PARTIAL;
+      ospf->spf_partial_count++;
+      if (msec > ospf->spf_partial_max_msec)
+        ospf->spf_partial_max_msec = msec;
+    }
+
   if (IS_DEBUG_OSPF_EVENT)
-    zlog_debug ("SPF: calculation complete");
+    zlog_debug ("SPF: %s calculation complete in %lu msec",
+                LOOKUP (ospf_spf_type_msg, ospf->spf_last_type), msec);
 
   return 0;
 }
 
 /* Add schedule for SPF calculation.  To avoid frequenst SPF calc, we
    set timer for SPF calc. */
-void
-ospf_spf_calculate_schedule (struct ospf *ospf)
+static void
+ospf_spf_schedule (struct ospf *ospf, int type)
 {
   unsigned long delay, elapsed, ht;
   struct timeval result;
 
   if (IS_DEBUG_OSPF_EVENT)
-    zlog_debug ("SPF: calculation timer scheduled");
+    zlog_debug ("SPF: %s calculation timer scheduled",
+                LOOKUP (ospf_spf_type_msg, type));
 
-  /* OSPF instance does not exist. */
-  if (ospf == NULL)
-    return;
+  if (type > ospf->spf_pending)
+    ospf->spf_pending = type;
   
   /* SPF calculation timer is already scheduled. */
   if (ospf->t_spf_calc)
@@ -1358,3 +2206,143 @@ ospf_spf_calculate_schedule (struct ospf *ospf)
   ospf->t_spf_calc =
     thread_add_timer_msec (master, ospf_spf_calculate_timer, ospf, delay);
 }
+
+/* Schedule a calculation which reruns Dijkstra for every area. */
+void
+ospf_spf_calculate_schedule (struct ospf *ospf)
+{
+  struct listnode *node;
+  struct ospf_area *area;
+
+  /* OSPF instance does not exist. */
+  if (ospf == NULL)
+    return;
+
+  for (ALL_LIST_ELEMENTS_RO (ospf->areas, node, area))
+    area->spf_changed = 1;
+
+  ospf_spf_schedule (ospf, OSPF_SPF_FULL);
+}
+
+/* Schedule a calculation which reruns Dijkstra for an area whose
+ * topology changed, and recalculates the routes of the others.
+ */
+void
+ospf_spf_schedule_area (struct ospf_area *area)
+{
+  area->spf_changed = 1;
+  ospf_spf_schedule (area->ospf, OSPF_SPF_FULL);
+}
+
+/* Schedule a calculation of routes only, for LSAs which do not change
+ * the shortest-path tree of any area: summary-LSAs, and router-LSAs
+ * whose stub links are all that changed.
+ */
+void
+ospf_spf_schedule_partial (struct ospf *ospf)
+{
+  if (ospf == NULL)
+    return;
+
+  ospf_spf_schedule (ospf, OSPF_SPF_PARTIAL);
+}
+
+/* Schedule a calculation for a router-LSA which changed links other
+ * than stub links, see ospf_spf_router_changed.
+ */
+void
+ospf_spf_schedule_router (struct ospf_area *area)
+{
+  ospf_spf_schedule (area->ospf, area->spf_changed ? OSPF_SPF_FULL
+                                                   : OSPF_SPF_INCREMENTAL);
+}
+
+/* Record a router-LSA about to be replaced by a new instance which
+ * changed links other than stub links.  The first instance recorded
+ * for a router since the tree of its area was built is the one the
+ * tree was built from, and is kept locked for ospf_spf_tree_update to
+ * compare with.
+ */
+void
+ospf_spf_router_changed (struct ospf_lsa *old, struct ospf_lsa *new)
+{
+  struct ospf_area *area = new->area;
+  struct listnode *node;
+  struct ospf_lsa *lsa;
+
+  if (area->spf_changed)
+    return;
+
+  if (area->spf == NULL
+      || (area->spf_routers
+          && listcount (area->spf_routers) >= OSPF_SPF_ROUTERS_MAX))
+    {
+      area->spf_changed = 1;
+      return;
+    }
+
+  if (area->spf_routers == NULL)
+    area->spf_routers = list_new ();
+
+  for (ALL_LIST_ELEMENTS_RO (area->spf_routers, node, lsa))
+    if (IPV4_ADDR_SAME (&lsa->data->id, &new->data->id))
+      return;
+
+  listnode_add (area->spf_routers, ospf_lsa_lock (old ? old : new));
+}
+
+/* Return 1 if a new instance of a router-LSA changes the shortest-path
+ * tree, rather than only the stub networks hung off it.
+ */
+int
+ospf_router_lsa_topo_different (struct ospf_lsa *old, struct ospf_lsa *new)
+{
+  struct router_lsa *rl1 = (struct router_lsa *) old->data;
+  struct router_lsa *rl2 = (struct router_lsa *) new->data;
+  u_char *p1, *p2, *lim1, *lim2;
+  struct router_lsa_link *l1, *l2;
+  int len1 = 0, len2 = 0;
+
+  if (rl1->header.options != rl2->header.options
+      || rl1->flags != rl2->flags)
+    return 1;
+
+  p1 = ((u_char *) rl1) + OSPF_LSA_HEADER_SIZE + 4;
+  lim1 = ((u_char *) rl1) + ntohs (rl1->header.length);
+  p2 = ((u_char *) rl2) + OSPF_LSA_HEADER_SIZE + 4;
+  lim2 = ((u_char *) rl2) + ntohs (rl2->header.length);
+
+  /* Compare the links other than stub links, in order. */
+  for (;;)
+    {
+      for (l1 = NULL; p1 < lim1; p1 += len1)
+        {
+          l1 = (struct router_lsa_link *) p1;
+          len1 = OSPF_ROUTER_LSA_LINK_SIZE
+                 + l1->m[0].tos_count * OSPF_ROUTER_LSA_TOS_SIZE;
+          if (l1->m[0].type != LSA_LINK_TYPE_STUB)
+            break;
+          l1 = NULL;
+        }
+      for (l2 = NULL; p2 < lim2; p2 += len2)
+        {
+          l2 = (struct router_lsa_link *) p2;
+          len2 = OSPF_ROUTER_LSA_LINK_SIZE
+                 + l2->m[0].tos_count * OSPF_ROUTER_LSA_TOS_SIZE;
+          if (l2->m[0].type != LSA_LINK_TYPE_STUB)
+            break;
+          l2 = NULL;
+        }
+
+      if (l1 == NULL || l2 == NULL)
+        return l1 != l2;
+
+      if (len1 != len2
+          || p1 + len1 > lim1 || p2 + len2 > lim2
+          || memcmp (l1, l2, len1))
+        return 1;
+
+      p1 += len1;
+      p2 += len2;
+    }
+}
@@ -30,6 +30,21 @@
 /* values for vertex->flags */
 #define OSPF_VERTEX_PROCESSED      0x01
 
+/* Kinds of routing table calculation.  A partial run keeps every
+ * area's shortest-path tree and only recalculates the routes hung off
+ * it; an incremental run also re-attaches the vertices of routers whose
+ * links changed to the trees kept; a full run reruns Dijkstra for the
+ * areas whose topology changed otherwise.
+ */
+#define OSPF_SPF_PARTIAL	1
+#define OSPF_SPF_INCREMENTAL	2
+#define OSPF_SPF_FULL		3
+
+/* Router-LSAs which may change in an area between two calculations
+ * before its tree is rebuilt rather than updated.
+ */
+#define OSPF_SPF_ROUTERS_MAX	16
+
 /* The "root" is the node running the SPF calculation */
 
 /* A router or network in an area */
@@ -38,6 +53,7 @@ struct vertex
   u_char flags;
   u_char type;		/* copied from LSA header */
   struct in_addr id;	/* copied from LSA header */
+  struct in_addr adv_router; /* copied from LSA header */
   struct lsa_header *lsa; /* Router or Network LSA */
   int *stat;		/* Link to LSA status. */
   u_int32_t distance;	/* from root to this vertex */  
@@ -59,7 +75,17 @@ struct vertex_parent
   int backlink;			/* index back to parent for router-lsa's */
 };
 
+extern const struct message ospf_spf_type_msg[];
+extern const int ospf_spf_type_msg_max;
+
 extern void ospf_spf_calculate_schedule (struct ospf *);
+extern void ospf_spf_schedule_area (struct ospf_area *);
+extern void ospf_spf_schedule_partial (struct ospf *);
+extern void ospf_spf_schedule_router (struct ospf_area *);
+extern void ospf_spf_router_changed (struct ospf_lsa *, struct ospf_lsa *);
+extern void ospf_spf_tree_free (struct ospf_area *);
+extern int ospf_router_lsa_topo_different (struct ospf_lsa *,
+                                           struct ospf_lsa *);
 extern void ospf_rtrs_free (struct route_table *);
 
 /* void ospf_spf_calculate_timer_add (); */
@@ -2758,6 +2758,21 @@ DEFUN (show_ip_ospf,
            (ospf->t_spf_calc ? "due in " : "is "),
            ospf_timer_dump (ospf->t_spf_calc, timebuf, sizeof (timebuf)),
            VTY_NEWLINE);
+  if (ospf->spf_last_type)
+    vty_out (vty, " Last SPF was %s, took %lu msec(s)%s",
+             LOOKUP (ospf_spf_type_msg, ospf->spf_last_type),
+             ospf->spf_last_msec, VTY_NEWLINE);
+  vty_out (vty, " SPF runs: %u full (longest %lu msec(s)),"
+                " %u incremental (longest %lu msec(s)),"
+                " %u partial (longest %lu msec(s))%s",
+           ospf->spf_full_count, ospf->spf_full_max_msec,
+           ospf->spf_incremental_count, ospf->spf_incremental_max_msec,
+           ospf->spf_partial_count, ospf->spf_partial_max_msec,
+           VTY_NEWLINE);
+  vty_out (vty, " SPF trees: %u calculated, %u updated, %u reused,"
+                " external routes kept %u time(s)%s",
+           ospf->spf_tree_count, ospf->spf_tree_updated,
+           ospf->spf_tree_reused, ospf->spf_ase_skipped, VTY_NEWLINE);
   
   /* Show refresh parameters. */
   vty_out (vty, " Refresh timer %d secs%s",
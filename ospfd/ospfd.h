@@ -201,6 +201,21 @@ struct ospf
   unsigned int spf_holdtime;		/* SPF hold time. */
   unsigned int spf_max_holdtime;	/* SPF maximum-holdtime */
   unsigned int spf_hold_multiplier;	/* Adaptive multiplier for hold time */
+  int spf_pending;			/* OSPF_SPF_ type of the scheduled run */
+
+  /* SPF statistics. */
+  u_int32_t spf_full_count;		/* Runs with Dijkstra for some area */
+  u_int32_t spf_incremental_count;	/* Runs updating some area's tree */
+  u_int32_t spf_partial_count;		/* Runs recalculating routes only */
+  u_int32_t spf_tree_count;		/* Area trees computed by Dijkstra */
+  u_int32_t spf_tree_updated;		/* Area trees updated incrementally */
+  u_int32_t spf_tree_reused;		/* Area trees kept from an earlier run */
+  u_int32_t spf_ase_skipped;		/* Runs not redoing external routes */
+  int spf_last_type;			/* OSPF_SPF_ type of the last run */
+  unsigned long spf_last_msec;		/* Duration of the last run */
+  unsigned long spf_full_max_msec;	/* Longest full run */
+  unsigned long spf_incremental_max_msec; /* Longest incremental run */
+  unsigned long spf_partial_max_msec;	/* Longest partial run */
   
   int default_originate;		/* Default information originate. */
 #define DEFAULT_ORIGINATE_NONE		0
@@ -429,8 +444,12 @@ struct ospf_area
 #define PREFIX_LIST_OUT(A)  (A)->plist_out.list
 #define PREFIX_NAME_OUT(A)  (A)->plist_out.name
 
-  /* Shortest Path Tree. */
+  /* Shortest Path Tree, kept between calculations. */
   struct vertex *spf;
+  struct list *spf_vertices;		/* All vertices, to free them */
+  struct list *spf_order;		/* Vertices in order added to tree */
+  int spf_changed;			/* Topology changed, rerun Dijkstra */
+  struct list *spf_routers;		/* see ospf_spf_router_changed */
 
   /* Threads. */
   struct thread *t_stub_router;    /* Stub-router timer */
@@ -0,0 +1,153 @@
+/*
+ * BGP adjacency benchmark.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/* Time adj-in/adj-out updates and lookups as the number of peers per
+ * prefix grows, keeping the total number of adjacencies the same.  The
+ * time per operation should stay flat rather than grow with the number
+ * of peers.
+ */
+#include <zebra.h>
+
+#include "memory.h"
+#include "prefix.h"
+#include "thread.h"
+#include "privs.h"
+#include "vty.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_advertise.h"
+
+/* need these to link in libbgp */
+struct zebra_privs_t *bgpd_privs = NULL;
+struct thread_master *master = NULL;
+
+#define ADJ_COUNT	(1 << 20)
+
+static struct peer *
+peer_make (void)
+{
+  struct peer *peer;
+
+  peer = XCALLOC (MTYPE_BGP_PEER, sizeof (struct peer));
+  peer->lock = 1;
+  bgp_sync_init (peer);
+  return peer;
+}
+
+static void
+run (unsigned int npeers, struct attr *attr, struct bgp_info *binfo)
+{
+  struct bgp_table *table;
+  struct bgp_node **rn;
+  struct peer **peer;
+  struct prefix p;
+  struct timeval start;
+  unsigned long set, lookup, unset;
+  unsigned int nprefix = ADJ_COUNT / npeers;
+  unsigned int i, j, found = 0;
+
+  table = bgp_table_init (AFI_IP, SAFI_UNICAST);
+  rn = calloc (nprefix, sizeof (struct bgp_node *));
+  peer = calloc (npeers, sizeof (struct peer *));
+
+  for (j = 0; j < npeers; j++)
+    peer[j] = peer_make ();
+
+  memset (&p, 0, sizeof (struct prefix));
+  p.family = AF_INET;
+  p.prefixlen = 24;
+  for (i = 0; i < nprefix; i++)
+    {
+      p.u.prefix4.s_addr = htonl (0x0a000000 + (i << 8));
+      rn[i] = bgp_node_get (table, &p);
+    }
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < nprefix; i++)
+    for (j = 0; j < npeers; j++)
+      {
+	bgp_adj_in_set (rn[i], peer[j], attr);
+	bgp_adj_out_set (rn[i], peer[j], &rn[i]->p, attr,
+	                 AFI_IP, SAFI_UNICAST, binfo);
+      }
+  set = quagga_elapsed (&start);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < nprefix; i++)
+    for (j = 0; j < npeers; j++)
+      found += bgp_adj_out_lookup (peer[j], &rn[i]->p, AFI_IP, SAFI_UNICAST,
+                                   rn[i]);
+  lookup = quagga_elapsed (&start);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < nprefix; i++)
+    for (j = 0; j < npeers; j++)
+      {
+	bgp_adj_out_unset (rn[i], peer[j], &rn[i]->p, AFI_IP, SAFI_UNICAST);
+	bgp_adj_in_unset (rn[i], peer[j]);
+      }
+  unset = quagga_elapsed (&start);
+
+  if (found != nprefix * npeers)
+    printf ("lookup found %u of %u\n", found, nprefix * npeers);
+
+  printf ("%6u %8u %10lu %10lu %10lu\n", npeers, nprefix,
+          set * 1000 / ADJ_COUNT, lookup * 1000 / ADJ_COUNT,
+          unset * 1000 / ADJ_COUNT);
+
+  for (i = 0; i < nprefix; i++)
+    bgp_unlock_node (rn[i]);
+  bgp_table_finish (&table);
+  for (j = 0; j < npeers; j++)
+    {
+      bgp_sync_delete (peer[j]);
+      XFREE (MTYPE_BGP_PEER, peer[j]);
+    }
+  free (peer);
+  free (rn);
+}
+
+int
+main (void)
+{
+  struct attr attr;
+  struct bgp_info *binfo;
+  unsigned int npeers;
+
+  master = thread_master_create ();
+  bgp_master_init ();
+  bgp_attr_init ();
+
+  bgp_attr_default_set (&attr, BGP_ORIGIN_IGP);
+  binfo = bgp_info_lock (XCALLOC (MTYPE_BGP_ROUTE, sizeof (struct bgp_info)));
+
+  printf ("%d adjacencies in and out\n", ADJ_COUNT);
+  printf ("%6s %8s %10s %10s %10s\n", "peers", "prefixes", "set(ns)",
+          "lookup(ns)", "unset(ns)");
+
+  for (npeers = 1; npeers <= 1024; npeers *= 4)
+    run (npeers, &attr, binfo);
+
+  return 0;
+}
@@ -0,0 +1,245 @@
+/*
+ * Community-list test and benchmark.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/* Match routes carrying up to 100 communities against standard and
+ * extended community-lists of a few hundred entries, mostly of one
+ * value each, with community_list_match(), community_list_exact_match()
+ * and ecommunity_list_match().  The results must be the same as trying
+ * each entry in turn, which is also timed.
+ */
+#include <zebra.h>
+
+#include "memory.h"
+#include "thread.h"
+#include "privs.h"
+#include "vty.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_community.h"
+#include "bgpd/bgp_ecommunity.h"
+#include "bgpd/bgp_regex.h"
+#include "bgpd/bgp_clist.h"
+
+/* need these to link in libbgp */
+struct zebra_privs_t *bgpd_privs = NULL;
+struct thread_master *master = NULL;
+
+#define ENTRY_COUNT	400
+#define ROUTE_COUNT	5000
+#define VALUE_MAX	100
+#define ROUNDS		10
+
+static void
+random_value (char *buf, size_t size)
+{
+  snprintf (buf, size, "%ld:%ld", 65000 + random () % 4, random () % 500);
+}
+
+/* Entry string: mostly one value, sometimes two or three. */
+static const char *
+random_entry (void)
+{
+  static char buf[64];
+  int len, n, i;
+
+  n = (random () % 10) ? 1 : 2 + random () % 2;
+  for (i = 0, len = 0; i < n; i++)
+    {
+      if (i)
+        buf[len++] = ' ';
+      random_value (buf + len, sizeof (buf) - len);
+      len += strlen (buf + len);
+    }
+  return buf;
+}
+
+static char *
+random_route (const char *prefix, int max)
+{
+  static char buf[VALUE_MAX * 24];
+  int len, n, i;
+
+  n = random () % (max + 1);
+  for (i = 0, len = 0; i < n; i++)
+    {
+      len += snprintf (buf + len, sizeof (buf) - len, "%s%s", i ? " " : "",
+                       prefix);
+      random_value (buf + len, sizeof (buf) - len);
+      len += strlen (buf + len);
+    }
+  buf[len] = '\0';
+  return buf;
+}
+
+/* Try each entry in turn. */
+static int
+scan (struct community *com, struct community_list *list, int exact)
+{
+  struct community_entry *entry;
+
+  for (entry = list->head; entry; entry = entry->next)
+    {
+      if (entry->any
+          || community_include (entry->u.com, COMMUNITY_INTERNET)
+          || (exact ? community_cmp (com, entry->u.com)
+                    : community_match (com, entry->u.com)))
+        return entry->direct == COMMUNITY_PERMIT;
+    }
+  return 0;
+}
+
+static int
+escan (struct ecommunity *ecom, struct community_list *list)
+{
+  struct community_entry *entry;
+
+  for (entry = list->head; entry; entry = entry->next)
+    if (entry->any || ecommunity_match (ecom, entry->u.ecom))
+      return entry->direct == COMMUNITY_PERMIT;
+  return 0;
+}
+
+static void
+report (const char *what, unsigned long fast, unsigned long slow, int hits)
+{
+  printf ("%-20s %10lu %10lu %8d\n", what,
+          fast * 1000 / (ROUNDS * ROUTE_COUNT),
+          slow * 1000 / (ROUNDS * ROUTE_COUNT), hits);
+}
+
+int
+main (void)
+{
+  struct community_list_handler *ch;
+  struct community_list *list, *elist;
+  struct community **coms;
+  struct ecommunity **ecoms;
+  struct timeval start;
+  unsigned long fast, slow;
+  char buf[64];
+  int i, r, hits, diff = 0;
+
+  master = thread_master_create ();
+  bgp_master_init ();
+  community_init ();
+  ecommunity_init ();
+  srandom (1);
+
+  ch = community_list_init ();
+  for (i = 0; i < ENTRY_COUNT; i++)
+    {
+      int direct = (random () % 4) ? COMMUNITY_PERMIT : COMMUNITY_DENY;
+
+      community_list_set (ch, "std", random_entry (), direct,
+                          COMMUNITY_LIST_STANDARD);
+      snprintf (buf, sizeof (buf), "rt ");
+      random_value (buf + 3, sizeof (buf) - 3);
+      extcommunity_list_set (ch, "ext", buf, direct,
+                             EXTCOMMUNITY_LIST_STANDARD);
+    }
+  community_list_set (ch, "std", "internet", COMMUNITY_DENY,
+                      COMMUNITY_LIST_STANDARD);
+  list = community_list_lookup (ch, "std", COMMUNITY_LIST_MASTER);
+  elist = community_list_lookup (ch, "ext", EXTCOMMUNITY_LIST_MASTER);
+
+  coms = calloc (ROUTE_COUNT, sizeof (struct community *));
+  ecoms = calloc (ROUTE_COUNT, sizeof (struct ecommunity *));
+  for (i = 0; i < ROUTE_COUNT; i++)
+    {
+      coms[i] = community_str2com (random_route ("", VALUE_MAX));
+      if (coms[i])
+        coms[i] = community_intern (coms[i]);
+      ecoms[i] = ecommunity_str2com (random_route ("rt ", VALUE_MAX / 4),
+                                     0, 1);
+      if (ecoms[i])
+        ecoms[i] = ecommunity_intern (ecoms[i]);
+    }
+  /* A few of exactly one value, for exact-match. */
+  for (i = 0; i < ROUTE_COUNT / 10; i++)
+    {
+      if (coms[i])
+        community_unintern (&coms[i]);
+      random_value (buf, sizeof (buf));
+      coms[i] = community_intern (community_str2com (buf));
+    }
+
+  printf ("%-20s %10s %10s %8s\n", "", "list(ns)", "scan(ns)", "permit");
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (r = 0, hits = 0; r < ROUNDS; r++)
+    for (i = 0; i < ROUTE_COUNT; i++)
+      hits += community_list_match (coms[i], list);
+  fast = quagga_elapsed (&start);
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (r = 0; r < ROUNDS; r++)
+    for (i = 0; i < ROUTE_COUNT; i++)
+      scan (coms[i], list, 0);
+  slow = quagga_elapsed (&start);
+  report ("community", fast, slow, hits / ROUNDS);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (r = 0, hits = 0; r < ROUNDS; r++)
+    for (i = 0; i < ROUTE_COUNT; i++)
+      hits += community_list_exact_match (coms[i], list);
+  fast = quagga_elapsed (&start);
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (r = 0; r < ROUNDS; r++)
+    for (i = 0; i < ROUTE_COUNT; i++)
+      scan (coms[i], list, 1);
+  slow = quagga_elapsed (&start);
+  report ("community exact", fast, slow, hits / ROUNDS);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (r = 0, hits = 0; r < ROUNDS; r++)
+    for (i = 0; i < ROUTE_COUNT; i++)
+      hits += ecommunity_list_match (ecoms[i], elist);
+  fast = quagga_elapsed (&start);
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (r = 0; r < ROUNDS; r++)
+    for (i = 0; i < ROUTE_COUNT; i++)
+      escan (ecoms[i], elist);
+  slow = quagga_elapsed (&start);
+  report ("extcommunity", fast, slow, hits / ROUNDS);
+
+  for (i = 0; i < ROUTE_COUNT; i++)
+    {
+      if (community_list_match (coms[i], list) != scan (coms[i], list, 0))
+        diff++;
+      if (community_list_exact_match (coms[i], list)
+          != scan (coms[i], list, 1))
+        diff++;
+      if (ecommunity_list_match (ecoms[i], elist) != escan (ecoms[i], elist))
+        diff++;
+    }
+
+  /* Take entries out, and the lists must still agree. */
+  community_list_unset (ch, "std", "internet", COMMUNITY_DENY,
+                        COMMUNITY_LIST_STANDARD);
+  for (i = 0; i < ROUTE_COUNT; i++)
+    if (community_list_match (coms[i], list) != scan (coms[i], list, 0))
+      diff++;
+
+  if (diff)
+    printf ("%d results differ\n", diff);
+
+  community_list_terminate (ch);
+  return diff ? 1 : 0;
+}
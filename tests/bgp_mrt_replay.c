@@ -0,0 +1,742 @@
+/*
+ * MRT replay benchmark.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/* Send the UPDATEs in an MRT file, such as one written by "dump bgp
+ * updates" or "dump bgp routes-mrt", or by a route collector, to bgpd
+ * from a number of peers, each of which sends the whole file.  The
+ * messages are read from sockets by bgp_read() and go through
+ * bgp_update_receive(), bgp_attr_parse(), bgp_nlri_parse(),
+ * bgp_update_main() and best path selection as they would from real
+ * peers.
+ *
+ * TABLE_DUMP_V2 RIB entries are made into UPDATEs, with the prefixes of
+ * successive entries of one peer packed into a message for as long as
+ * their attributes stay the same.  BGP4MP UPDATEs are sent as they were
+ * received, except for those with 2 byte AS paths, which are skipped as
+ * the peers here all speak AS4.
+ *
+ * The CPU time of each stage is that of the threads which run it:
+ * receive is bgp_read() and process is the route processing work queue.
+ * With more than one peer, process includes queueing the best paths
+ * out to the other peers, but as there is no MRAI timer running they
+ * are never sent.
+ *
+ * Usage: bgpmrtreplay [-n peers] file
+ */
+#include <zebra.h>
+
+#include "log.h"
+#include "memory.h"
+#include "prefix.h"
+#include "vty.h"
+#include "thread.h"
+#include "workqueue.h"
+#include "sockunion.h"
+#include "sockopt.h"
+#include "network.h"
+#include "privs.h"
+#include "zclient.h"
+#include "if.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_community.h"
+#include "bgpd/bgp_ecommunity.h"
+#include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_dump.h"
+
+/* need these to link in libbgp */
+struct zebra_privs_t bgpd_privs;
+struct thread_master *master = NULL;
+
+extern struct zclient *zclient;
+extern struct zclient *zlookup;
+
+/* MRT types bgp_dump.h doesn't have. */
+#define MRT_TABLE_DUMP_V2	13
+#define MRT_BGP4MP_ET		17
+#define MRT_HEADER_SIZE		12
+
+#define REPLAY_AS		4200000000U
+#define REPLAY_SOCKBUF		(1 << 20)
+
+/* The UPDATEs to send, back to back. */
+static u_char *msgs;
+static size_t msgs_len;
+static size_t msgs_size;
+
+static unsigned long msg_count;
+static unsigned long prefix_count;
+static unsigned long skipped;
+
+/* An UPDATE being made up from the TABLE_DUMP_V2 entries of a peer. */
+struct pending
+{
+  afi_t afi;
+  unsigned long count;
+  size_t attr_len;
+  size_t nh_len;
+  size_t nlri_len;
+  u_char attr[BGP_MAX_PACKET_SIZE];
+  u_char nh[256];
+  u_char nlri[BGP_MAX_PACKET_SIZE];
+};
+
+/* One per peer in the peer index table. */
+static struct pending *pending;
+static unsigned int npending;
+
+enum
+{
+  STAGE_RECEIVE,
+  STAGE_PROCESS,
+  STAGE_OTHER,
+  STAGE_MAX
+};
+
+static const char *stage_name[STAGE_MAX] =
+{
+  "receive",
+  "process",
+  "other",
+};
+
+static struct
+{
+  unsigned long cpu;
+  unsigned long calls;
+} stage[STAGE_MAX];
+
+static u_char *
+msgs_grow (size_t len)
+{
+  u_char *p;
+
+  while (msgs_len + len > msgs_size)
+    {
+      msgs_size = msgs_size ? msgs_size * 2 : (1 << 20);
+      msgs = realloc (msgs, msgs_size);
+      if (! msgs)
+        {
+          fprintf (stderr, "out of memory\n");
+          exit (1);
+        }
+    }
+  p = msgs + msgs_len;
+  msgs_len += len;
+  return p;
+}
+
+/* Number of prefixes in a run of NLRI. */
+static unsigned long
+nlri_count (const u_char *p, size_t len)
+{
+  unsigned long n = 0;
+  size_t off = 0;
+
+  while (off < len)
+    {
+      off += 1 + (p[off] + 7) / 8;
+      n++;
+    }
+  return n;
+}
+
+/* Find the length of the attribute at p, and of its header.  Returns -1
+   if it runs past end. */
+static int
+attr_len (const u_char *p, const u_char *end, size_t *hl, size_t *l)
+{
+  if (p + 3 > end)
+    return -1;
+  if (p[0] & BGP_ATTR_FLAG_EXTLEN)
+    {
+      if (p + 4 > end)
+        return -1;
+      *hl = 4;
+      *l = p[2] << 8 | p[3];
+    }
+  else
+    {
+      *hl = 3;
+      *l = p[2];
+    }
+  if (p + *hl + *l > end)
+    return -1;
+  return 0;
+}
+
+/* Number of prefixes an UPDATE announces or withdraws. */
+static unsigned long
+update_count (const u_char *msg, size_t len)
+{
+  const u_char *p = msg + BGP_HEADER_SIZE;
+  const u_char *end = msg + len;
+  const u_char *aend;
+  unsigned long n;
+  size_t wlen, alen, hl, l, nhl;
+
+  if (p + 2 > end)
+    return 0;
+  wlen = p[0] << 8 | p[1];
+  p += 2;
+  if (p + wlen + 2 > end)
+    return 0;
+  n = nlri_count (p, wlen);
+  p += wlen;
+
+  alen = p[0] << 8 | p[1];
+  p += 2;
+  if (p + alen > end)
+    return n;
+  aend = p + alen;
+
+  for (; attr_len (p, aend, &hl, &l) == 0; p += hl + l)
+    {
+      if (p[1] == BGP_ATTR_MP_REACH_NLRI && l >= 5)
+        {
+          nhl = p[hl + 3];
+          if (5 + nhl <= l)
+            n += nlri_count (p + hl + 5 + nhl, l - 5 - nhl);
+        }
+      else if (p[1] == BGP_ATTR_MP_UNREACH_NLRI && l >= 3)
+        n += nlri_count (p + hl + 3, l - 3);
+    }
+
+  return n + nlri_count (aend, end - aend);
+}
+
+static void
+pending_flush (struct pending *pd)
+{
+  u_char *p;
+  size_t alen, mlen = 0, len;
+
+  if (! pd->count)
+    return;
+
+  alen = pd->attr_len;
+  if (pd->afi == AFI_IP6)
+    {
+      mlen = 5 + pd->nh_len + pd->nlri_len;
+      alen += 4 + mlen;
+    }
+  len = BGP_HEADER_SIZE + 4 + alen + (pd->afi == AFI_IP ? pd->nlri_len : 0);
+
+  p = msgs_grow (len);
+  memset (p, 0xff, BGP_MARKER_SIZE);
+  p += BGP_MARKER_SIZE;
+  *p++ = len >> 8;
+  *p++ = len;
+  *p++ = BGP_MSG_UPDATE;
+
+  /* No withdrawn routes. */
+  *p++ = 0;
+  *p++ = 0;
+
+  *p++ = alen >> 8;
+  *p++ = alen;
+  memcpy (p, pd->attr, pd->attr_len);
+  p += pd->attr_len;
+
+  if (pd->afi == AFI_IP6)
+    {
+      *p++ = BGP_ATTR_FLAG_OPTIONAL | BGP_ATTR_FLAG_EXTLEN;
+      *p++ = BGP_ATTR_MP_REACH_NLRI;
+      *p++ = mlen >> 8;
+      *p++ = mlen;
+      *p++ = 0;
+      *p++ = AFI_IP6;
+      *p++ = SAFI_UNICAST;
+      *p++ = pd->nh_len;
+      memcpy (p, pd->nh, pd->nh_len);
+      p += pd->nh_len;
+      *p++ = 0;
+    }
+  memcpy (p, pd->nlri, pd->nlri_len);
+
+  msg_count++;
+  prefix_count += pd->count;
+  pd->count = 0;
+  pd->nlri_len = 0;
+}
+
+static void
+pending_flush_all (void)
+{
+  unsigned int i;
+
+  for (i = 0; i < npending; i++)
+    pending_flush (&pending[i]);
+}
+
+/* Add a RIB entry to the UPDATE being made up for its peer.  The
+   MP_REACH_NLRI of a TABLE_DUMP_V2 entry has only the nexthop, the rest
+   of it is put back when the UPDATE is made. */
+static void
+rib_entry_add (unsigned int idx, afi_t afi, u_char plen, const u_char *pfx,
+               const u_char *attr, size_t len)
+{
+  struct pending *pd;
+  const u_char *p, *end = attr + len;
+  u_char abuf[BGP_MAX_PACKET_SIZE];
+  u_char nh[256];
+  size_t alen = 0, nh_len = 0, hl, l, size;
+  size_t psize = (plen + 7) / 8;
+
+  if (idx >= npending || len > BGP_MAX_PACKET_SIZE)
+    {
+      skipped++;
+      return;
+    }
+  pd = &pending[idx];
+
+  for (p = attr; attr_len (p, end, &hl, &l) == 0; p += hl + l)
+    {
+      const u_char *v = p + hl;
+
+      if (p[1] != BGP_ATTR_MP_REACH_NLRI)
+        {
+          memcpy (abuf + alen, p, hl + l);
+          alen += hl + l;
+        }
+      /* Some write the whole attribute rather than just the nexthop. */
+      else if (l >= 1 && v[0] == l - 1)
+        {
+          nh_len = v[0];
+          memcpy (nh, v + 1, nh_len);
+        }
+      else if (l >= 4 && (size_t) v[3] + 4 <= l)
+        {
+          nh_len = v[3];
+          memcpy (nh, v + 4, nh_len);
+        }
+    }
+
+  if (pd->count
+      && (pd->afi != afi
+          || pd->attr_len != alen || memcmp (pd->attr, abuf, alen)
+          || pd->nh_len != nh_len || memcmp (pd->nh, nh, nh_len)))
+    pending_flush (pd);
+
+  size = BGP_HEADER_SIZE + 4 + alen + (afi == AFI_IP6 ? 9 + nh_len : 0)
+         + 1 + psize;
+  if (pd->count && size + pd->nlri_len > BGP_MAX_PACKET_SIZE)
+    pending_flush (pd);
+  if (size > BGP_MAX_PACKET_SIZE)
+    {
+      skipped++;
+      return;
+    }
+
+  if (! pd->count)
+    {
+      pd->afi = afi;
+      memcpy (pd->attr, abuf, alen);
+      pd->attr_len = alen;
+      memcpy (pd->nh, nh, nh_len);
+      pd->nh_len = nh_len;
+    }
+  pd->nlri[pd->nlri_len++] = plen;
+  memcpy (pd->nlri + pd->nlri_len, pfx, psize);
+  pd->nlri_len += psize;
+  pd->count++;
+}
+
+static int
+table_dump_v2 (u_int16_t subtype, const u_char *p, size_t len)
+{
+  const u_char *end = p + len;
+  const u_char *pfx;
+  unsigned int count, idx, i;
+  size_t vlen, alen;
+  u_char plen;
+  afi_t afi;
+
+  switch (subtype)
+    {
+    case TABLE_DUMP_V2_PEER_INDEX_TABLE:
+      if (len < 8)
+        return -1;
+      vlen = p[4] << 8 | p[5];
+      if (len < 8 + vlen)
+        return -1;
+      pending_flush_all ();
+      free (pending);
+      npending = p[6 + vlen] << 8 | p[7 + vlen];
+      pending = calloc (npending ? npending : 1, sizeof (struct pending));
+      return 0;
+    case TABLE_DUMP_V2_RIB_IPV4_UNICAST:
+      afi = AFI_IP;
+      break;
+    case TABLE_DUMP_V2_RIB_IPV6_UNICAST:
+      afi = AFI_IP6;
+      break;
+    default:
+      skipped++;
+      return 0;
+    }
+
+  if (len < 5)
+    return -1;
+  plen = p[4];
+  pfx = p + 5;
+  p = pfx + (plen + 7) / 8;
+  if (plen > (afi == AFI_IP ? IPV4_MAX_BITLEN : IPV6_MAX_BITLEN)
+      || p + 2 > end)
+    return -1;
+  count = p[0] << 8 | p[1];
+  p += 2;
+
+  for (i = 0; i < count; i++)
+    {
+      if (p + 8 > end)
+        return -1;
+      idx = p[0] << 8 | p[1];
+      alen = p[6] << 8 | p[7];
+      p += 8;
+      if (p + alen > end)
+        return -1;
+      rib_entry_add (idx, afi, plen, pfx, p, alen);
+      p += alen;
+    }
+  return 0;
+}
+
+static int
+bgp4mp (u_int16_t subtype, const u_char *p, size_t len)
+{
+  const u_char *msg;
+  size_t off, mlen;
+
+  switch (subtype)
+    {
+    case BGP4MP_MESSAGE_AS4:
+      break;
+    case BGP4MP_MESSAGE:
+      skipped++;
+      return 0;
+    default:
+      return 0;
+    }
+
+  /* Peer and local AS, ifindex, AFI and the two addresses. */
+  if (len < 12)
+    return -1;
+  off = 12 + 2 * ((p[10] << 8 | p[11]) == AFI_IP6 ? 16 : 4);
+  if (len < off + BGP_HEADER_SIZE)
+    return -1;
+
+  msg = p + off;
+  mlen = msg[BGP_MARKER_SIZE] << 8 | msg[BGP_MARKER_SIZE + 1];
+  if (mlen < BGP_HEADER_SIZE || mlen > len - off)
+    return -1;
+  if (msg[BGP_MARKER_SIZE + 2] != BGP_MSG_UPDATE)
+    return 0;
+
+  memcpy (msgs_grow (mlen), msg, mlen);
+  msg_count++;
+  prefix_count += update_count (msg, mlen);
+  return 0;
+}
+
+/* Turn the MRT file into the UPDATEs to send. */
+static int
+mrt_load (const char *path)
+{
+  struct stat st;
+  u_char *buf, *p, *end;
+  u_int16_t type, subtype;
+  size_t len;
+  unsigned long records = 0;
+  FILE *fp;
+  int ret = 0;
+
+  if ((fp = fopen (path, "r")) == NULL || fstat (fileno (fp), &st) < 0)
+    {
+      fprintf (stderr, "%s: %s\n", path, safe_strerror (errno));
+      return -1;
+    }
+  buf = malloc (st.st_size ? st.st_size : 1);
+  if (! buf || fread (buf, 1, st.st_size, fp) != (size_t) st.st_size)
+    {
+      fprintf (stderr, "%s: read failed\n", path);
+      fclose (fp);
+      return -1;
+    }
+  fclose (fp);
+
+  for (p = buf, end = buf + st.st_size; p < end && ret == 0; p += len)
+    {
+      if (p + MRT_HEADER_SIZE > end)
+        {
+          ret = -1;
+          break;
+        }
+      type = p[4] << 8 | p[5];
+      subtype = p[6] << 8 | p[7];
+      len = p[8] << 24 | p[9] << 16 | p[10] << 8 | p[11];
+      p += MRT_HEADER_SIZE;
+      if (p + len > end)
+        {
+          ret = -1;
+          break;
+        }
+      records++;
+
+      switch (type)
+        {
+        case MRT_TABLE_DUMP_V2:
+          ret = table_dump_v2 (subtype, p, len);
+          break;
+        case MRT_BGP4MP_ET:
+          /* Microseconds, then as for BGP4MP. */
+          if (len < 4)
+            ret = -1;
+          else
+            ret = bgp4mp (subtype, p + 4, len - 4);
+          break;
+        case MSG_PROTOCOL_BGP4MP:
+          ret = bgp4mp (subtype, p, len);
+          break;
+        default:
+          skipped++;
+          break;
+        }
+    }
+  pending_flush_all ();
+  free (buf);
+
+  if (ret < 0)
+    fprintf (stderr, "%s: malformed record %lu\n", path, records);
+  return ret;
+}
+
+static struct peer *
+replay_peer_new (struct bgp *bgp, unsigned int i, int fd)
+{
+  struct peer *peer;
+  char host[32];
+  afi_t afi;
+
+  peer = peer_create_accept (bgp);
+  snprintf (host, sizeof (host), "replay-%u", i);
+  peer->host = XSTRDUP (MTYPE_BGP_PEER_HOST, host);
+  peer->su.sin.sin_family = AF_INET;
+  peer->su.sin.sin_addr.s_addr = htonl (0x0a000001 + i);
+  peer->remote_id = peer->su.sin.sin_addr;
+  peer->as = REPLAY_AS + 1 + i;
+  peer->local_as = bgp->as;
+  peer->ttl = 1;
+  SET_FLAG (peer->cap, PEER_CAP_AS4_RCV | PEER_CAP_AS4_ADV);
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    {
+      peer->afc[afi][SAFI_UNICAST] = 1;
+      peer->afc_adv[afi][SAFI_UNICAST] = 1;
+      peer->afc_recv[afi][SAFI_UNICAST] = 1;
+      peer->afc_nego[afi][SAFI_UNICAST] = 1;
+    }
+
+  peer->fd = fd;
+  peer->status = Established;
+  peer->t_read = thread_add_read (master, bgp_read, peer, fd);
+  return peer;
+}
+
+/* Everything sent has been read and dealt with. */
+static int
+replay_done (struct peer **peers, size_t *sent, unsigned int npeers)
+{
+  unsigned int i;
+
+  for (i = 0; i < npeers; i++)
+    if (sent[i] < msgs_len || bgp_read_pending (peers[i]))
+      return 0;
+
+  if (bm->process_main_queue && listcount (bm->process_main_queue->items))
+    return 0;
+  return 1;
+}
+
+static int
+stage_of (struct thread *thread)
+{
+  if (! strcmp (thread->funcname, "bgp_read"))
+    return STAGE_RECEIVE;
+  if (! strcmp (thread->funcname, "work_queue_run"))
+    return STAGE_PROCESS;
+  return STAGE_OTHER;
+}
+
+/* Prefixes in a RIB, and the paths to them. */
+static unsigned long
+rib_count (struct bgp_table *table, unsigned long *paths)
+{
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+  unsigned long n = 0;
+
+  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+    if (rn->info)
+      {
+        n++;
+        for (ri = rn->info; ri; ri = ri->next)
+          (*paths)++;
+      }
+  return n;
+}
+
+static unsigned long
+cpu_usec (void)
+{
+  struct rusage ru;
+
+  getrusage (RUSAGE_SELF, &ru);
+  return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000
+         + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+static void
+usage (void)
+{
+  fprintf (stderr, "usage: bgpmrtreplay [-n peers] file\n");
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  struct bgp *bgp;
+  struct peer **peers;
+  struct thread thread;
+  struct timeval start;
+  struct rusage ru;
+  unsigned long t, cpu, paths = 0, n4, n6;
+  unsigned int npeers = 1, i;
+  as_t as = REPLAY_AS;
+  size_t *sent;
+  int *fds;
+  int c, s;
+
+  while ((c = getopt (argc, argv, "n:")) != -1)
+    switch (c)
+      {
+      case 'n':
+        npeers = atoi (optarg);
+        break;
+      default:
+        usage ();
+      }
+  if (optind != argc - 1 || npeers < 1)
+    usage ();
+
+  zprivs_init (&bgpd_privs);
+  bgp_master_init ();
+  master = bm->master;
+  bgp_attr_init ();
+  if_init ();
+
+  /* No zebra. */
+  zclient = zclient_new ();
+  zclient->sock = -1;
+  zlookup = zclient_new ();
+  zlookup->sock = -1;
+
+  if (mrt_load (argv[optind]) < 0)
+    return 1;
+  printf ("%s: %lu UPDATEs, %lu prefixes, %lu skipped\n", argv[optind],
+          msg_count, prefix_count, skipped);
+
+  bm->port = 0;
+  if (bgp_get (&bgp, &as, NULL))
+    {
+      fprintf (stderr, "failed to create BGP instance\n");
+      return 1;
+    }
+
+  peers = calloc (npeers, sizeof (struct peer *));
+  sent = calloc (npeers, sizeof (size_t));
+  fds = calloc (npeers, sizeof (int));
+  for (i = 0; i < npeers; i++)
+    {
+      int sv[2];
+
+      if (socketpair (AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+        {
+          fprintf (stderr, "socketpair: %s\n", safe_strerror (errno));
+          return 1;
+        }
+      for (s = 0; s < 2; s++)
+        {
+          set_nonblocking (sv[s]);
+          setsockopt_so_sendbuf (sv[s], REPLAY_SOCKBUF);
+          setsockopt_so_recvbuf (sv[s], REPLAY_SOCKBUF);
+        }
+      peers[i] = replay_peer_new (bgp, i, sv[0]);
+      fds[i] = sv[1];
+    }
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  while (! replay_done (peers, sent, npeers))
+    {
+      for (i = 0; i < npeers; i++)
+        {
+          ssize_t n;
+
+          if (sent[i] < msgs_len
+              && (n = write (fds[i], msgs + sent[i], msgs_len - sent[i])) > 0)
+            sent[i] += n;
+        }
+
+      if (! thread_fetch (master, &thread))
+        break;
+      s = stage_of (&thread);
+      cpu = cpu_usec ();
+      thread_call (&thread);
+      stage[s].cpu += cpu_usec () - cpu;
+      stage[s].calls++;
+    }
+  t = quagga_elapsed (&start);
+
+  printf ("%u peer%s, %lu.%03lu s, %.0f prefixes/s\n",
+          npeers, npeers == 1 ? "" : "s", t / 1000000, t / 1000 % 1000,
+          t ? (double) prefix_count * npeers * 1000000 / t : 0.0);
+
+  printf ("%-10s %10s %10s\n", "stage", "cpu(ms)", "calls");
+  for (s = 0; s < STAGE_MAX; s++)
+    printf ("%-10s %10lu %10lu\n", stage_name[s], stage[s].cpu / 1000,
+            stage[s].calls);
+
+  getrusage (RUSAGE_SELF, &ru);
+  printf ("peak RSS %ld kB\n", ru.ru_maxrss);
+  n4 = rib_count (bgp->rib[AFI_IP][SAFI_UNICAST], &paths);
+  n6 = rib_count (bgp->rib[AFI_IP6][SAFI_UNICAST], &paths);
+  printf ("RIB %lu IPv4, %lu IPv6 prefixes, %lu paths\n", n4, n6, paths);
+  printf ("interned %lu attr, %lu aspath, %lu community, "
+          "%lu ecommunity, %lu transit\n",
+          attr_count (), aspath_count (), community_count (),
+          ecommunity_count (), attr_unknown_count ());
+
+  return 0;
+}
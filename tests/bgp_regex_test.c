@@ -0,0 +1,197 @@
+/*
+ * AS path regular expression test and benchmark.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/* Match a set of AS path filters against paths of the kinds seen in a
+ * full table, including sets and confederation segments, both with
+ * bgp_aspath_regexec() and with plain regexec().  The answers must be
+ * the same; the times show what the fast forms save.
+ */
+#include <zebra.h>
+
+#include "memory.h"
+#include "thread.h"
+#include "privs.h"
+#include "vty.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_regex.h"
+
+/* need these to link in libbgp */
+struct zebra_privs_t *bgpd_privs = NULL;
+struct thread_master *master = NULL;
+
+#define PATH_COUNT	20000
+#define ROUNDS		10
+
+static const char *patterns[] =
+{
+  ".*",
+  "^$",
+  "_65000_",
+  "^65000_",
+  "_65000$",
+  "^65000$",
+  "_3356_",
+  "_701_1239_",
+  "^174_3356_",
+  "_65001_65002$",
+  "_1_",
+  "_65000",
+  "^65000",
+  "65000_",
+  "_6500._",
+  "^(174|3356)_",
+  "_[0-9]+_65000_",
+  NULL,
+};
+
+/* A few ASNs are common, so that the filters above have something to
+   find. */
+static const as_t common[] =
+{
+  1, 174, 701, 1239, 3356, 65000, 65001, 65002, 65003, 650001,
+};
+
+static as_t
+random_as (void)
+{
+  if (random () % 3 == 0)
+    return common[random () % (sizeof (common) / sizeof (common[0]))];
+  return 1 + random () % 70000;
+}
+
+static struct aspath *
+random_path (void)
+{
+  char buf[256];
+  int len = 0;
+  int i, n;
+
+  switch (random () % 8)
+    {
+    case 0:
+      /* Confederation segment first. */
+      len += snprintf (buf + len, sizeof (buf) - len, "(%u %u) ",
+                       random_as (), random_as ());
+      break;
+    case 1:
+      if (random () % 4 == 0)
+        {
+          /* Empty path, as for locally originated routes. */
+          buf[0] = '\0';
+          return aspath_intern (aspath_str2aspath (buf));
+        }
+      break;
+    }
+
+  n = 1 + random () % 6;
+  for (i = 0; i < n; i++)
+    len += snprintf (buf + len, sizeof (buf) - len, "%s%u",
+                     i ? " " : "", random_as ());
+
+  if (random () % 8 == 0)
+    /* Aggregated, with an AS set at the end. */
+    len += snprintf (buf + len, sizeof (buf) - len, " {%u,%u}",
+                     random_as (), random_as ());
+
+  return aspath_intern (aspath_str2aspath (buf));
+}
+
+int
+main (void)
+{
+  struct aspath **paths;
+  struct aspath_regex *ar;
+  regex_t *reg;
+  struct timeval start;
+  unsigned long fast, slow;
+  int i, j, r, hits, diff, failed = 0;
+
+  master = thread_master_create ();
+  bgp_master_init ();
+  aspath_init ();
+  srandom (1);
+
+  paths = calloc (PATH_COUNT, sizeof (struct aspath *));
+  for (i = 0; i < PATH_COUNT; i++)
+    paths[i] = random_path ();
+
+  printf ("%-18s %5s %8s %10s %10s\n", "pattern", "fast", "matches",
+          "fast(ns)", "regexec(ns)");
+
+  for (j = 0; patterns[j]; j++)
+    {
+      ar = bgp_aspath_regcomp (patterns[j]);
+      reg = bgp_regcomp (patterns[j]);
+      if (! ar || ! reg)
+        {
+          printf ("%s: failed to compile\n", patterns[j]);
+          failed++;
+          continue;
+        }
+
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+      for (r = 0; r < ROUNDS; r++)
+        for (i = 0; i < PATH_COUNT; i++)
+          bgp_aspath_regexec (ar, paths[i]);
+      fast = quagga_elapsed (&start);
+
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+      for (r = 0; r < ROUNDS; r++)
+        for (i = 0; i < PATH_COUNT; i++)
+          regexec (reg, paths[i]->str, 0, NULL, 0);
+      slow = quagga_elapsed (&start);
+
+      for (i = 0, hits = 0, diff = 0; i < PATH_COUNT; i++)
+        {
+          int want = regexec (reg, paths[i]->str, 0, NULL, 0) != REG_NOMATCH;
+          int got = bgp_aspath_regexec (ar, paths[i]) != REG_NOMATCH;
+
+          hits += got;
+          if (want != got)
+            {
+              if (diff++ < 5)
+                printf ("%s: \"%s\" gives %d, regexec %d\n", patterns[j],
+                        paths[i]->str, got, want);
+            }
+        }
+
+      printf ("%-18s %5s %8d %10lu %10lu\n", patterns[j],
+              ar->fast ? "yes" : "no", hits,
+              fast * 1000 / (ROUNDS * PATH_COUNT),
+              slow * 1000 / (ROUNDS * PATH_COUNT));
+      if (diff)
+        {
+          printf ("%s: %d results differ\n", patterns[j], diff);
+          failed++;
+        }
+
+      bgp_aspath_regex_free (ar);
+      bgp_regex_free (reg);
+    }
+
+  for (i = 0; i < PATH_COUNT; i++)
+    aspath_unintern (&paths[i]);
+  free (paths);
+
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,154 @@
+/*
+ * Hash table benchmark.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/* Fill a hash from its default size to about as many entries as a full
+ * table has attributes, then release and re-add random entries while
+ * it grows and an iterator releases every other one.  Each step is
+ * checked against a plain array of which entries should be present.
+ */
+#include <zebra.h>
+
+#include "memory.h"
+#include "hash.h"
+#include "thread.h"
+
+struct thread_master *master;
+
+#define ENTRY_COUNT	1000000
+#define CHURN_COUNT	2000000
+
+static unsigned int vals[ENTRY_COUNT];
+static char present[ENTRY_COUNT];
+
+static unsigned int
+val_key (void *p)
+{
+  /* A weak key, so that probe sequences get some length. */
+  return *(unsigned int *) p * 2654435761U >> 8;
+}
+
+static int
+val_cmp (const void *p1, const void *p2)
+{
+  return *(const unsigned int *) p1 == *(const unsigned int *) p2;
+}
+
+static unsigned long walked;
+
+static void
+release_odd (struct hash_backet *backet, void *arg)
+{
+  struct hash *hash = arg;
+  unsigned int *val = backet->data;
+
+  walked++;
+  if (*val & 1)
+    {
+      hash_release (hash, val);
+      present[val - vals] = 0;
+    }
+}
+
+static unsigned int
+check (struct hash *hash)
+{
+  unsigned int i, wrong = 0;
+  unsigned long count = 0;
+
+  for (i = 0; i < ENTRY_COUNT; i++)
+    {
+      if ((hash_lookup (hash, &vals[i]) != NULL) != present[i])
+	wrong++;
+      count += present[i];
+    }
+  if (count != hash->count)
+    wrong++;
+  return wrong;
+}
+
+int
+main (void)
+{
+  struct hash *hash;
+  struct timeval start;
+  unsigned long t;
+  unsigned int i, n, wrong = 0;
+
+  for (i = 0; i < ENTRY_COUNT; i++)
+    vals[i] = i;
+
+  hash = hash_create (val_key, val_cmp);
+  srandom (1);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < ENTRY_COUNT; i++)
+    {
+      hash_get (hash, &vals[i], hash_alloc_intern);
+      present[i] = 1;
+    }
+  t = quagga_elapsed (&start);
+  printf ("%lu entries, %u slots, grown %lu times\n",
+	  hash->count, hash->size, hash->expands);
+  printf ("%-24s %8lu ns/op\n", "insert", t * 1000 / ENTRY_COUNT);
+  wrong += check (hash);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < ENTRY_COUNT; i++)
+    hash_lookup (hash, &vals[i]);
+  t = quagga_elapsed (&start);
+  printf ("%-24s %8lu ns/op\n", "lookup", t * 1000 / ENTRY_COUNT);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < CHURN_COUNT; i++)
+    {
+      n = random () % ENTRY_COUNT;
+      if (present[n])
+	hash_release (hash, &vals[n]);
+      else
+	hash_get (hash, &vals[n], hash_alloc_intern);
+      present[n] = !present[n];
+    }
+  t = quagga_elapsed (&start);
+  printf ("%-24s %8lu ns/op\n", "release/re-add", t * 1000 / CHURN_COUNT);
+  wrong += check (hash);
+
+  n = hash->count;
+  walked = 0;
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  hash_iterate (hash, release_odd, hash);
+  t = quagga_elapsed (&start);
+  printf ("%-24s %8lu ns/entry\n", "iterate", walked ? t * 1000 / walked : 0);
+  if (walked != n)
+    wrong++;
+  wrong += check (hash);
+
+  hash_clean (hash, NULL);
+  memset (present, 0, sizeof (present));
+  wrong += check (hash);
+  hash_free (hash);
+
+  if (wrong)
+    {
+      printf ("%u checks failed\n", wrong);
+      return 1;
+    }
+  return 0;
+}
@@ -0,0 +1,100 @@
+/*
+ * Slab allocator benchmark.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/* Compare a MEMORY_SLAB type against a plain malloc'd type, with the
+ * sort of churn a BGP table sees: fill, withdraw and re-add a random
+ * half, then flush.  Each allocator is run in its own process so that
+ * the peak RSS reported is its own.
+ */
+#include <zebra.h>
+#include <sys/wait.h>
+
+#include "memory.h"
+#include "thread.h"
+
+struct thread_master *master;
+
+#define OBJ_SIZE 	88	/* roughly a struct bgp_info */
+#define OBJ_COUNT	2000000
+
+static void
+churn (const char *name, int mtype)
+{
+  void **objs;
+  struct timeval start;
+  struct rusage ru;
+  unsigned long fill, readd, flush;
+  int i;
+
+  objs = calloc (OBJ_COUNT, sizeof (void *));
+  srandom (1);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < OBJ_COUNT; i++)
+    objs[i] = XCALLOC (mtype, OBJ_SIZE);
+  fill = quagga_elapsed (&start) / 1000;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < OBJ_COUNT; i++)
+    if (random () & 1)
+      XFREE (mtype, objs[i]);
+  for (i = 0; i < OBJ_COUNT; i++)
+    if (objs[i] == NULL)
+      objs[i] = XCALLOC (mtype, OBJ_SIZE);
+  readd = quagga_elapsed (&start) / 1000;
+
+  getrusage (RUSAGE_SELF, &ru);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < OBJ_COUNT; i++)
+    XFREE (mtype, objs[i]);
+  flush = quagga_elapsed (&start) / 1000;
+
+  printf ("%-8s %9lu %9lu %9lu %10ld\n", name, fill, readd, flush,
+          ru.ru_maxrss);
+  free (objs);
+}
+
+static void
+run (const char *name, int mtype)
+{
+  pid_t pid;
+
+  fflush (stdout);
+  if ((pid = fork ()) == 0)
+    {
+      churn (name, mtype);
+      exit (0);
+    }
+  waitpid (pid, NULL, 0);
+}
+
+int
+main (void)
+{
+  printf ("%d objects of %d bytes\n", OBJ_COUNT, OBJ_SIZE);
+  printf ("%-8s %9s %9s %9s %10s\n", "", "fill(ms)", "readd(ms)",
+          "flush(ms)", "maxrss(KB)");
+
+  run ("malloc", MTYPE_TMP);
+  run ("slab", MTYPE_BGP_ROUTE);
+  return 0;
+}
@@ -0,0 +1,221 @@
+/*
+ * Prefix-list benchmark.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/* Build a prefix-list shaped like one generated from IRR data, mostly
+ * exact /24s and /22-/16 aggregates with "le 24", with some denies and
+ * overlapping entries, then apply it to a mix of prefixes.  Results are
+ * checked against a plain first-match scan of the entries in sequence
+ * order, which is also timed, before and after deleting half the list.
+ */
+#include <zebra.h>
+
+#include "command.h"
+#include "memory.h"
+#include "prefix.h"
+#include "plist.h"
+#include "thread.h"
+
+struct thread_master *master;
+
+#define ENTRY_COUNT	150000
+#define LOOKUP_COUNT	1000000
+#define SCAN_COUNT	2000
+
+static char list_name[] = "irr";
+
+struct entry
+{
+  struct orf_prefix orf;
+  int permit;
+  int deleted;
+};
+
+static struct entry *entries;
+static int nentries;
+
+static void
+random_entry (struct entry *e, u_int32_t seq)
+{
+  unsigned int r = random () % 100;
+  struct prefix *p = &e->orf.p;
+
+  memset (e, 0, sizeof (struct entry));
+  e->orf.seq = seq;
+  e->permit = (random () % 20) != 0;
+
+  p->family = AF_INET;
+  if (r < 70)
+    p->prefixlen = 24;
+  else
+    {
+      p->prefixlen = 16 + random () % 8;
+      e->orf.le = 24;
+      if (r >= 95)
+        e->orf.ge = p->prefixlen + 1;
+    }
+  p->u.prefix4.s_addr = htonl ((1 + random () % 223) << 24
+                               | (random () & 0xffffff));
+  apply_mask (p);
+}
+
+static void
+random_prefix (struct prefix *p)
+{
+  memset (p, 0, sizeof (struct prefix));
+  p->family = AF_INET;
+
+  /* Mostly prefixes from the list's own address space. */
+  if (random () % 4)
+    {
+      struct entry *e = &entries[random () % nentries];
+
+      *p = e->orf.p;
+      if (e->orf.le && random () % 2)
+        {
+          p->prefixlen = e->orf.p.prefixlen
+                         + random () % (25 - e->orf.p.prefixlen);
+          p->u.prefix4.s_addr |= htonl (random ()
+                                        & ~(0xffffffff << (32 - p->prefixlen))
+                                        & 0xffffff00);
+          apply_mask (p);
+        }
+      return;
+    }
+
+  p->prefixlen = 8 + random () % 25;
+  p->u.prefix4.s_addr = htonl ((1 + random () % 223) << 24
+                               | (random () & 0xffffff));
+  apply_mask (p);
+}
+
+/* What a first-match scan of the list in sequence order gives. */
+static enum prefix_list_type
+scan (struct prefix *p)
+{
+  struct entry *e;
+  int i;
+
+  for (i = 0; i < nentries; i++)
+    {
+      e = &entries[i];
+      if (e->deleted || ! prefix_match (&e->orf.p, p))
+        continue;
+      if (! e->orf.le && ! e->orf.ge)
+        {
+          if (e->orf.p.prefixlen != p->prefixlen)
+            continue;
+        }
+      else
+        {
+          if (e->orf.le && p->prefixlen > e->orf.le)
+            continue;
+          if (e->orf.ge && p->prefixlen < e->orf.ge)
+            continue;
+        }
+      return e->permit ? PREFIX_PERMIT : PREFIX_DENY;
+    }
+  return PREFIX_DENY;
+}
+
+static int
+run (struct prefix_list *plist, struct prefix *prefixes, const char *what)
+{
+  struct timeval start;
+  unsigned long t;
+  unsigned int i, permit, diff;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0, permit = 0; i < LOOKUP_COUNT; i++)
+    if (prefix_list_apply (plist, &prefixes[i]) == PREFIX_PERMIT)
+      permit++;
+  t = quagga_elapsed (&start);
+  printf ("%-24s %8lu ns/op, %u permitted\n", what,
+          t * 1000 / LOOKUP_COUNT, permit);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0, diff = 0; i < SCAN_COUNT; i++)
+    if (scan (&prefixes[i]) != prefix_list_apply (plist, &prefixes[i]))
+      diff++;
+  t = quagga_elapsed (&start);
+  printf ("%-24s %8lu ns/op\n", "  first-match scan", t * 1000 / SCAN_COUNT);
+
+  if (diff)
+    printf ("%u of %u results differ\n", diff, SCAN_COUNT);
+  return diff;
+}
+
+int
+main (void)
+{
+  struct prefix_list *plist;
+  struct prefix *prefixes;
+  struct timeval start;
+  unsigned long t;
+  int i, n, failed = 0;
+
+  master = thread_master_create ();
+  srandom (1);
+
+  entries = calloc (ENTRY_COUNT, sizeof (struct entry));
+  prefixes = calloc (LOOKUP_COUNT, sizeof (struct prefix));
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0, n = 0; i < ENTRY_COUNT; i++)
+    {
+      struct entry *e = &entries[n];
+
+      random_entry (e, (i + 1) * 5);
+      if (prefix_bgp_orf_set (list_name, AFI_IP, &e->orf, e->permit, 1)
+          == CMD_SUCCESS)
+        n++;
+    }
+  nentries = n;
+  t = quagga_elapsed (&start);
+  printf ("%d entries\n", nentries);
+  printf ("%-24s %8lu ns/op\n", "add", t * 1000 / ENTRY_COUNT);
+
+  plist = prefix_list_lookup (AFI_ORF_PREFIX, list_name);
+  for (i = 0; i < LOOKUP_COUNT; i++)
+    random_prefix (&prefixes[i]);
+
+  failed += run (plist, prefixes, "apply");
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < nentries; i += 2)
+    {
+      struct entry *e = &entries[i];
+
+      if (prefix_bgp_orf_set (list_name, AFI_IP, &e->orf, e->permit, 0)
+          != CMD_SUCCESS)
+        {
+          printf ("failed to delete entry %d\n", i);
+          failed++;
+        }
+      e->deleted = 1;
+    }
+  t = quagga_elapsed (&start);
+  printf ("%-24s %8lu ns/op\n", "delete", t * 2000 / nentries);
+
+  failed += run (plist, prefixes, "apply (half deleted)");
+
+  prefix_bgp_orf_remove_all (list_name);
+  return failed ? 1 : 0;
+}
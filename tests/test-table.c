@@ -0,0 +1,171 @@
+/*
+ * Route table benchmark.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/* Insert, look up, walk and delete an IPv4 table of about the size and
+ * prefix length mix of a full Internet table.  Longest prefix matches
+ * are run both with the table's index and from the top of the tree,
+ * and must give the same answers.
+ */
+#include <zebra.h>
+
+#include "memory.h"
+#include "prefix.h"
+#include "table.h"
+#include "thread.h"
+
+struct thread_master *master;
+
+#define PREFIX_COUNT	500000
+#define LOOKUP_COUNT	2000000
+
+/* Rough share of each prefix length, in 1/1000ths. */
+static const struct
+{
+  u_char len;
+  unsigned int share;
+} mix[] =
+{
+  { 24, 560 }, { 23, 90 }, { 22, 100 }, { 21, 50 }, { 20, 50 },
+  { 19, 40 }, { 18, 25 }, { 17, 15 }, { 16, 40 }, { 15, 5 },
+  { 14, 8 }, { 13, 5 }, { 12, 3 }, { 11, 2 }, { 10, 1 },
+  { 8, 1 }, { 0, 0 },
+};
+
+static void
+random_prefix (struct prefix_ipv4 *p)
+{
+  unsigned int r = random () % 1000;
+  int i;
+
+  for (i = 0; mix[i + 1].len && r >= mix[i].share; i++)
+    r -= mix[i].share;
+
+  p->family = AF_INET;
+  p->prefixlen = mix[i].len;
+  /* Unicast space, weighted low like real allocations. */
+  p->prefix.s_addr = htonl ((1 + random () % 223) << 24
+                            | (random () & 0xffffff));
+  apply_mask_ipv4 (p);
+}
+
+int
+main (void)
+{
+  struct route_table *table;
+  struct route_node *rn;
+  struct route_node **index;
+  struct prefix_ipv4 *prefixes;
+  struct in_addr *addrs;
+  struct route_node **found;
+  struct timeval start;
+  unsigned long t;
+  unsigned int i, n, hits, diff;
+
+  master = thread_master_create ();
+  srandom (1);
+
+  prefixes = calloc (PREFIX_COUNT, sizeof (struct prefix_ipv4));
+  addrs = calloc (LOOKUP_COUNT, sizeof (struct in_addr));
+  found = calloc (LOOKUP_COUNT, sizeof (struct route_node *));
+
+  for (i = 0; i < PREFIX_COUNT; i++)
+    random_prefix (&prefixes[i]);
+  for (i = 0; i < LOOKUP_COUNT; i++)
+    addrs[i].s_addr = htonl ((1 + random () % 223) << 24
+                             | (random () & 0xffffff));
+
+  table = route_table_init ();
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0, n = 0; i < PREFIX_COUNT; i++)
+    {
+      rn = route_node_get (table, (struct prefix *) &prefixes[i]);
+      if (rn->info)
+        route_unlock_node (rn);
+      else
+        {
+          rn->info = &prefixes[i];
+          n++;
+        }
+    }
+  t = quagga_elapsed (&start);
+  printf ("%u prefixes, %lu nodes\n", n, table->count);
+  printf ("%-24s %8lu ns/op\n", "insert", t * 1000 / PREFIX_COUNT);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0, hits = 0; i < LOOKUP_COUNT; i++)
+    if ((found[i] = route_node_match_ipv4 (table, &addrs[i])))
+      {
+        route_unlock_node (found[i]);
+        hits++;
+      }
+  t = quagga_elapsed (&start);
+  printf ("%-24s %8lu ns/op, %u found\n", "match (indexed)",
+          t * 1000 / LOOKUP_COUNT, hits);
+
+  index = table->index;
+  table->index = NULL;
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0, diff = 0; i < LOOKUP_COUNT; i++)
+    {
+      rn = route_node_match_ipv4 (table, &addrs[i]);
+      if (rn)
+        route_unlock_node (rn);
+      if (rn != found[i])
+        diff++;
+    }
+  t = quagga_elapsed (&start);
+  table->index = index;
+  printf ("%-24s %8lu ns/op\n", "match (tree)", t * 1000 / LOOKUP_COUNT);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < PREFIX_COUNT; i++)
+    if ((rn = route_node_lookup (table, (struct prefix *) &prefixes[i])))
+      route_unlock_node (rn);
+  t = quagga_elapsed (&start);
+  printf ("%-24s %8lu ns/op\n", "lookup", t * 1000 / PREFIX_COUNT);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (rn = route_top (table), i = 0; rn; rn = route_next (rn))
+    i++;
+  t = quagga_elapsed (&start);
+  printf ("%-24s %8lu ns/node\n", "walk", t * 1000 / i);
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+  for (i = 0; i < PREFIX_COUNT; i++)
+    if ((rn = route_node_lookup (table, (struct prefix *) &prefixes[i])))
+      {
+        rn->info = NULL;
+        route_unlock_node (rn);
+        route_unlock_node (rn);
+      }
+  t = quagga_elapsed (&start);
+  printf ("%-24s %8lu ns/op\n", "delete", t * 1000 / PREFIX_COUNT);
+
+  if (diff || table->count)
+    {
+      printf ("%u matches differ, %lu nodes left\n", diff, table->count);
+      return 1;
+    }
+
+  route_table_finish (table);
+  return 0;
+}
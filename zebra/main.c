@@ -34,9 +34,11 @@
 #include "sigevent.h"
 
 #include "zebra/rib.h"
+#include "zebra/rt.h"
 #include "zebra/zserv.h"
 #include "zebra/debug.h"
 #include "zebra/router-id.h"
+#include "zebra/zebra_rnh.h"
 #include "zebra/irdp.h"
 #include "zebra/rtadv.h"
 
@@ -168,7 +170,10 @@ sigint (void)
   zlog_notice ("Terminating on signal");
 
   if (!retain_mode)
-    rib_close ();
+    {
+      rib_close ();
+      kernel_route_flush ();
+    }
 #ifdef HAVE_IRDP
   irdp_finish();
 #endif
@@ -324,6 +329,7 @@ main (int argc, char **argv)
   zebra_if_init ();
   zebra_debug_init ();
   router_id_init();
+  zebra_rnh_init ();
   zebra_vty_init ();
   access_list_init ();
   prefix_list_init ();
@@ -91,10 +91,68 @@ struct rib
  * sub-queue 4: any other origin (if any)
  */
 #define MQ_SIZE 5
+
+/* Nodes handled by one run of the meta queue. */
+#define MQ_BATCH_SIZE 64
+
+/* Buckets of the sub-queue histograms.  Bucket 0 counts zeroes, and
+ * bucket i values from 2^(i-1) to 2^i - 1, the last one holding all
+ * larger values.
+ */
+#define MQ_HIST_SIZE 24
+
+struct meta_queue_stats
+{
+  unsigned long queued;		/* nodes added */
+  unsigned long coalesced;	/* changes to nodes already queued */
+  unsigned long processed;
+
+  unsigned long depth[MQ_HIST_SIZE];	/* length, as nodes are added */
+  unsigned long latency[MQ_HIST_SIZE];	/* usecs from added to processed */
+};
+
+/* A route_node waiting in a sub-queue. */
+struct meta_queue_entry
+{
+  struct route_node *rn;
+  struct timeval queued;
+};
+
 struct meta_queue
 {
-  struct list *subq[MQ_SIZE];
+  struct list *subq[MQ_SIZE];	/* of struct meta_queue_entry */
   u_int32_t size; /* sum of lengths of all subqueues */
+
+  /* Statistics. */
+  struct meta_queue_stats stats[MQ_SIZE];
+  unsigned long runs;
+  unsigned long reaped;		/* entries freed without processing */
+};
+
+/* Kernel updates decided by rib_process(), waiting to be applied.
+ * There is at most one queued update per route_node, later decisions
+ * for the node being folded into it.
+ */
+struct fib_update
+{
+  struct route_node *rn;
+
+  /* Copy of the entry in the kernel, to be removed. */
+  struct rib *old;
+
+  /* Entry to be installed, as it is when the update is applied. */
+  struct rib *new;
+};
+
+struct fib_queue
+{
+  struct list *updates;
+  struct hash *pending;	/* by route_node */
+
+  /* Statistics. */
+  unsigned long queued;
+  unsigned long coalesced;
+  unsigned long applied;
 };
 
 /* Static route information. */
@@ -225,6 +283,7 @@ extern struct nexthop *nexthop_ifname_add (struct rib *, char *);
 extern struct nexthop *nexthop_blackhole_add (struct rib *);
 extern struct nexthop *nexthop_ipv4_add (struct rib *, struct in_addr *,
 					 struct in_addr *);
+extern void rib_install_failed (struct prefix *, struct rib *);
 extern void rib_lookup_and_dump (struct prefix_ipv4 *);
 extern void rib_lookup_and_pushup (struct prefix_ipv4 *);
 extern void rib_dump (const char *, const struct prefix_ipv4 *, const struct rib *);
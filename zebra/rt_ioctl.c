@@ -347,6 +347,17 @@ kernel_delete_ipv4 (struct prefix *p, struct rib *rib)
 {
   return kernel_ioctl_ipv4 (SIOCDELRT, p, rib, AF_INET);
 }
+
+/* Ioctls are done as they are made. */
+void
+kernel_route_flush (void)
+{
+}
+
+void
+kernel_route_forget (struct rib *rib)
+{
+}
 
 #ifdef HAVE_IPV6
 
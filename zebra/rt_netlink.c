@@ -231,6 +231,9 @@ netlink_request (int family, int type, struct nlsock *nl)
       return -1;
     }
 
+  if (nl == &netlink_cmd)
+    kernel_route_flush ();
+
   memset (&snl, 0, sizeof snl);
   snl.nl_family = AF_NETLINK;
 
@@ -1176,6 +1179,236 @@ netlink_talk_filter (struct sockaddr_nl *snl, struct nlmsghdr *h)
   return 0;
 }
 
+/* Route changes are not sent one at a time, but appended to a batch
+   which goes to the kernel in one sendmsg() when it fills up, or from
+   an event once the RIB work queue yields.  Only the last message of
+   a batch asks for an ACK.  The kernel handles the messages in order,
+   before sendmsg() returns, so once that ACK is read every message
+   before it without an error reply has been applied.  Error replies
+   are matched back to their route by sequence number.  */
+#define NL_BATCH_BUFSIZE	32768
+#define NL_BATCH_MAX		512
+
+struct nl_batch_route
+{
+  int cmd;
+  struct prefix p;
+  struct rib *rib;
+};
+
+static struct
+{
+  char buf[NL_BATCH_BUFSIZE];
+  size_t len;
+  size_t last;
+  u_int32_t seq;
+  unsigned int count;
+  struct nl_batch_route route[NL_BATCH_MAX];
+  struct thread *t_flush;
+} nl_batch;
+
+static int
+netlink_batch_error (struct nl_batch_route *route, u_int32_t seq, int errnum)
+{
+  char buf[INET6_ADDRSTRLEN];
+
+  /* The same races in link handling netlink_parse_info allows for. */
+  if ((route->cmd == RTM_DELROUTE && (errnum == ENODEV || errnum == ESRCH))
+      || (route->cmd == RTM_NEWROUTE && errnum == EEXIST))
+    {
+      if (IS_ZEBRA_DEBUG_KERNEL)
+	zlog_debug ("%s: error: %s type=%s(%u), seq=%u",
+		    netlink_cmd.name, safe_strerror (errnum),
+		    lookup (nlmsg_str, route->cmd), route->cmd, seq);
+      return 0;
+    }
+
+  zlog_err ("%s error: %s, type=%s(%u), seq=%u, %s/%d",
+	    netlink_cmd.name, safe_strerror (errnum),
+	    lookup (nlmsg_str, route->cmd), route->cmd, seq,
+	    inet_ntop (route->p.family, &route->p.u.prefix, buf, sizeof buf),
+	    route->p.prefixlen);
+
+  if (route->cmd == RTM_NEWROUTE && route->rib)
+    rib_install_failed (&route->p, route->rib);
+  return -1;
+}
+
+/* Read the replies to a batch just sent. */
+static int
+netlink_batch_ack (u_int32_t last)
+{
+  int status;
+  int ret = 0;
+  char buf[4096];
+  struct iovec iov = { buf, sizeof buf };
+  struct sockaddr_nl snl;
+  struct msghdr msg = { (void *) &snl, sizeof snl, &iov, 1, NULL, 0, 0 };
+  struct nlmsghdr *h;
+  struct nlmsgerr *err;
+  u_int32_t seq;
+
+  while (1)
+    {
+      /* Everything was queued before sendmsg() returned, so there is
+         nothing to wait for. */
+      status = recvmsg (netlink_cmd.sock, &msg, MSG_DONTWAIT);
+      if (status < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  zlog (NULL, LOG_ERR, "%s batch seq %u-%u: replies lost: %s",
+		netlink_cmd.name, nl_batch.seq, last,
+		safe_strerror (errno));
+	  return -1;
+	}
+      if (status == 0)
+	{
+	  zlog (NULL, LOG_ERR, "%s EOF", netlink_cmd.name);
+	  return -1;
+	}
+
+      for (h = (struct nlmsghdr *) buf; NLMSG_OK (h, (unsigned int) status);
+	   h = NLMSG_NEXT (h, status))
+	{
+	  if (h->nlmsg_type != NLMSG_ERROR
+	      || h->nlmsg_len < NLMSG_LENGTH (sizeof (struct nlmsgerr)))
+	    {
+	      netlink_talk_filter (&snl, h);
+	      continue;
+	    }
+
+	  err = (struct nlmsgerr *) NLMSG_DATA (h);
+	  seq = err->msg.nlmsg_seq;
+
+	  if (err->error && seq - nl_batch.seq < nl_batch.count)
+	    if (netlink_batch_error (&nl_batch.route[seq - nl_batch.seq],
+				     seq, -err->error) < 0)
+	      ret = -1;
+
+	  if (seq == last)
+	    return ret;
+	}
+    }
+}
+
+/* Send the batch, and read the replies. */
+static int
+netlink_batch_flush (void)
+{
+  int status;
+  struct sockaddr_nl snl;
+  struct iovec iov = { (void *) nl_batch.buf, nl_batch.len };
+  struct msghdr msg = { (void *) &snl, sizeof snl, &iov, 1, NULL, 0, 0 };
+  struct nlmsghdr *n;
+  unsigned int i;
+  int save_errno;
+  int ret;
+
+  if (nl_batch.count == 0)
+    return 0;
+
+  n = (struct nlmsghdr *) (nl_batch.buf + nl_batch.last);
+  n->nlmsg_flags |= NLM_F_ACK;
+
+  if (IS_ZEBRA_DEBUG_KERNEL)
+    zlog_debug ("netlink_batch_flush: %s %u messages, %lu bytes, seq=%u-%u",
+		netlink_cmd.name, nl_batch.count, (unsigned long) nl_batch.len,
+		nl_batch.seq, n->nlmsg_seq);
+
+  memset (&snl, 0, sizeof snl);
+  snl.nl_family = AF_NETLINK;
+
+  if (zserv_privs.change (ZPRIVS_RAISE))
+    zlog (NULL, LOG_ERR, "Can't raise privileges");
+  status = sendmsg (netlink_cmd.sock, &msg, 0);
+  save_errno = errno;
+  if (zserv_privs.change (ZPRIVS_LOWER))
+    zlog (NULL, LOG_ERR, "Can't lower privileges");
+
+  if (status < 0)
+    {
+      zlog (NULL, LOG_ERR, "netlink_batch_flush sendmsg() error: %s",
+	    safe_strerror (save_errno));
+      for (i = 0; i < nl_batch.count; i++)
+	if (nl_batch.route[i].cmd == RTM_NEWROUTE && nl_batch.route[i].rib)
+	  rib_install_failed (&nl_batch.route[i].p, nl_batch.route[i].rib);
+      ret = -1;
+    }
+  else
+    ret = netlink_batch_ack (n->nlmsg_seq);
+
+  nl_batch.len = 0;
+  nl_batch.count = 0;
+  return ret;
+}
+
+static int
+netlink_batch_flush_event (struct thread *thread)
+{
+  nl_batch.t_flush = NULL;
+  netlink_batch_flush ();
+  return 0;
+}
+
+/* Queue a route change to be sent to the kernel. */
+static int
+netlink_batch_add (struct nlmsghdr *n, struct prefix *p, struct rib *rib)
+{
+  struct nl_batch_route *route;
+
+  if (nl_batch.len + NLMSG_ALIGN (n->nlmsg_len) > NL_BATCH_BUFSIZE
+      || nl_batch.count == NL_BATCH_MAX)
+    netlink_batch_flush ();
+
+  n->nlmsg_seq = ++netlink_cmd.seq;
+  if (nl_batch.count == 0)
+    nl_batch.seq = n->nlmsg_seq;
+
+  if (IS_ZEBRA_DEBUG_KERNEL)
+    zlog_debug ("netlink_batch_add: %s type %s(%u), seq=%u",
+		netlink_cmd.name, lookup (nlmsg_str, n->nlmsg_type),
+		n->nlmsg_type, n->nlmsg_seq);
+
+  memcpy (nl_batch.buf + nl_batch.len, n, n->nlmsg_len);
+  nl_batch.last = nl_batch.len;
+  nl_batch.len += NLMSG_ALIGN (n->nlmsg_len);
+
+  route = &nl_batch.route[nl_batch.count++];
+  route->cmd = n->nlmsg_type;
+  prefix_copy (&route->p, p);
+  route->rib = rib;
+
+  if (! nl_batch.t_flush)
+    nl_batch.t_flush = thread_add_event (zebrad.master,
+					 netlink_batch_flush_event, NULL, 0);
+  return 0;
+}
+
+/* Send any route changes still queued. */
+void
+kernel_route_flush (void)
+{
+  if (nl_batch.t_flush)
+    {
+      thread_cancel (nl_batch.t_flush);
+      nl_batch.t_flush = NULL;
+    }
+  netlink_batch_flush ();
+}
+
+/* A RIB entry is being freed.  Don't let an error for a change queued
+   for it find whatever is allocated at its address by then. */
+void
+kernel_route_forget (struct rib *rib)
+{
+  unsigned int i;
+
+  for (i = 0; i < nl_batch.count; i++)
+    if (nl_batch.route[i].rib == rib)
+      nl_batch.route[i].rib = NULL;
+}
+
 /* sendmsg() to netlink socket then recvmsg(). */
 static int
 netlink_talk (struct nlmsghdr *n, struct nlsock *nl)
@@ -1186,6 +1419,11 @@ netlink_talk (struct nlmsghdr *n, struct nlsock *nl)
   struct msghdr msg = { (void *) &snl, sizeof snl, &iov, 1, NULL, 0, 0 };
   int save_errno;
 
+  /* Keep queued route changes in order with this one, and their
+     replies out of the way. */
+  if (nl == &netlink_cmd)
+    kernel_route_flush ();
+
   memset (&snl, 0, sizeof snl);
   snl.nl_family = AF_NETLINK;
 
@@ -1302,7 +1540,6 @@ netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib,
                          int family)
 {
   int bytelen;
-  struct sockaddr_nl snl;
   struct nexthop *nexthop = NULL;
   int nexthop_num = 0;
   int discard;
@@ -1715,12 +1952,8 @@ netlink_route_multipath (int cmd, struct prefix *p, struct rib *rib,
 
 skip:
 
-  /* Destination netlink address. */
-  memset (&snl, 0, sizeof snl);
-  snl.nl_family = AF_NETLINK;
-
-  /* Talk to netlink socket. */
-  return netlink_talk (&req.n, &netlink_cmd);
+  /* Queue for the kernel. */
+  return netlink_batch_add (&req.n, p, rib);
 }
 
 int
@@ -256,6 +256,17 @@ kernel_delete_ipv4 (struct prefix *p, struct rib *rib)
   return route;
 }
 
+/* Routing socket messages are sent as they are made. */
+void
+kernel_route_flush (void)
+{
+}
+
+void
+kernel_route_forget (struct rib *rib)
+{
+}
+
 #ifdef HAVE_IPV6
 
 /* Calculate sin6_len value for netmask socket value. */
@@ -34,12 +34,15 @@
 #include "workqueue.h"
 #include "prefix.h"
 #include "routemap.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "zebra/rib.h"
 #include "zebra/rt.h"
 #include "zebra/zserv.h"
 #include "zebra/redistribute.h"
 #include "zebra/debug.h"
+#include "zebra/zebra_rnh.h"
 
 /* Default rtm_table for all clients */
 extern struct zebra_t zebrad;
@@ -929,6 +932,36 @@ rib_install_kernel (struct route_node *rn, struct rib *rib)
     }
 }
 
+/* The kernel refused a route which rib_install_kernel() had queued
+   for it.  The rib is still allocated, kernel_route_forget() sees to
+   that, but may have been unlinked from its node since.  */
+void
+rib_install_failed (struct prefix *p, struct rib *rib)
+{
+  struct route_table *table;
+  struct route_node *rn;
+  struct rib *match;
+  struct nexthop *nexthop;
+
+  table = vrf_table (p->family == AF_INET ? AFI_IP : AFI_IP6, SAFI_UNICAST, 0);
+  if (! table)
+    return;
+
+  rn = route_node_lookup (table, p);
+  if (! rn)
+    return;
+
+  for (match = rn->info; match; match = match->next)
+    if (match == rib)
+      {
+	for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+	  UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+	zebra_rnh_check (rn);
+	break;
+      }
+  route_unlock_node (rn);
+}
+
 /* Uninstall the route from kernel. */
 static int
 rib_uninstall_kernel (struct route_node *rn, struct rib *rib)
@@ -954,6 +987,205 @@ rib_uninstall_kernel (struct route_node *rn, struct rib *rib)
   return ret;
 }
 
+/* Kernel updates.
+ *
+ * rib_process() doesn't talk to the kernel itself, but queues what it
+ * decided for the route_node on zebrad.fibq, which is run once the RIB
+ * work queue and zserv reads let it.  Further decisions for a node
+ * whose update hasn't been applied yet are merged into that update, so
+ * an entry which is withdrawn before its install is applied never
+ * reaches the kernel, and one which changes many times is installed
+ * once, as it is by then.
+ *
+ * The FIB nexthop flags of an entry are cleared when its removal is
+ * queued, and set again by the kernel code when its install is applied.
+ */
+static unsigned int
+fib_update_hash_key (void *p)
+{
+  struct fib_update *u = p;
+
+  return jhash (&u->rn, sizeof (u->rn), 0);
+}
+
+static int
+fib_update_hash_cmp (const void *p1, const void *p2)
+{
+  const struct fib_update *u1 = p1;
+  const struct fib_update *u2 = p2;
+
+  return u1->rn == u2->rn;
+}
+
+static struct fib_update *
+fib_queue_lookup (struct route_node *rn)
+{
+  struct fib_update lookup;
+
+  lookup.rn = rn;
+  return hash_lookup (zebrad.fq->pending, &lookup);
+}
+
+/* Find the update queued for the node, or queue a new one. */
+static struct fib_update *
+fib_queue_get (struct route_node *rn)
+{
+  struct fib_queue *fq = zebrad.fq;
+  struct fib_update *u;
+
+  if ((u = fib_queue_lookup (rn)))
+    {
+      fq->coalesced++;
+      return u;
+    }
+
+  u = XCALLOC (MTYPE_FIB_UPDATE, sizeof (struct fib_update));
+  u->rn = rn;
+  route_lock_node (rn);
+  hash_get (fq->pending, u, hash_alloc_intern);
+  listnode_add (fq->updates, u);
+  fq->queued++;
+
+  if (! zebrad.fibq->items->count)
+    work_queue_add (zebrad.fibq, fq);
+
+  return u;
+}
+
+/* Copy of an entry as the kernel has it, for removing it later. */
+static struct rib *
+rib_copy_fib (struct rib *rib)
+{
+  struct rib *copy;
+  struct nexthop *nexthop;
+  struct nexthop *new;
+  struct nexthop *last = NULL;
+
+  copy = XMALLOC (MTYPE_RIB, sizeof (struct rib));
+  memcpy (copy, rib, sizeof (struct rib));
+  copy->next = copy->prev = NULL;
+  copy->nexthop = NULL;
+
+  for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+    {
+      new = XMALLOC (MTYPE_NEXTHOP, sizeof (struct nexthop));
+      memcpy (new, nexthop, sizeof (struct nexthop));
+      if (nexthop->ifname)
+	new->ifname = XSTRDUP (0, nexthop->ifname);
+      new->next = NULL;
+      new->prev = last;
+      if (last)
+	last->next = new;
+      else
+	copy->nexthop = new;
+      last = new;
+    }
+
+  return copy;
+}
+
+static void
+rib_free_copy (struct rib *rib)
+{
+  struct nexthop *nexthop, *next;
+
+  for (nexthop = rib->nexthop; nexthop; nexthop = next)
+    {
+      next = nexthop->next;
+      nexthop_free (nexthop);
+    }
+  XFREE (MTYPE_RIB, rib);
+}
+
+/* Queue the install of a RIB entry. */
+static void
+fib_queue_install (struct route_node *rn, struct rib *rib)
+{
+  fib_queue_get (rn)->new = rib;
+}
+
+/* Queue the removal of a RIB entry from the kernel. */
+static void
+fib_queue_uninstall (struct route_node *rn, struct rib *rib)
+{
+  struct fib_update *u;
+  struct nexthop *nexthop;
+
+  u = fib_queue_lookup (rn);
+  if (u && u->new == rib)
+    {
+      /* It hasn't been installed yet. */
+      u->new = NULL;
+      zebrad.fq->coalesced++;
+    }
+  else if (! u || ! u->old)
+    fib_queue_get (rn)->old = rib_copy_fib (rib);
+
+  for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+    UNSET_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB);
+}
+
+/* A RIB entry is being freed, make sure it isn't left queued. */
+static void
+fib_queue_forget (struct route_node *rn, struct rib *rib)
+{
+  struct fib_update *u;
+
+  u = fib_queue_lookup (rn);
+  if (u && u->new == rib)
+    u->new = NULL;
+  kernel_route_forget (rib);
+}
+
+/* Apply the oldest queued update.  wq is zebrad.fibq, and data is the
+ * fib_queue.
+ */
+static wq_item_status
+fib_queue_process (struct work_queue *dummy, void *data)
+{
+  struct fib_queue *fq = data;
+  struct listnode *node;
+  struct fib_update *u;
+  int check = 0;
+
+  if (! (node = listhead (fq->updates)))
+    return WQ_SUCCESS;
+
+  u = listgetdata (node);
+  list_delete_node (fq->updates, node);
+  hash_release (fq->pending, u);
+
+  /* Nexthops never resolve over BGP routes. */
+  if (u->old)
+    {
+      check |= (u->old->type != ZEBRA_ROUTE_BGP);
+      rib_uninstall_kernel (u->rn, u->old);
+      rib_free_copy (u->old);
+    }
+  if (u->new)
+    {
+      check |= (u->new->type != ZEBRA_ROUTE_BGP);
+      rib_install_kernel (u->rn, u->new);
+    }
+  fq->applied++;
+
+  if (check)
+    zebra_rnh_check (u->rn);
+
+  route_unlock_node (u->rn);
+  XFREE (MTYPE_FIB_UPDATE, u);
+
+  return listcount (fq->updates) ? WQ_REQUEUE : WQ_SUCCESS;
+}
+
+/* Apply all queued updates now. */
+static void
+fib_queue_drain (void)
+{
+  while (listcount (zebrad.fq->updates))
+    fib_queue_process (zebrad.fibq, zebrad.fq);
+}
+
 /* Uninstall the route from kernel. */
 static void
 rib_uninstall (struct route_node *rn, struct rib *rib)
@@ -962,7 +1194,7 @@ rib_uninstall (struct route_node *rn, struct rib *rib)
     {
       redistribute_delete (&rn->p, rib);
       if (! RIB_SYSTEM_ROUTE (rib))
-	rib_uninstall_kernel (rn, rib);
+	fib_queue_uninstall (rn, rib);
       UNSET_FLAG (rib->flags, ZEBRA_FLAG_SELECTED);
     }
 }
@@ -979,6 +1211,7 @@ rib_process (struct route_node *rn)
   struct rib *select = NULL;
   struct rib *del = NULL;
   int installed = 0;
+  int check = 0;
   struct nexthop *nexthop = NULL;
   char buf[INET6_ADDRSTRLEN];
   
@@ -1087,13 +1320,15 @@ rib_process (struct route_node *rn)
         {
           redistribute_delete (&rn->p, select);
           if (! RIB_SYSTEM_ROUTE (select))
-            rib_uninstall_kernel (rn, select);
+            fib_queue_uninstall (rn, select);
 
           /* Set real nexthop. */
           nexthop_active_update (rn, select, 1);
   
           if (! RIB_SYSTEM_ROUTE (select))
-            rib_install_kernel (rn, select);
+            fib_queue_install (rn, select);
+          else
+            check = 1;
           redistribute_add (&rn->p, select);
         }
       else if (! RIB_SYSTEM_ROUTE (select))
@@ -1112,7 +1347,7 @@ rib_process (struct route_node *rn)
               break;
             }
           if (! installed) 
-            rib_install_kernel (rn, select);
+            fib_queue_install (rn, select);
         }
       goto end;
     }
@@ -1128,7 +1363,9 @@ rib_process (struct route_node *rn)
           buf, rn->p.prefixlen, fib);
       redistribute_delete (&rn->p, fib);
       if (! RIB_SYSTEM_ROUTE (fib))
-	rib_uninstall_kernel (rn, fib);
+	fib_queue_uninstall (rn, fib);
+      else
+        check = 1;
       UNSET_FLAG (fib->flags, ZEBRA_FLAG_SELECTED);
 
       /* Set real nexthop. */
@@ -1148,7 +1385,9 @@ rib_process (struct route_node *rn)
       nexthop_active_update (rn, select, 1);
 
       if (! RIB_SYSTEM_ROUTE (select))
-        rib_install_kernel (rn, select);
+        fib_queue_install (rn, select);
+      else
+        check = 1;
       SET_FLAG (select->flags, ZEBRA_FLAG_SELECTED);
       redistribute_add (&rn->p, select);
     }
@@ -1163,24 +1402,45 @@ rib_process (struct route_node *rn)
     }
 
 end:
+  /* Routes which don't go through the FIB queue are already in the
+     kernel, so nexthops which resolve over them can be checked now. */
+  if (check)
+    zebra_rnh_check (rn);
+
   if (IS_ZEBRA_DEBUG_RIB_Q)
     zlog_debug ("%s: %s/%d: rn %p dequeued", __func__, buf, rn->p.prefixlen, rn);
 }
 
-/* Take a list of route_node structs and return 1, if there was a record
- * picked from it and processed by rib_process(). Don't process more, 
- * than one RN record; operate only in the specified sub-queue.
+/* Count a value in a sub-queue histogram. */
+static void
+meta_queue_hist_add (unsigned long *hist, unsigned long val)
+{
+  unsigned int i = 0;
+
+  while (val && i < MQ_HIST_SIZE - 1)
+    {
+      val >>= 1;
+      i++;
+    }
+  hist[i]++;
+}
+
+/* Take the first route_node of the specified sub-queue, process it with
+ * rib_process() and return 1, or return 0 if the sub-queue is empty.
  */
 static unsigned int
-process_subq (struct list * subq, u_char qindex)
+process_subq (struct meta_queue *mq, u_char qindex, struct timeval *now)
 {
+  struct list *subq = mq->subq[qindex];
   struct listnode *lnode  = listhead (subq);
+  struct meta_queue_entry *entry;
   struct route_node *rnode;
 
   if (!lnode)
     return 0;
 
-  rnode = listgetdata (lnode);
+  entry = listgetdata (lnode);
+  rnode = entry->rn;
   rib_process (rnode);
 
   if (rnode->info) /* The first RIB record is holding the flags bitmask. */
@@ -1195,25 +1455,37 @@ process_subq (struct list * subq, u_char qindex)
 #endif
   route_unlock_node (rnode);
   list_delete_node (subq, lnode);
+
+  mq->stats[qindex].processed++;
+  meta_queue_hist_add (mq->stats[qindex].latency,
+		       (now->tv_sec - entry->queued.tv_sec) * 1000000
+		       + (now->tv_usec - entry->queued.tv_usec));
+  XFREE (MTYPE_RIB_QUEUE, entry);
   return 1;
 }
 
-/* Dispatch the meta queue by picking, processing and unlocking the next RN from
- * a non-empty sub-queue with lowest priority. wq is equal to zebra->ribq and data
- * is pointed to the meta queue structure.
+/* Dispatch the meta queue by picking, processing and unlocking up to
+ * MQ_BATCH_SIZE RNs, each from the non-empty sub-queue with lowest
+ * priority at the time. wq is equal to zebra->ribq and data is pointed
+ * to the meta queue structure.
  */
 static wq_item_status
 meta_queue_process (struct work_queue *dummy, void *data)
 {
   struct meta_queue * mq = data;
-  unsigned i;
+  struct timeval now;
+  unsigned i, n;
 
-  for (i = 0; i < MQ_SIZE; i++)
-    if (process_subq (mq->subq[i], i))
-      {
-	mq->size--;
-	break;
-      }
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  mq->runs++;
+
+  for (n = 0; n < MQ_BATCH_SIZE && mq->size; n++)
+    for (i = 0; i < MQ_SIZE; i++)
+      if (process_subq (mq, i, &now))
+	{
+	  mq->size--;
+	  break;
+	}
   return mq->size ? WQ_REQUEUE : WQ_SUCCESS;
 }
 
@@ -1239,6 +1511,7 @@ static void
 rib_meta_queue_add (struct meta_queue *mq, struct route_node *rn)
 {
   struct rib *rib;
+  struct meta_queue_entry *entry;
   char buf[INET6_ADDRSTRLEN];
 
   if (IS_ZEBRA_DEBUG_RIB_Q)
@@ -1251,17 +1524,26 @@ rib_meta_queue_add (struct meta_queue *mq, struct route_node *rn)
       /* Invariant: at this point we always have rn->info set. */
       if (CHECK_FLAG (((struct rib *)rn->info)->rn_status, RIB_ROUTE_QUEUED(qindex)))
 	{
+	  mq->stats[qindex].coalesced++;
 	  if (IS_ZEBRA_DEBUG_RIB_Q)
 	    zlog_debug ("%s: %s/%d: rn %p is already queued in sub-queue %u",
 			__func__, buf, rn->p.prefixlen, rn, qindex);
 	  continue;
 	}
 
+      entry = XMALLOC (MTYPE_RIB_QUEUE, sizeof (struct meta_queue_entry));
+      entry->rn = rn;
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &entry->queued);
+
       SET_FLAG (((struct rib *)rn->info)->rn_status, RIB_ROUTE_QUEUED(qindex));
-      listnode_add (mq->subq[qindex], rn);
+      listnode_add (mq->subq[qindex], entry);
       route_lock_node (rn);
       mq->size++;
 
+      mq->stats[qindex].queued++;
+      meta_queue_hist_add (mq->stats[qindex].depth,
+			   listcount (mq->subq[qindex]));
+
       if (IS_ZEBRA_DEBUG_RIB_Q)
 	zlog_debug ("%s: %s/%d: queued rn %p into sub-queue %u",
 		    __func__, buf, rn->p.prefixlen, rn, qindex);
@@ -1317,6 +1599,19 @@ meta_queue_new (void)
   return new;
 }
 
+static struct fib_queue *
+fib_queue_new (void)
+{
+  struct fib_queue *new;
+
+  new = XCALLOC (MTYPE_WORK_QUEUE, sizeof (struct fib_queue));
+  new->updates = list_new ();
+  new->pending = hash_create_size (4096, fib_update_hash_key,
+                                   fib_update_hash_cmp);
+  new->pending->name = "FIB pending updates";
+  return new;
+}
+
 /* initialise zebra rib work queue */
 static void
 rib_queue_init (struct zebra_t *zebra)
@@ -1337,6 +1632,20 @@ rib_queue_init (struct zebra_t *zebra)
   
   if (!(zebra->mq = meta_queue_new ()))
     zlog_err ("%s: could not initialise meta queue!", __func__);
+
+  if (! (zebra->fibq = work_queue_new (zebra->master,
+                                       "kernel route updates")))
+    {
+      zlog_err ("%s: could not initialise FIB work queue!", __func__);
+      return;
+    }
+
+  zebra->fibq->spec.workfunc = &fib_queue_process;
+  zebra->fibq->spec.errorfunc = NULL;
+  zebra->fibq->spec.max_retries = 3;
+  zebra->fibq->spec.hold = rib_process_hold_time;
+
+  zebra->fq = fib_queue_new ();
 }
 
 /* RIB updates are processed via a queue of pointers to route_nodes.
@@ -1349,7 +1658,8 @@ rib_queue_init (struct zebra_t *zebra)
  * and then submit route_node to queue for best-path selection later.
  * Order of add/delete state changes are preserved for any given RIB.
  *
- * Deleted RIBs are reaped during best-path selection.
+ * Deleted RIBs are reaped during best-path selection, or at once by
+ * rib_delnode if they were never selected.
  *
  * rib_addnode
  * |-> rib_link or unset RIB_ENTRY_REMOVE        |->Update kernel with
@@ -1464,6 +1774,8 @@ rib_unlink (struct route_node *rn, struct rib *rib)
         }
     }
 
+  fib_queue_forget (rn, rib);
+
   /* free RIB and nexthops */
   for (nexthop = rib->nexthop; nexthop; nexthop = next)
     {
@@ -1486,6 +1798,21 @@ rib_delnode (struct route_node *rn, struct rib *rib)
       buf, rn->p.prefixlen, rn, rib);
   }
   SET_FLAG (rib->status, RIB_ENTRY_REMOVED);
+
+  /* An entry which isn't selected was never passed to the kernel or to
+   * clients, and rib_process() would only free it.  Do that now, while
+   * another entry keeps the node and its queue state, so a prefix which
+   * is replaced or withdrawn many times before the queue gets to it
+   * only carries the latest entry, and is processed once.
+   */
+  if (! CHECK_FLAG (rib->flags, ZEBRA_FLAG_SELECTED)
+      && (rib->prev || rib->next))
+    {
+      zebrad.mq->reaped++;
+      rib_unlink (rn, rib);
+      return;
+    }
+
   rib_queue_add (&zebrad, rn);
 }
 
@@ -2941,6 +3268,7 @@ rib_close_table (struct route_table *table)
 void
 rib_close (void)
 {
+  fib_queue_drain ();
   rib_close_table (vrf_table (AFI_IP, SAFI_UNICAST, 0));
   rib_close_table (vrf_table (AFI_IP6, SAFI_UNICAST, 0));
 }
@@ -0,0 +1,376 @@
+/*
+ * Nexthop tracking for zebra clients.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/* Clients register the addresses they use as nexthops, and are sent a
+ * ZEBRA_NEXTHOP_UPDATE with the route resolving an address when they
+ * register it and whenever that changes, instead of having to poll with
+ * nexthop lookups.
+ */
+#include <zebra.h>
+
+#include "prefix.h"
+#include "table.h"
+#include "stream.h"
+#include "memory.h"
+#include "linklist.h"
+#include "command.h"
+#include "log.h"
+#include "zclient.h"
+
+#include "zebra/rib.h"
+#include "zebra/zserv.h"
+#include "zebra/zebra_rnh.h"
+
+/* A registered nexthop.  The resolution last sent for it is kept so
+   that route changes which don't alter it are not sent on. */
+struct rnh
+{
+  /* Clients which registered the address. */
+  struct list *clients;
+
+  /* Encoded ZEBRA_NEXTHOP_UPDATE body last sent. */
+  u_char *state;
+  size_t state_len;
+
+  u_int32_t metric;
+  u_char nexthop_num;
+
+  unsigned long updates;
+};
+
+/* Registered nexthops, as host prefixes. */
+static struct route_table *rnh_table[AFI_MAX];
+
+/* Scratch buffer the resolution is encoded into. */
+static struct stream *rnh_stream;
+
+static void
+rnh_free (struct rnh *rnh)
+{
+  list_free (rnh->clients);
+  if (rnh->state)
+    XFREE (MTYPE_RNH, rnh->state);
+  XFREE (MTYPE_RNH, rnh);
+}
+
+/* Encode the route the address resolves over now: its metric and its
+   installed nexthops, as in a nexthop lookup reply. */
+static void
+rnh_encode (struct stream *s, struct prefix *p, struct rnh *rnh)
+{
+  struct rib *rib = NULL;
+  struct nexthop *nexthop;
+  unsigned long nump;
+  u_char num = 0;
+
+  stream_reset (s);
+  stream_putc (s, p->family);
+  stream_put (s, &p->u.prefix, PSIZE (p->prefixlen));
+
+  if (p->family == AF_INET)
+    rib = rib_match_ipv4 (p->u.prefix4);
+#ifdef HAVE_IPV6
+  else if (p->family == AF_INET6)
+    rib = rib_match_ipv6 (&p->u.prefix6);
+#endif /* HAVE_IPV6 */
+
+  rnh->metric = rib ? rib->metric : 0;
+  stream_putl (s, rnh->metric);
+  nump = stream_get_endp (s);
+  stream_putc (s, 0);
+
+  if (rib)
+    for (nexthop = rib->nexthop; nexthop; nexthop = nexthop->next)
+      if (CHECK_FLAG (nexthop->flags, NEXTHOP_FLAG_FIB))
+	{
+	  stream_putc (s, nexthop->type);
+	  switch (nexthop->type)
+	    {
+	    case ZEBRA_NEXTHOP_IPV4:
+	      stream_put_in_addr (s, &nexthop->gate.ipv4);
+	      break;
+#ifdef HAVE_IPV6
+	    case ZEBRA_NEXTHOP_IPV6:
+	      stream_put (s, &nexthop->gate.ipv6, 16);
+	      break;
+	    case ZEBRA_NEXTHOP_IPV6_IFINDEX:
+	    case ZEBRA_NEXTHOP_IPV6_IFNAME:
+	      stream_put (s, &nexthop->gate.ipv6, 16);
+	      stream_putl (s, nexthop->ifindex);
+	      break;
+#endif /* HAVE_IPV6 */
+	    case ZEBRA_NEXTHOP_IFINDEX:
+	    case ZEBRA_NEXTHOP_IFNAME:
+	      stream_putl (s, nexthop->ifindex);
+	      break;
+	    default:
+	      /* do nothing */
+	      break;
+	    }
+	  num++;
+	}
+  stream_putc_at (s, nump, num);
+  rnh->nexthop_num = num;
+}
+
+/* Resolve a registered nexthop again, and send the result to all its
+   clients if it changed, or else only to client, if that's given. */
+static void
+rnh_evaluate (struct route_node *rn, struct zserv *client)
+{
+  struct rnh *rnh = rn->info;
+  struct listnode *node;
+  struct zserv *c;
+  size_t len;
+
+  rnh_encode (rnh_stream, &rn->p, rnh);
+  len = stream_get_endp (rnh_stream);
+
+  if (rnh->state && rnh->state_len == len
+      && ! memcmp (rnh->state, STREAM_DATA (rnh_stream), len))
+    {
+      if (client)
+	zsend_nexthop_update (client, STREAM_DATA (rnh_stream), len);
+      return;
+    }
+
+  if (rnh->state)
+    XFREE (MTYPE_RNH, rnh->state);
+  rnh->state = XMALLOC (MTYPE_RNH, len);
+  memcpy (rnh->state, STREAM_DATA (rnh_stream), len);
+  rnh->state_len = len;
+  rnh->updates++;
+
+  for (ALL_LIST_ELEMENTS_RO (rnh->clients, node, c))
+    zsend_nexthop_update (c, STREAM_DATA (rnh_stream), len);
+}
+
+/* Read one address of a register or unregister message. */
+static int
+rnh_read_prefix (struct stream *s, struct prefix *p)
+{
+  memset (p, 0, sizeof (struct prefix));
+
+  if (STREAM_READABLE (s) < 1)
+    return -1;
+  p->family = stream_getc (s);
+
+  switch (p->family)
+    {
+    case AF_INET:
+      p->prefixlen = IPV4_MAX_BITLEN;
+      break;
+#ifdef HAVE_IPV6
+    case AF_INET6:
+      p->prefixlen = IPV6_MAX_BITLEN;
+      break;
+#endif /* HAVE_IPV6 */
+    default:
+      zlog_warn ("%s: unknown address family %d", __func__, p->family);
+      return -1;
+    }
+
+  if (STREAM_READABLE (s) < (size_t) PSIZE (p->prefixlen))
+    return -1;
+  stream_get (&p->u.prefix, s, PSIZE (p->prefixlen));
+  return 0;
+}
+
+/* Drop a client's registration of a nexthop.  Takes the node's lock
+   held by the caller. */
+static void
+rnh_client_remove (struct route_node *rn, struct zserv *client)
+{
+  struct rnh *rnh = rn->info;
+
+  listnode_delete (rnh->clients, client);
+  if (listcount (rnh->clients) == 0)
+    {
+      rnh_free (rnh);
+      rn->info = NULL;
+      route_unlock_node (rn);
+    }
+  route_unlock_node (rn);
+}
+
+/* ZEBRA_NEXTHOP_REGISTER: one or more addresses to track. */
+void
+zebra_rnh_register (struct zserv *client, u_short length)
+{
+  struct prefix p;
+  struct route_node *rn;
+  struct rnh *rnh;
+
+  while (rnh_read_prefix (client->ibuf, &p) == 0)
+    {
+      rn = route_node_get (rnh_table[family2afi (p.family)], &p);
+      if (rn->info)
+	{
+	  rnh = rn->info;
+	  route_unlock_node (rn);
+	}
+      else
+	{
+	  rnh = XCALLOC (MTYPE_RNH, sizeof (struct rnh));
+	  rnh->clients = list_new ();
+	  rn->info = rnh;
+	}
+
+      if (! listnode_lookup (rnh->clients, client))
+	listnode_add (rnh->clients, client);
+
+      rnh_evaluate (rn, client);
+    }
+}
+
+/* ZEBRA_NEXTHOP_UNREGISTER: addresses no longer of interest. */
+void
+zebra_rnh_unregister (struct zserv *client, u_short length)
+{
+  struct prefix p;
+  struct route_node *rn;
+
+  while (rnh_read_prefix (client->ibuf, &p) == 0)
+    {
+      rn = route_node_lookup (rnh_table[family2afi (p.family)], &p);
+      if (! rn)
+	continue;
+      if (listnode_lookup (((struct rnh *) rn->info)->clients, client))
+	rnh_client_remove (rn, client);
+      else
+	route_unlock_node (rn);
+    }
+}
+
+/* A client has gone, drop everything it registered. */
+void
+zebra_rnh_client_close (struct zserv *client)
+{
+  struct route_node *rn;
+  afi_t afi;
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    if (rnh_table[afi])
+      for (rn = route_top (rnh_table[afi]); rn; rn = route_next (rn))
+	if (rn->info
+	    && listnode_lookup (((struct rnh *) rn->info)->clients, client))
+	  {
+	    /* Keep the node for route_next. */
+	    route_lock_node (rn);
+	    rnh_client_remove (rn, client);
+	  }
+}
+
+/* The route at rib_rn has changed.  Only registered addresses within
+   its prefix can resolve over it, so only those are looked at. */
+void
+zebra_rnh_check (struct route_node *rib_rn)
+{
+  struct route_table *table;
+  struct route_node *top;
+  struct route_node *rn;
+  struct prefix *p = &rib_rn->p;
+
+  table = rnh_table[family2afi (p->family)];
+  if (! table)
+    return;
+
+  top = table->top;
+  while (top && top->p.prefixlen < p->prefixlen
+	 && prefix_match (&top->p, p))
+    top = top->link[prefix_bit (&p->u.prefix, top->p.prefixlen)];
+
+  if (! top || ! prefix_match (p, &top->p))
+    return;
+
+  route_lock_node (top);
+  for (rn = top; rn; rn = route_next_until (rn, top))
+    if (rn->info)
+      rnh_evaluate (rn, NULL);
+}
+
+static void
+rnh_show (struct vty *vty, afi_t afi)
+{
+  struct route_node *rn;
+  struct rnh *rnh;
+  char buf[INET6_ADDRSTRLEN];
+
+  if (! rnh_table[afi])
+    return;
+
+  for (rn = route_top (rnh_table[afi]); rn; rn = route_next (rn))
+    if ((rnh = rn->info) != NULL)
+      {
+	inet_ntop (rn->p.family, &rn->p.u.prefix, buf, INET6_ADDRSTRLEN);
+	if (rnh->nexthop_num)
+	  vty_out (vty, "%s resolved, metric %u, %u nexthop%s",
+		   buf, rnh->metric, rnh->nexthop_num,
+		   rnh->nexthop_num == 1 ? "" : "s");
+	else
+	  vty_out (vty, "%s unresolved", buf);
+	vty_out (vty, ", %u client%s, %lu update%s%s",
+		 listcount (rnh->clients),
+		 listcount (rnh->clients) == 1 ? "" : "s",
+		 rnh->updates, rnh->updates == 1 ? "" : "s", VTY_NEWLINE);
+      }
+}
+
+DEFUN (show_ip_nht,
+       show_ip_nht_cmd,
+       "show ip nht",
+       SHOW_STR
+       IP_STR
+       "IP nexthop tracking table\n")
+{
+  rnh_show (vty, AFI_IP);
+  return CMD_SUCCESS;
+}
+
+#ifdef HAVE_IPV6
+DEFUN (show_ipv6_nht,
+       show_ipv6_nht_cmd,
+       "show ipv6 nht",
+       SHOW_STR
+       IPV6_STR
+       "IPv6 nexthop tracking table\n")
+{
+  rnh_show (vty, AFI_IP6);
+  return CMD_SUCCESS;
+}
+#endif /* HAVE_IPV6 */
+
+void
+zebra_rnh_init (void)
+{
+  rnh_table[AFI_IP] = route_table_init ();
+#ifdef HAVE_IPV6
+  rnh_table[AFI_IP6] = route_table_init ();
+#endif /* HAVE_IPV6 */
+  rnh_stream = stream_new (ZEBRA_MAX_PACKET_SIZ);
+
+  install_element (VIEW_NODE, &show_ip_nht_cmd);
+  install_element (ENABLE_NODE, &show_ip_nht_cmd);
+#ifdef HAVE_IPV6
+  install_element (VIEW_NODE, &show_ipv6_nht_cmd);
+  install_element (ENABLE_NODE, &show_ipv6_nht_cmd);
+#endif /* HAVE_IPV6 */
+}
@@ -0,0 +1,36 @@
+/*
+ * Nexthop tracking for zebra clients.
+ *
+ * This file is part of Quagga.
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _ZEBRA_RNH_H
+#define _ZEBRA_RNH_H
+
+#include "table.h"
+#include "zebra/zserv.h"
+
+extern void zebra_rnh_init (void);
+extern void zebra_rnh_register (struct zserv *, u_short);
+extern void zebra_rnh_unregister (struct zserv *, u_short);
+extern void zebra_rnh_client_close (struct zserv *);
+
+/* The selected or installed route at a RIB node has changed. */
+extern void zebra_rnh_check (struct route_node *);
+
+#endif /* _ZEBRA_RNH_H */
@@ -30,6 +30,8 @@
 
 #include "zebra/zserv.h"
 
+extern struct zebra_t zebrad;
+
 /* General fucntion for static route. */
 static int
 zebra_static_ipv4 (struct vty *vty, int add_cmd, const char *dest_str,
@@ -1089,6 +1091,12 @@ vty_show_ip_route_summary (struct vty *vty, struct route_table *table)
   vty_out (vty, "------%s", VTY_NEWLINE);
   vty_out (vty, "%-20s %-20d %-20d %s", "Totals", rib_cnt[ZEBRA_ROUTE_TOTAL], 
 	   fib_cnt[ZEBRA_ROUTE_TOTAL], VTY_NEWLINE);  
+
+  if (zebrad.fq)
+    vty_out (vty, "%sKernel updates: %lu queued, %lu merged, %lu applied, "
+	     "%u pending%s", VTY_NEWLINE, zebrad.fq->queued,
+	     zebrad.fq->coalesced, zebrad.fq->applied,
+	     listcount (zebrad.fq->updates), VTY_NEWLINE);
 }
 
 /* Show route summary.  */
@@ -1111,6 +1119,79 @@ DEFUN (show_ip_route_summary,
   return CMD_SUCCESS;
 }
 
+static const char *meta_queue_names[MQ_SIZE] =
+{
+  "connected, kernel",
+  "static",
+  "IGP",
+  "BGP",
+  "other",
+};
+
+/* Print the non-empty buckets of two histograms side by side. */
+static void
+vty_show_meta_queue_hist (struct vty *vty, unsigned long *depth,
+			  unsigned long *latency)
+{
+  char range[32];
+  unsigned int i;
+
+  vty_out (vty, "  %-20s %12s %16s%s", "Range", "Depth", "Latency (usec)",
+	   VTY_NEWLINE);
+  for (i = 0; i < MQ_HIST_SIZE; i++)
+    {
+      if (! depth[i] && ! latency[i])
+	continue;
+      if (i == 0)
+	snprintf (range, sizeof (range), "0");
+      else if (i == 1)
+	snprintf (range, sizeof (range), "1");
+      else if (i == MQ_HIST_SIZE - 1)
+	snprintf (range, sizeof (range), "%lu-", 1UL << (i - 1));
+      else
+	snprintf (range, sizeof (range), "%lu-%lu",
+		  1UL << (i - 1), (1UL << i) - 1);
+      vty_out (vty, "  %-20s %12lu %16lu%s", range, depth[i], latency[i],
+	       VTY_NEWLINE);
+    }
+}
+
+DEFUN (show_rib_queue,
+       show_rib_queue_cmd,
+       "show rib queue",
+       SHOW_STR
+       "Routing information base\n"
+       "Route processing queue statistics\n")
+{
+  struct meta_queue *mq = zebrad.mq;
+  struct meta_queue_stats *st;
+  unsigned long processed = 0;
+  unsigned int i;
+
+  if (! mq)
+    return CMD_SUCCESS;
+
+  for (i = 0; i < MQ_SIZE; i++)
+    processed += mq->stats[i].processed;
+
+  vty_out (vty, "%u nodes waiting, %lu processed in %lu runs, "
+	   "%lu entries freed unprocessed%s", mq->size, processed, mq->runs,
+	   mq->reaped, VTY_NEWLINE);
+
+  for (i = 0; i < MQ_SIZE; i++)
+    {
+      st = &mq->stats[i];
+      vty_out (vty, "%sSub-queue %u (%s): %lu queued, %lu merged, "
+	       "%lu processed, %u waiting%s", VTY_NEWLINE, i,
+	       meta_queue_names[i], st->queued, st->coalesced, st->processed,
+	       listcount (mq->subq[i]), VTY_NEWLINE);
+      if (st->queued)
+	vty_show_meta_queue_hist (vty, st->depth, st->latency);
+    }
+
+  return CMD_SUCCESS;
+}
+
 /* Write IPv4 static route configuration. */
 static int
 static_config_ipv4 (struct vty *vty)
@@ -2088,6 +2169,8 @@ zebra_vty_init (void)
   install_element (ENABLE_NODE, &show_ip_route_protocol_cmd);
   install_element (ENABLE_NODE, &show_ip_route_supernets_cmd);
   install_element (ENABLE_NODE, &show_ip_route_summary_cmd);
+  install_element (VIEW_NODE, &show_rib_queue_cmd);
+  install_element (ENABLE_NODE, &show_rib_queue_cmd);
 
 #ifdef HAVE_IPV6
   install_element (CONFIG_NODE, &ipv6_route_cmd);
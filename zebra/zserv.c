@@ -42,10 +42,17 @@
 #include "zebra/redistribute.h"
 #include "zebra/debug.h"
 #include "zebra/ipforward.h"
+#include "zebra/zebra_rnh.h"
 
 /* Event list of zebra. */
 enum event { ZEBRA_SERV, ZEBRA_READ, ZEBRA_WRITE };
 
+/* Size of the buffer a client's messages are read into, and how much
+   of them one run of zebra_client_read handles. */
+#define ZSERV_READ_BUFSIZ         (4 * ZEBRA_MAX_PACKET_SIZ)
+#define ZSERV_READ_BUDGET_BYTES   (1024 * 1024)
+#define ZSERV_READ_BUDGET_MSEC    20
+
 extern struct zebra_t zebrad;
 
 static void zebra_event (enum event event, int sock, struct zserv *client);
@@ -691,6 +698,24 @@ zsend_router_id_update (struct zserv *client, struct prefix *p)
   return zebra_server_send_message(client);
 }
 
+/* Resolution of a registered nexthop has changed.  Send
+   ZEBRA_NEXTHOP_UPDATE, with the body already encoded, to client. */
+int
+zsend_nexthop_update (struct zserv *client, u_char *data, size_t len)
+{
+  struct stream *s;
+
+  s = client->obuf;
+  stream_reset (s);
+
+  zserv_create_header (s, ZEBRA_NEXTHOP_UPDATE);
+  stream_put (s, data, len);
+
+  stream_putw_at (s, 0, stream_get_endp (s));
+
+  return zebra_server_send_message(client);
+}
+
 /* Register zebra server interface information.  Send current all
    interface and address information. */
 static int
@@ -1127,6 +1152,9 @@ zebra_score_rib (int client_sock)
 static void
 zebra_client_close (struct zserv *client)
 {
+  /* Forget the nexthops it registered. */
+  zebra_rnh_client_close (client);
+
   /* Close file descriptor. */
   if (client->sock)
     {
@@ -1140,6 +1168,8 @@ zebra_client_close (struct zserv *client)
     stream_free (client->ibuf);
   if (client->obuf)
     stream_free (client->obuf);
+  if (client->rbuf)
+    stream_free (client->rbuf);
   if (client->wb)
     buffer_free(client->wb);
 
@@ -1168,6 +1198,7 @@ zebra_client_create (int sock)
   client->sock = sock;
   client->ibuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
   client->obuf = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  client->rbuf = stream_new (ZSERV_READ_BUFSIZ);
   client->wb = buffer_new(0);
 
   /* Set table number. */
@@ -1180,57 +1211,27 @@ zebra_client_create (int sock)
   zebra_event (ZEBRA_READ, sock, client);
 }
 
-/* Handler of zebra service request. */
+/* Handle the first message in the client's read buffer, if all of it
+   has been read.  Returns 1 if a message was handled, 0 if more data
+   is needed, and -1 if the client was closed. */
 static int
-zebra_client_read (struct thread *thread)
+zebra_client_dispatch (struct zserv *client)
 {
-  int sock;
-  struct zserv *client;
-  size_t already;
+  int sock = client->sock;
+  struct stream *s = client->rbuf;
+  size_t getp;
   uint16_t length, command;
   uint8_t marker, version;
 
-  /* Get thread data.  Reset reading thread because I'm running. */
-  sock = THREAD_FD (thread);
-  client = THREAD_ARG (thread);
-  client->t_read = NULL;
-
-  if (client->t_suicide)
-    {
-      zebra_client_close(client);
-      return -1;
-    }
-
-  /* Read length and command (if we don't have it already). */
-  if ((already = stream_get_endp(client->ibuf)) < ZEBRA_HEADER_SIZE)
-    {
-      ssize_t nbyte;
-      if (((nbyte = stream_read_try (client->ibuf, sock,
-				     ZEBRA_HEADER_SIZE-already)) == 0) ||
-	  (nbyte == -1))
-	{
-	  if (IS_ZEBRA_DEBUG_EVENT)
-	    zlog_debug ("connection closed socket [%d]", sock);
-	  zebra_client_close (client);
-	  return -1;
-	}
-      if (nbyte != (ssize_t)(ZEBRA_HEADER_SIZE-already))
-	{
-	  /* Try again later. */
-	  zebra_event (ZEBRA_READ, sock, client);
-	  return 0;
-	}
-      already = ZEBRA_HEADER_SIZE;
-    }
-
-  /* Reset to read from the beginning of the incoming packet. */
-  stream_set_getp(client->ibuf, 0);
+  if (STREAM_READABLE (s) < ZEBRA_HEADER_SIZE)
+    return 0;
 
   /* Fetch header values */
-  length = stream_getw (client->ibuf);
-  marker = stream_getc (client->ibuf);
-  version = stream_getc (client->ibuf);
-  command = stream_getw (client->ibuf);
+  getp = stream_get_getp (s);
+  length = stream_getw_from (s, getp);
+  marker = stream_getc_from (s, getp + 2);
+  version = stream_getc_from (s, getp + 3);
+  command = stream_getw_from (s, getp + 4);
 
   if (marker != ZEBRA_HEADER_MARKER || version != ZSERV_VERSION)
     {
@@ -1254,26 +1255,14 @@ zebra_client_read (struct thread *thread)
       return -1;
     }
 
-  /* Read rest of data. */
-  if (already < length)
-    {
-      ssize_t nbyte;
-      if (((nbyte = stream_read_try (client->ibuf, sock,
-				     length-already)) == 0) ||
-	  (nbyte == -1))
-	{
-	  if (IS_ZEBRA_DEBUG_EVENT)
-	    zlog_debug ("connection closed [%d] when reading zebra data", sock);
-	  zebra_client_close (client);
-	  return -1;
-	}
-      if (nbyte != (ssize_t)(length-already))
-        {
-	  /* Try again later. */
-	  zebra_event (ZEBRA_READ, sock, client);
-	  return 0;
-	}
-    }
+  /* Wait for the rest of the message. */
+  if (STREAM_READABLE (s) < length)
+    return 0;
+
+  stream_reset (client->ibuf);
+  stream_put (client->ibuf, stream_pnt (s), length);
+  stream_forward_getp (s, length);
+  stream_set_getp (client->ibuf, ZEBRA_HEADER_SIZE);
 
   length -= ZEBRA_HEADER_SIZE;
 
@@ -1285,6 +1274,7 @@ zebra_client_read (struct thread *thread)
     zlog_debug ("zebra message received [%s] %d", 
 	       zserv_command_string (command), length);
 
+  /* Route messages may carry several routes, one after another. */
   switch (command) 
     {
     case ZEBRA_ROUTER_ID_ADD:
@@ -1300,17 +1290,21 @@ zebra_client_read (struct thread *thread)
       zread_interface_delete (client, length);
       break;
     case ZEBRA_IPV4_ROUTE_ADD:
-      zread_ipv4_add (client, length);
+      while (STREAM_READABLE (client->ibuf))
+	zread_ipv4_add (client, length);
       break;
     case ZEBRA_IPV4_ROUTE_DELETE:
-      zread_ipv4_delete (client, length);
+      while (STREAM_READABLE (client->ibuf))
+	zread_ipv4_delete (client, length);
       break;
 #ifdef HAVE_IPV6
     case ZEBRA_IPV6_ROUTE_ADD:
-      zread_ipv6_add (client, length);
+      while (STREAM_READABLE (client->ibuf))
+	zread_ipv6_add (client, length);
       break;
     case ZEBRA_IPV6_ROUTE_DELETE:
-      zread_ipv6_delete (client, length);
+      while (STREAM_READABLE (client->ibuf))
+	zread_ipv6_delete (client, length);
       break;
 #endif /* HAVE_IPV6 */
     case ZEBRA_REDISTRIBUTE_ADD:
@@ -1339,6 +1333,12 @@ zebra_client_read (struct thread *thread)
     case ZEBRA_HELLO:
       zread_hello (client);
       break;
+    case ZEBRA_NEXTHOP_REGISTER:
+      zebra_rnh_register (client, length);
+      break;
+    case ZEBRA_NEXTHOP_UNREGISTER:
+      zebra_rnh_unregister (client, length);
+      break;
     default:
       zlog_info ("Zebra received unknown command %d", command);
       break;
@@ -1351,7 +1351,69 @@ zebra_client_read (struct thread *thread)
       return -1;
     }
 
-  stream_reset (client->ibuf);
+  return 1;
+}
+
+/* Handler of zebra service request.  Reads and handles whatever the
+   client has sent, up to ZSERV_READ_BUDGET_BYTES or for about
+   ZSERV_READ_BUDGET_MSEC, so that a client pushing a full table does
+   not cost one read and one thread per route, nor starve the others. */
+static int
+zebra_client_read (struct thread *thread)
+{
+  int sock;
+  int ret;
+  struct zserv *client;
+  struct timeval start, now;
+  size_t total, room;
+  ssize_t nbyte;
+
+  /* Get thread data.  Reset reading thread because I'm running. */
+  sock = THREAD_FD (thread);
+  client = THREAD_ARG (thread);
+  client->t_read = NULL;
+
+  if (client->t_suicide)
+    {
+      zebra_client_close(client);
+      return -1;
+    }
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &start);
+
+  for (total = 0; total < ZSERV_READ_BUDGET_BYTES; total += nbyte)
+    {
+      /* The buffer holds at least one whole message, so there is
+         always room behind a partial one. */
+      stream_pulldown (client->rbuf);
+      room = STREAM_WRITEABLE (client->rbuf);
+
+      nbyte = stream_read_try (client->rbuf, sock, room);
+      if (nbyte == 0 || nbyte == -1)
+	{
+	  if (IS_ZEBRA_DEBUG_EVENT)
+	    zlog_debug ("connection closed socket [%d]", sock);
+	  zebra_client_close (client);
+	  return -1;
+	}
+      if (nbyte == -2)
+	break;
+
+      while ((ret = zebra_client_dispatch (client)) > 0)
+	;
+      if (ret < 0)
+	return -1;
+
+      /* A short read has emptied the socket. */
+      if ((size_t) nbyte < room)
+	break;
+
+      quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+      if ((now.tv_sec - start.tv_sec) * 1000
+	  + (now.tv_usec - start.tv_usec) / 1000 >= ZSERV_READ_BUDGET_MSEC)
+	break;
+    }
+
   zebra_event (ZEBRA_READ, sock, client);
   return 0;
 }
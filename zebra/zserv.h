@@ -42,6 +42,11 @@ struct zserv
   struct stream *ibuf;
   struct stream *obuf;
 
+  /* Data read from the client, which may hold several messages and
+     the start of one more.  Each message is copied to ibuf to be
+     handled. */
+  struct stream *rbuf;
+
   /* Buffer of data waiting to be written to client. */
   struct buffer *wb;
 
@@ -81,6 +86,10 @@ struct zebra_t
   /* rib work queue */
   struct work_queue *ribq;
   struct meta_queue *mq;
+
+  /* kernel update work queue */
+  struct work_queue *fibq;
+  struct fib_queue *fq;
 };
 
 /* Count prefix size from mask length */
@@ -107,6 +116,7 @@ extern int zsend_interface_update (int, struct zserv *, struct interface *);
 extern int zsend_route_multipath (int, struct zserv *, struct prefix *, 
                                   struct rib *);
 extern int zsend_router_id_update(struct zserv *, struct prefix *);
+extern int zsend_nexthop_update (struct zserv *, u_char *, size_t);
 
 extern pid_t pid;
 